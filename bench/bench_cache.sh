@@ -0,0 +1,46 @@
+#!/bin/sh
+#
+# Time nop -b on a generated source with and without the module cache. The
+# first run with -c writes the cache and the others read it. The source and
+# the cache are written to a temporary directory. Needs ../src/nop to be
+# built.
+#
+# usage: bench_cache.sh [kbytes] [runs]
+#
+NOP=../src/nop
+KB=${1:-8192}
+RUNS=${2:-3}
+DIR=$(mktemp -d)
+
+if [ ! -x $NOP ]; then
+    echo "$NOP is not built"
+    exit 1
+fi
+
+make -s gen_corpus || exit 1
+./gen_corpus -s nest -k $KB > $DIR/nest.nop
+
+run() {
+    start=$(date +%s.%N)
+    $NOP -b $1 $DIR/nest.nop > /dev/null
+    status=$?
+    end=$(date +%s.%N)
+    echo "$2 $start $end $status" | \
+        awk '{ printf("mode: %s sec: %.3f status: %d\n", $1, $3 - $2, $4) }'
+}
+
+i=0
+while [ $i -lt $RUNS ]; do
+    run "" parse
+    i=$((i + 1))
+done
+
+run -c write
+i=0
+while [ $i -lt $RUNS ]; do
+    run -c cached
+    i=$((i + 1))
+done
+ls -l $DIR/nest.nop $DIR/nest.nopc | awk '{ printf("file: %s bytes: %s\n", $9, $5) }'
+
+rm -rf $DIR
@@ -0,0 +1,26 @@
+/*
+ * Scaffolding linked into every benchmark.
+ */
+#include <stddef.h>
+#include <time.h>
+
+#include "context.h"
+#include "scanner.h"
+#include "bench_common.h"
+
+int verbosity = 0; // referenced by errors.c
+
+/*
+ * Normally provided by context.c and the scanner, which need the parser.
+ * They are weak so that the benchmarks that link those get the real ones.
+ */
+__attribute__((weak)) parse_ctx_t* get_context() { return NULL; }
+__attribute__((weak)) int get_line_no() { return 0; }
+__attribute__((weak)) int get_col_no() { return 0; }
+
+double now() {
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
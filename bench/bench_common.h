@@ -0,0 +1,23 @@
+/*
+ * What the benchmarks here share.
+ */
+#ifndef __BENCH_COMMON_H__
+#define __BENCH_COMMON_H__
+
+/*
+ * Declare the tests of a benchmark as the enum test_t, ending in NUM_TESTS,
+ * and their names in test_names[], from one list, such as
+ *
+ *   #define TESTS(X) X(TEST_DIGIT, "digit") X(TEST_NEWLINE, "newline")
+ *   BENCH_TESTS(TESTS);
+ */
+#define BENCH_TEST_ID(id, name)     id,
+#define BENCH_TEST_NAME(id, name)   name,
+#define BENCH_TESTS(list) \
+    typedef enum { list(BENCH_TEST_ID) NUM_TESTS } test_t; \
+    static const char* test_names[] = { list(BENCH_TEST_NAME) }
+
+// seconds on the monotonic clock
+double now();
+
+#endif /* __BENCH_COMMON_H__ */
@@ -0,0 +1,149 @@
+/*
+ * Time reporting a file's worth of errors through a diagnostics sink and
+ * writing them out in one piece, against printing each one as it is found
+ * on an unbuffered stream, which is how syntax errors went to stderr
+ * before. The output goes to /dev/null, so what is timed is the formatting
+ * and the calls, not a terminal. The tests are:
+ *
+ *   distinct   every error is at its own line
+ *   repeated   the errors are 100 messages at 100 places over and over,
+ *              the way a cascade after one bad token looks
+ *
+ * Each test keeps the fastest of several runs, and the results are printed
+ * as one JSON object per line:
+ *
+ *   {"bench":"diags","test":"distinct","way":"sink","format":"text",
+ *    "errors":..,"seconds":..,"errors_per_sec":..,"written":..}
+ *
+ * where the way is "sink" or "printf" and written is the number of records
+ * that were written, which is fewer than the errors when they repeat or go
+ * past the limit. The sink has no limit here unless -l sets one.
+ *
+ * Usage: bench_diags [-n errors] [-l limit] [-r runs]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "memory.h"
+#include "intern.h"
+#include "errors.h"
+#include "context.h"
+#include "bench_common.h"
+
+#define TESTS(X) \
+    X(TEST_DISTINCT, "distinct") \
+    X(TEST_REPEATED, "repeated")
+
+BENCH_TESTS(TESTS);
+
+static FILE* null_out;
+static FILE* raw_out;        // unbuffered, like stderr
+
+static void place(test_t test, long i, int* line, int* col) {
+
+    *line = (test == TEST_DISTINCT)? (int)i + 1: (int)(i % 100) + 1;
+    *col = (int)(i % 7) + 1;
+}
+
+static double run_sink(test_t test, diag_format_t fmt, long count, size_t limit,
+                        size_t* written) {
+
+    const char* file = intern_str("bench.nop");
+
+    double start = now();
+    diag_sink_t* sink = create_diag_sink(limit);
+    for(long i = 0; i < count; i++) {
+        int line, col;
+        place(test, i, &line, &col);
+        add_diag(sink, SEV_ERROR, file, line, col, "syntax",
+                    "syntax error, unexpected %s", (i & 1)? "'{'": "IDENTIFIER");
+    }
+    write_diags(sink, null_out, fmt);
+    fflush(null_out);
+    double secs = now() - start;
+
+    *written = sink->count + (sink->dropped > 0);
+    destroy_diag_sink(sink);
+    return secs;
+}
+
+static double run_printf(test_t test, long count, size_t* written) {
+
+    double start = now();
+    for(long i = 0; i < count; i++) {
+        int line, col;
+        place(test, i, &line, &col);
+        fprintf(raw_out, "syntax error: %d: %d: syntax error, unexpected %s\n",
+                    line, col, (i & 1)? "'{'": "IDENTIFIER");
+    }
+    double secs = now() - start;
+
+    *written = (size_t)count;
+    return secs;
+}
+
+static void usage(const char* prog) {
+
+    fprintf(stderr, "usage: %s [-n errors] [-l limit] [-r runs]\n", prog);
+    exit(1);
+}
+
+int main(int argc, char** argv) {
+
+    long count = 100000;
+    long limit = 0;
+    int runs = 5;
+    int opt;
+
+    while((opt = getopt(argc, argv, "n:l:r:")) != -1) {
+        switch(opt) {
+            case 'n':
+                count = atol(optarg);
+                break;
+            case 'l':
+                limit = atol(optarg);
+                break;
+            case 'r':
+                runs = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+    if(optind != argc || count < 1 || limit < 0 || runs < 1)
+        usage(argv[0]);
+
+    null_out = fopen("/dev/null", "w");
+    raw_out = fopen("/dev/null", "w");
+    if(null_out == NULL || raw_out == NULL) {
+        perror("/dev/null");
+        return 1;
+    }
+    setvbuf(raw_out, NULL, _IONBF, 0);
+
+    for(int t = 0; t < NUM_TESTS; t++) {
+        // the sink as text and as JSON, and then the old way
+        for(int way = 0; way < 3; way++) {
+            double best = 0;
+            size_t written = 0;
+            for(int i = 0; i < runs; i++) {
+                double secs = (way < 2)?
+                        run_sink(t, (way == 0)? DIAG_TEXT: DIAG_JSON, count, (size_t)limit, &written):
+                        run_printf(t, count, &written);
+                if(i == 0 || secs < best)
+                    best = secs;
+            }
+            printf("{\"bench\":\"diags\",\"test\":\"%s\",\"way\":\"%s\",\"format\":\"%s\",\"errors\":%ld,\"seconds\":%.6f,\"errors_per_sec\":%.0f,\"written\":%zu}\n",
+                        test_names[t], (way < 2)? "sink": "printf",
+                        (way == 1)? "json": "text", count, best, count / best, written);
+            fflush(stdout);
+        }
+    }
+
+    fclose(null_out);
+    fclose(raw_out);
+    destroy_intern_pool();
+    return 0;
+}
@@ -0,0 +1,172 @@
+/*
+ * Time dicts through the runtime functions that the interpreter and the VM
+ * call for d[k] and d[k] = v, so the time includes checking the key and
+ * interning a string key as well as the hash map. Each test keeps the
+ * fastest of several runs:
+ *
+ *   insert_int     set n int keys, spread out by a large odd multiplier,
+ *                  in a new dict
+ *   lookup_int     read all of them back
+ *   insert_string  set n string keys made with snprintf, which have to be
+ *                  interned, in a new dict
+ *   lookup_string  read them back with the same, uninterned, strings, which
+ *                  keep the hash from the first run
+ *   miss           look up n int keys that are not in the dict
+ *
+ * The results are printed as one JSON object per line:
+ *
+ *   {"bench":"dict","test":"lookup_int","keys":..,"seconds":..,
+ *    "ops_per_sec":..}
+ *
+ * Usage: bench_dict [-n keys] [-r runs]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "memory.h"
+#include "intern.h"
+#include "runtime.h"
+#include "context.h"
+#include "bench_common.h"
+
+#define TESTS(X) \
+    X(TEST_INSERT_INT, "insert_int") \
+    X(TEST_LOOKUP_INT, "lookup_int") \
+    X(TEST_INSERT_STRING, "insert_string") \
+    X(TEST_LOOKUP_STRING, "lookup_string") \
+    X(TEST_MISS, "miss")
+
+BENCH_TESTS(TESTS);
+
+static volatile long sink;
+
+static long int_key(long i) {
+
+    return (i * 2654435761L) & 0xFFFFFFFFFFL;
+}
+
+static void check(rt_error_t err, runtime_t* rt) {
+
+    if(err != RT_OK) {
+        fprintf(stderr, "bench_dict: %s\n", rt->msg);
+        exit(1);
+    }
+}
+
+/*
+ * Run the test on the dict, which the insert tests fill and the others
+ * read. The int keys in the dict are even, so the miss test looks for odd
+ * ones.
+ */
+static double run_test(test_t test, runtime_t* rt, value_t dict, str_t** strs, long n) {
+
+    double start = now();
+    value_t res;
+    long total = 0;
+
+    switch(test) {
+        case TEST_INSERT_INT:
+            for(long i = 0; i < n; i++)
+                check(rt_set_index(rt, dict, INT_VAL(int_key(i) * 2), INT_VAL(i)), rt);
+            break;
+
+        case TEST_LOOKUP_INT:
+            for(long i = 0; i < n; i++) {
+                check(rt_index(rt, dict, INT_VAL(int_key(i) * 2), &res), rt);
+                total += AS_INT(res);
+            }
+            break;
+
+        case TEST_INSERT_STRING:
+            for(long i = 0; i < n; i++)
+                check(rt_set_index(rt, dict, STRING_VAL(strs[i]), INT_VAL(i)), rt);
+            break;
+
+        case TEST_LOOKUP_STRING:
+            for(long i = 0; i < n; i++) {
+                check(rt_index(rt, dict, STRING_VAL(strs[i]), &res), rt);
+                total += AS_INT(res);
+            }
+            break;
+
+        case TEST_MISS:
+            for(long i = 0; i < n; i++) {
+                check(rt_has(rt, dict, INT_VAL(int_key(i) * 2 + 1), &res), rt);
+                total += AS_BOOL(res);
+            }
+            break;
+
+        default:
+            break;
+    }
+    sink = total;
+    return now() - start;
+}
+
+static void usage(const char* prog) {
+
+    fprintf(stderr, "usage: %s [-n keys] [-r runs]\n", prog);
+    exit(1);
+}
+
+int main(int argc, char** argv) {
+
+    long n = 1000000;
+    int runs = 5;
+    int opt;
+    char buf[32];
+
+    while((opt = getopt(argc, argv, "n:r:")) != -1) {
+        switch(opt) {
+            case 'n':
+                n = atol(optarg);
+                break;
+            case 'r':
+                runs = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+    if(optind != argc || n < 1 || runs < 1)
+        usage(argv[0]);
+
+    arena_t* arena = create_arena(0);
+    str_t** strs = ALLOC_LST(n, str_t*);
+    for(long i = 0; i < n; i++) {
+        int len = snprintf(buf, sizeof(buf), "key_%ld", int_key(i));
+        strs[i] = str_new(arena, buf, len);
+    }
+
+    for(int t = 0; t < NUM_TESTS; t++) {
+        double best = 0;
+
+        for(int i = 0; i < runs; i++) {
+            // the lookups need a full dict, made outside of the time
+            runtime_t rt;
+            init_runtime(&rt);
+            value_t dict = rt_zero(&rt, DICT_TYPE(VAL_INT));
+            if(t == TEST_LOOKUP_INT || t == TEST_MISS)
+                run_test(TEST_INSERT_INT, &rt, dict, strs, n);
+            else if(t == TEST_LOOKUP_STRING)
+                run_test(TEST_INSERT_STRING, &rt, dict, strs, n);
+
+            double secs = run_test(t, &rt, dict, strs, n);
+            if(i == 0 || secs < best)
+                best = secs;
+            free_runtime(&rt);
+        }
+
+        printf("{\"bench\":\"dict\",\"test\":\"%s\",\"keys\":%ld,\"seconds\":%.6f,\"ops_per_sec\":%.0f}\n",
+                    test_names[t], n, best, n / ((best > 0)? best: 1e-9));
+        fflush(stdout);
+    }
+
+    FREE(strs);
+    destroy_arena(arena);
+    destroy_intern_pool();
+    return 0;
+}
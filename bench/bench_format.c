@@ -0,0 +1,200 @@
+/*
+ * Time formatted strings through rt_format(), which the interpreter and the
+ * VM call for "..."(args), against the way it worked before format plans:
+ * scanning the format on every call, writing each argument with snprintf()
+ * onto the end of a growing buffer and copying that to the arena. Both make
+ * the same strings. The formats are:
+ *
+ *   ints     "{0} + {1} = {2}" with three ints
+ *   floats   "x = {0}, y = {1}" with a whole and a fractional float
+ *   strings  "{0}/{1}/{2}.nop" with three strings
+ *   log      "[{0}] {1}: read {2} of {3} bytes in {4} ms", the kind of
+ *            line a logging program makes, with a mix of all three
+ *
+ * Each test keeps the fastest of several runs, and the results are printed
+ * as one JSON object per line:
+ *
+ *   {"bench":"format","test":"log","way":"plan","strings":..,"seconds":..,
+ *    "ops_per_sec":..}
+ *
+ * Usage: bench_format [-n strings] [-r runs]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "memory.h"
+#include "intern.h"
+#include "runtime.h"
+#include "context.h"
+#include "bench_common.h"
+
+#define MAX_ARGS    5
+
+typedef struct {
+    const char* name;
+    const char* fmt;
+    int nargs;
+} test_t;
+
+static const test_t tests[] = {
+    { "ints", "{0} + {1} = {2}", 3 },
+    { "floats", "x = {0}, y = {1}", 2 },
+    { "strings", "{0}/{1}/{2}.nop", 3 },
+    { "log", "[{0}] {1}: read {2} of {3} bytes in {4} ms", 5 },
+};
+
+#define NUM_TESTS   (int)(sizeof(tests) / sizeof(tests[0]))
+
+static const char* texts[] = { "src", "tests", "bench", "runtime", "format", "main" };
+
+static str_t* words[6];
+
+static volatile size_t sink;
+
+static void make_args(int test, long i, value_t* args) {
+
+    switch(test) {
+        case 0:
+            args[0] = INT_VAL(i);
+            args[1] = INT_VAL(i * 7919);
+            args[2] = INT_VAL(i + i * 7919);
+            break;
+        case 1:
+            args[0] = FLOAT_VAL((double)(i % 1000));
+            args[1] = FLOAT_VAL(i / 3.0);
+            break;
+        case 2:
+            for(int j = 0; j < 3; j++)
+                args[j] = STRING_VAL(words[(i + j) % 6]);
+            break;
+        default:
+            args[0] = INT_VAL(i);
+            args[1] = STRING_VAL(words[i % 6]);
+            args[2] = INT_VAL(i % 4096);
+            args[3] = INT_VAL(4096);
+            args[4] = FLOAT_VAL((i % 100) / 8.0);
+            break;
+    }
+}
+
+static void add(char** buf, size_t* len, size_t* cap, const char* str, size_t n) {
+
+    if(*len + n + 1 > *cap) {
+        while(*len + n + 1 > *cap)
+            *cap = (*cap == 0)? 128: *cap << 1;
+        *buf = REALLOC(*buf, *cap);
+    }
+    memcpy(*buf + *len, str, n);
+    *len += n;
+    (*buf)[*len] = '\0';
+}
+
+// how a format was made before it had a plan
+static value_t scan_format(runtime_t* rt, const char* fmt, value_t* args, char** buf,
+                        size_t* cap) {
+
+    char tmp[64];
+    size_t len = 0;
+
+    add(buf, &len, cap, "", 0);
+    while(*fmt != '\0') {
+        const char* end;
+        if(*fmt == '{' && fmt[1] >= '0' && fmt[1] <= '9') {
+            int arg = (int)strtol(fmt + 1, (char**)&end, 10);
+            if(*end == '}') {
+                const char* str = format_value(args[arg], tmp, sizeof(tmp));
+                add(buf, &len, cap, str, strlen(str));
+                fmt = end + 1;
+                continue;
+            }
+        }
+        for(end = fmt + 1; *end != '\0' && *end != '{'; end++)
+            ;
+        add(buf, &len, cap, fmt, end - fmt);
+        fmt = end;
+    }
+    return STRING_VAL(str_new(rt->arena, *buf, len));
+}
+
+static double run_test(int test, int plan_way, long n) {
+
+    runtime_t rt;
+    value_t args[MAX_ARGS], res;
+    fmt_plan_t* plan = create_format_plan(tests[test].fmt);
+    char* buf = NULL;
+    size_t cap = 0, total = 0;
+
+    init_runtime(&rt);
+    double start = now();
+    for(long i = 0; i < n; i++) {
+        make_args(test, i, args);
+        if(plan_way) {
+            if(rt_format(&rt, plan, args, tests[test].nargs, &res) != RT_OK) {
+                fprintf(stderr, "bench_format: %s\n", rt.msg);
+                exit(1);
+            }
+        }
+        else
+            res = scan_format(&rt, tests[test].fmt, args, &buf, &cap);
+        total += AS_STRING(res)[0];
+    }
+    double secs = now() - start;
+
+    sink = total;
+    if(buf != NULL)
+        FREE(buf);
+    destroy_format_plan(plan);
+    free_runtime(&rt);
+    return secs;
+}
+
+static void usage(const char* prog) {
+
+    fprintf(stderr, "usage: %s [-n strings] [-r runs]\n", prog);
+    exit(1);
+}
+
+int main(int argc, char** argv) {
+
+    long n = 1000000;
+    int runs = 5;
+    int opt;
+
+    while((opt = getopt(argc, argv, "n:r:")) != -1) {
+        switch(opt) {
+            case 'n':
+                n = atol(optarg);
+                break;
+            case 'r':
+                runs = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+    if(optind != argc || n < 1 || runs < 1)
+        usage(argv[0]);
+
+    for(int i = 0; i < 6; i++)
+        words[i] = STR_OF(intern_str(texts[i]));
+
+    for(int t = 0; t < NUM_TESTS; t++) {
+        for(int way = 0; way < 2; way++) {
+            double best = 0;
+            for(int i = 0; i < runs; i++) {
+                double secs = run_test(t, way, n);
+                if(i == 0 || secs < best)
+                    best = secs;
+            }
+            printf("{\"bench\":\"format\",\"test\":\"%s\",\"way\":\"%s\",\"strings\":%ld,\"seconds\":%.6f,\"ops_per_sec\":%.0f}\n",
+                        tests[t].name, way? "plan": "scan", n, best, n / ((best > 0)? best: 1e-9));
+            fflush(stdout);
+        }
+    }
+
+    destroy_intern_pool();
+    return 0;
+}
@@ -0,0 +1,212 @@
+/*
+ * Time load_imports() on a graph of modules that is made here, in a new
+ * directory under /tmp that is taken away again at the end. The modules are
+ * in layers, and each module imports three modules of the next layer, so
+ * every module below the first layer is imported by about three others and
+ * the graph is full of diamonds. One more file, main.nop, imports the whole
+ * first layer. Each module has a name space with a struct and a few methods
+ * so that there is something to parse. The tests are:
+ *
+ *   dag        the graph as it is
+ *   cycle      the same, with the first module of every layer after the
+ *              first importing the first module of the layer above it,
+ *              which imports it, so there is a cycle for each layer
+ *
+ * Each test is timed with one thread, then two, four and so on up to the
+ * number of processors, keeping the fastest of several runs. The results
+ * are printed as one JSON object per line:
+ *
+ *   {"bench":"imports","test":"dag","modules":..,"threads":..,
+ *    "seconds":..,"modules_per_sec":..,"speedup":..,"parsed":..,
+ *    "cycles":..}
+ *
+ * where parsed is the number of files that were parsed, which must be the
+ * number of modules and main.nop however many imports there are of each,
+ * and speedup is against the time with one thread.
+ *
+ * Usage: bench_imports [-m modules] [-w width] [-j threads] [-r runs]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "memory.h"
+#include "intern.h"
+#include "context.h"
+#include "imports.h"
+#include "bench_common.h"
+
+#define TESTS(X) \
+    X(TEST_DAG, "dag") \
+    X(TEST_CYCLE, "cycle")
+
+BENCH_TESTS(TESTS);
+
+static char dir[] = "/tmp/bench_imports.XXXXXX";
+
+static FILE* open_module(const char* name) {
+
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s.nop", dir, name);
+    FILE* fp = fopen(path, "w");
+    if(fp == NULL) {
+        perror(path);
+        exit(1);
+    }
+    return fp;
+}
+
+/*
+ * Write the modules, numbered from zero, width to a layer. Module m is in
+ * layer m / width and imports three modules of the next layer.
+ */
+static void make_modules(test_t test, int modules, int width) {
+
+    char name[64];
+
+    for(int m = 0; m < modules; m++) {
+        int layer = m / width;
+        int pos = m % width;
+        int next = (layer + 1) * width;
+
+        snprintf(name, sizeof(name), "m%d", m);
+        FILE* fp = open_module(name);
+        for(int i = 0; i < 3 && next < modules; i++) {
+            int dep = next + (pos + i * 7) % width;
+            if(dep < modules)
+                fprintf(fp, "import \"m%d\"\n", dep);
+        }
+        if(test == TEST_CYCLE && layer > 0 && pos == 0)
+            fprintf(fp, "import \"m%d\"\n", (layer - 1) * width);
+
+        fprintf(fp, "\nnamespace m%d {\n", m);
+        fprintf(fp, "    struct rec {\n        int id\n        float weight\n        int total(int n)\n    }\n\n");
+        for(int i = 0; i < 3; i++) {
+            fprintf(fp, "    int rec.total(int n) {\n        int sum = %d\n        int i = 0\n", m + i);
+            fprintf(fp, "        while(i < n) {\n            sum = sum + i * %d\n", i + 3);
+            fprintf(fp, "            i = i + 1\n        }\n        return sum\n    }\n\n");
+        }
+        fprintf(fp, "}\n");
+        fclose(fp);
+    }
+
+    FILE* fp = open_module("main");
+    for(int m = 0; m < width && m < modules; m++)
+        fprintf(fp, "import \"m%d\"\n", m);
+    fprintf(fp, "\nentry {\n    int done = 1\n}\n");
+    fclose(fp);
+}
+
+static void remove_modules(int modules) {
+
+    char path[256];
+
+    for(int m = 0; m < modules; m++) {
+        snprintf(path, sizeof(path), "%s/m%d.nop", dir, m);
+        remove(path);
+    }
+    snprintf(path, sizeof(path), "%s/main.nop", dir);
+    remove(path);
+}
+
+static double run_test(const char* main_file, int threads, size_t* parsed, int* cycles) {
+
+    double start = now();
+    import_graph_t* graph = load_imports(&main_file, 1, threads);
+    double secs = now() - start;
+
+    *parsed = graph->count;
+    *cycles = graph->cycles;
+    destroy_import_graph(graph);
+    return secs;
+}
+
+static void usage(const char* prog) {
+
+    fprintf(stderr, "usage: %s [-m modules] [-w width] [-j threads] [-r runs]\n", prog);
+    exit(1);
+}
+
+int main(int argc, char** argv) {
+
+    int modules = 1000;
+    int width = 20;
+    int max_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int runs = 3;
+    int opt;
+
+    while((opt = getopt(argc, argv, "m:w:j:r:")) != -1) {
+        switch(opt) {
+            case 'm':
+                modules = atoi(optarg);
+                break;
+            case 'w':
+                width = atoi(optarg);
+                break;
+            case 'j':
+                max_threads = atoi(optarg);
+                break;
+            case 'r':
+                runs = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+    if(optind != argc || modules < 1 || width < 1 || runs < 1)
+        usage(argv[0]);
+    if(max_threads < 1)
+        max_threads = 1;
+
+    if(mkdtemp(dir) == NULL) {
+        perror(dir);
+        return 1;
+    }
+    char main_file[256];
+    snprintf(main_file, sizeof(main_file), "%s/main.nop", dir);
+
+    int status = 0;
+    for(int t = 0; t < NUM_TESTS; t++) {
+        make_modules(t, modules, width);
+
+        double single = 0;
+        for(int threads = 1; ; threads <<= 1) {
+            if(threads > max_threads)
+                threads = max_threads;
+
+            double best = 0;
+            size_t parsed = 0;
+            int cycles = 0;
+            for(int i = 0; i < runs; i++) {
+                double secs = run_test(main_file, threads, &parsed, &cycles);
+                if(i == 0 || secs < best)
+                    best = secs;
+            }
+            if(threads == 1)
+                single = best;
+
+            printf("{\"bench\":\"imports\",\"test\":\"%s\",\"modules\":%d,\"threads\":%d,\"seconds\":%.6f,\"modules_per_sec\":%.0f,\"speedup\":%.2f,\"parsed\":%zu,\"cycles\":%d}\n",
+                        test_names[t], modules, threads, best, parsed / best,
+                        single / best, parsed, cycles);
+            fflush(stdout);
+
+            if(parsed != (size_t)modules + 1) {
+                fprintf(stderr, "bench_imports: %zu files parsed for %d modules\n", parsed, modules + 1);
+                status = 1;
+            }
+            if((t == TEST_CYCLE) != (cycles != 0)) {
+                fprintf(stderr, "bench_imports: %d cycles found in the %s test\n", cycles, test_names[t]);
+                status = 1;
+            }
+            if(threads == max_threads)
+                break;
+        }
+
+        remove_modules(modules);
+    }
+
+    rmdir(dir);
+    destroy_intern_pool();
+    return status;
+}
@@ -0,0 +1,31 @@
+#!/bin/sh
+#
+# Time the interpreter and the bytecode VM on primes.nop and sieve.nop,
+# which count the primes below one million, and on the test programs that
+# run. Needs ../src/nop to be built.
+#
+# usage: bench_interp.sh [runs]
+#
+NOP=../src/nop
+RUNS=${1:-3}
+PROGS="primes.nop sieve.nop ../tests/gcd.nop ../tests/recursion.nop"
+
+if [ ! -x $NOP ]; then
+    echo "$NOP is not built"
+    exit 1
+fi
+
+for p in $PROGS; do
+    for mode in -r -b; do
+        i=0
+        while [ $i -lt $RUNS ]; do
+            start=$(date +%s.%N)
+            $NOP $mode $p > /dev/null
+            status=$?
+            end=$(date +%s.%N)
+            echo "$p $mode $start $end $status" | \
+                awk '{ printf("program: %s mode: %s sec: %.3f status: %d\n", $1, $2, $4 - $3, $5) }'
+            i=$((i + 1))
+        done
+    done
+done
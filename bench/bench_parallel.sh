@@ -0,0 +1,40 @@
+#!/bin/sh
+#
+# Time the parser on many files with 1 up to N worker threads. The test
+# sources are copied COPIES times into a scratch directory so that there is
+# enough work to spread out. Needs ../src/nop to be built.
+#
+# usage: bench_parallel.sh [copies] [max jobs]
+#
+NOP=../src/nop
+COPIES=${1:-50}
+MAXJOBS=${2:-$(nproc)}
+WORK=$(mktemp -d)
+trap 'rm -rf $WORK' EXIT
+
+if [ ! -x $NOP ]; then
+    echo "$NOP is not built"
+    exit 1
+fi
+
+i=0
+while [ $i -lt $COPIES ]; do
+    for f in ../tests/*.nop; do
+        cp $f $WORK/$i-$(basename $f)
+    done
+    i=$((i + 1))
+done
+
+FILES=$(ls $WORK/*.nop | wc -l)
+$NOP -j 1 $WORK/*.nop > $WORK/base.txt
+
+j=1
+while [ $j -le $MAXJOBS ]; do
+    start=$(date +%s.%N)
+    $NOP -j $j $WORK/*.nop > $WORK/out.txt
+    end=$(date +%s.%N)
+    if cmp -s $WORK/base.txt $WORK/out.txt; then same=same; else same=DIFFERENT; fi
+    echo "$j $FILES $start $end $same" | \
+        awk '{ printf("jobs: %d files: %d sec: %.3f output: %s\n", $1, $2, $4 - $3, $5) }'
+    j=$((j * 2))
+done
@@ -0,0 +1,189 @@
+/*
+ * Measure the scanner and the parser on whole files. For every file the
+ * scanner is run alone, calling yylex() until the end of the input, and then
+ * the file is parsed with yyparse(), which includes building the AST and
+ * the symbol table. Each is run several times and the fastest run is kept.
+ * The string pool is emptied after every run, so every run interns the
+ * names from scratch the same as the compiler does.
+ *
+ * The results are printed as one JSON object per line so that they can be
+ * kept and compared between builds:
+ *
+ *   {"bench":"lex","file":"nest.nop","bytes":..,"tokens":..,"seconds":..,
+ *    "tokens_per_sec":..,"mb_per_sec":..,"allocs":..,"reallocs":..,
+ *    "alloc_bytes":..,"peak_rss_kb":..,"errors":..}
+ *
+ * The parse line uses the token count of the scan to work out tokens per
+ * second. The allocation counts are for one run. The peak RSS is for the
+ * whole process up to that point, so it only grows from line to line.
+ *
+ * Usage: bench_parse [-r runs] [-m lex|parse|both] file...
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+
+#include "memory.h"
+#include "intern.h"
+#include "context.h"
+#include "parser.h"
+#include "scanner.h"
+#include "bench_common.h"
+
+#define MODE_LEX    0x01
+#define MODE_PARSE  0x02
+
+typedef struct {
+    double seconds;
+    size_t tokens;
+    int errors;
+    alloc_stats_t alloc;
+} result_t;
+
+static long peak_rss_kb() {
+
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss; // kilobytes on Linux
+}
+
+static void run_lex(const char* fname, result_t* res) {
+
+    parse_ctx_t* ctx = create_context(fname);
+    YYSTYPE lval;
+    YYLTYPE lloc;
+    size_t tokens = 0;
+
+    set_context(ctx);
+    reset_alloc_stats();
+    double start = now();
+
+    if(init_scanner(ctx))
+        while(yylex(&lval, &lloc, ctx->scanner) != 0)
+            tokens++;
+    destroy_scanner(ctx);
+
+    res->seconds = now() - start;
+    get_alloc_stats(&res->alloc);
+    res->tokens = tokens;
+    res->errors = ctx->errors;
+    set_context(NULL);
+    destroy_context(ctx);
+    destroy_intern_pool();
+}
+
+static void run_parse(const char* fname, result_t* res) {
+
+    parse_ctx_t* ctx = create_context(fname);
+
+    reset_alloc_stats();
+    double start = now();
+
+    parse_context(ctx);
+
+    res->seconds = now() - start;
+    get_alloc_stats(&res->alloc);
+    res->errors = ctx->errors;
+    destroy_context(ctx);
+    destroy_intern_pool();
+}
+
+static void run_best(void (*func)(const char*, result_t*), const char* fname,
+                        int runs, result_t* best) {
+
+    result_t res;
+
+    for(int i = 0; i < runs; i++) {
+        memset(&res, 0, sizeof(res));
+        (*func)(fname, &res);
+        if(i == 0 || res.seconds < best->seconds)
+            *best = res;
+    }
+}
+
+static void print_json_str(const char* str) {
+
+    putchar('"');
+    for(; *str != '\0'; str++) {
+        if(*str == '"' || *str == '\\')
+            putchar('\\');
+        putchar(*str);
+    }
+    putchar('"');
+}
+
+static void report(const char* bench, const char* fname, size_t bytes,
+                        size_t tokens, result_t* res) {
+
+    double secs = (res->seconds > 0)? res->seconds: 1e-9;
+
+    printf("{\"bench\":\"%s\",\"file\":", bench);
+    print_json_str(fname);
+    printf(",\"bytes\":%zu,\"tokens\":%zu,\"seconds\":%.6f", bytes, tokens, res->seconds);
+    printf(",\"tokens_per_sec\":%.0f,\"mb_per_sec\":%.2f", tokens / secs, bytes / secs / (1024.0 * 1024.0));
+    printf(",\"allocs\":%zu,\"reallocs\":%zu,\"alloc_bytes\":%zu",
+                res->alloc.allocs, res->alloc.reallocs, res->alloc.bytes);
+    printf(",\"peak_rss_kb\":%ld,\"errors\":%d}\n", peak_rss_kb(), res->errors);
+    fflush(stdout);
+}
+
+static void usage(const char* prog) {
+
+    fprintf(stderr, "usage: %s [-r runs] [-m lex|parse|both] file...\n", prog);
+    exit(1);
+}
+
+int main(int argc, char** argv) {
+
+    int runs = 5;
+    int mode = MODE_LEX | MODE_PARSE;
+    int opt;
+
+    while((opt = getopt(argc, argv, "r:m:")) != -1) {
+        switch(opt) {
+            case 'r':
+                runs = atoi(optarg);
+                break;
+            case 'm':
+                if(strcmp(optarg, "lex") == 0)
+                    mode = MODE_LEX;
+                else if(strcmp(optarg, "parse") == 0)
+                    mode = MODE_PARSE;
+                else if(strcmp(optarg, "both") == 0)
+                    mode = MODE_LEX | MODE_PARSE;
+                else
+                    usage(argv[0]);
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+    if(optind >= argc || runs < 1)
+        usage(argv[0]);
+
+    for(int i = optind; i < argc; i++) {
+        const char* fname = argv[i];
+        struct stat st;
+        result_t lex, parse;
+
+        if(stat(fname, &st) != 0) {
+            perror(fname);
+            return 1;
+        }
+
+        // the parse needs the token count even when the scan is not reported
+        run_best(run_lex, fname, (mode & MODE_LEX)? runs: 1, &lex);
+        if(mode & MODE_LEX)
+            report("lex", fname, st.st_size, lex.tokens, &lex);
+
+        if(mode & MODE_PARSE) {
+            run_best(run_parse, fname, runs, &parse);
+            report("parse", fname, st.st_size, lex.tokens, &parse);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,267 @@
+/*
+ * Time the parse of a file that is broken in many places, to see what error
+ * recovery costs and how many errors it reports. The file is made here, of
+ * name spaces with a struct and a few methods each, with blocks nested a
+ * few deep, and then broken at places picked by a fixed seed, so every run
+ * breaks it the same way. A break is one of:
+ *
+ *   - a character taken out
+ *   - a stray character put in, such as a brace or an operator
+ *   - a keyword put in, such as struct or namespace
+ *   - a line taken out or written twice
+ *
+ * The file is parsed with 0, 1, 10, 100, 1000 and 10000 breaks. Each parse
+ * keeps the fastest of several runs, and the results are printed as one
+ * JSON object per line:
+ *
+ *   {"bench":"recovery","breaks":..,"lines":..,"bytes":..,"errors":..,
+ *    "reported":..,"stopped":..,"seconds":..,"mb_per_sec":..,"slowdown":..}
+ *
+ * where errors is the number of errors the parse counted, reported is the
+ * number of records in the file's diagnostics, stopped is 1 if the parse
+ * ended at the error limit, and slowdown is the time over the time of the
+ * file with no breaks.
+ *
+ * Usage: bench_recovery [-l lines] [-e limit] [-r runs] [-s seed]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "memory.h"
+#include "intern.h"
+#include "errors.h"
+#include "context.h"
+#include "bench_common.h"
+
+static const long breaks[] = { 0, 1, 10, 100, 1000, 10000 };
+
+static const char* strays[] = {
+    "{", "}", "(", ")", "[", "]", ",", ".", "=", "+", "*",
+    " struct ", " namespace ", " entry ", " if ", " while ", " int ", " return ",
+};
+
+// xorshift, so that the breaks are the same on every system
+static unsigned long long seed = 0x9E3779B97F4A7C15ULL;
+
+static unsigned long next_random() {
+
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return (unsigned long)(seed >> 11);
+}
+
+typedef struct {
+    char* buf;
+    size_t len;
+    size_t cap;
+} text_t;
+
+static void put(text_t* text, const char* str, size_t len) {
+
+    if(text->len + len + 2 > text->cap) {
+        while(text->len + len + 2 > text->cap)
+            text->cap = (text->cap == 0)? 0x01 << 16: text->cap << 1;
+        text->buf = REALLOC(text->buf, text->cap);
+    }
+    memcpy(text->buf + text->len, str, len);
+    text->len += len;
+}
+
+static void add(text_t* text, const char* fmt, int num) {
+
+    char tmp[256];
+    int n = snprintf(tmp, sizeof(tmp), fmt, num, num, num);
+    put(text, tmp, (size_t)n);
+}
+
+/*
+ * A source of about the number of lines, which parses without errors.
+ */
+static void make_source(text_t* text, long lines) {
+
+    for(int unit = 0; unit * 40 < lines; unit++) {
+        add(text, "namespace unit%d {\n", unit);
+        add(text, "    struct rec%d {\n", unit);
+        add(text, "        int id\n        float weight\n        int total(int n)\n    }\n\n", unit);
+        for(int m = 0; m < 2; m++) {
+            add(text, "    int rec%d.total(int n) {\n", unit);
+            add(text, "        int sum = %d\n        int i = 0\n", unit * 3 + m);
+            add(text, "        while(i < n) {\n            if(i > %d) {\n", m + 7);
+            add(text, "                if(sum < %d) {\n", unit + 100);
+            add(text, "                    sum = sum + i * %d\n", unit % 97 + 11);
+            add(text, "                }\n            }\n", unit);
+            add(text, "            i = i + 1\n        }\n", unit);
+            add(text, "        return sum - %d\n    }\n\n", m + 13);
+        }
+        add(text, "}\n\n", unit);
+    }
+    add(text, "entry {\n    int done = %d\n}\n", 1);
+}
+
+static size_t line_start(const char* buf, size_t pos) {
+
+    while(pos > 0 && buf[pos - 1] != '\n')
+        pos--;
+    return pos;
+}
+
+static size_t line_end(const char* buf, size_t len, size_t pos) {
+
+    while(pos < len && buf[pos] != '\n')
+        pos++;
+    return (pos < len)? pos + 1: pos;
+}
+
+/*
+ * Break the source in count places, into a new text.
+ */
+static void break_source(text_t* out, const text_t* src, long count) {
+
+    size_t* places = ALLOC_LST(count + 1, size_t);
+    int* kinds = ALLOC_LST(count + 1, int);
+
+    // the places in order, so that the text is copied once
+    for(long i = 0; i < count; i++)
+        places[i] = next_random() % src->len;
+    for(long i = 1; i < count; i++) {
+        size_t p = places[i];
+        long j = i;
+        for(; j > 0 && places[j - 1] > p; j--)
+            places[j] = places[j - 1];
+        places[j] = p;
+    }
+    for(long i = 0; i < count; i++)
+        kinds[i] = (int)(next_random() % 5);
+
+    size_t pos = 0;
+    out->len = 0;
+    for(long i = 0; i < count; i++) {
+        size_t at = places[i];
+        if(at < pos)
+            continue;
+        put(out, src->buf + pos, at - pos);
+        pos = at;
+
+        switch(kinds[i]) {
+            case 0:     // take out a character
+                pos++;
+                break;
+            case 1:     // put in a stray character or keyword
+            case 2: {
+                const char* stray = strays[next_random() % (sizeof(strays) / sizeof(strays[0]))];
+                put(out, stray, strlen(stray));
+                break;
+            }
+            case 3:     // take out the rest of the line
+                pos = line_end(src->buf, src->len, at);
+                break;
+            case 4: {   // write the line twice
+                size_t start = line_start(src->buf, at);
+                size_t end = line_end(src->buf, src->len, at);
+                put(out, src->buf + at, end - at);
+                put(out, src->buf + start, end - start);
+                pos = end;
+                break;
+            }
+        }
+    }
+    put(out, src->buf + pos, src->len - pos);
+    out->buf[out->len] = out->buf[out->len + 1] = '\0';
+
+    FREE(kinds);
+    FREE(places);
+}
+
+/*
+ * Parse a copy of the text, since the scanner writes into it.
+ */
+static double run_parse(const text_t* text, char* copy, int* errors, size_t* reported, int* stopped) {
+
+    memcpy(copy, text->buf, text->len + 2);
+    parse_ctx_t* ctx = create_context(intern_str("fuzz.nop"));
+
+    double start = now();
+    parse_context_text(ctx, copy, text->len);
+    double secs = now() - start;
+
+    *errors = ctx->errors;
+    *reported = ctx->diags->count;
+    *stopped = ctx->stopped;
+    destroy_context(ctx);
+    return secs;
+}
+
+static void usage(const char* prog) {
+
+    fprintf(stderr, "usage: %s [-l lines] [-e limit] [-r runs] [-s seed]\n", prog);
+    exit(1);
+}
+
+int main(int argc, char** argv) {
+
+    long lines = 50000;
+    int runs = 3;
+    int opt;
+
+    while((opt = getopt(argc, argv, "l:e:r:s:")) != -1) {
+        switch(opt) {
+            case 'l':
+                lines = atol(optarg);
+                break;
+            case 'e':
+                set_diag_limit((size_t)atol(optarg));
+                break;
+            case 'r':
+                runs = atoi(optarg);
+                break;
+            case 's':
+                seed = strtoull(optarg, NULL, 0);
+                if(seed == 0)
+                    usage(argv[0]);
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+    if(optind != argc || lines < 1 || runs < 1)
+        usage(argv[0]);
+
+    text_t src = { NULL, 0, 0 };
+    text_t broken = { NULL, 0, 0 };
+    make_source(&src, lines);
+    long nlines = 0;
+    for(size_t i = 0; i < src.len; i++)
+        nlines += (src.buf[i] == '\n');
+
+    double clean = 0;
+    for(size_t b = 0; b < sizeof(breaks) / sizeof(breaks[0]); b++) {
+        break_source(&broken, &src, breaks[b]);
+        char* copy = ALLOC(broken.len + 2);
+
+        double best = 0;
+        int errors = 0;
+        int stopped = 0;
+        size_t reported = 0;
+        for(int i = 0; i < runs; i++) {
+            double secs = run_parse(&broken, copy, &errors, &reported, &stopped);
+            if(i == 0 || secs < best)
+                best = secs;
+        }
+        if(b == 0)
+            clean = best;
+
+        printf("{\"bench\":\"recovery\",\"breaks\":%ld,\"lines\":%ld,\"bytes\":%zu,\"errors\":%d,\"reported\":%zu,\"stopped\":%d,\"seconds\":%.6f,\"mb_per_sec\":%.1f,\"slowdown\":%.2f}\n",
+                    breaks[b], nlines, broken.len, errors, reported, stopped, best,
+                    broken.len / best / 1e6, best / clean);
+        fflush(stdout);
+        FREE(copy);
+    }
+
+    FREE(src.buf);
+    FREE(broken.buf);
+    destroy_intern_pool();
+    return 0;
+}
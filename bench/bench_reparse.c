@@ -0,0 +1,239 @@
+/*
+ * Time the incremental parse of an edited file against parsing all of it
+ * again, which is what every keystroke cost before. The file is one that is
+ * made here, of name spaces with a struct and a few methods each, about 46
+ * lines to a name space, or one given on the command line. The edits are
+ * the ones a person makes while typing:
+ *
+ *   digit      change one digit of a number in a method to another digit
+ *   newline    add a new line in a method, which moves everything after
+ *              it down a line, and take it out again
+ *
+ * The edits are at places spread over the whole file. Each test keeps the
+ * fastest of several runs, and the results are printed as one JSON object
+ * per line:
+ *
+ *   {"bench":"reparse","test":"digit","way":"edit","lines":..,"edits":..,
+ *    "seconds":..,"ms_per_edit":..,"bytes_scanned":..}
+ *
+ * where the way is "edit" for edit_document() and "full" for parsing the
+ * whole text again after every edit. Bytes scanned is the average for one
+ * edit.
+ *
+ * Usage: bench_reparse [-l lines] [-n edits] [-r runs] [file]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "memory.h"
+#include "intern.h"
+#include "context.h"
+#include "reparse.h"
+#include "bench_common.h"
+
+#define TESTS(X) \
+    X(TEST_DIGIT, "digit") \
+    X(TEST_NEWLINE, "newline")
+
+BENCH_TESTS(TESTS);
+
+static void add(char** buf, size_t* len, size_t* cap, const char* fmt, int num) {
+
+    char tmp[256];
+    int n = snprintf(tmp, sizeof(tmp), fmt, num, num, num);
+
+    if(*len + n + 1 > *cap) {
+        while(*len + n + 1 > *cap)
+            *cap = (*cap == 0)? 0x01 << 16: *cap << 1;
+        *buf = REALLOC(*buf, *cap);
+    }
+    memcpy(*buf + *len, tmp, n + 1);
+    *len += n;
+}
+
+/*
+ * A source of about the number of lines, which parses without errors.
+ */
+static char* make_source(long lines, size_t* len) {
+
+    char* buf = NULL;
+    size_t cap = 0;
+    *len = 0;
+
+    for(int unit = 0; unit * 46 < lines; unit++) {
+        add(&buf, len, &cap, "namespace unit%d {\n", unit);
+        add(&buf, len, &cap, "    struct rec%d {\n", unit);
+        add(&buf, len, &cap, "        int id\n        string name\n", unit);
+        add(&buf, len, &cap, "        float weight\n        int total(int n)\n    }\n\n", unit);
+        for(int m = 0; m < 3; m++) {
+            add(&buf, len, &cap, "    int rec%d.total(int n) {\n", unit);
+            add(&buf, len, &cap, "        int sum = %d\n        int i = 0\n", unit * 3 + m);
+            add(&buf, len, &cap, "        while(i < n) {\n            if(i > %d) {\n", m + 7);
+            add(&buf, len, &cap, "                sum = sum + i * %d\n            }\n", unit % 97 + 11);
+            add(&buf, len, &cap, "            i = i + 1\n        }\n", unit);
+            add(&buf, len, &cap, "        return sum - %d\n    }\n\n", m + 13);
+        }
+        add(&buf, len, &cap, "}\n\n", unit);
+    }
+    add(&buf, len, &cap, "entry {\n    int done = %d\n}\n", 1);
+    return buf;
+}
+
+static char* read_source(const char* fname, size_t* len) {
+
+    FILE* fp = fopen(fname, "r");
+    if(fp == NULL) {
+        perror(fname);
+        exit(1);
+    }
+    fseek(fp, 0, SEEK_END);
+    *len = (size_t)ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    char* buf = ALLOC(*len + 1);
+    if(fread(buf, 1, *len, fp) != *len) {
+        perror(fname);
+        exit(1);
+    }
+    fclose(fp);
+    return buf;
+}
+
+/*
+ * The places to edit: digits that are in the middle of a line, after some
+ * indent, spread evenly over the file.
+ */
+static size_t* find_places(const char* text, size_t len, long count) {
+
+    size_t* places = ALLOC_LST(count, size_t);
+    size_t step = len / count;
+
+    for(long i = 0; i < count; i++) {
+        size_t pos = i * step;
+        while(pos < len && !(text[pos] >= '1' && text[pos] <= '8' && pos > 8 &&
+                    text[pos - 1] == ' ' && text[pos - 8] == ' '))
+            pos++;
+        if(pos == len) {
+            fprintf(stderr, "bench_reparse: not enough numbers to edit\n");
+            exit(1);
+        }
+        places[i] = pos;
+    }
+    return places;
+}
+
+// the edit without the parse, for the way that parses everything again
+static int splice(document_t* doc, size_t pos, size_t removed, const char* text, size_t len) {
+
+    if(doc->len - removed + len + 2 > doc->cap) {
+        doc->cap = (doc->len - removed + len + 2) << 1;
+        doc->text = REALLOC_LST(doc->text, doc->cap, char);
+    }
+    memmove(doc->text + pos + len, doc->text + pos + removed, doc->len - pos - removed + 2);
+    memcpy(doc->text + pos, text, len);
+    doc->len = doc->len - removed + len;
+    return reparse_document(doc);
+}
+
+static int edit(document_t* doc, int full, size_t pos, size_t removed,
+                        const char* text, size_t len, size_t* scanned) {
+
+    int errors = full? splice(doc, pos, removed, text, len):
+                    edit_document(doc, pos, removed, text, len);
+    *scanned += full? doc->len: doc->scanned;
+    return errors;
+}
+
+static double run_test(test_t test, int full, const char* text, size_t len,
+                        size_t* places, long edits, size_t* scanned) {
+
+    document_t* doc = open_document("bench.nop", text, len);
+    *scanned = 0;
+
+    double start = now();
+    for(long i = 0; i < edits; i++) {
+        size_t pos = places[i];
+        int errors;
+        if(test == TEST_DIGIT) {
+            char digit[2] = { (char)(doc->text[pos] ^ 1), '\0' };
+            errors = edit(doc, full, pos, 1, digit, 1, scanned);
+        }
+        else {
+            errors = edit(doc, full, pos, 0, "\n", 1, scanned);
+            errors += edit(doc, full, pos, 1, "", 0, scanned);
+        }
+        if(errors != 0) {
+            fprintf(stderr, "bench_reparse: the edit at %zu made errors\n", pos);
+            exit(1);
+        }
+    }
+    double secs = now() - start;
+
+    close_document(doc);
+    return secs;
+}
+
+static void usage(const char* prog) {
+
+    fprintf(stderr, "usage: %s [-l lines] [-n edits] [-r runs] [file]\n", prog);
+    exit(1);
+}
+
+int main(int argc, char** argv) {
+
+    long lines = 50000;
+    long edits = 200;
+    int runs = 3;
+    int opt;
+
+    while((opt = getopt(argc, argv, "l:n:r:")) != -1) {
+        switch(opt) {
+            case 'l':
+                lines = atol(optarg);
+                break;
+            case 'n':
+                edits = atol(optarg);
+                break;
+            case 'r':
+                runs = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+    if(optind < argc - 1 || lines < 1 || edits < 1 || runs < 1)
+        usage(argv[0]);
+
+    size_t len;
+    char* text = (optind < argc)? read_source(argv[optind], &len): make_source(lines, &len);
+    size_t* places = find_places(text, len, edits);
+    long nlines = 0;
+    for(size_t i = 0; i < len; i++)
+        nlines += (text[i] == '\n');
+
+    for(int t = 0; t < NUM_TESTS; t++) {
+        for(int full = 0; full < 2; full++) {
+            // parsing everything is slow, so it does fewer edits
+            long n = full? (edits + 9) / 10: edits;
+            double best = 0;
+            size_t scanned = 0;
+            for(int i = 0; i < runs; i++) {
+                double secs = run_test(t, full, text, len, places, n, &scanned);
+                if(i == 0 || secs < best)
+                    best = secs;
+            }
+            // the new line is two edits, one to add it and one to take it out
+            n *= (t == TEST_NEWLINE)? 2: 1;
+            printf("{\"bench\":\"reparse\",\"test\":\"%s\",\"way\":\"%s\",\"lines\":%ld,\"edits\":%ld,\"seconds\":%.6f,\"ms_per_edit\":%.3f,\"bytes_scanned\":%zu}\n",
+                        test_names[t], full? "full": "edit", nlines, n, best,
+                        best * 1000 / n, scanned / n);
+            fflush(stdout);
+        }
+    }
+
+    FREE(places);
+    FREE(text);
+    destroy_intern_pool();
+    return 0;
+}
@@ -0,0 +1,193 @@
+/*
+ * Time string values the way a program uses them, through the runtime calls
+ * behind + and d[k], against the way they worked before strings had a
+ * header: + counting both strings and copying them into a new one, and a
+ * key counting and hashing its text every time it was looked up. The tests
+ * are:
+ *
+ *   append     s = s + "<8 chars>" n times, then read s once
+ *   prepend    s = "<8 chars>" + s n times, then read s once
+ *   lookup     look up a set of 1,000 keys that the program made, such as
+ *              by formatting, in a dict of them, n times in all
+ *   literal    the same with keys that are literals of the program
+ *
+ * Each test keeps the fastest of several runs, and the results are printed
+ * as one JSON object per line:
+ *
+ *   {"bench":"string","test":"append","way":"str","ops":..,"seconds":..,
+ *    "ops_per_sec":..}
+ *
+ * where the way is "str" for the runtime and "copy" for before. Copying
+ * makes appending quadratic, so the concatenations have their own count.
+ *
+ * Usage: bench_string [-c concatenations] [-n lookups] [-r runs]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "memory.h"
+#include "intern.h"
+#include "runtime.h"
+#include "context.h"
+#include "bench_common.h"
+
+#define NUM_KEYS    1000
+
+#define TESTS(X) \
+    X(TEST_APPEND, "append") \
+    X(TEST_PREPEND, "prepend") \
+    X(TEST_LOOKUP, "lookup") \
+    X(TEST_LITERAL, "literal")
+
+BENCH_TESTS(TESTS);
+
+static volatile long sink;
+
+static void check(rt_error_t err, runtime_t* rt) {
+
+    if(err != RT_OK) {
+        fprintf(stderr, "bench_string: %s\n", rt->msg);
+        exit(1);
+    }
+}
+
+// how + joined two strings before they knew their lengths
+static value_t copy_concat(runtime_t* rt, value_t left, value_t right, char** buf, size_t* cap) {
+
+    const char* l = AS_STRING(left);
+    const char* r = AS_STRING(right);
+    size_t llen = strlen(l), rlen = strlen(r);
+
+    if(llen + rlen + 1 > *cap) {
+        while(llen + rlen + 1 > *cap)
+            *cap = (*cap == 0)? 128: *cap << 1;
+        *buf = REALLOC(*buf, *cap);
+    }
+    memcpy(*buf, l, llen);
+    memcpy(*buf + llen, r, rlen);
+    return STRING_VAL(str_new(rt->arena, *buf, llen + rlen));
+}
+
+// how a key was found before, from its text alone
+static value_t* copy_lookup(value_t dict, value_t key) {
+
+    const char* str = intern_find(AS_STRING(key));
+    return (str != NULL)? dict_find(AS_DICT(dict), STRING_VAL(STR_OF(str))): NULL;
+}
+
+static double run_concat(test_t test, int str_way, long n) {
+
+    runtime_t rt;
+    value_t piece, acc, res;
+    char* buf = NULL;
+    size_t cap = 0;
+
+    init_runtime(&rt);
+    piece = STRING_VAL(STR_OF(intern_str("01234567")));
+    acc = STRING_VAL(str_empty());
+
+    double start = now();
+    for(long i = 0; i < n; i++) {
+        value_t left = (test == TEST_APPEND)? acc: piece;
+        value_t right = (test == TEST_APPEND)? piece: acc;
+        if(str_way)
+            check(rt_binary(&rt, '+', left, right, &res), &rt);
+        else
+            res = copy_concat(&rt, left, right, &buf, &cap);
+        acc = res;
+    }
+    sink = AS_STRING(acc)[n * 4];
+    double secs = now() - start;
+
+    if(buf != NULL)
+        FREE(buf);
+    free_runtime(&rt);
+    return secs;
+}
+
+static double run_lookup(test_t test, int str_way, long n) {
+
+    runtime_t rt;
+    value_t keys[NUM_KEYS], res;
+    char buf[32];
+    long total = 0;
+
+    init_runtime(&rt);
+    value_t dict = rt_zero(&rt, DICT_TYPE(VAL_INT));
+    for(int i = 0; i < NUM_KEYS; i++) {
+        int len = snprintf(buf, sizeof(buf), "customer_%d", i * 7919);
+        keys[i] = STRING_VAL((test == TEST_LITERAL)? STR_OF(intern_strn(buf, len)):
+                            str_new(rt.arena, buf, len));
+        check(rt_set_index(&rt, dict, keys[i], INT_VAL(i)), &rt);
+    }
+
+    double start = now();
+    for(long i = 0; i < n; i++) {
+        value_t key = keys[i % NUM_KEYS];
+        if(str_way) {
+            check(rt_index(&rt, dict, key, &res), &rt);
+            total += AS_INT(res);
+        }
+        else
+            total += AS_INT(*copy_lookup(dict, key));
+    }
+    double secs = now() - start;
+
+    sink = total;
+    free_runtime(&rt);
+    return secs;
+}
+
+static void usage(const char* prog) {
+
+    fprintf(stderr, "usage: %s [-c concatenations] [-n lookups] [-r runs]\n", prog);
+    exit(1);
+}
+
+int main(int argc, char** argv) {
+
+    long nconcat = 10000;
+    long nlookup = 1000000;
+    int runs = 5;
+    int opt;
+
+    while((opt = getopt(argc, argv, "c:n:r:")) != -1) {
+        switch(opt) {
+            case 'c':
+                nconcat = atol(optarg);
+                break;
+            case 'n':
+                nlookup = atol(optarg);
+                break;
+            case 'r':
+                runs = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+    if(optind != argc || nconcat < 1 || nlookup < 1 || runs < 1)
+        usage(argv[0]);
+
+    for(int t = 0; t < NUM_TESTS; t++) {
+        long n = (t == TEST_APPEND || t == TEST_PREPEND)? nconcat: nlookup;
+        for(int way = 0; way < 2; way++) {
+            double best = 0;
+            for(int i = 0; i < runs; i++) {
+                double secs = (t == TEST_APPEND || t == TEST_PREPEND)?
+                            run_concat(t, way, n): run_lookup(t, way, n);
+                if(i == 0 || secs < best)
+                    best = secs;
+            }
+            printf("{\"bench\":\"string\",\"test\":\"%s\",\"way\":\"%s\",\"ops\":%ld,\"seconds\":%.6f,\"ops_per_sec\":%.0f}\n",
+                        test_names[t], way? "str": "copy", n, best, n / ((best > 0)? best: 1e-9));
+            fflush(stdout);
+        }
+    }
+
+    destroy_intern_pool();
+    return 0;
+}
@@ -0,0 +1,110 @@
+/*
+ * Measure symbol table lookups as the table grows. The names are added in
+ * sorted order because that is what the generated sources do. Then measure
+ * lookups through nested block scopes and the cost of opening and closing
+ * a scope.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "intern.h"
+#include "symbols.h"
+#include "context.h"
+#include "bench_common.h"
+
+#define MAX_SYMBOLS 1000000
+#define LOOKUPS     1000000
+
+#define LOCALS      8
+#define SCOPE_LOOPS 100000
+
+/*
+ * Open depth block scopes with a few locals in each and look up a global
+ * name from the innermost one, which has to go through all of them.
+ */
+static void bench_depth(const char** names, int depth) {
+
+    symbol_data_t val;
+    char local[16];
+    long sum = 0;
+
+    for(int d = 0; d < depth; d++) {
+        push_scope(SCOPE_BLOCK, NULL);
+        for(int i = 0; i < LOCALS; i++) {
+            snprintf(local, sizeof(local), "loc%d_%d", d, i);
+            add_inum_symbol(local, i, 1, 0, 0);
+        }
+    }
+
+    double start = now();
+    for(int i = 0; i < LOOKUPS; i++)
+        if(find_symbol(names[i & 0xFFFF], &val) == SYM_NO_ERROR)
+            sum += val.value.inum;
+    double find_time = now() - start;
+
+    for(int d = 0; d < depth; d++)
+        pop_scope();
+
+    printf("depth: %d find_global_ns: %.1f (%ld)\n", depth,
+                find_time * 1e9 / LOOKUPS, sum);
+}
+
+/*
+ * Open a scope, add a few locals and close it again.
+ */
+static void bench_push_pop(const char** names) {
+
+    double start = now();
+    for(int n = 0; n < SCOPE_LOOPS; n++) {
+        push_scope(SCOPE_METHOD, NULL);
+        for(int i = 0; i < LOCALS; i++)
+            add_inum_symbol(names[i], i, 1, 0, 0);
+        pop_scope();
+    }
+    double time = now() - start;
+
+    printf("scope: %d locals push_add_pop_ns: %.1f\n", LOCALS,
+                time * 1e9 / SCOPE_LOOPS);
+}
+
+int main() {
+
+    static const char* names[MAX_SYMBOLS];
+    char name[16];
+    symbol_data_t val;
+    size_t added = 0;
+    unsigned int seed = 1;
+
+    // interned like the names from the scanner
+    for(int i = 0; i < MAX_SYMBOLS; i++) {
+        snprintf(name, sizeof(name), "sym%07d", i);
+        names[i] = intern_str(name);
+    }
+
+    for(size_t size = 100; size <= MAX_SYMBOLS; size *= 10) {
+
+        double start = now();
+        for(; added < size; added++)
+            add_inum_symbol(names[added], (long)added, 1, 1, 0);
+        double add_time = now() - start;
+
+        long sum = 0;
+        start = now();
+        for(int i = 0; i < LOOKUPS; i++) {
+            seed = seed * 1103515245 + 12345;
+            if(find_symbol(names[seed % size], &val) == SYM_NO_ERROR)
+                sum += val.value.inum;
+        }
+        double find_time = now() - start;
+
+        printf("symbols: %zu add_ns: %.1f find_ns: %.1f (%ld)\n", size,
+                add_time * 1e9 / size, find_time * 1e9 / LOOKUPS, sum);
+    }
+
+    for(int depth = 1; depth <= 64; depth *= 4)
+        bench_depth(names, depth);
+    bench_push_pop(names);
+
+    destroy_symbols();
+    return 0;
+}
@@ -0,0 +1,110 @@
+/*
+ * Measure how long the scanner takes to decide whether an identifier is a
+ * type name. The old check compared the text against fixed strings; the new
+ * one looks the interned name up in the type set. Both are timed alone and
+ * together with interning the text, which is the whole identifier path in
+ * the scanner.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "intern.h"
+#include "typenames.h"
+#include "context.h"
+#include "bench_common.h"
+
+#define NAMES       5000
+#define TYPES       50
+#define TOKENS      1000000
+#define ROUNDS      5
+
+// what check_type() used to do
+static int old_check(const char* text) {
+
+    if(strcmp(text, "lkjg") == 0 ||
+            strcmp(text, "some_name") == 0)
+        return 1;
+    else
+        return 0;
+}
+
+int main() {
+
+    static char names[NAMES][16];
+    static const char* interned[NAMES];
+    static int stream[TOKENS];
+    unsigned int seed = 1;
+    volatile long sink = 0;
+    long hits;
+
+    for(int i = 0; i < NAMES; i++) {
+        snprintf(names[i], sizeof(names[i]), "%s%d", (i < TYPES)? "type": "name", i);
+        interned[i] = intern_str(names[i]);
+    }
+
+    type_set_t* set = create_type_set();
+    for(int i = 0; i < TYPES; i++)
+        add_type_name(set, interned[i]);
+
+    // short names are used much more than long ones, the same as in source
+    for(int i = 0; i < TOKENS; i++) {
+        seed = seed * 1103515245 + 12345;
+        int n = (seed >> 8) % NAMES;
+        seed = seed * 1103515245 + 12345;
+        stream[i] = n % (((seed >> 8) % NAMES) + 1);
+    }
+
+    double best_old = 1e9, best_new = 1e9, best_old_path = 1e9, best_new_path = 1e9;
+    for(int r = 0; r < ROUNDS; r++) {
+        double start;
+
+        hits = 0;
+        start = now();
+        for(int i = 0; i < TOKENS; i++)
+            hits += old_check(names[stream[i]]);
+        sink += hits;
+        double t = now() - start;
+        if(t < best_old)
+            best_old = t;
+
+        hits = 0;
+        start = now();
+        for(int i = 0; i < TOKENS; i++)
+            hits += is_type_name(set, interned[stream[i]]);
+        sink += hits;
+        t = now() - start;
+        if(t < best_new)
+            best_new = t;
+
+        start = now();
+        for(int i = 0; i < TOKENS; i++) {
+            const char* text = names[stream[i]];
+            intern_strn(text, strlen(text));
+            hits += old_check(text);
+        }
+        sink += hits;
+        t = now() - start;
+        if(t < best_old_path)
+            best_old_path = t;
+
+        start = now();
+        for(int i = 0; i < TOKENS; i++) {
+            const char* text = names[stream[i]];
+            hits += is_type_name(set, intern_strn(text, strlen(text)));
+        }
+        sink += hits;
+        t = now() - start;
+        if(t < best_new_path)
+            best_new_path = t;
+    }
+
+    printf("check_type: strcmp ns: %.2f set ns: %.2f\n",
+                best_old * 1e9 / TOKENS, best_new * 1e9 / TOKENS);
+    printf("identifier: strcmp tokens_per_sec: %.0f set tokens_per_sec: %.0f (%ld)\n",
+                TOKENS / best_old_path, TOKENS / best_new_path, (long)sink);
+
+    destroy_type_set(set);
+    destroy_intern_pool();
+    return 0;
+}
@@ -0,0 +1,262 @@
+/*
+ * Compare the run time value word of value.h with the struct it replaced,
+ * a type byte next to a union, which is copied here as old_value_t. Each
+ * test runs over an array of values with both layouts and keeps the
+ * fastest of several runs:
+ *
+ *   create     make an int or a float from a counter and store it
+ *   arith      add up an array of ints into an int value
+ *   dispatch   switch on the type of a mixed array, as the runtime does
+ *              for an operator that is not typed
+ *   call       pass two values to a function and return one, which is
+ *              where the size decides between registers and memory
+ *
+ * The results are printed as one JSON object per line:
+ *
+ *   {"bench":"value","test":"arith","layout":"word","value_bytes":8,
+ *    "values":..,"seconds":..,"ns_per_value":..}
+ *
+ * followed by a line with the time of the word over the time of the
+ * struct for each test.
+ *
+ * Usage: bench_value [-n values] [-r runs]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "memory.h"
+#include "intern.h"
+#include "value.h"
+#include "context.h"
+#include "bench_common.h"
+
+typedef struct {
+    uint8_t type;
+    union {
+        long inum;
+        unsigned long unum;
+        double fnum;
+        const char* str;
+    } as;
+} old_value_t;
+
+#define OLD_TYPE(v)         ((v).type)
+#define OLD_INT_VAL(n)      ((old_value_t){.type = VAL_INT, .as.inum = (n)})
+#define OLD_FLOAT_VAL(n)    ((old_value_t){.type = VAL_FLOAT, .as.fnum = (n)})
+#define OLD_STRING_VAL(s)   ((old_value_t){.type = VAL_STRING, .as.str = (s)})
+#define OLD_AS_INT(v)       ((v).as.inum)
+#define OLD_AS_FLOAT(v)     ((v).as.fnum)
+#define OLD_AS_STRING(v)    ((v).as.str)
+
+#define TESTS(X) \
+    X(TEST_CREATE, "create") \
+    X(TEST_ARITH, "arith") \
+    X(TEST_DISPATCH, "dispatch") \
+    X(TEST_CALL, "call")
+
+BENCH_TESTS(TESTS);
+
+static volatile double sink;
+
+__attribute__((noinline)) static value_t add_words(value_t a, value_t b) {
+
+    if(IS_INT(a) && IS_INT(b))
+        return INT_VAL(AS_INT(a) + AS_INT(b));
+    return FLOAT_VAL(AS_FLOAT(a) + AS_FLOAT(b));
+}
+
+__attribute__((noinline)) static old_value_t add_structs(old_value_t a, old_value_t b) {
+
+    if(OLD_TYPE(a) == VAL_INT && OLD_TYPE(b) == VAL_INT)
+        return OLD_INT_VAL(OLD_AS_INT(a) + OLD_AS_INT(b));
+    return OLD_FLOAT_VAL(OLD_AS_FLOAT(a) + OLD_AS_FLOAT(b));
+}
+
+// every third value is a float and every seventh a string
+static void fill_words(value_t* vals, long n) {
+
+    str_t* seven = STR_OF(intern_str("seven"));
+
+    for(long i = 0; i < n; i++)
+        vals[i] = (i % 7 == 0)? STRING_VAL(seven):
+                  (i % 3 == 0)? FLOAT_VAL(i * 0.5): INT_VAL(i);
+}
+
+static void fill_structs(old_value_t* vals, long n) {
+
+    for(long i = 0; i < n; i++)
+        vals[i] = (i % 7 == 0)? OLD_STRING_VAL("seven"):
+                  (i % 3 == 0)? OLD_FLOAT_VAL(i * 0.5): OLD_INT_VAL(i);
+}
+
+static double run_words(test_t test, value_t* vals, long n) {
+
+    double start = now();
+    value_t acc = INT_VAL(0);
+    double total = 0;
+
+    switch(test) {
+        case TEST_CREATE:
+            for(long i = 0; i < n; i++)
+                vals[i] = (i & 1)? FLOAT_VAL(i * 0.5): INT_VAL(i);
+            total = AS_FLOAT(vals[n - 1]);
+            break;
+
+        case TEST_ARITH:
+            for(long i = 0; i < n; i++)
+                acc = INT_VAL(AS_INT(acc) + AS_INT(vals[i]));
+            total = AS_INT(acc);
+            break;
+
+        case TEST_DISPATCH:
+            for(long i = 0; i < n; i++) {
+                switch(VAL_TYPE(vals[i])) {
+                    case VAL_INT: total += AS_INT(vals[i]); break;
+                    case VAL_FLOAT: total += AS_FLOAT(vals[i]); break;
+                    case VAL_STRING: total += AS_STRING(vals[i])[0]; break;
+                    default: break;
+                }
+            }
+            break;
+
+        case TEST_CALL:
+            for(long i = 0; i < n; i++)
+                acc = add_words(acc, vals[i]);
+            total = AS_INT(acc);
+            break;
+
+        default:
+            break;
+    }
+    sink = total;
+    return now() - start;
+}
+
+static double run_structs(test_t test, old_value_t* vals, long n) {
+
+    double start = now();
+    old_value_t acc = OLD_INT_VAL(0);
+    double total = 0;
+
+    switch(test) {
+        case TEST_CREATE:
+            for(long i = 0; i < n; i++)
+                vals[i] = (i & 1)? OLD_FLOAT_VAL(i * 0.5): OLD_INT_VAL(i);
+            total = OLD_AS_FLOAT(vals[n - 1]);
+            break;
+
+        case TEST_ARITH:
+            for(long i = 0; i < n; i++)
+                acc = OLD_INT_VAL(OLD_AS_INT(acc) + OLD_AS_INT(vals[i]));
+            total = OLD_AS_INT(acc);
+            break;
+
+        case TEST_DISPATCH:
+            for(long i = 0; i < n; i++) {
+                switch(OLD_TYPE(vals[i])) {
+                    case VAL_INT: total += OLD_AS_INT(vals[i]); break;
+                    case VAL_FLOAT: total += OLD_AS_FLOAT(vals[i]); break;
+                    case VAL_STRING: total += OLD_AS_STRING(vals[i])[0]; break;
+                    default: break;
+                }
+            }
+            break;
+
+        case TEST_CALL:
+            for(long i = 0; i < n; i++)
+                acc = add_structs(acc, vals[i]);
+            total = OLD_AS_INT(acc);
+            break;
+
+        default:
+            break;
+    }
+    sink = total;
+    return now() - start;
+}
+
+static void print_result(test_t test, const char* layout, size_t size, long n, double secs) {
+
+    printf("{\"bench\":\"value\",\"test\":\"%s\",\"layout\":\"%s\",\"value_bytes\":%zu",
+                test_names[test], layout, size);
+    printf(",\"values\":%ld,\"seconds\":%.6f,\"ns_per_value\":%.3f}\n", n, secs, secs * 1e9 / n);
+}
+
+static void usage(const char* prog) {
+
+    fprintf(stderr, "usage: %s [-n values] [-r runs]\n", prog);
+    exit(1);
+}
+
+int main(int argc, char** argv) {
+
+    long n = 10000000;
+    int runs = 5;
+    int opt;
+
+    while((opt = getopt(argc, argv, "n:r:")) != -1) {
+        switch(opt) {
+            case 'n':
+                n = atol(optarg);
+                break;
+            case 'r':
+                runs = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+    if(optind != argc || n < 1 || runs < 1)
+        usage(argv[0]);
+
+    value_t* words = ALLOC_LST(n, value_t);
+    old_value_t* structs = ALLOC_LST(n, old_value_t);
+    double ratio[NUM_TESTS];
+
+    // for a sum that gets too large to fit in a value
+    arena_t* boxes = create_arena(0);
+    set_box_arena(boxes);
+
+    for(int t = 0; t < NUM_TESTS; t++) {
+        double word_best = 0, struct_best = 0;
+
+        for(int i = 0; i < runs; i++) {
+            // the arithmetic tests need ints only, the others a mix
+            if(t == TEST_ARITH || t == TEST_CALL) {
+                for(long j = 0; j < n; j++) {
+                    words[j] = INT_VAL(j & 0xFFFF);
+                    structs[j] = OLD_INT_VAL(j & 0xFFFF);
+                }
+            }
+            else {
+                fill_words(words, n);
+                fill_structs(structs, n);
+            }
+
+            double secs = run_words(t, words, n);
+            if(i == 0 || secs < word_best)
+                word_best = secs;
+            secs = run_structs(t, structs, n);
+            if(i == 0 || secs < struct_best)
+                struct_best = secs;
+        }
+
+        print_result(t, "word", sizeof(value_t), n, word_best);
+        print_result(t, "struct", sizeof(old_value_t), n, struct_best);
+        ratio[t] = word_best / ((struct_best > 0)? struct_best: 1e-9);
+        fflush(stdout);
+    }
+
+    printf("{\"bench\":\"value\",\"test\":\"ratio\"");
+    for(int t = 0; t < NUM_TESTS; t++)
+        printf(",\"%s\":%.2f", test_names[t], ratio[t]);
+    printf("}\n");
+
+    set_box_arena(NULL);
+    destroy_arena(boxes);
+    FREE(structs);
+    FREE(words);
+    return 0;
+}
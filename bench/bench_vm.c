@@ -0,0 +1,134 @@
+/*
+ * Compare the bytecode VM with the tree walking interpreter. Each file is
+ * parsed and resolved once, compiled to bytecode, and then run by both,
+ * several times, keeping the fastest run of each. What the programs print
+ * is thrown away.
+ *
+ * The results are printed as one JSON object per line:
+ *
+ *   {"bench":"vm","file":"primes.nop","functions":..,"code":..,
+ *    "compile_seconds":..,"insns":..,"seconds":..,"insns_per_sec":..,
+ *    "interp_seconds":..,"speedup":..,"status":..}
+ *
+ * code is the number of instructions that were compiled and insns the
+ * number that one run executed. speedup is the interpreter's time over the
+ * VM's. status is non-zero if the program stopped with a run time error,
+ * which makes the times meaningless.
+ *
+ * Usage: bench_vm [-r runs] file...
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "memory.h"
+#include "intern.h"
+#include "context.h"
+#include "resolve.h"
+#include "interp.h"
+#include "bytecode.h"
+#include "vm.h"
+#include "bench_common.h"
+
+static FILE* null_out;
+
+static void print_json_str(const char* str) {
+
+    putchar('"');
+    for(; *str != '\0'; str++) {
+        if(*str == '"' || *str == '\\')
+            putchar('\\');
+        putchar(*str);
+    }
+    putchar('"');
+}
+
+static void bench_file(const char* fname, int runs) {
+
+    parse_ctx_t* ctx = create_context(fname);
+    parse_context(ctx);
+    if(ctx->errors != 0) {
+        fprintf(stderr, "%s: %d errors, not run\n", fname, ctx->errors);
+        destroy_context(ctx);
+        return;
+    }
+
+    program_t* prog = resolve_program(ctx->ast);
+    double start = now();
+    module_t* mod = compile_program(prog);
+    double compile = now() - start;
+
+    int code = 0;
+    for(int i = 0; i < mod->nfuncs; i++)
+        code += mod->funcs[i].ncode;
+
+    double vm_best = 0, interp_best = 0;
+    vm_stats_t stats;
+    int status = 0;
+
+    for(int i = 0; i < runs; i++) {
+        start = now();
+        status |= run_module(mod, null_out, &stats);
+        double secs = now() - start;
+        if(i == 0 || secs < vm_best)
+            vm_best = secs;
+
+        start = now();
+        status |= run_program(prog, null_out);
+        secs = now() - start;
+        if(i == 0 || secs < interp_best)
+            interp_best = secs;
+    }
+
+    double secs = (vm_best > 0)? vm_best: 1e-9;
+    printf("{\"bench\":\"vm\",\"file\":");
+    print_json_str(fname);
+    printf(",\"functions\":%d,\"code\":%d,\"compile_seconds\":%.6f", mod->nfuncs, code, compile);
+    printf(",\"insns\":%llu,\"seconds\":%.6f,\"insns_per_sec\":%.0f",
+                (unsigned long long)stats.insns, vm_best, stats.insns / secs);
+    printf(",\"interp_seconds\":%.6f,\"speedup\":%.2f,\"status\":%d}\n",
+                interp_best, interp_best / secs, status);
+    fflush(stdout);
+
+    destroy_module(mod);
+    destroy_program(prog);
+    destroy_context(ctx);
+    destroy_intern_pool();
+}
+
+static void usage(const char* prog) {
+
+    fprintf(stderr, "usage: %s [-r runs] file...\n", prog);
+    exit(1);
+}
+
+int main(int argc, char** argv) {
+
+    int runs = 3;
+    int opt;
+
+    while((opt = getopt(argc, argv, "r:")) != -1) {
+        switch(opt) {
+            case 'r':
+                runs = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+    if(optind >= argc || runs < 1)
+        usage(argv[0]);
+
+    null_out = fopen("/dev/null", "w");
+    if(null_out == NULL) {
+        perror("/dev/null");
+        return 1;
+    }
+
+    for(int i = optind; i < argc; i++)
+        bench_file(argv[i], runs);
+
+    fclose(null_out);
+    return 0;
+}
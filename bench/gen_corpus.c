@@ -0,0 +1,184 @@
+/*
+ * Write a synthetic NOP source file to stdout for the parser benchmarks.
+ * The output is valid input for the parser. It is made of units, each in a
+ * namespace of its own, and units are added until the file is at least the
+ * requested size. The shape decides what a unit stresses:
+ *
+ *   nest       methods with if and while blocks nested to the given depth
+ *   wide       structs with the given number of members
+ *   strings    string variables with long literals that have escapes
+ *   consts     many integer, hex and float constants in expressions
+ *   mixed      one of each of the above per unit
+ *
+ * Usage: gen_corpus [-s shape] [-k kbytes] [-d depth] [-w width] [-l length]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+
+typedef enum {
+    SHAPE_NEST,
+    SHAPE_WIDE,
+    SHAPE_STRINGS,
+    SHAPE_CONSTS,
+    SHAPE_MIXED,
+} shape_t;
+
+static const char* shape_names[] = {
+    "nest", "wide", "strings", "consts", "mixed",
+};
+
+static const char* member_types[] = {
+    "int", "uint", "float", "bool", "string", "int list", "string dict",
+};
+
+#define NUM_SHAPES          (sizeof(shape_names) / sizeof(shape_names[0]))
+#define NUM_MEMBER_TYPES    (sizeof(member_types) / sizeof(member_types[0]))
+
+// the number of items in one unit of the strings and consts shapes
+#define ITEMS_PER_UNIT      16
+
+static size_t written = 0;
+
+static void emit(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+
+static void emit(const char* fmt, ...) {
+
+    va_list args;
+    va_start(args, fmt);
+    int n = vprintf(fmt, args);
+    va_end(args);
+    if(n > 0)
+        written += n;
+}
+
+static void indent(int level) {
+
+    emit("%*s", level * 4, "");
+}
+
+static void gen_nest(int unit, int depth) {
+
+    emit("    int nest%d(int x) {\n", unit);
+    emit("        int total = 0\n");
+    for(int i = 0; i < depth; i++) {
+        indent(i + 2);
+        if(i & 1)
+            emit("while(x < %d) {\n", i * 7 + 3);
+        else
+            emit("if(x > %d and total < %d) {\n", i, unit + i);
+        indent(i + 3);
+        emit("total = total + x * %d\n", i + 1);
+    }
+    for(int i = depth - 1; i >= 0; i--) {
+        indent(i + 3);
+        emit("x += 1\n");
+        indent(i + 2);
+        emit("}\n");
+    }
+    emit("        return total\n");
+    emit("    }\n\n");
+}
+
+static void gen_wide(int unit, int width) {
+
+    emit("    struct wide%d {\n", unit);
+    for(int i = 0; i < width; i++)
+        emit("        %s member%d\n", member_types[i % NUM_MEMBER_TYPES], i);
+    emit("        ctor(int member0)\n");
+    emit("        public int get(int index)\n");
+    emit("    }\n\n");
+    emit("    wide%d.ctor(int start) {\n", unit);
+    emit("        member0 = start\n");
+    emit("    }\n\n");
+}
+
+static void gen_strings(int unit, int length) {
+
+    static const char text[] = "the quick brown fox jumps over the lazy dog ";
+
+    for(int i = 0; i < ITEMS_PER_UNIT; i++) {
+        emit("    string text%d = \"", i);
+        for(int j = 0; j < length; j++) {
+            if(j % 64 == 63)
+                emit("\\n");
+            else if(j % 97 == 96)
+                emit("\\\"");
+            else
+                emit("%c", text[(j + unit) % (sizeof(text) - 1)]);
+        }
+        emit("\"\n");
+    }
+    emit("    string single%d = 'absolute {%d} literal \\ kept as is'\n\n", unit, unit);
+}
+
+static void gen_consts(int unit) {
+
+    for(int i = 0; i < ITEMS_PER_UNIT; i++)
+        emit("    public const int K%d = %d + 0x%X * %d - %d\n",
+                    i, unit * 31 + i, unit + i + 1, i + 2, unit % 1000);
+    for(int i = 0; i < ITEMS_PER_UNIT / 2; i++)
+        emit("    const float F%d = %d.%d * 1.5e%d\n", i, unit, i, i % 8);
+    emit("    int table%d = [1, 2, 3, 4, 5, 6, 7, 8, 0x10, 0x20, 0x40, 0x80]\n\n", unit);
+}
+
+static void usage(const char* prog) {
+
+    fprintf(stderr, "usage: %s [-s nest|wide|strings|consts|mixed] [-k kbytes] "
+                    "[-d depth] [-w width] [-l length]\n", prog);
+    exit(1);
+}
+
+int main(int argc, char** argv) {
+
+    shape_t shape = SHAPE_MIXED;
+    size_t target = 1024;
+    int depth = 32;
+    int width = 64;
+    int length = 512;
+    int opt;
+
+    while((opt = getopt(argc, argv, "s:k:d:w:l:")) != -1) {
+        switch(opt) {
+            case 's': {
+                size_t i;
+                for(i = 0; i < NUM_SHAPES; i++)
+                    if(strcmp(optarg, shape_names[i]) == 0)
+                        break;
+                if(i == NUM_SHAPES)
+                    usage(argv[0]);
+                shape = (shape_t)i;
+                break;
+            }
+            case 'k': target = strtoul(optarg, NULL, 10); break;
+            case 'd': depth = atoi(optarg); break;
+            case 'w': width = atoi(optarg); break;
+            case 'l': length = atoi(optarg); break;
+            default: usage(argv[0]);
+        }
+    }
+    if(depth < 1 || width < 1 || length < 1)
+        usage(argv[0]);
+
+    target *= 1024;
+    emit("/*\n * Generated by gen_corpus -s %s -k %zu -d %d -w %d -l %d\n */\n",
+                shape_names[shape], target / 1024, depth, width, length);
+
+    for(int unit = 0; written < target; unit++) {
+        emit("namespace %s%d {\n", shape_names[shape], unit);
+        if(shape == SHAPE_NEST || shape == SHAPE_MIXED)
+            gen_nest(unit, depth);
+        if(shape == SHAPE_WIDE || shape == SHAPE_MIXED)
+            gen_wide(unit, width);
+        if(shape == SHAPE_STRINGS || shape == SHAPE_MIXED)
+            gen_strings(unit, length);
+        if(shape == SHAPE_CONSTS || shape == SHAPE_MIXED)
+            gen_consts(unit);
+        emit("}\n\n");
+    }
+
+    emit("entry {\n    int done = 1\n}\n");
+    return 0;
+}
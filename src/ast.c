@@ -0,0 +1,249 @@
+/*
+ * AST node pool. The parser creates the nodes in its semantic actions and
+ * later passes walk them by index. See ast.h for the layout. Every
+ * translation unit has its own pool, so files can be parsed in parallel.
+ *
+ * The node array and the value array grow together by doubling, so adding a
+ * node is amortized O(1) and there is one allocation per array, not one per
+ * node.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "memory.h"
+#include "errors.h"
+#include "ast.h"
+#include "parser.h"
+
+#define INITIAL_NODES   (0x01 << 10)
+
+static const char* kind_names[] = {
+    "ERROR", "LIST", "NAMESPACE", "IMPORT", "ENTRY", "FSTRING", "CALL_PARAMS",
+    "INDEX", "IDENT", "COMPOUND_ID", "COMPOUND_NAME", "TYPE_NAME", "TYPE_SPEC",
+    "INUM", "UNUM", "FNUM", "BOOL", "BINARY", "UNARY", "CAST", "ASSIGN",
+    "STRUCT", "VAR_DECL", "METHOD_DECL", "CTOR_DECL", "DTOR_DECL",
+    "METHOD_DEF", "BLOCK", "BREAK", "CONTINUE", "RETURN", "EXPR_STMT",
+    "DICT_ELEM", "LIST_INIT", "DICT_INIT", "VAR_DEF", "IF", "ELSE_IF", "ELSE",
+    "WHILE", "DO", "FOR", "CASE", "DEFAULT", "SWITCH",
+};
+
+const char* ast_kind_name(ast_kind_t kind) {
+
+    return (kind < AST_NUM_KINDS)? kind_names[kind]: "UNKNOWN";
+}
+
+static void grow_pool(ast_t* pool) {
+
+    pool->cap = (pool->cap == 0)? INITIAL_NODES: pool->cap << 1;
+    pool->nodes = REALLOC_LST(pool->nodes, pool->cap, ast_node_t);
+    pool->values = REALLOC_LST(pool->values, pool->cap, ast_value_t);
+}
+
+/*
+ * Create an empty AST. Index 0 is reserved for AST_NONE.
+ */
+ast_t* create_ast() {
+
+    ast_t* pool = ALLOC_DS(ast_t);
+    grow_pool(pool);
+    memset(&pool->nodes[0], 0, sizeof(ast_node_t));
+    pool->values[0].unum = 0;
+    pool->count = 1;
+    pool->root = AST_NONE;
+
+    return pool;
+}
+
+void destroy_ast(ast_t* pool) {
+
+    if(pool != NULL) {
+        FREE(pool->nodes);
+        FREE(pool->values);
+        FREE(pool);
+    }
+}
+
+/*
+ * Create a node and return its index. The value is zeroed.
+ */
+ast_idx_t ast_make(ast_t* pool, ast_kind_t kind, int op, int line, int col,
+                        ast_idx_t c0, ast_idx_t c1, ast_idx_t c2, ast_idx_t c3) {
+
+    if(pool->count + 1 > pool->cap)
+        grow_pool(pool);
+
+    ast_idx_t idx = (ast_idx_t)pool->count++;
+    ast_node_t* node = &pool->nodes[idx];
+    node->kind = (uint8_t)kind;
+    node->flags = 0;
+    node->op = (uint16_t)op;
+    node->line = (uint32_t)line;
+    node->col = (uint32_t)col;
+    node->child[0] = c0;
+    node->child[1] = c1;
+    node->child[2] = c2;
+    node->child[3] = c3;
+    node->next = AST_NONE;
+    pool->values[idx].unum = 0;
+
+    return idx;
+}
+
+/*
+ * Create a node that carries a name or a string.
+ */
+ast_idx_t ast_make_str(ast_t* pool, ast_kind_t kind, const char* str,
+                        int line, int col, ast_idx_t c0, ast_idx_t c1) {
+
+    ast_idx_t idx = ast_make(pool, kind, 0, line, col, c0, c1, AST_NONE, AST_NONE);
+    pool->values[idx].str = str;
+    return idx;
+}
+
+ast_idx_t ast_list_new(ast_t* pool, int line, int col) {
+
+    return ast_make(pool, AST_LIST, 0, line, col, AST_NONE, AST_NONE, AST_NONE, AST_NONE);
+}
+
+/*
+ * Add the item to the end of the list and return the list. The list keeps
+ * the last item, so this does not walk the list.
+ */
+ast_idx_t ast_list_append(ast_t* pool, ast_idx_t list, ast_idx_t item) {
+
+    ast_node_t* lst = &pool->nodes[list];
+    if(lst->child[0] == AST_NONE)
+        lst->child[0] = item;
+    else
+        pool->nodes[lst->child[1]].next = item;
+
+    lst->child[1] = item;
+    lst->child[2]++;
+
+    return list;
+}
+
+ast_idx_t ast_list_first(ast_t* pool, ast_idx_t list) {
+
+    return (list == AST_NONE)? AST_NONE: pool->nodes[list].child[0];
+}
+
+size_t ast_list_count(ast_t* pool, ast_idx_t list) {
+
+    return (list == AST_NONE)? 0: pool->nodes[list].child[2];
+}
+
+/*
+ * Return the number of nodes, not counting the reserved one.
+ */
+size_t ast_count(ast_t* pool) {
+
+    return pool->count - 1;
+}
+
+// the names are literals, so that threads that dump at once do not share a buffer
+static const char* op_name(int op) {
+
+    switch(op) {
+        case 0: return "";
+        case '+': return "+";
+        case '-': return "-";
+        case '*': return "*";
+        case '/': return "/";
+        case '%': return "%";
+        case '<': return "<";
+        case '>': return ">";
+        case '=': return "=";
+        case LE_OP: return "<=";
+        case GE_OP: return ">=";
+        case EQ_OP: return "==";
+        case NE_OP: return "!=";
+        case AND_OP: return "and";
+        case OR_OP: return "or";
+        case NOT: return "not";
+        case ADD_ASSIGN: return "+=";
+        case SUB_ASSIGN: return "-=";
+        case MUL_ASSIGN: return "*=";
+        case DIV_ASSIGN: return "/=";
+        case MOD_ASSIGN: return "%=";
+        case BOOL: return "bool";
+        case INT: return "int";
+        case UINT: return "uint";
+        case FLOAT: return "float";
+        case STRING: return "string";
+        case NOTHING: return "nothing";
+        case TYPEDEF_NAME: return "typedef";
+        case LIST: return "list";
+        case DICT: return "dict";
+        default: return "?";
+    }
+}
+
+static void dump_node(ast_t* pool, int indent, ast_idx_t idx) {
+
+    ast_node_t* node = &pool->nodes[idx];
+    ast_value_t* val = &pool->values[idx];
+
+    printf("%*s%s", indent, "", ast_kind_name(node->kind));
+    if(node->op != 0)
+        printf(" %s", op_name(node->op));
+    switch(node->kind) {
+        case AST_INUM:
+        case AST_BOOL:
+            printf(" %ld", val->inum);
+            break;
+        case AST_UNUM:
+            printf(" 0x%lX", val->unum);
+            break;
+        case AST_FNUM:
+            printf(" %g", val->fnum);
+            break;
+        case AST_FSTRING:
+            printf(" \"%s\"", val->str);
+            break;
+        default:
+            if(val->str != NULL && node->kind != AST_LIST)
+                printf(" %s", val->str);
+            break;
+    }
+    if(node->flags & AST_F_PUBLIC)
+        printf(" public");
+    if(node->flags & AST_F_PRIVATE)
+        printf(" private");
+    if(node->flags & AST_F_CONST)
+        printf(" const");
+    printf(" (%u:%u)\n", node->line, node->col);
+
+    if(node->kind == AST_LIST) {
+        for(ast_idx_t item = node->child[0]; item != AST_NONE; item = pool->nodes[item].next)
+            dump_node(pool, indent + 4, item);
+    }
+    else {
+        for(int i = 0; i < 4; i++)
+            if(node->child[i] != AST_NONE)
+                dump_node(pool, indent + 4, node->child[i]);
+    }
+}
+
+/*
+ * Print the tree under the node, one node per line.
+ */
+void dump_ast(ast_t* pool, ast_idx_t idx) {
+
+    if(idx != AST_NONE)
+        dump_node(pool, 0, idx);
+}
+
+/*
+ * Print how many nodes there are and how much memory they use.
+ */
+void print_ast_stats(ast_t* pool) {
+
+    size_t per_node = sizeof(ast_node_t) + sizeof(ast_value_t);
+
+    printf("AST nodes:          %zu\n", ast_count(pool));
+    printf("AST bytes per node: %zu (%zu node + %zu value)\n", per_node,
+                sizeof(ast_node_t), sizeof(ast_value_t));
+    printf("AST bytes used:     %zu\n", ast_count(pool) * per_node);
+    printf("AST bytes reserved: %zu\n", pool->cap * per_node);
+}
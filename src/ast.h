@@ -0,0 +1,133 @@
+#ifndef __AST_H__
+#define __AST_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * The AST is stored in one contiguous array of fixed size nodes and the
+ * nodes refer to each other by 32 bit index. Index 0 is never used for a
+ * real node, so it stands for "no node". Pointers to nodes are only good
+ * until the next node is created, because the array can move when it grows.
+ * Keep indexes, not pointers.
+ *
+ * Literal values and names are kept in a second array with the same indexes
+ * as the nodes.
+ */
+typedef uint32_t ast_idx_t;
+
+#define AST_NONE    ((ast_idx_t)0)
+
+typedef enum {
+    AST_ERROR,
+    AST_LIST,           // child[0] = first, child[1] = last, child[2] = count
+    AST_NAMESPACE,      // str = name, child[0] = item list
+    AST_IMPORT,         // child[0] = formatted string
+    AST_ENTRY,          // child[0] = body
+    AST_FSTRING,        // str = format, child[0] = expression list
+    AST_CALL_PARAMS,    // child[0] = expression list
+    AST_INDEX,          // child[0] = expression
+    AST_IDENT,          // str = name, child[0] = parameter list
+    AST_COMPOUND_ID,    // child[0] = list of AST_IDENT
+    AST_COMPOUND_NAME,  // child[0] = list of AST_IDENT
+    AST_TYPE_NAME,      // op = type token, str = name
+    AST_TYPE_SPEC,      // op = LIST, DICT or 0, child[0] = type name
+    AST_INUM,           // inum
+    AST_UNUM,           // unum
+    AST_FNUM,           // fnum
+    AST_BOOL,           // inum
+    AST_BINARY,         // op = operator, child[0] = left, child[1] = right
+    AST_UNARY,          // op = operator, child[0] = operand
+    AST_CAST,           // child[0] = type spec, child[1] = expression
+    AST_ASSIGN,         // op = operator, child[0] = name, child[1] = expression
+    AST_STRUCT,         // str = name, child[0] = item list
+    AST_VAR_DECL,       // str = name, child[0] = type spec
+    AST_METHOD_DECL,    // str = name, child[0] = type spec, child[1] = params
+    AST_CTOR_DECL,      // child[1] = params
+    AST_DTOR_DECL,
+    AST_METHOD_DEF,     // op = kind, child[0] = type spec, child[1] = name,
+                        // child[2] = params, child[3] = body
+    AST_BLOCK,          // child[0] = statement list
+    AST_BREAK,
+    AST_CONTINUE,
+    AST_RETURN,         // child[0] = expression
+    AST_EXPR_STMT,      // child[0] = expression
+    AST_DICT_ELEM,      // str = name, child[0] = expression
+    AST_LIST_INIT,      // child[0] = expression list
+    AST_DICT_INIT,      // child[0] = element list
+    AST_VAR_DEF,        // child[0] = declaration, child[1] = initializer
+    AST_IF,             // child[0] = expr, child[1] = body, child[2] = else list
+    AST_ELSE_IF,        // child[0] = expr, child[1] = body
+    AST_ELSE,           // child[1] = body
+    AST_WHILE,          // child[0] = expr, child[1] = body
+    AST_DO,             // child[0] = expr, child[1] = body
+    AST_FOR,            // child[0] = init, child[1] = expr, child[2] = step,
+                        // child[3] = body
+    AST_CASE,           // child[0] = expr, child[1] = body
+    AST_DEFAULT,        // child[1] = body
+    AST_SWITCH,         // child[0] = expr, child[1] = case list
+    AST_NUM_KINDS
+} ast_kind_t;
+
+// node flags
+#define AST_F_PUBLIC    0x01
+#define AST_F_PRIVATE   0x02
+#define AST_F_CONST     0x04
+
+// kinds of AST_METHOD_DEF
+#define AST_M_METHOD    0
+#define AST_M_CTOR      1
+#define AST_M_DTOR      2
+
+typedef struct {
+    uint8_t kind;
+    uint8_t flags;
+    uint16_t op;
+    uint32_t line;
+    uint32_t col;
+    ast_idx_t child[4];
+    ast_idx_t next;     // next node in the same list
+} ast_node_t;
+
+typedef union {
+    long inum;
+    unsigned long unum;
+    double fnum;
+    const char* str;
+} ast_value_t;
+
+/*
+ * One AST per translation unit. The node array and the value array always
+ * have the same capacity.
+ */
+typedef struct {
+    ast_node_t* nodes;
+    ast_value_t* values;
+    size_t count;
+    size_t cap;
+    ast_idx_t root;
+} ast_t;
+
+#define AST_NODE(a, i)      (&(a)->nodes[i])
+#define AST_VALUE(a, i)     (&(a)->values[i])
+#define AST_KIND(a, i)      ((a)->nodes[i].kind)
+#define AST_CHILD(a, i, n)  ((a)->nodes[i].child[n])
+
+ast_t* create_ast();
+void destroy_ast(ast_t* ast);
+
+ast_idx_t ast_make(ast_t* ast, ast_kind_t kind, int op, int line, int col,
+                        ast_idx_t c0, ast_idx_t c1, ast_idx_t c2, ast_idx_t c3);
+ast_idx_t ast_make_str(ast_t* ast, ast_kind_t kind, const char* str,
+                        int line, int col, ast_idx_t c0, ast_idx_t c1);
+ast_idx_t ast_list_new(ast_t* ast, int line, int col);
+ast_idx_t ast_list_append(ast_t* ast, ast_idx_t list, ast_idx_t item);
+ast_idx_t ast_list_first(ast_t* ast, ast_idx_t list);
+size_t ast_list_count(ast_t* ast, ast_idx_t list);
+size_t ast_count(ast_t* ast);
+
+const char* ast_kind_name(ast_kind_t kind);
+void dump_ast(ast_t* ast, ast_idx_t idx);
+void print_ast_stats(ast_t* ast);
+
+#endif
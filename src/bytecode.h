@@ -0,0 +1,160 @@
+#ifndef __BYTECODE_H__
+#define __BYTECODE_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include "memory.h"
+#include "value.h"
+#include "resolve.h"
+
+/*
+ * Register based bytecode. Every instruction is 8 bytes: an opcode and three
+ * 16 bit operands. Registers are the slots of the method's frame; the locals
+ * that the resolution pass assigned come first and the temporaries follow.
+ *
+ * Operand formats:
+ *   F_A      a = register
+ *   F_AB     a, b = registers
+ *   F_ABC    a, b, c = registers
+ *   F_ABK    a, b = registers, c = constant
+ *   F_AK     a = register, b | c << 16 = constant
+ *   F_AG     a = register, b = global
+ *   F_AT     a, b = registers, c = value type, or STRUCT_TYPE() of a layout
+ *   F_J      c = jump target
+ *   F_AJ     a = register, c = jump target
+ *   F_ABJ    a, b = registers, c = jump target
+ *   F_AKJ    a = register, b = constant, c = jump target
+ *   F_CALL   a = first argument and result, b = method or builtin, or
+ *            for CALLD the set of overloads, c = argument count
+ *   F_FMT    a = result, b = format plan, a + 1 ... = c arguments
+ *   F_LIST   a = list or dict, b = its type, a + 1 ... = c elements, or
+ *            keys and values
+ *   F_AS     a = register, b = struct layout
+ *   F_ABF    a, b = registers, c = field
+ *   F_AFC    a = register, b = field, c = register
+ *   F_ERR    b = message constant
+ *   F_NONE   no operands
+ *
+ * The typed families (I for int, U for uint, F for float) do no checks and
+ * no conversions; the compiler only uses them when it knows the types. The
+ * untyped ones go through the runtime. IK means an int and an int constant.
+ */
+#define ARITH(s, f) \
+    OP(ADD##s, f) OP(SUB##s, f) OP(MUL##s, f) OP(DIV##s, f) OP(MOD##s, f)
+#define COMPARE(p, s, f) \
+    OP(p##EQ##s, f) OP(p##NE##s, f) OP(p##LT##s, f) \
+    OP(p##GT##s, f) OP(p##LE##s, f) OP(p##GE##s, f)
+
+#define OPCODES \
+    OP(MOVE, F_AB) OP(LOADK, F_AK) OP(GETG, F_AG) OP(SETG, F_AG) \
+    ARITH(, F_ABC) COMPARE(, , F_ABC) \
+    ARITH(I, F_ABC) COMPARE(, I, F_ABC) \
+    ARITH(U, F_ABC) COMPARE(, U, F_ABC) \
+    ARITH(F, F_ABC) COMPARE(, F, F_ABC) \
+    ARITH(IK, F_ABK) COMPARE(, IK, F_ABK) \
+    OP(NEG, F_AB) OP(NOT, F_AB) OP(BOOL, F_AB) OP(CONV, F_AT) OP(CAST, F_AT) \
+    OP(JMP, F_J) OP(JMPF, F_AJ) OP(JMPT, F_AJ) \
+    COMPARE(J, I, F_ABJ) COMPARE(J, IK, F_AKJ) \
+    OP(CALL, F_CALL) OP(CALLD, F_CALL) OP(BUILTIN, F_CALL) OP(FMT, F_FMT) \
+    OP(NEW, F_LIST) OP(EXTEND, F_LIST) OP(GETIDX, F_ABC) OP(SETIDX, F_ABC) \
+    OP(INST, F_AS) OP(GETF, F_ABF) OP(SETF, F_AFC) \
+    OP(RET, F_A) OP(RETN, F_NONE) OP(ERR, F_ERR)
+
+typedef enum {
+#define OP(n, f) OP_##n,
+    OPCODES
+#undef OP
+    OP_NUM_CODES
+} opcode_t;
+
+typedef enum {
+    F_A, F_AB, F_ABC, F_ABK, F_AK, F_AG, F_AT, F_J, F_AJ, F_ABJ, F_AKJ,
+    F_CALL, F_FMT, F_LIST, F_AS, F_ABF, F_AFC, F_ERR, F_NONE,
+} op_format_t;
+
+// where each operator is in its family, counting from ADD or EQ
+#define ARITH_ADD   0
+#define ARITH_SUB   1
+#define ARITH_MUL   2
+#define ARITH_DIV   3
+#define ARITH_MOD   4
+#define CMP_EQ      0
+#define CMP_NE      1
+#define CMP_LT      2
+#define CMP_GT      3
+#define CMP_LE      4
+#define CMP_GE      5
+
+#define NO_JUMP     0xFFFF
+#define MAX_OPERAND 0xFFFF
+
+// a field operand is the offset of the field and how it is stored, see
+// FIELD_KIND()
+#define FIELD_OPERAND(off, kind)    ((off) << 3 | (kind))
+#define FIELD_OFFSET(f)             ((f) >> 3)
+#define FIELD_STORED(f)             ((f) & 7)
+#define MAX_FIELD_OFFSET            (MAX_OPERAND >> 3)
+
+typedef struct {
+    uint16_t op;
+    uint16_t a;
+    uint16_t b;
+    uint16_t c;
+} instr_t;
+
+typedef struct {
+    uint32_t line;
+    uint32_t col;
+} code_loc_t;
+
+/*
+ * The code of one method. The locations run parallel to the code and are
+ * only used to report run time errors.
+ */
+typedef struct {
+    const char* name;
+    instr_t* code;
+    code_loc_t* locs;
+    int ncode;
+    int cap;
+    int nparams;
+    int nregs;
+} func_t;
+
+/*
+ * A compiled file. funcs[i] is the code of method i of the program that it
+ * was compiled from. The function that initializes the name space variables
+ * comes after the methods.
+ *
+ * A module that was loaded from the cache has its code, locations, names
+ * and strings in the mapped cache file, which is read only.
+ */
+typedef struct {
+    func_t* funcs;
+    int nfuncs;
+    int entry;              // -1 if there is no entry block
+    int init;
+    value_t* consts;
+    int nconsts;
+    uint8_t* global_types;
+    int nglobals;
+    struct_layout_t* layouts;   // of the structs, for INST and CONV
+    int nlayouts;
+    uint32_t* dispatch;     // the overloads for CALLD, as in the program
+    int ndispatch;
+    fmt_plan_t** formats;   // the plans for FMT
+    int nformats;
+    arena_t* arena;         // messages of the errors and boxed constants
+    void* map;              // the cache file, or NULL
+    size_t map_len;
+} module_t;
+
+#define OPERAND_K(i)    ((uint32_t)(i)->b | ((uint32_t)(i)->c << 16))
+
+module_t* compile_program(program_t* prog);
+void destroy_module(module_t* mod);
+
+const char* opcode_name(int op);
+void dump_module(module_t* mod, FILE* fp);
+
+#endif
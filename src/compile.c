@@ -0,0 +1,1233 @@
+/*
+ * Compile a resolved program to register bytecode. See bytecode.h for the
+ * instruction set.
+ *
+ * An expression is compiled into a register and the compiler keeps track of
+ * its type where the type is known from the declarations. When both sides of
+ * an operator have a known numeric type the typed instruction is used, and
+ * a comparison that decides a branch becomes one compare and jump. Values
+ * are converted to the declared type where they are stored, the same as the
+ * interpreter does, so the types of locals can be trusted.
+ *
+ * Temporaries are handed out above the locals like a stack and each
+ * statement gives back what it took. The arguments of a call are put in
+ * consecutive temporaries at the top, and the callee's frame starts at the
+ * first of them.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "memory.h"
+#include "errors.h"
+#include "parser.h"
+#include "bytecode.h"
+#include "runtime.h"
+
+typedef struct {
+    uint16_t reg;
+    uint8_t type;           // static type, VAL_ANY if it is not known
+} opnd_t;
+
+/*
+ * A construct that break jumps out of. The unpatched jumps of break and
+ * continue are chained through their targets. A continue in a switch
+ * belongs to the loop around it.
+ */
+typedef struct _breakable_t_ {
+    struct _breakable_t_* outer;
+    int is_loop;
+    int breaks;
+    int continues;
+} breakable_t;
+
+typedef struct {
+    uint8_t type;
+    uint64_t bits;
+    int index;
+} const_slot_t;
+
+typedef struct {
+    module_t* mod;
+    program_t* prog;
+    ast_t* ast;
+    func_t* fn;
+    method_t* method;       // NULL in the global initializer
+    ast_idx_t node;         // for the locations of what is emitted
+    int nlocals;            // registers below this are variables
+    int ntemps;             // the next free register
+    breakable_t* brk;
+    const_slot_t* kslots;   // constants that are already in the pool
+    int nkslots;
+} comp_t;
+
+static opnd_t expr(comp_t* c, ast_idx_t idx, int dest);
+static void statement(comp_t* c, ast_idx_t idx);
+
+#define KIND(i)     AST_KIND(c->ast, i)
+#define CHILD(i, n) AST_CHILD(c->ast, i, n)
+#define NEXT(i)     (AST_NODE(c->ast, i)->next)
+#define FIRST(l)    (((l) == AST_NONE)? AST_NONE: AST_CHILD(c->ast, l, 0))
+
+#define INIT_CHUNK  64      // registers, an even number
+
+static int emit(comp_t* c, int op, int a, int b, int cc) {
+
+    func_t* fn = c->fn;
+
+    if(fn->ncode >= MAX_OPERAND)
+        fatal_error("method %s is too large to compile", fn->name);
+    if(fn->ncode + 1 > fn->cap) {
+        fn->cap = (fn->cap == 0)? 64: fn->cap << 1;
+        fn->code = REALLOC_LST(fn->code, fn->cap, instr_t);
+        fn->locs = REALLOC_LST(fn->locs, fn->cap, code_loc_t);
+    }
+
+    instr_t* ins = &fn->code[fn->ncode];
+    ins->op = (uint16_t)op;
+    ins->a = (uint16_t)a;
+    ins->b = (uint16_t)b;
+    ins->c = (uint16_t)cc;
+    fn->locs[fn->ncode].line = AST_NODE(c->ast, c->node)->line;
+    fn->locs[fn->ncode].col = AST_NODE(c->ast, c->node)->col;
+    return fn->ncode++;
+}
+
+static int here(comp_t* c) {
+
+    return c->fn->ncode;
+}
+
+static void patch(comp_t* c, int jump, int target) {
+
+    if(jump != NO_JUMP)
+        c->fn->code[jump].c = (uint16_t)target;
+}
+
+// point every jump in the chain at the target
+static void patch_chain(comp_t* c, int chain, int target) {
+
+    while(chain != NO_JUMP) {
+        int next = c->fn->code[chain].c;
+        patch(c, chain, target);
+        chain = next;
+    }
+}
+
+static int alloc_reg(comp_t* c) {
+
+    if(c->ntemps >= MAX_OPERAND)
+        fatal_error("method %s needs too many registers", c->fn->name);
+    int reg = c->ntemps++;
+    if(c->ntemps > c->fn->nregs)
+        c->fn->nregs = c->ntemps;
+    return reg;
+}
+
+static int target_reg(comp_t* c, int dest) {
+
+    return (dest >= 0)? dest: alloc_reg(c);
+}
+
+/*
+ * Add a constant to the pool, or find the one that is already there. The
+ * pool is shared by the whole module and looked up through a hash table.
+ */
+static int add_const(comp_t* c, value_t val) {
+
+    module_t* mod = c->mod;
+    uint64_t bits = value_bits(val);
+
+    if(mod->nconsts * 2 >= c->nkslots) {
+        int nslots = (c->nkslots == 0)? 256: c->nkslots << 1;
+        const_slot_t* slots = ALLOC_LST(nslots, const_slot_t);
+        for(int i = 0; i < c->nkslots; i++) {
+            if(c->kslots[i].index == 0)
+                continue;
+            size_t h = (size_t)(c->kslots[i].bits * 0x9E3779B97F4A7C15ULL) >> 32;
+            while(slots[h & (nslots - 1)].index != 0)
+                h++;
+            slots[h & (nslots - 1)] = c->kslots[i];
+        }
+        if(c->kslots != NULL)
+            FREE(c->kslots);
+        c->kslots = slots;
+        c->nkslots = nslots;
+    }
+
+    // index is one more than the constant, so zero is an empty slot
+    size_t h = (size_t)(bits * 0x9E3779B97F4A7C15ULL) >> 32;
+    for(;; h++) {
+        const_slot_t* slot = &c->kslots[h & (c->nkslots - 1)];
+        if(slot->index == 0) {
+            mod->consts = REALLOC_LST(mod->consts, mod->nconsts + 1, value_t);
+            mod->consts[mod->nconsts++] = val;
+            slot->type = VAL_TYPE(val);
+            slot->bits = bits;
+            slot->index = mod->nconsts;
+            return mod->nconsts - 1;
+        }
+        if(slot->type == VAL_TYPE(val) && slot->bits == bits)
+            return slot->index - 1;
+    }
+}
+
+static void load_const(comp_t* c, int reg, value_t val) {
+
+    int k = add_const(c, val);
+    emit(c, OP_LOADK, reg, k & 0xFFFF, (unsigned)k >> 16);
+}
+
+static void error_op(comp_t* c, const char* fmt, const char* arg) {
+
+    char buf[256];
+    snprintf(buf, sizeof(buf), fmt, arg);
+    str_t* msg = str_new(c->mod->arena, buf, strlen(buf));
+    int k = add_const(c, STRING_VAL(msg));
+    if(k > MAX_OPERAND)
+        fatal_error("too many constants in %s", c->fn->name);
+    emit(c, OP_ERR, 0, k, 0);
+}
+
+/*
+ * Convert the register in place if the static type is not already the
+ * declared type.
+ */
+static void convert_to(comp_t* c, int reg, int from, int type) {
+
+    if(type != VAL_ANY && from != type)
+        emit(c, OP_CONV, reg, reg, type);
+}
+
+static int arith_offset(int op) {
+
+    switch(op) {
+        case '+': return ARITH_ADD;
+        case '-': return ARITH_SUB;
+        case '*': return ARITH_MUL;
+        case '/': return ARITH_DIV;
+        case '%': return ARITH_MOD;
+        default: return -1;
+    }
+}
+
+static int compare_offset(int op) {
+
+    switch(op) {
+        case EQ_OP: return CMP_EQ;
+        case NE_OP: return CMP_NE;
+        case '<': return CMP_LT;
+        case '>': return CMP_GT;
+        case LE_OP: return CMP_LE;
+        case GE_OP: return CMP_GE;
+        default: return -1;
+    }
+}
+
+static int negate_compare(int off) {
+
+    static const int neg[] = { CMP_NE, CMP_EQ, CMP_GE, CMP_LE, CMP_GT, CMP_LT };
+    return neg[off];
+}
+
+#define IS_INTLIKE(t)   ((t) == VAL_INT || (t) == VAL_BOOL)
+
+/*
+ * Which typed family, if any, is right for the operand types. Returns 'I',
+ * 'U', 'F' or 0.
+ */
+static int family(int left, int right) {
+
+    if(IS_INTLIKE(left) && IS_INTLIKE(right))
+        return 'I';
+    if((left == VAL_UINT && (right == VAL_UINT || IS_INTLIKE(right))) ||
+                (right == VAL_UINT && IS_INTLIKE(left)))
+        return 'U';
+    if(left == VAL_FLOAT && right == VAL_FLOAT)
+        return 'F';
+    return 0;
+}
+
+// what the interpreter would produce, if it can be known
+static int result_type(int op, int left, int right) {
+
+    if(compare_offset(op) >= 0)
+        return VAL_BOOL;
+    if(left == VAL_STRING && right == VAL_STRING && op == '+')
+        return VAL_STRING;
+    if(left == VAL_ANY || right == VAL_ANY || left == VAL_STRING || right == VAL_STRING ||
+                left == VAL_NOTHING || right == VAL_NOTHING)
+        return VAL_ANY;
+    if(left == VAL_FLOAT || right == VAL_FLOAT)
+        return VAL_FLOAT;
+    if(left == VAL_UINT || right == VAL_UINT)
+        return VAL_UINT;
+    return VAL_INT;
+}
+
+/*
+ * The instruction for the operator on the types, with the right operand in
+ * a register.
+ */
+static int binary_opcode(int op, int left, int right) {
+
+    int arith = arith_offset(op);
+    int cmp = compare_offset(op);
+
+    switch(family(left, right)) {
+        case 'I': return (arith >= 0)? OP_ADDI + arith: OP_EQI + cmp;
+        case 'U': return (arith >= 0)? OP_ADDU + arith: OP_EQU + cmp;
+        case 'F': return (arith >= 0)? OP_ADDF + arith: OP_EQF + cmp;
+        default: return (arith >= 0)? OP_ADD + arith: OP_EQ + cmp;
+    }
+}
+
+/*
+ * The index of the right operand's constant if it is an int literal or an
+ * int that was folded, and the index fits in an operand.
+ */
+static int int_literal(comp_t* c, ast_idx_t idx) {
+
+    binding_t* b = BIND(c->prog, idx);
+    int k;
+
+    if(b->kind == BIND_CONST && b->type == VAL_INT)
+        k = add_const(c, c->prog->consts[b->index]);
+    else if(KIND(idx) == AST_INUM)
+        k = add_const(c, INT_VAL(AST_VALUE(c->ast, idx)->inum));
+    else
+        return -1;
+    return (k <= MAX_OPERAND)? k: -1;
+}
+
+/*
+ * Apply the operator to the left operand and the right expression and put
+ * the result in dest. The temporaries from save up are free again once the
+ * operands are read, so the result can go in one of them.
+ */
+static opnd_t emit_binary(comp_t* c, int op, opnd_t left, ast_idx_t right_idx, int dest, int save) {
+
+    opnd_t res;
+    int k = IS_INTLIKE(left.type)? int_literal(c, right_idx): -1;
+
+    if(k >= 0) {
+        int arith = arith_offset(op);
+        int opcode = (arith >= 0)? OP_ADDIK + arith: OP_EQIK + compare_offset(op);
+        c->ntemps = save;
+        res.reg = target_reg(c, dest);
+        res.type = (arith >= 0)? VAL_INT: VAL_BOOL;
+        emit(c, opcode, res.reg, left.reg, k);
+        return res;
+    }
+
+    opnd_t right = expr(c, right_idx, -1);
+    c->ntemps = save;
+    res.reg = target_reg(c, dest);
+    res.type = result_type(op, left.type, right.type);
+    emit(c, binary_opcode(op, left.type, right.type), res.reg, left.reg, right.reg);
+    return res;
+}
+
+/*
+ * "and" and "or" do not evaluate the right side if the left side decides.
+ * The result goes through a new temporary, because dest may be a variable
+ * that the right side reads.
+ */
+static opnd_t logical(comp_t* c, ast_idx_t idx, int dest) {
+
+    int save = c->ntemps;
+    int tmp = alloc_reg(c);
+    int jump_op = (AST_NODE(c->ast, idx)->op == AND_OP)? OP_JMPF: OP_JMPT;
+
+    opnd_t left = expr(c, CHILD(idx, 0), tmp);
+    emit(c, OP_BOOL, tmp, left.reg, 0);
+    int jump = emit(c, jump_op, tmp, 0, NO_JUMP);
+    opnd_t right = expr(c, CHILD(idx, 1), tmp);
+    emit(c, OP_BOOL, tmp, right.reg, 0);
+    patch(c, jump, here(c));
+
+    c->ntemps = save;
+    opnd_t res = { (uint16_t)target_reg(c, dest), VAL_BOOL };
+    if(res.reg != tmp)
+        emit(c, OP_MOVE, res.reg, tmp, 0);
+    return res;
+}
+
+/*
+ * Put the list, dict or struct that an index, a method or a field is used
+ * on in a register. That is the local itself when dest is -1 and the
+ * variable is a local.
+ */
+static int receiver_reg(comp_t* c, ast_idx_t idx, int dest) {
+
+    binding_t* b = BIND(c->prog, CHILD(CHILD(idx, 0), 1));
+
+    if(b->kind == BIND_LOCAL) {
+        if(dest < 0)
+            return b->index;
+        emit(c, OP_MOVE, dest, b->index, 0);
+        return dest;
+    }
+    dest = target_reg(c, dest);
+    emit(c, OP_GETG, dest, b->index, 0);
+    return dest;
+}
+
+/*
+ * Put the arguments in consecutive registers from the top and return the
+ * first. There is always at least one register, for the result. If dest is
+ * the last temporary the call is made there, so that the result does not
+ * have to be moved. A list or dict method gets the list or dict before its
+ * arguments, and a method of a struct the instance.
+ */
+static int arguments(comp_t* c, ast_idx_t args, ast_idx_t params, int dest, ast_idx_t recv) {
+
+    int base = c->ntemps;
+
+    if(dest >= c->nlocals && dest == c->ntemps - 1)
+        base = dest;
+    else
+        alloc_reg(c);
+    if(recv != AST_NONE)
+        receiver_reg(c, recv, base);
+    for(ast_idx_t n = FIRST(args); n != AST_NONE; n = NEXT(n)) {
+        int reg = (n == FIRST(args) && recv == AST_NONE)? base: alloc_reg(c);
+        int save = c->ntemps;
+        opnd_t arg = expr(c, n, reg);
+        c->ntemps = save;
+        if(params != AST_NONE) {
+            ast_idx_t saved = c->node;
+            c->node = n;
+            convert_to(c, reg, arg.type, DECL_TYPE(BIND(c->prog, params)));
+            c->node = saved;
+            params = NEXT(params);
+        }
+    }
+    return base;
+}
+
+static opnd_t call(comp_t* c, ast_idx_t idx, binding_t* b, int dest) {
+
+    int save = c->ntemps;
+    int nargs = b->nargs;
+    int base, op;
+    opnd_t res;
+
+    if(b->kind == BIND_METHOD) {
+        method_t* m = &c->prog->methods[b->index];
+        int owned = (m->owner >= 0);
+        base = arguments(c, b->args, FIRST(m->params), dest, owned? idx: AST_NONE);
+        op = OP_CALL;
+        res.type = m->ret_type;
+        nargs += owned;
+    }
+    else if(b->kind == BIND_DISPATCH) {
+        // the arguments are converted when the method is chosen
+        int skip = SET_SKIP(&c->prog->dispatch[b->index]);
+        if(b->index > MAX_OPERAND)
+            fatal_error("too many overloaded calls in %s", c->fn->name);
+        base = arguments(c, b->args, AST_NONE, dest, skip? idx: AST_NONE);
+        op = OP_CALLD;
+        res.type = b->type;
+        nargs += skip;
+    }
+    else if(b->index == BUILTIN_PRINT) {
+        base = arguments(c, b->args, AST_NONE, dest, AST_NONE);
+        op = OP_BUILTIN;
+        res.type = VAL_NOTHING;
+    }
+    else {
+        base = arguments(c, b->args, AST_NONE, dest, idx);
+        op = OP_BUILTIN;
+        res.type = b->type;
+        nargs++;
+    }
+    c->node = idx;
+    emit(c, op, base, b->index, nargs);
+
+    c->ntemps = save;
+    res.reg = target_reg(c, dest);
+    if(res.reg != base)
+        emit(c, OP_MOVE, res.reg, base, 0);
+    return res;
+}
+
+static const char* name_text(comp_t* c, ast_idx_t idx, char* buf, size_t len) {
+
+    size_t pos = 0;
+
+    buf[0] = '\0';
+    for(ast_idx_t n = FIRST(CHILD(idx, 0)); n != AST_NONE && pos < len; n = NEXT(n))
+        pos += snprintf(buf + pos, len - pos, "%s%s", (pos > 0)? ".": "",
+                            AST_VALUE(c->ast, n)->str);
+    return buf;
+}
+
+/*
+ * Read an element of a list or a dict. The type of the elements is known
+ * from the declaration, and GETIDX fails if the variable is neither.
+ */
+static opnd_t element(comp_t* c, ast_idx_t idx, binding_t* b, int dest) {
+
+    int save = c->ntemps;
+    int var = receiver_reg(c, idx, -1);
+    opnd_t index = expr(c, b->args, -1);
+
+    c->ntemps = save;
+    opnd_t res = { (uint16_t)target_reg(c, dest), b->type };
+    c->node = idx;
+    emit(c, OP_GETIDX, res.reg, var, index.reg);
+    return res;
+}
+
+// the operand of a field, or -1 after an error if its offset does not fit
+static int field_operand(comp_t* c, ast_idx_t idx, binding_t* b) {
+
+    char buf[128];
+
+    if(b->index > MAX_FIELD_OFFSET) {
+        error_op(c, "%s is too far into its struct", name_text(c, idx, buf, sizeof(buf)));
+        return -1;
+    }
+    return FIELD_OPERAND(b->index, FIELD_KIND(b->type));
+}
+
+/*
+ * Read a field of a struct, which is at an offset that the resolver found.
+ * GETF fails if the variable is not a struct.
+ */
+static opnd_t field(comp_t* c, ast_idx_t idx, binding_t* b, int dest) {
+
+    int var = receiver_reg(c, idx, -1);
+    opnd_t res = { (uint16_t)target_reg(c, dest), b->type };
+    int fld;
+
+    c->node = idx;
+    if((fld = field_operand(c, idx, b)) >= 0)
+        emit(c, OP_GETF, res.reg, var, fld);
+    return res;
+}
+
+static opnd_t name(comp_t* c, ast_idx_t idx, int dest) {
+
+    binding_t* b = BIND(c->prog, idx);
+    opnd_t res = { 0, b->type };
+    char buf[128];
+
+    switch(b->kind) {
+        case BIND_LOCAL:
+            if(dest < 0 || dest == (int)b->index) {
+                res.reg = b->index;
+                return res;
+            }
+            emit(c, OP_MOVE, dest, b->index, 0);
+            res.reg = dest;
+            return res;
+
+        case BIND_GLOBAL:
+            res.reg = target_reg(c, dest);
+            emit(c, OP_GETG, res.reg, b->index, 0);
+            return res;
+
+        case BIND_METHOD:
+        case BIND_DISPATCH:
+        case BIND_BUILTIN:
+            return call(c, idx, b, dest);
+
+        case BIND_ELEMENT:
+            return element(c, idx, b, dest);
+
+        case BIND_FIELD:
+            return field(c, idx, b, dest);
+
+        default:
+            error_op(c, "%s is not defined", name_text(c, idx, buf, sizeof(buf)));
+            res.reg = target_reg(c, dest);
+            res.type = VAL_ANY;
+            return res;
+    }
+}
+
+static opnd_t format(comp_t* c, ast_idx_t idx, int dest) {
+
+    int save = c->ntemps;
+    int base = (dest >= c->nlocals && dest == c->ntemps - 1)? dest: alloc_reg(c);
+    int nargs = 0;
+
+    for(ast_idx_t n = FIRST(CHILD(idx, 0)); n != AST_NONE; n = NEXT(n), nargs++) {
+        int reg = alloc_reg(c);
+        int inner = c->ntemps;
+        expr(c, n, reg);
+        c->ntemps = inner;
+    }
+
+    // the module keeps its own copy of the plan
+    module_t* mod = c->mod;
+    if(mod->nformats > MAX_OPERAND)
+        fatal_error("too many formatted strings in %s", c->fn->name);
+    mod->formats = REALLOC_LST(mod->formats, mod->nformats + 1, fmt_plan_t*);
+    mod->formats[mod->nformats] = copy_format_plan(c->prog->formats[BIND(c->prog, idx)->index]);
+    c->node = idx;
+    emit(c, OP_FMT, base, mod->nformats++, nargs);
+
+    c->ntemps = save;
+    opnd_t res = { (uint16_t)target_reg(c, dest), VAL_STRING };
+    if(res.reg != base)
+        emit(c, OP_MOVE, res.reg, base, 0);
+    return res;
+}
+
+/*
+ * Compile the expression. The result goes to dest, or when dest is -1, to
+ * a new temporary or straight to the local that the expression names.
+ */
+static opnd_t expr(comp_t* c, ast_idx_t idx, int dest) {
+
+    ast_node_t* node = AST_NODE(c->ast, idx);
+    ast_value_t* val = AST_VALUE(c->ast, idx);
+    binding_t* b = BIND(c->prog, idx);
+    ast_idx_t saved = c->node;
+    opnd_t res = { 0, VAL_ANY };
+    int save;
+
+    c->node = idx;
+    if(b->kind == BIND_CONST) {
+        // folded, or a constant
+        res.reg = target_reg(c, dest);
+        res.type = b->type;
+        load_const(c, res.reg, c->prog->consts[b->index]);
+        c->node = saved;
+        return res;
+    }
+
+    switch(node->kind) {
+        case AST_COMPOUND_NAME:
+            res = name(c, idx, dest);
+            break;
+
+        case AST_INUM:
+            res.reg = target_reg(c, dest);
+            res.type = VAL_INT;
+            load_const(c, res.reg, INT_VAL(val->inum));
+            break;
+
+        case AST_UNUM:
+            res.reg = target_reg(c, dest);
+            res.type = VAL_UINT;
+            load_const(c, res.reg, UINT_VAL(val->unum));
+            break;
+
+        case AST_FNUM:
+            res.reg = target_reg(c, dest);
+            res.type = VAL_FLOAT;
+            load_const(c, res.reg, FLOAT_VAL(val->fnum));
+            break;
+
+        case AST_BOOL:
+            res.reg = target_reg(c, dest);
+            res.type = VAL_BOOL;
+            load_const(c, res.reg, BOOL_VAL(val->inum));
+            break;
+
+        case AST_FSTRING:
+            if(node->child[0] != AST_NONE)
+                res = format(c, idx, dest);
+            else {
+                res.reg = target_reg(c, dest);
+                res.type = VAL_STRING;
+                load_const(c, res.reg, STRING_VAL(STR_OF(val->str)));
+            }
+            break;
+
+        case AST_BINARY:
+            if(node->op == AND_OP || node->op == OR_OP)
+                res = logical(c, idx, dest);
+            else {
+                save = c->ntemps;
+                opnd_t left = expr(c, node->child[0], -1);
+                res = emit_binary(c, node->op, left, node->child[1], dest, save);
+            }
+            break;
+
+        case AST_UNARY: {
+            save = c->ntemps;
+            opnd_t operand = expr(c, node->child[0], -1);
+            c->ntemps = save;
+            res.reg = target_reg(c, dest);
+            if(node->op == NOT) {
+                res.type = VAL_BOOL;
+                emit(c, OP_NOT, res.reg, operand.reg, 0);
+            }
+            else {
+                res.type = (operand.type == VAL_BOOL)? VAL_INT:
+                            (operand.type >= VAL_INT && operand.type <= VAL_FLOAT)? operand.type: VAL_ANY;
+                emit(c, OP_NEG, res.reg, operand.reg, 0);
+            }
+            break;
+        }
+
+        case AST_CAST: {
+            save = c->ntemps;
+            opnd_t operand = expr(c, node->child[1], -1);
+            c->ntemps = save;
+            res.reg = target_reg(c, dest);
+            res.type = BIND(c->prog, idx)->type;
+            emit(c, OP_CAST, res.reg, operand.reg, res.type);
+            break;
+        }
+
+        default:
+            error_op(c, "%s cannot be run yet", ast_kind_name(node->kind));
+            res.reg = target_reg(c, dest);
+            break;
+    }
+
+    c->node = saved;
+    return res;
+}
+
+/*
+ * Jump to the target if the condition is true, or if it is false when
+ * when_true is zero. A comparison of two ints, or of an int and an int
+ * literal, is a single compare and jump. Returns the jump so that it can be
+ * patched if the target is not known yet, or NO_JUMP if the condition is a
+ * constant that never jumps.
+ */
+static int cond_jump(comp_t* c, ast_idx_t idx, int when_true, int target) {
+
+    ast_node_t* node = AST_NODE(c->ast, idx);
+    binding_t* b = BIND(c->prog, idx);
+    int save = c->ntemps;
+    int cmp = (node->kind == AST_BINARY)? compare_offset(node->op): -1;
+    int jump;
+
+    c->node = idx;
+    if(b->kind == BIND_CONST || node->kind == AST_BOOL) {
+        value_t val = (b->kind == BIND_CONST)? c->prog->consts[b->index]:
+                            BOOL_VAL(AST_VALUE(c->ast, idx)->inum);
+        if(value_truth(val) != when_true)
+            return NO_JUMP;
+        return emit(c, OP_JMP, 0, 0, target);
+    }
+    if(cmp >= 0) {
+        opnd_t left = expr(c, node->child[0], -1);
+        if(IS_INTLIKE(left.type)) {
+            int off = when_true? cmp: negate_compare(cmp);
+            int k = int_literal(c, node->child[1]);
+            if(k >= 0) {
+                c->ntemps = save;
+                c->node = idx;
+                return emit(c, OP_JEQIK + off, left.reg, k, target);
+            }
+            opnd_t right = expr(c, node->child[1], -1);
+            if(IS_INTLIKE(right.type)) {
+                c->ntemps = save;
+                c->node = idx;
+                return emit(c, OP_JEQI + off, left.reg, right.reg, target);
+            }
+            int tmp = alloc_reg(c);
+            emit(c, binary_opcode(node->op, left.type, right.type), tmp, left.reg, right.reg);
+            jump = emit(c, when_true? OP_JMPT: OP_JMPF, tmp, 0, target);
+            c->ntemps = save;
+            return jump;
+        }
+        opnd_t res = emit_binary(c, node->op, left, node->child[1], -1, save);
+        jump = emit(c, when_true? OP_JMPT: OP_JMPF, res.reg, 0, target);
+        c->ntemps = save;
+        return jump;
+    }
+
+    opnd_t res = expr(c, idx, -1);
+    c->node = idx;
+    jump = emit(c, when_true? OP_JMPT: OP_JMPF, res.reg, 0, target);
+    c->ntemps = save;
+    return jump;
+}
+
+/*
+ * Return from the method with nothing. A method that has a return type
+ * reports the error the interpreter does, when it gets here.
+ */
+static void return_nothing(comp_t* c) {
+
+    int type = (c->method != NULL)? c->method->ret_type: VAL_NOTHING;
+
+    if(type == VAL_NOTHING || type == VAL_ANY)
+        emit(c, OP_RETN, 0, 0, 0);
+    else {
+        int save = c->ntemps;
+        int reg = alloc_reg(c);
+        load_const(c, reg, NOTHING_VAL);
+        emit(c, OP_CONV, reg, reg, type);
+        emit(c, OP_RET, reg, 0, 0);
+        c->ntemps = save;
+    }
+}
+
+/*
+ * A list or dict initializer. The elements are put in the registers above
+ * the variable and added INIT_CHUNK registers at a time, so that a long one
+ * does not need a register for every element. A dict element takes two,
+ * its key and its value.
+ */
+static void container_init(comp_t* c, ast_idx_t idx, int dest, int type) {
+
+    int save = c->ntemps;
+    int base = (dest >= c->nlocals && dest == c->ntemps - 1)? dest: alloc_reg(c);
+    int first = c->ntemps;
+    int is_dict = (KIND(idx) == AST_DICT_INIT);
+    int op = OP_NEW;
+    ast_idx_t n = FIRST(CHILD(idx, 0));
+
+    c->node = idx;
+    if(is_dict? !IS_DICT_TYPE(type): !IS_LIST_TYPE(type)) {
+        error_op(c, is_dict? "a dict cannot initialize %s": "a list cannot initialize %s",
+                    VAL_TOSTR(type));
+        c->ntemps = save;
+        return;
+    }
+
+    do {
+        int count = 0;
+        for(; n != AST_NONE && count < INIT_CHUNK; n = NEXT(n)) {
+            int inner;
+            if(is_dict) {
+                load_const(c, alloc_reg(c), STRING_VAL(STR_OF(AST_VALUE(c->ast, n)->str)));
+                count++;
+            }
+            int reg = alloc_reg(c);
+            inner = c->ntemps;
+            expr(c, is_dict? CHILD(n, 0): n, reg);
+            c->ntemps = inner;
+            count++;
+        }
+        c->node = idx;
+        emit(c, op, base, type, count);
+        c->ntemps = first;
+        op = OP_EXTEND;
+    } while(n != AST_NONE);
+
+    c->ntemps = save;
+    if(dest != base)
+        emit(c, OP_MOVE, dest, base, 0);
+}
+
+static void define(comp_t* c, ast_idx_t idx) {
+
+    binding_t* b = BIND(c->prog, CHILD(idx, 0));
+    ast_idx_t init = CHILD(idx, 1);
+    int reg = (b->kind == BIND_LOCAL)? (int)b->index: alloc_reg(c);
+
+    if(init != AST_NONE && (KIND(init) == AST_LIST_INIT || KIND(init) == AST_DICT_INIT))
+        container_init(c, init, reg, b->type);
+    else if(init != AST_NONE) {
+        opnd_t val = expr(c, init, reg);
+        convert_to(c, reg, val.type, DECL_TYPE(b));
+    }
+    else if(IS_CONTAINER_TYPE(b->type))
+        emit(c, OP_NEW, reg, b->type, 0);
+    else if(b->type == VAL_STRUCT)
+        emit(c, OP_INST, reg, b->layout, 0);
+    else
+        load_const(c, reg, zero_value(b->type));
+
+    if(b->kind == BIND_GLOBAL)
+        emit(c, OP_SETG, reg, b->index, 0);
+}
+
+/*
+ * Assign to an element of a list or a dict. SETIDX converts the value to
+ * the type of the elements.
+ */
+static void assign_element(comp_t* c, ast_idx_t idx, int op) {
+
+    ast_idx_t target = CHILD(idx, 0);
+    binding_t* b = BIND(c->prog, target);
+    int var = receiver_reg(c, target, -1);
+    opnd_t index = expr(c, b->args, -1);
+    opnd_t res;
+
+    if(op == 0)
+        res = expr(c, CHILD(idx, 1), -1);
+    else {
+        opnd_t cur = { (uint16_t)alloc_reg(c), b->type };
+        c->node = idx;
+        emit(c, OP_GETIDX, cur.reg, var, index.reg);
+        res = emit_binary(c, op, cur, CHILD(idx, 1), cur.reg, c->ntemps);
+    }
+    c->node = idx;
+    emit(c, OP_SETIDX, var, index.reg, res.reg);
+}
+
+/*
+ * Assign to a field of a struct. The value is converted to the type of the
+ * field first, in a temporary unless it already is one.
+ */
+static void assign_field(comp_t* c, ast_idx_t idx, int op) {
+
+    ast_idx_t target = CHILD(idx, 0);
+    binding_t* b = BIND(c->prog, target);
+    int var = receiver_reg(c, target, -1);
+    int fld;
+    opnd_t res;
+
+    c->node = idx;
+    if((fld = field_operand(c, target, b)) < 0)
+        return;
+
+    if(op == 0)
+        res = expr(c, CHILD(idx, 1), -1);
+    else {
+        opnd_t cur = { (uint16_t)alloc_reg(c), b->type };
+        c->node = idx;
+        emit(c, OP_GETF, cur.reg, var, fld);
+        res = emit_binary(c, op, cur, CHILD(idx, 1), cur.reg, c->ntemps);
+    }
+    c->node = idx;
+    if(b->type != VAL_ANY && res.type != b->type) {
+        if(res.reg < c->nlocals) {
+            int reg = alloc_reg(c);
+            emit(c, OP_MOVE, reg, res.reg, 0);
+            res.reg = reg;
+        }
+        emit(c, OP_CONV, res.reg, res.reg, b->type);
+    }
+    emit(c, OP_SETF, var, fld, res.reg);
+}
+
+static void assign(comp_t* c, ast_idx_t idx) {
+
+    ast_node_t* node = AST_NODE(c->ast, idx);
+    binding_t* b = BIND(c->prog, node->child[0]);
+    char buf[128];
+    int op;
+
+    switch(node->op) {
+        case ADD_ASSIGN: op = '+'; break;
+        case SUB_ASSIGN: op = '-'; break;
+        case MUL_ASSIGN: op = '*'; break;
+        case DIV_ASSIGN: op = '/'; break;
+        case MOD_ASSIGN: op = '%'; break;
+        default: op = 0; break;
+    }
+
+    if(b->kind == BIND_ELEMENT) {
+        assign_element(c, idx, op);
+        return;
+    }
+    if(b->kind == BIND_FIELD) {
+        assign_field(c, idx, op);
+        return;
+    }
+    if(b->kind == BIND_CONST) {
+        error_op(c, "cannot assign to the constant %s", name_text(c, node->child[0], buf, sizeof(buf)));
+        return;
+    }
+    if(b->kind != BIND_LOCAL && b->kind != BIND_GLOBAL) {
+        error_op(c, "cannot assign to %s", name_text(c, node->child[0], buf, sizeof(buf)));
+        return;
+    }
+
+    int reg = (b->kind == BIND_LOCAL)? (int)b->index: alloc_reg(c);
+    opnd_t res;
+    if(op == 0)
+        res = expr(c, node->child[1], reg);
+    else {
+        opnd_t cur = { (uint16_t)reg, b->type };
+        if(b->kind == BIND_GLOBAL)
+            emit(c, OP_GETG, reg, b->index, 0);
+        res = emit_binary(c, op, cur, node->child[1], reg, c->ntemps);
+    }
+    convert_to(c, reg, res.type, DECL_TYPE(b));
+
+    if(b->kind == BIND_GLOBAL)
+        emit(c, OP_SETG, reg, b->index, 0);
+}
+
+static void enter(comp_t* c, breakable_t* brk, int is_loop) {
+
+    brk->outer = c->brk;
+    brk->is_loop = is_loop;
+    brk->breaks = NO_JUMP;
+    brk->continues = NO_JUMP;
+    c->brk = brk;
+}
+
+static void leave(comp_t* c, breakable_t* brk, int cont_target, int break_target) {
+
+    patch_chain(c, brk->continues, cont_target);
+    patch_chain(c, brk->breaks, break_target);
+    c->brk = brk->outer;
+}
+
+/*
+ * Loops are laid out with the condition at the bottom, so an iteration
+ * takes one jump.
+ */
+static void loop(comp_t* c, ast_idx_t cond, ast_idx_t body, ast_idx_t step, int test_first) {
+
+    breakable_t brk;
+    int enter_jump = test_first? emit(c, OP_JMP, 0, 0, NO_JUMP): -1;
+    int top = here(c);
+
+    enter(c, &brk, 1);
+    statement(c, body);
+    int cont = here(c);
+    if(step != AST_NONE) {
+        int save = c->ntemps;
+        expr(c, step, -1);
+        c->ntemps = save;
+    }
+    if(enter_jump >= 0)
+        patch(c, enter_jump, here(c));
+    if(cond != AST_NONE)
+        cond_jump(c, cond, 1, top);
+    else
+        emit(c, OP_JMP, 0, 0, top);
+    leave(c, &brk, cont, here(c));
+}
+
+static void if_statement(comp_t* c, ast_idx_t idx) {
+
+    int end = NO_JUMP;
+    int next = cond_jump(c, CHILD(idx, 0), 0, NO_JUMP);
+
+    statement(c, CHILD(idx, 1));
+    for(ast_idx_t n = FIRST(CHILD(idx, 2)); n != AST_NONE; n = NEXT(n)) {
+        end = emit(c, OP_JMP, 0, 0, end);
+        patch(c, next, here(c));
+        next = NO_JUMP;
+        if(KIND(n) == AST_ELSE_IF)
+            next = cond_jump(c, CHILD(n, 0), 0, NO_JUMP);
+        statement(c, CHILD(n, 1));
+    }
+    if(next != NO_JUMP)
+        patch(c, next, here(c));
+    patch_chain(c, end, here(c));
+}
+
+static void switch_statement(comp_t* c, ast_idx_t idx) {
+
+    breakable_t brk;
+    opnd_t val = expr(c, CHILD(idx, 0), alloc_reg(c));
+
+    enter(c, &brk, 0);
+    for(ast_idx_t n = FIRST(CHILD(idx, 1)); n != AST_NONE; n = NEXT(n)) {
+        int next = NO_JUMP;
+        c->node = n;
+        if(KIND(n) == AST_CASE) {
+            int save = c->ntemps;
+            opnd_t cv = expr(c, CHILD(n, 0), -1);
+            int tmp = alloc_reg(c);
+            emit(c, binary_opcode(EQ_OP, val.type, cv.type), tmp, val.reg, cv.reg);
+            next = emit(c, OP_JMPF, tmp, 0, NO_JUMP);
+            c->ntemps = save;
+        }
+        statement(c, CHILD(n, 1));
+        brk.breaks = emit(c, OP_JMP, 0, 0, brk.breaks);
+        if(next != NO_JUMP)
+            patch(c, next, here(c));
+    }
+    leave(c, &brk, NO_JUMP, here(c));
+}
+
+static void statement(comp_t* c, ast_idx_t idx) {
+
+    ast_node_t* node = AST_NODE(c->ast, idx);
+    int save = c->ntemps;
+    breakable_t* brk;
+
+    c->node = idx;
+    switch(node->kind) {
+        case AST_BLOCK:
+            for(ast_idx_t n = FIRST(node->child[0]); n != AST_NONE; n = NEXT(n))
+                statement(c, n);
+            break;
+
+        case AST_VAR_DEF:
+            define(c, idx);
+            break;
+
+        case AST_ASSIGN:
+            assign(c, idx);
+            break;
+
+        case AST_EXPR_STMT:
+            expr(c, node->child[0], -1);
+            break;
+
+        case AST_IF:
+            if_statement(c, idx);
+            break;
+
+        case AST_WHILE:
+            loop(c, node->child[0], node->child[1], AST_NONE, 1);
+            break;
+
+        case AST_DO:
+            loop(c, node->child[0], node->child[1], AST_NONE, 0);
+            break;
+
+        case AST_FOR:
+            if(node->child[0] != AST_NONE && KIND(node->child[0]) == AST_VAR_DEF)
+                define(c, node->child[0]);
+            loop(c, node->child[1], node->child[3], node->child[2], 1);
+            break;
+
+        case AST_SWITCH:
+            switch_statement(c, idx);
+            break;
+
+        case AST_BREAK:
+        case AST_CONTINUE:
+            for(brk = c->brk; brk != NULL; brk = brk->outer)
+                if(node->kind == AST_BREAK || brk->is_loop)
+                    break;
+            if(brk == NULL)
+                return_nothing(c);
+            else if(node->kind == AST_BREAK)
+                brk->breaks = emit(c, OP_JMP, 0, 0, brk->breaks);
+            else
+                brk->continues = emit(c, OP_JMP, 0, 0, brk->continues);
+            break;
+
+        case AST_RETURN:
+            if(node->child[0] == AST_NONE)
+                return_nothing(c);
+            else {
+                int type = (c->method != NULL)? c->method->ret_type: VAL_NOTHING;
+                opnd_t val = expr(c, node->child[0], -1);
+                c->node = idx;
+                if(type != VAL_ANY && type != val.type) {
+                    int reg = alloc_reg(c);
+                    emit(c, OP_CONV, reg, val.reg, type);
+                    val.reg = reg;
+                }
+                emit(c, OP_RET, val.reg, 0, 0);
+            }
+            break;
+
+        default:
+            error_op(c, "%s cannot be run yet", ast_kind_name(node->kind));
+            break;
+    }
+    c->ntemps = save;
+}
+
+// the signature, which tells overloads apart
+static const char* func_name(method_t* m) {
+
+    if(m == NULL)
+        return "(init)";
+    if(m->parts == NULL)
+        return "entry";
+    return m->sig;
+}
+
+static void compile_method(comp_t* c, int index) {
+
+    method_t* m = &c->prog->methods[index];
+
+    c->fn = &c->mod->funcs[index];
+    c->method = m;
+    c->fn->name = func_name(m);
+    c->fn->nparams = m->nparams + (m->owner >= 0);
+    c->fn->nregs = m->nslots;
+    c->nlocals = m->nslots;
+    c->ntemps = m->nslots;
+    c->node = m->def;
+    c->brk = NULL;
+
+    statement(c, m->body);
+    c->node = m->def;
+    return_nothing(c);
+}
+
+static void compile_init(comp_t* c) {
+
+    program_t* prog = c->prog;
+
+    c->fn = &c->mod->funcs[c->mod->init];
+    c->method = NULL;
+    c->fn->name = func_name(NULL);
+    c->nlocals = 0;
+    c->ntemps = 0;
+    c->brk = NULL;
+    c->node = AST_NONE;
+
+    for(int i = 0; i < prog->nglobals; i++) {
+        c->node = prog->globals[i].def;
+        define(c, prog->globals[i].def);
+        c->ntemps = 0;
+    }
+    emit(c, OP_RETN, 0, 0, 0);
+}
+
+/*
+ * Compile every method, the entry block and the initializers of the name
+ * space variables.
+ */
+module_t* compile_program(program_t* prog) {
+
+    module_t* mod = ALLOC_DS(module_t);
+    mod->arena = create_arena(0);
+    mod->nfuncs = prog->nmethods + 1;
+    mod->funcs = ALLOC_LST(mod->nfuncs, func_t);
+    mod->entry = prog->entry;
+    mod->init = prog->nmethods;
+    mod->nglobals = prog->nglobals;
+    mod->global_types = ALLOC_LST(prog->nglobals + 1, uint8_t);
+    for(int i = 0; i < prog->nglobals; i++)
+        mod->global_types[i] = prog->globals[i].type;
+    mod->layouts = copy_layouts(prog->layouts, prog->nlayouts);
+    mod->nlayouts = prog->nlayouts;
+    mod->dispatch = ALLOC_LST(prog->ndispatch + 1, uint32_t);
+    if(prog->ndispatch > 0)
+        memcpy(mod->dispatch, prog->dispatch, prog->ndispatch * sizeof(uint32_t));
+    mod->ndispatch = prog->ndispatch;
+
+    comp_t c;
+    memset(&c, 0, sizeof(c));
+    c.mod = mod;
+    c.prog = prog;
+    c.ast = prog->ast;
+
+    // the literals that are boxed belong to the module
+    arena_t* boxes = set_box_arena(mod->arena);
+    for(int i = 0; i < prog->nmethods; i++)
+        compile_method(&c, i);
+    compile_init(&c);
+    set_box_arena(boxes);
+
+    if(c.kslots != NULL)
+        FREE(c.kslots);
+    return mod;
+}
+
+void destroy_module(module_t* mod) {
+
+    if(mod != NULL) {
+        if(mod->map != NULL)
+            munmap(mod->map, mod->map_len);
+        else {
+            for(int i = 0; i < mod->nfuncs; i++) {
+                if(mod->funcs[i].code != NULL)
+                    FREE(mod->funcs[i].code);
+                if(mod->funcs[i].locs != NULL)
+                    FREE(mod->funcs[i].locs);
+            }
+            FREE(mod->global_types);
+            FREE(mod->dispatch);
+        }
+        destroy_layouts(mod->layouts, mod->nlayouts);
+        for(int i = 0; i < mod->nformats; i++)
+            destroy_format_plan(mod->formats[i]);
+        if(mod->formats != NULL)
+            FREE(mod->formats);
+        FREE(mod->funcs);
+        if(mod->consts != NULL)
+            FREE(mod->consts);
+        destroy_arena(mod->arena);
+        FREE(mod);
+    }
+}
@@ -0,0 +1,200 @@
+/*
+ * Parse context for one translation unit. The thread that is parsing a file
+ * has that file's context as its current context, which is how code that is
+ * not handed the context, such as the error routines, finds it.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "memory.h"
+#include "errors.h"
+#include "context.h"
+#include "parser.h"
+#include "scanner.h"
+
+static _Thread_local parse_ctx_t* current = NULL;
+
+parse_ctx_t* get_context() {
+
+    return current;
+}
+
+void set_context(parse_ctx_t* ctx) {
+
+    current = ctx;
+}
+
+/*
+ * Create a context for the file. Nothing is opened until the file is parsed.
+ */
+parse_ctx_t* create_context(const char* fname) {
+
+    parse_ctx_t* ctx = ALLOC_DS(parse_ctx_t);
+    ctx->fname = fname;
+    ctx->line_no = 1;
+    ctx->col_no = 1;
+    ctx->arena = create_arena(0);
+    ctx->ast = create_ast();
+    ctx->types = create_type_set();
+    ctx->diags = create_diag_sink(get_diag_limit());
+
+    return ctx;
+}
+
+void destroy_context(parse_ctx_t* ctx) {
+
+    if(ctx != NULL) {
+        destroy_diag_sink(ctx->diags);
+        for(size_t i = 0; i < ctx->nitems; i++)
+            destroy_diag_sink(ctx->items[i].diags);
+        if(ctx->items != NULL)
+            FREE(ctx->items);
+        if(ctx->type_names != NULL)
+            FREE(ctx->type_names);
+        destroy_scope(ctx->symbols);
+        destroy_type_set(ctx->types);
+        destroy_ast(ctx->ast);
+        destroy_arena(ctx->arena);
+        FREE(ctx);
+    }
+}
+
+/*
+ * Write what the parse of the file found to the stream, in the format that
+ * was asked for.
+ */
+void flush_context_output(parse_ctx_t* ctx, FILE* fp) {
+
+    write_diags(ctx->diags, fp, get_diag_format());
+}
+
+/*
+ * Run the parser over whatever the scanner was set up to read. The context
+ * is the current context of the calling thread while this runs, and the
+ * file's symbols are the current symbols.
+ */
+static void run_parser(parse_ctx_t* ctx) {
+
+    parse_ctx_t* saved = current;
+    scope_t* saved_scope = set_scope(ctx->symbols);
+    current = ctx;
+
+    ctx->item_first = (ast_idx_t)ctx->ast->count;
+    ctx->item_errors = ctx->errors;
+    ctx->item_diags = ctx->diags->count;
+    ctx->item_recoveries = ctx->recoveries;
+    ctx->item_types = ctx->ntypes;
+    if(ctx->keep_items)
+        set_symbol_item(ctx->item_serial);
+    yyparse(ctx->scanner, ctx);
+
+    // a syntax error can leave scopes open
+    ctx->symbols = get_global_scope();
+    set_scope(saved_scope);
+    current = saved;
+}
+
+/*
+ * Scan and parse the file. Returns the number of errors, which counts a file
+ * that cannot be opened.
+ */
+int parse_context(parse_ctx_t* ctx) {
+
+    if(init_scanner(ctx))
+        run_parser(ctx);
+    destroy_scanner(ctx);
+
+    return ctx->errors;
+}
+
+/*
+ * Scan and parse text that is already in memory, such as the part of an
+ * edited file that changed. The text is scanned in place and must be
+ * followed by two NUL bytes. It starts at the line, column and offset that
+ * are in the context, so the locations are those of the whole file, and
+ * the nodes are added to the AST that is there. Returns the number of
+ * errors, or -1 if the text ends in the middle of a comment or a string.
+ */
+int parse_context_text(parse_ctx_t* ctx, char* text, size_t len) {
+
+    init_scanner_text(ctx, text, len);
+    run_parser(ctx);
+    int open = scanner_in_token(ctx);
+    destroy_scanner(ctx);
+
+    return open? -1: ctx->errors;
+}
+
+/*
+ * Record where a top level item is, if the context keeps them. The parser
+ * calls this when it reduces the item, so the item's nodes are the ones made
+ * since the item before it, and so are the diagnostics it keeps a copy of.
+ */
+void add_context_item(parse_ctx_t* ctx, ast_idx_t node, size_t offset, size_t length,
+                        int line, int col, int end_line, int end_col) {
+
+    if(!ctx->keep_items)
+        return;
+
+    if(ctx->nitems == ctx->items_cap) {
+        ctx->items_cap = (ctx->items_cap == 0)? 64: ctx->items_cap << 1;
+        ctx->items = REALLOC_LST(ctx->items, ctx->items_cap, item_span_t);
+    }
+
+    item_span_t* item = &ctx->items[ctx->nitems++];
+    item->node = node;
+    item->first = ctx->item_first;
+    item->end = (ast_idx_t)ctx->ast->count;
+    item->offset = offset;
+    item->length = length;
+    item->line = line;
+    item->col = col;
+    item->end_line = end_line;
+    item->end_col = end_col;
+    item->errors = ctx->errors - ctx->item_errors;
+    item->recovered = ctx->recoveries != ctx->item_recoveries;
+    item->ntypes = ctx->ntypes - ctx->item_types;
+    item->serial = ctx->item_serial++;
+    item->moved = 0;
+    item->diags = NULL;
+    if(ctx->diags->count > ctx->item_diags) {
+        item->diags = create_diag_sink(0);
+        copy_diags(item->diags, ctx->diags, ctx->item_diags, 0);
+    }
+    set_symbol_item(ctx->item_serial);
+
+    ctx->item_first = item->end;
+    ctx->item_errors = ctx->errors;
+    ctx->item_diags = ctx->diags->count;
+    ctx->item_recoveries = ctx->recoveries;
+    ctx->item_types = ctx->ntypes;
+}
+
+/*
+ * Add a struct name to the type names. When the context keeps its items the
+ * name is kept in order too, since error recovery can throw away the struct
+ * after its name was added, and the name still counts.
+ */
+void add_context_type(parse_ctx_t* ctx, const char* name) {
+
+    add_type_name(ctx->types, name);
+    if(!ctx->keep_items)
+        return;
+
+    if(ctx->ntypes == ctx->types_cap) {
+        ctx->types_cap = (ctx->types_cap == 0)? 16: ctx->types_cap << 1;
+        ctx->type_names = REALLOC_LST(ctx->type_names, ctx->types_cap, const char*);
+    }
+    ctx->type_names[ctx->ntypes++] = name;
+}
+
+int get_line_no() {
+
+    return (current != NULL)? current->line_no: 0;
+}
+
+int get_col_no() {
+
+    return (current != NULL)? current->col_no: 0;
+}
@@ -0,0 +1,126 @@
+#ifndef __CONTEXT_H__
+#define __CONTEXT_H__
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include "memory.h"
+#include "ast.h"
+#include "symbols.h"
+#include "typenames.h"
+#include "errors.h"
+
+/*
+ * Everything that belongs to the parse of one translation unit. The scanner
+ * and the parser are reentrant and get all of their state from here, so any
+ * number of files can be parsed at the same time on different threads.
+ */
+typedef struct {
+    size_t cap;
+    size_t len;
+    char* buf;
+} str_buffer_t;
+
+/*
+ * Where a top level item of the file is, kept when the context is asked for
+ * it. The item's nodes are the ones from first up to end, not including end.
+ */
+typedef struct {
+    ast_idx_t node;
+    ast_idx_t first;
+    ast_idx_t end;
+    size_t offset;          // of the first character
+    size_t length;
+    int line;
+    int col;
+    int end_line;           // the position just after the last character
+    int end_col;
+    int errors;             // found while parsing the item
+    int recovered;          // the parser recovered from a syntax error in it
+    size_t ntypes;          // struct names that it declared
+    int serial;             // what its symbols are tagged with
+    int moved;              // lines it moved since its nodes were made
+    diag_sink_t* diags;     // what was reported in it, or NULL
+} item_span_t;
+
+/*
+ * What the parser's error recovery keeps between tokens. See recover() in
+ * parser.y.
+ */
+typedef struct {
+    int depth;              // braces that are open, with the lookahead's
+    int last;               // the token the parser was given last
+    int last_line;          // the line it ends on
+    int prev_line;          // and the one the token before it ends on
+    int closes;             // '}' to give the parser before the held token
+    int token;              // read and held back while they are given, or 0
+    int line;               // where the held token is
+    int col;
+    int end_line;
+    int end_col;
+    size_t offset;
+    size_t length;
+} recovery_t;
+
+typedef struct _parse_ctx_t_ {
+    const char* fname;
+    void* scanner;          // yyscan_t, owned by scanner.l
+
+    // scanner state
+    int line_no;
+    int col_no;
+    size_t offset;          // byte offset of the current token
+    size_t str_offset;      // where the current string literal started
+    str_buffer_t sbuf;      // string literal being scanned
+
+    // input, either mapped or read with stdio
+    FILE* fp;
+    char* map_base;
+    size_t map_len;
+    size_t src_len;
+    void* map_buffer;       // YY_BUFFER_STATE
+
+    // results
+    arena_t* arena;         // string literals and other per file data
+    ast_t* ast;
+    scope_t* symbols;       // global scope of this file
+    type_set_t* types;      // struct names, which scan as TYPEDEF_NAME
+    int errors;
+    int recoveries;         // times the parser recovered from a syntax error
+    int stopped;            // the parse ended at the error limit
+    int unreadable;         // the file could not be opened
+    recovery_t recovery;
+
+    // the top level items, recorded when keep_items is set
+    int keep_items;
+    item_span_t* items;
+    size_t nitems;
+    size_t items_cap;
+    ast_idx_t item_first;   // where the nodes of the next item start
+    int item_errors;        // errors before the next item
+    size_t item_diags;      // and records in the sink
+    int item_recoveries;    // and recoveries
+    int item_serial;        // of the next item
+    const char** type_names; // in the order they were declared
+    size_t ntypes;
+    size_t types_cap;
+    size_t item_types;      // type names before the next item
+
+    // what the parse found, written out by flush_context_output()
+    diag_sink_t* diags;
+} parse_ctx_t;
+
+parse_ctx_t* create_context(const char* fname);
+void destroy_context(parse_ctx_t* ctx);
+int parse_context(parse_ctx_t* ctx);
+int parse_context_text(parse_ctx_t* ctx, char* text, size_t len);
+void add_context_type(parse_ctx_t* ctx, const char* name);
+void add_context_item(parse_ctx_t* ctx, ast_idx_t node, size_t offset, size_t length,
+                        int line, int col, int end_line, int end_col);
+
+void flush_context_output(parse_ctx_t* ctx, FILE* fp);
+
+parse_ctx_t* get_context();
+void set_context(parse_ctx_t* ctx);
+
+#endif
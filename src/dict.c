@@ -0,0 +1,210 @@
+/*
+ * The hash map behind dicts. See dict.h for the layout.
+ *
+ * A control byte is CTRL_EMPTY or the top seven bits of the hash of the key
+ * in the slot, and the slots are probed a group at a time. With SSE2 a
+ * group is 16 bytes, compared in one instruction. Elsewhere it is 8 bytes
+ * compared as one 64 bit word, which can report a slot that does not match
+ * after one that does; the key comparison sorts that out. The groups are
+ * probed in triangular order, which visits every group of a power of two.
+ *
+ * The table grows to keep it at most 7/8 full, so every probe ends at a
+ * group with an empty slot.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "memory.h"
+#include "dict.h"
+
+#define CTRL_EMPTY  0x80
+#define MIN_ENTRIES 8
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+
+#define GROUP       16
+typedef uint32_t match_t;
+
+static inline match_t match_byte(const uint8_t* ctrl, uint8_t byte) {
+
+    __m128i group = _mm_loadu_si128((const __m128i*)ctrl);
+    return (match_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)byte)));
+}
+
+static inline match_t match_empty(const uint8_t* ctrl) {
+
+    return match_byte(ctrl, CTRL_EMPTY);
+}
+
+static inline int match_slot(match_t m) {
+
+    return __builtin_ctz(m);
+}
+
+#else
+
+#define GROUP       8
+#define LOW_BITS    UINT64_C(0x0101010101010101)
+#define HIGH_BITS   UINT64_C(0x8080808080808080)
+typedef uint64_t match_t;
+
+// the group as a word with the first control byte lowest
+static inline uint64_t load_group(const uint8_t* ctrl) {
+
+    uint64_t word = 0;
+    for(int i = GROUP - 1; i >= 0; i--)
+        word = (word << 8) | ctrl[i];
+    return word;
+}
+
+static inline match_t match_byte(const uint8_t* ctrl, uint8_t byte) {
+
+    uint64_t word = load_group(ctrl) ^ (LOW_BITS * byte);
+    return (word - LOW_BITS) & ~word & HIGH_BITS;
+}
+
+static inline match_t match_empty(const uint8_t* ctrl) {
+
+    // only an empty slot has the high bit set
+    return load_group(ctrl) & HIGH_BITS;
+}
+
+static inline int match_slot(match_t m) {
+
+    int slot = 0;
+    while(!(m & 0x80)) {
+        m >>= 8;
+        slot++;
+    }
+    return slot;
+}
+
+#endif
+
+static inline uint64_t key_hash(value_t key) {
+
+    uint64_t hash = IS_STRING(key)? AS_STR(key)->hash: (uint64_t)AS_INT(key);
+    return hash * UINT64_C(0x9E3779B97F4A7C15);
+}
+
+#define HASH_CTRL(h)    ((uint8_t)((h) >> 57))
+#define HASH_GROUP(h)   ((size_t)((h) ^ ((h) >> 32)))
+
+static inline int same_key(value_t a, value_t b) {
+
+    // ints too large for the word are boxed, so their words can differ
+    return a.bits == b.bits ||
+            (VAL_TAG(a) == TAG_INT_BOX && VAL_TAG(b) == TAG_INT_BOX && AS_INT(a) == AS_INT(b));
+}
+
+/*
+ * Return the slot that holds the key, or if it is not there, the first
+ * empty slot on its probe sequence with *found cleared.
+ */
+static size_t probe(dict_t* dict, value_t key, uint64_t hash, int* found) {
+
+    size_t mask = dict->nslots / GROUP - 1;
+    size_t group = HASH_GROUP(hash) & mask;
+    uint8_t h = HASH_CTRL(hash);
+
+    for(size_t step = 1;; step++) {
+        const uint8_t* ctrl = dict->ctrl + group * GROUP;
+        for(match_t m = match_byte(ctrl, h); m != 0; m &= m - 1) {
+            size_t slot = group * GROUP + match_slot(m);
+            if(same_key(dict->entries[dict->slots[slot]].key, key)) {
+                *found = 1;
+                return slot;
+            }
+        }
+        match_t empty = match_empty(ctrl);
+        if(empty != 0) {
+            *found = 0;
+            return group * GROUP + match_slot(empty);
+        }
+        group = (group + step) & mask;
+    }
+}
+
+// make the slots again for twice as many, from the entries in order
+static void grow_slots(dict_t* dict) {
+
+    int found;
+
+    dict->nslots <<= 1;
+    FREE(dict->ctrl);
+    FREE(dict->slots);
+    dict->ctrl = ALLOC(dict->nslots);
+    dict->slots = ALLOC_LST(dict->nslots, uint32_t);
+    memset(dict->ctrl, CTRL_EMPTY, dict->nslots);
+
+    for(size_t i = 0; i < dict->len; i++) {
+        uint64_t hash = key_hash(dict->entries[i].key);
+        size_t slot = probe(dict, dict->entries[i].key, hash, &found);
+        dict->ctrl[slot] = HASH_CTRL(hash);
+        dict->slots[slot] = (uint32_t)i;
+    }
+}
+
+dict_t* create_dict(int elem) {
+
+    dict_t* dict = ALLOC_DS(dict_t);
+    dict->elem = elem;
+    dict->len = 0;
+    dict->cap = MIN_ENTRIES;
+    dict->nslots = GROUP;
+    dict->entries = ALLOC_LST(dict->cap, dict_entry_t);
+    dict->ctrl = ALLOC(dict->nslots);
+    dict->slots = ALLOC_LST(dict->nslots, uint32_t);
+    dict->next = NULL;
+    memset(dict->ctrl, CTRL_EMPTY, dict->nslots);
+    return dict;
+}
+
+void destroy_dict(dict_t* dict) {
+
+    FREE(dict->entries);
+    FREE(dict->ctrl);
+    FREE(dict->slots);
+    FREE(dict);
+}
+
+/*
+ * Return where the value of the key is kept, or NULL if the key is not in
+ * the dict.
+ */
+value_t* dict_find(dict_t* dict, value_t key) {
+
+    int found;
+    size_t slot = probe(dict, key, key_hash(key), &found);
+    return found? &dict->entries[dict->slots[slot]].val: NULL;
+}
+
+/*
+ * Set the value of the key. A new key goes after the ones already there.
+ */
+void dict_insert(dict_t* dict, value_t key, value_t val) {
+
+    uint64_t hash = key_hash(key);
+    int found;
+    size_t slot = probe(dict, key, hash, &found);
+
+    if(found) {
+        dict->entries[dict->slots[slot]].val = val;
+        return;
+    }
+
+    if((dict->len + 1) * 8 > dict->nslots * 7) {
+        grow_slots(dict);
+        slot = probe(dict, key, hash, &found);
+    }
+    if(dict->len == dict->cap) {
+        dict->cap <<= 1;
+        dict->entries = REALLOC_LST(dict->entries, dict->cap, dict_entry_t);
+    }
+
+    dict->entries[dict->len].key = key;
+    dict->entries[dict->len].val = val;
+    dict->ctrl[slot] = HASH_CTRL(hash);
+    dict->slots[slot] = (uint32_t)dict->len++;
+}
@@ -0,0 +1,46 @@
+#ifndef __DICT_H__
+#define __DICT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "value.h"
+
+/*
+ * A hash map from ints and strings to values, laid out the way the Swiss
+ * tables are. Every slot has a control byte that is either empty or seven
+ * bits of the hash of the key in it, and a lookup compares the bytes of a
+ * whole group of slots with the hash at once, so most lookups touch one
+ * group of control bytes and then the one entry that matched.
+ *
+ * The slots only hold the index of an entry. The entries are kept in the
+ * order they were inserted, so the dict lists its keys in that order and
+ * growing only rebuilds the slots. Nothing is ever removed.
+ *
+ * Keys must be ints or interned strings, so that two keys are the same if
+ * their words are, and a string key hashes with the hash it was interned
+ * with. The runtime interns the keys it is given.
+ */
+typedef struct {
+    value_t key;
+    value_t val;
+} dict_entry_t;
+
+struct _dict_t_ {
+    uint8_t* ctrl;          // a control byte for every slot
+    uint32_t* slots;        // the entry in every full slot
+    dict_entry_t* entries;  // in the order they were inserted
+    size_t len;
+    size_t cap;             // room in entries
+    size_t nslots;          // a power of two and a whole number of groups
+    uint8_t elem;           // the value type of the values
+    struct _dict_t_* next;  // the runtime's list of dicts
+};
+
+dict_t* create_dict(int elem);
+void destroy_dict(dict_t* dict);
+
+value_t* dict_find(dict_t* dict, value_t key);
+void dict_insert(dict_t* dict, value_t key, value_t val);
+
+#endif
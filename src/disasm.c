@@ -0,0 +1,125 @@
+/*
+ * Print compiled bytecode in a form that can be read.
+ */
+#include <stdio.h>
+
+#include "bytecode.h"
+#include "runtime.h"
+
+static const char* op_names[] = {
+#define OP(n, f) #n,
+    OPCODES
+#undef OP
+};
+
+static const uint8_t op_formats[] = {
+#define OP(n, f) f,
+    OPCODES
+#undef OP
+};
+
+const char* opcode_name(int op) {
+
+    return (op >= 0 && op < OP_NUM_CODES)? op_names[op]: "???";
+}
+
+static void print_const(module_t* mod, int k, FILE* fp) {
+
+    char buf[64];
+
+    if(k >= mod->nconsts) {
+        fprintf(fp, "K%d", k);
+        return;
+    }
+    value_t val = mod->consts[k];
+    if(IS_STRING(val))
+        fprintf(fp, "\"%s\"", AS_STRING(val));
+    else
+        fprintf(fp, "%s:%s", VAL_TOSTR(VAL_TYPE(val)), format_value(val, buf, sizeof(buf)));
+}
+
+static const char* field_kind_name(int kind) {
+
+    return (kind == 0)? "word": VAL_TOSTR(kind);
+}
+
+static void dump_instr(module_t* mod, func_t* fn, int pc, FILE* fp) {
+
+    instr_t* ins = &fn->code[pc];
+
+    fprintf(fp, "  %5d  %4u:%-3u  %-8s", pc, fn->locs[pc].line, fn->locs[pc].col,
+                opcode_name(ins->op));
+    switch(op_formats[ins->op]) {
+        case F_A: fprintf(fp, "R%u", ins->a); break;
+        case F_AB: fprintf(fp, "R%u, R%u", ins->a, ins->b); break;
+        case F_ABC: fprintf(fp, "R%u, R%u, R%u", ins->a, ins->b, ins->c); break;
+        case F_ABK:
+            fprintf(fp, "R%u, R%u, ", ins->a, ins->b);
+            print_const(mod, ins->c, fp);
+            break;
+        case F_AK:
+            fprintf(fp, "R%u, ", ins->a);
+            print_const(mod, OPERAND_K(ins), fp);
+            break;
+        case F_AG: fprintf(fp, "R%u, G%u", ins->a, ins->b); break;
+        case F_AT:
+            fprintf(fp, "R%u, R%u, %s", ins->a, ins->b, IS_STRUCT_TYPE(ins->c)?
+                        mod->layouts[ins->c - STRUCT_TYPE(0)].name: VAL_TOSTR(ins->c));
+            break;
+        case F_J: fprintf(fp, "-> %u", ins->c); break;
+        case F_AJ: fprintf(fp, "R%u -> %u", ins->a, ins->c); break;
+        case F_ABJ: fprintf(fp, "R%u, R%u -> %u", ins->a, ins->b, ins->c); break;
+        case F_AKJ:
+            fprintf(fp, "R%u, ", ins->a);
+            print_const(mod, ins->b, fp);
+            fprintf(fp, " -> %u", ins->c);
+            break;
+        case F_CALL:
+            if(ins->op == OP_CALL)
+                fprintf(fp, "R%u, %s, %u", ins->a, mod->funcs[ins->b].name, ins->c);
+            else if(ins->op == OP_CALLD) {
+                const uint32_t* set = mod->dispatch + ins->b;
+                fprintf(fp, "R%u, ", ins->a);
+                for(uint32_t i = 0; i < SET_CANDIDATES(set); i++)
+                    fprintf(fp, "%s%s", (i > 0)? " | ": "", mod->funcs[SET_METHOD(set, i)].name);
+                fprintf(fp, ", %u", ins->c);
+            }
+            else
+                fprintf(fp, "R%u, builtin %u, %u", ins->a, ins->b, ins->c);
+            break;
+        case F_FMT:
+            fprintf(fp, "R%u, \"%s\" in %d parts, %u", ins->a, mod->formats[ins->b]->text,
+                        mod->formats[ins->b]->nsegs, ins->c);
+            break;
+        case F_LIST: fprintf(fp, "R%u, %s, %u", ins->a, VAL_TOSTR(ins->b), ins->c); break;
+        case F_AS: fprintf(fp, "R%u, %s", ins->a, mod->layouts[ins->b].name); break;
+        case F_ABF:
+            fprintf(fp, "R%u, R%u, +%u %s", ins->a, ins->b, FIELD_OFFSET(ins->c),
+                        field_kind_name(FIELD_STORED(ins->c)));
+            break;
+        case F_AFC:
+            fprintf(fp, "R%u, +%u %s, R%u", ins->a, FIELD_OFFSET(ins->b),
+                        field_kind_name(FIELD_STORED(ins->b)), ins->c);
+            break;
+        case F_ERR: print_const(mod, ins->b, fp); break;
+        default: break;
+    }
+    fputc('\n', fp);
+}
+
+void dump_module(module_t* mod, FILE* fp) {
+
+    int total = 0;
+
+    for(int i = 0; i < mod->nfuncs; i++) {
+        func_t* fn = &mod->funcs[i];
+        fprintf(fp, "%s%s: params %d, registers %d, instructions %d\n",
+                    fn->name, (i == mod->entry)? " (entry)": "",
+                    fn->nparams, fn->nregs, fn->ncode);
+        for(int pc = 0; pc < fn->ncode; pc++)
+            dump_instr(mod, fn, pc, fp);
+        fputc('\n', fp);
+        total += fn->ncode;
+    }
+    fprintf(fp, "%d functions, %d instructions, %d constants\n", mod->nfuncs, total, mod->nconsts);
+}
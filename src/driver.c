@@ -0,0 +1,66 @@
+/*
+ * Parse several translation units at the same time. Each file has its own
+ * context, scanner, parser stack and AST, so the only shared state is the
+ * intern pool. Every identifier goes through it, so finding a name that is
+ * there takes no lock, and adding one locks only one shard of the pool.
+ *
+ * The worker threads take the next file from a shared counter, so a long
+ * file does not hold up the short ones behind it. The diagnostics of each
+ * file are kept with it, and the caller prints them in the order that the
+ * files were given.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "memory.h"
+#include "errors.h"
+#include "context.h"
+#include "driver.h"
+
+typedef struct {
+    parse_ctx_t** ctxs;
+    int count;
+    atomic_int next;
+} work_t;
+
+static void* worker(void* arg) {
+
+    work_t* work = (work_t*)arg;
+    int idx;
+
+    while((idx = atomic_fetch_add(&work->next, 1)) < work->count)
+        parse_context(work->ctxs[idx]);
+
+    return NULL;
+}
+
+int parse_all(parse_ctx_t** ctxs, int count, int jobs) {
+
+    work_t work;
+    work.ctxs = ctxs;
+    work.count = count;
+    atomic_init(&work.next, 0);
+
+    if(jobs > count)
+        jobs = count;
+
+    if(jobs <= 1)
+        worker(&work);
+    else {
+        pthread_t* threads = ALLOC_LST(jobs, pthread_t);
+        for(int i = 0; i < jobs; i++)
+            if(pthread_create(&threads[i], NULL, worker, &work) != 0)
+                fatal_error("cannot create thread %d", i);
+        for(int i = 0; i < jobs; i++)
+            pthread_join(threads[i], NULL);
+        FREE(threads);
+    }
+
+    int errors = 0;
+    for(int i = 0; i < count; i++)
+        errors += ctxs[i]->errors;
+
+    return errors;
+}
@@ -0,0 +1,12 @@
+#ifndef __DRIVER_H__
+#define __DRIVER_H__
+
+#include "context.h"
+
+/*
+ * Parse every context, using up to jobs threads. Returns the total number
+ * of errors.
+ */
+int parse_all(parse_ctx_t** ctxs, int count, int jobs);
+
+#endif
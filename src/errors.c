@@ -1,55 +1,415 @@
+/*
+ * Diagnostics. See errors.h.
+ *
+ * The records of a sink are in an array, with their messages in an arena,
+ * and a table of their hashes finds the one that a new record repeats. A
+ * sink has a lock, since the sink of the process can be used by any thread,
+ * but a file's sink is only used by the thread that parses it, so the lock
+ * is never waited for while files are parsed in parallel.
+ *
+ * A fatal error ends the process, so it writes what the sinks of the thread
+ * have before it writes itself. It does not allocate, since it is what the
+ * allocator calls when it fails.
+ */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdarg.h>
+#include <pthread.h>
 
-static int errors = 0;
+#include "memory.h"
+#include "intern.h"
+#include "json.h"
+#include "context.h"
 
-int get_errors() {
-    return errors;
+#define INITIAL_SLOTS   (0x01 << 6)
+
+// the longest message; a longer one is cut short
+#define MAX_MESSAGE     1024
+
+static diag_format_t format = DIAG_TEXT;
+static size_t limit = DEFAULT_DIAG_LIMIT;
+
+// for anything that is not found while a file is parsed
+static diag_sink_t process_sink = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .limit = DEFAULT_DIAG_LIMIT,
+};
+
+static const char* severity_names[] = { "note", "warning", "error", "fatal" };
+
+// after the place, as a compiler prints them; an error from the parser is
+// a syntax error
+static const char* severity_prefix[] = { "msg: ", "warning: ", "error: ", "fatal error: " };
+
+diag_sink_t* create_diag_sink(size_t limit) {
+
+    diag_sink_t* sink = ALLOC_DS(diag_sink_t);
+    memset(sink, 0, sizeof(diag_sink_t));
+    pthread_mutex_init(&sink->lock, NULL);
+    sink->limit = limit;
+    return sink;
 }
 
-void reset_errors() {
-    errors = 0;
+static void free_records(diag_sink_t* sink) {
+
+    if(sink->arena != NULL)
+        destroy_arena(sink->arena);
+    if(sink->list != NULL)
+        FREE(sink->list);
+    if(sink->slots != NULL)
+        FREE(sink->slots);
+    sink->arena = NULL;
+    sink->list = NULL;
+    sink->slots = NULL;
+    sink->count = sink->cap = sink->nslots = sink->notes = 0;
+    sink->errors = sink->dropped = 0;
+}
+
+void destroy_diag_sink(diag_sink_t* sink) {
+
+    if(sink != NULL) {
+        free_records(sink);
+        pthread_mutex_destroy(&sink->lock);
+        FREE(sink);
+    }
+}
+
+void clear_diags(diag_sink_t* sink) {
+
+    pthread_mutex_lock(&sink->lock);
+    if(sink->arena != NULL)
+        reset_arena(sink->arena);
+    if(sink->slots != NULL)
+        memset(sink->slots, 0, sink->nslots * sizeof(size_t));
+    sink->count = sink->notes = 0;
+    sink->errors = sink->dropped = 0;
+    pthread_mutex_unlock(&sink->lock);
+}
+
+static int same_diag(diagnostic_t* rec, severity_t sev, const char* file, int line,
+                        int col, const char* code, const char* message, unsigned int hash) {
+
+    return rec->hash == hash && rec->severity == sev && rec->line == line &&
+                rec->col == col && rec->file == file && rec->code == code &&
+                strcmp(rec->message, message) == 0;
+}
+
+static size_t* find_slot(diag_sink_t* sink, unsigned int hash, severity_t sev,
+                        const char* file, int line, int col, const char* code,
+                        const char* message) {
+
+    size_t mask = sink->nslots - 1;
+    size_t idx = hash & mask;
+
+    while(sink->slots[idx] != 0 && !same_diag(&sink->list[sink->slots[idx] - 1],
+                sev, file, line, col, code, message, hash))
+        idx = (idx + 1) & mask;
+
+    return &sink->slots[idx];
+}
+
+static void grow_slots(diag_sink_t* sink) {
+
+    sink->nslots = (sink->nslots == 0)? INITIAL_SLOTS: sink->nslots << 1;
+    if(sink->slots != NULL)
+        FREE(sink->slots);
+    sink->slots = ALLOC_LST(sink->nslots, size_t);
+    memset(sink->slots, 0, sink->nslots * sizeof(size_t));
+
+    for(size_t i = 0; i < sink->count; i++) {
+        diagnostic_t* rec = &sink->list[i];
+        *find_slot(sink, rec->hash, rec->severity, rec->file, rec->line, rec->col,
+                    rec->code, rec->message) = i + 1;
+    }
+}
+
+/*
+ * Add a record with a message that is already formatted. The caller holds
+ * the lock. The file and the code are compared by pointer, so they are
+ * interned or constant.
+ */
+static void add_record(diag_sink_t* sink, severity_t sev, const char* file, int line,
+                        int col, const char* code, const char* message, int repeats) {
+
+    if(sev >= SEV_ERROR)
+        sink->errors += repeats + 1;
+
+    if((sink->count + 1) * 4 > sink->nslots * 3)
+        grow_slots(sink);
+
+    unsigned int hash = hash_str(message, strlen(message)) ^ (unsigned int)(line * 31 + col);
+    size_t* slot = find_slot(sink, hash, sev, file, line, col, code, message);
+    if(*slot != 0) {
+        sink->list[*slot - 1].repeats += repeats + 1;
+        return;
+    }
+    // notes have a limit of their own, so the one that says where a parse
+    // stopped at the limit is still kept
+    size_t kept = (sev == SEV_NOTE)? sink->notes: sink->count - sink->notes;
+    if(sink->limit != 0 && kept >= sink->limit) {
+        sink->dropped += repeats + 1;
+        return;
+    }
+    if(sev == SEV_NOTE)
+        sink->notes++;
+
+    if(sink->count == sink->cap) {
+        sink->cap = (sink->cap == 0)? 16: sink->cap << 1;
+        sink->list = REALLOC_LST(sink->list, sink->cap, diagnostic_t);
+    }
+    if(sink->arena == NULL)
+        sink->arena = create_arena(0);
+
+    diagnostic_t* rec = &sink->list[sink->count++];
+    rec->severity = sev;
+    rec->file = file;
+    rec->line = line;
+    rec->col = col;
+    rec->code = code;
+    rec->message = ARENA_DUPSTR(sink->arena, message);
+    rec->hash = hash;
+    rec->repeats = repeats;
+    *slot = sink->count;
+}
+
+void add_diag_va(diag_sink_t* sink, severity_t sev, const char* file, int line, int col,
+                        const char* code, const char* fmt, va_list args) {
+
+    char message[MAX_MESSAGE];
+    vsnprintf(message, sizeof(message), fmt, args);
+
+    pthread_mutex_lock(&sink->lock);
+    add_record(sink, sev, file, line, col, code, message, 0);
+    pthread_mutex_unlock(&sink->lock);
+}
+
+void add_diag(diag_sink_t* sink, severity_t sev, const char* file, int line, int col,
+                        const char* code, const char* fmt, ...) {
+
+    va_list args;
+
+    va_start(args, fmt);
+    add_diag_va(sink, sev, file, line, col, code, fmt, args);
+    va_end(args);
+}
+
+/*
+ * Add the records of a sink from the first on to another, with their lines
+ * moved down by lines. This is how an edited file keeps the records of each
+ * of its items, and puts them back where the item is after the edit.
+ */
+void copy_diags(diag_sink_t* dest, diag_sink_t* src, size_t first, int lines) {
+
+    pthread_mutex_lock(&src->lock);
+    pthread_mutex_lock(&dest->lock);
+    for(size_t i = first; i < src->count; i++) {
+        diagnostic_t* rec = &src->list[i];
+        add_record(dest, rec->severity, rec->file, (rec->line > 0)? rec->line + lines: 0,
+                    rec->col, rec->code, rec->message, rec->repeats);
+    }
+    pthread_mutex_unlock(&dest->lock);
+    pthread_mutex_unlock(&src->lock);
+}
+
+static void write_record(FILE* fp, diag_format_t fmt, diagnostic_t* rec) {
+
+    if(fmt == DIAG_TEXT) {
+        if(rec->file != NULL)
+            fputs(rec->file, fp);
+        if(rec->line > 0)
+            fprintf(fp, (rec->file != NULL)? ":%d:%d": "%d:%d", rec->line, rec->col);
+        if(rec->file != NULL || rec->line > 0)
+            fputs(": ", fp);
+        if(rec->severity == SEV_ERROR && strcmp(rec->code, "syntax") == 0)
+            fputs("syntax error: ", fp);
+        else
+            fputs(severity_prefix[rec->severity], fp);
+        fputs(rec->message, fp);
+        if(rec->repeats > 0)
+            fprintf(fp, " (%d more times)", rec->repeats);
+        fputc('\n', fp);
+        return;
+    }
+
+    fprintf(fp, "{\"severity\":\"%s\",\"file\":", severity_names[rec->severity]);
+    if(rec->file != NULL)
+        write_json_str(fp, rec->file, strlen(rec->file));
+    else
+        fputs("null", fp);
+    fprintf(fp, ",\"line\":%d,\"col\":%d,\"code\":", rec->line, rec->col);
+    write_json_str(fp, rec->code, strlen(rec->code));
+    fputs(",\"message\":", fp);
+    write_json_str(fp, rec->message, strlen(rec->message));
+    fprintf(fp, ",\"repeats\":%d}\n", rec->repeats);
+}
+
+static void write_records(diag_sink_t* sink, FILE* fp, diag_format_t fmt) {
+
+    for(size_t i = 0; i < sink->count; i++)
+        write_record(fp, fmt, &sink->list[i]);
+
+    if(sink->dropped > 0) {
+        char message[64];
+        snprintf(message, sizeof(message), "%zu more diagnostics not shown", sink->dropped);
+        diagnostic_t rec = { SEV_NOTE, NULL, 0, 0, "limit", message, 0, 0 };
+        write_record(fp, fmt, &rec);
+    }
 }
 
-void error(const char* fmt, ...) {
+/*
+ * Write the records of the sink in the order they were found, in one write
+ * if there is the memory to put them together.
+ */
+void write_diags(diag_sink_t* sink, FILE* fp, diag_format_t fmt) {
+
+    pthread_mutex_lock(&sink->lock);
+    if(sink->count > 0 || sink->dropped > 0) {
+        char* buf;
+        size_t len;
+        FILE* mem = open_memstream(&buf, &len);
+        if(mem != NULL) {
+            write_records(sink, mem, fmt);
+            fclose(mem);
+            fwrite(buf, 1, len, fp);
+            free(buf); // allocated by open_memstream()
+        }
+        else
+            write_records(sink, fp, fmt);
+    }
+    pthread_mutex_unlock(&sink->lock);
+}
 
-    printf("syntax error: ");
-    va_list(args);
+void set_diag_format(diag_format_t fmt) {
+
+    format = fmt;
+}
+
+diag_format_t get_diag_format() {
+
+    return format;
+}
+
+/*
+ * The limit of the sinks that are made after this, zero for no limit.
+ */
+void set_diag_limit(size_t max) {
+
+    limit = max;
+    process_sink.limit = max;
+}
+
+size_t get_diag_limit() {
+
+    return limit;
+}
+
+/*
+ * Write what was found outside of a parse, and forget it.
+ */
+void flush_errors(FILE* fp) {
+
+    write_diags(&process_sink, fp, format);
+    clear_diags(&process_sink);
+}
+
+/*
+ * The sink of the file that is being parsed on this thread, or the one of
+ * the process, and the name of the file.
+ */
+static diag_sink_t* current_sink(const char** file) {
+
+    parse_ctx_t* ctx = get_context();
+    *file = (ctx != NULL)? ctx->fname: NULL;
+    return (ctx != NULL)? ctx->diags: &process_sink;
+}
+
+void error_at(const char* code, int line, int col, const char* fmt, ...) {
+
+    const char* file;
+    diag_sink_t* sink = current_sink(&file);
+    va_list args;
+
+    va_start(args, fmt);
+    add_diag_va(sink, SEV_ERROR, file, line, col, code, fmt, args);
+    va_end(args);
+
+    parse_ctx_t* ctx = get_context();
+    if(ctx != NULL)
+        ctx->errors++;
+}
+
+void warning_at(const char* code, int line, int col, const char* fmt, ...) {
+
+    const char* file;
+    diag_sink_t* sink = current_sink(&file);
+    va_list args;
 
     va_start(args, fmt);
-    vprintf(fmt, args);
+    add_diag_va(sink, SEV_WARNING, file, line, col, code, fmt, args);
     va_end(args);
+}
+
+/*
+ * Write a sink directly to the stream. If the lock is held, it is held by
+ * the caller of the allocator that failed, or by another thread, and the
+ * records cannot be trusted, so they are left.
+ */
+static void write_fatal(diag_sink_t* sink, FILE* fp) {
 
-    printf("\n");
-    errors++;
+    if(pthread_mutex_trylock(&sink->lock) == 0) {
+        write_records(sink, fp, format);
+        pthread_mutex_unlock(&sink->lock);
+    }
 }
 
 void fatal_error(const char* fmt, ...) {
 
-    printf("fatal error: ");
-    va_list(args);
+    char message[MAX_MESSAGE];
+    va_list args;
 
     va_start(args, fmt);
-    vprintf(fmt, args);
+    vsnprintf(message, sizeof(message), fmt, args);
     va_end(args);
 
-    printf("\n");
-    errors++;
+    // a fatal error ends the process, so do not leave anything in a buffer
+    parse_ctx_t* ctx = get_context();
+    fflush(stdout);
+    if(ctx != NULL)
+        write_fatal(ctx->diags, stdout);
+    write_fatal(&process_sink, stdout);
+
+    diagnostic_t rec = { SEV_FATAL, (ctx != NULL)? ctx->fname: NULL, 0, 0, "fatal", message, 0, 0 };
+    write_record(stdout, format, &rec);
+    fflush(stdout);
     exit(1);
 }
 
+int get_errors() {
+
+    parse_ctx_t* ctx = get_context();
+    return (ctx != NULL)? ctx->errors: (int)process_sink.errors;
+}
+
+void reset_errors() {
+
+    parse_ctx_t* ctx = get_context();
+    if(ctx != NULL)
+        ctx->errors = 0;
+    else
+        clear_diags(&process_sink);
+}
+
 extern int verbosity; // defined in nop.c
 void msg(int level, const char* fmt, ...) {
 
     if(verbosity >= level) {
-        printf("msg: ");
-        va_list(args);
+        const char* file;
+        diag_sink_t* sink = current_sink(&file);
+        va_list args;
 
         va_start(args, fmt);
-        vprintf(fmt, args);
+        add_diag_va(sink, SEV_NOTE, file, 0, 0, "msg", fmt, args);
         va_end(args);
-
-        printf("\n");
     }
 }
@@ -1,7 +1,87 @@
 #ifndef __ERROR_H__
 #define __ERROR_H__
 
-void error(const char* fmt, ...);
+#include <stdio.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <pthread.h>
+
+#include "memory.h"
+
+/*
+ * Diagnostics are kept as records in a sink instead of being printed when
+ * they are found. Each file that is parsed has its own sink, and there is
+ * one for the process for anything found outside of a parse. A sink is
+ * written out in one piece, as text or as one JSON object per line.
+ *
+ * A record that is the same as one the sink has already, the same kind at
+ * the same place with the same message, is counted as a repeat of it and
+ * not kept again. After the limit, the records are counted and dropped.
+ * Notes are counted apart from the rest, so the note that says where a
+ * parse stopped because of the limit is still kept, and they have a limit
+ * of the same size.
+ *
+ * As text a record is the file, the line and the column, and then the
+ * kind, "syntax error" for an error from the parser, and the message.
+ */
+typedef enum {
+    SEV_NOTE,
+    SEV_WARNING,
+    SEV_ERROR,
+    SEV_FATAL,
+} severity_t;
+
+typedef enum {
+    DIAG_TEXT,
+    DIAG_JSON,
+} diag_format_t;
+
+typedef struct {
+    severity_t severity;
+    const char* file;       // NULL if it is not about a file
+    int line;               // zero if it has no position
+    int col;
+    const char* code;       // what kind it is, such as "syntax"
+    const char* message;    // in the arena of the sink
+    unsigned int hash;
+    int repeats;            // times it was found again
+} diagnostic_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    arena_t* arena;
+    diagnostic_t* list;
+    size_t count;
+    size_t cap;
+    size_t notes;           // of the records
+    size_t* slots;          // index + 1 of a record by its hash
+    size_t nslots;
+    size_t limit;           // records that are kept, zero for no limit
+    size_t errors;          // reported, with the repeats and the dropped
+    size_t dropped;
+} diag_sink_t;
+
+#define DEFAULT_DIAG_LIMIT  1000
+
+diag_sink_t* create_diag_sink(size_t limit);
+void destroy_diag_sink(diag_sink_t* sink);
+void clear_diags(diag_sink_t* sink);
+void add_diag(diag_sink_t* sink, severity_t sev, const char* file, int line, int col,
+                        const char* code, const char* fmt, ...);
+void add_diag_va(diag_sink_t* sink, severity_t sev, const char* file, int line, int col,
+                        const char* code, const char* fmt, va_list args);
+void copy_diags(diag_sink_t* dest, diag_sink_t* src, size_t first, int lines);
+void write_diags(diag_sink_t* sink, FILE* fp, diag_format_t format);
+
+void set_diag_format(diag_format_t format);
+diag_format_t get_diag_format();
+void set_diag_limit(size_t limit);
+size_t get_diag_limit();
+void flush_errors(FILE* fp);
+
+// about the file that is being parsed on this thread
+void error_at(const char* code, int line, int col, const char* fmt, ...);
+void warning_at(const char* code, int line, int col, const char* fmt, ...);
 void fatal_error(const char* fmt, ...);
 int get_errors();
 void reset_errors();
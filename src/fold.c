@@ -0,0 +1,329 @@
+/*
+ * Constant folding. This runs at the end of resolution and finds every
+ * expression whose value can be known before the program runs: literals,
+ * variables that are declared const with a constant initializer, and the
+ * operators, casts and formatted strings over them. The value is computed
+ * once, with the same runtime functions that the interpreter and the VM
+ * use, and the expression is bound to it. Neither of them evaluates a
+ * folded expression or reads a constant variable again.
+ *
+ * Only the largest constant expression matters, but the ones inside it are
+ * bound as well, which does no harm. An operation that fails, such as a
+ * division by zero, is not folded, so that it fails when it runs, the same
+ * as it would have. Assigning to a constant is bound as an error.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "memory.h"
+#include "parser.h"
+#include "runtime.h"
+#include "resolve.h"
+
+#define MAX_ARGS    32
+
+typedef enum {
+    GLOBAL_UNSEEN,
+    GLOBAL_BUSY,            // its initializer is being folded
+    GLOBAL_CONST,
+    GLOBAL_VAR,
+} global_state_t;
+
+typedef struct {
+    program_t* prog;
+    ast_t* ast;
+    runtime_t rt;
+    uint8_t* global_state;
+    int* global_const;      // index of the value of a constant global
+    int* local_const;       // by AST_VAR_DECL, index of the value plus one
+    int consts_cap;         // values that prog->consts has room for
+} folder_t;
+
+static int fold(folder_t* f, ast_idx_t idx, value_t* out);
+
+#define CHILD(i, n) AST_CHILD(f->ast, i, n)
+
+static int add_const(folder_t* f, value_t val) {
+
+    program_t* prog = f->prog;
+
+    if(prog->nconsts == f->consts_cap) {
+        f->consts_cap = (f->consts_cap == 0)? 64: f->consts_cap << 1;
+        prog->consts = REALLOC_LST(prog->consts, f->consts_cap, value_t);
+    }
+    prog->consts[prog->nconsts] = val;
+    return prog->nconsts++;
+}
+
+static void bind_const(folder_t* f, ast_idx_t idx, int k) {
+
+    binding_t* b = BIND(f->prog, idx);
+    b->kind = BIND_CONST;
+    b->index = k;
+    b->type = VAL_TYPE(f->prog->consts[k]);
+}
+
+// bind the expression to the value and return true
+static int folded(folder_t* f, ast_idx_t idx, value_t val, value_t* out) {
+
+    bind_const(f, idx, add_const(f, val));
+    *out = val;
+    return 1;
+}
+
+static int is_const_decl(folder_t* f, ast_idx_t decl) {
+
+    ast_idx_t spec = CHILD(decl, 0);
+    return spec != AST_NONE && (AST_NODE(f->ast, spec)->flags & AST_F_CONST);
+}
+
+/*
+ * The value of a declared constant: the initializer, or the zero value of
+ * the type if there is none, converted to the type. A list, a dict or a
+ * struct is made when the program runs, so a constant one is not folded.
+ */
+static int const_value(folder_t* f, ast_idx_t init, int type, value_t* out) {
+
+    if(IS_CONTAINER_TYPE(type) || type == VAL_STRUCT)
+        return 0;
+    if(init == AST_NONE) {
+        if(type == VAL_ANY)
+            return 0;
+        *out = zero_value(type);
+        return 1;
+    }
+    return fold(f, init, out) && rt_convert(&f->rt, out, type) == RT_OK;
+}
+
+/*
+ * Globals are folded when they are first used, because a constant can be
+ * defined after the code that uses it. One that depends on itself is not a
+ * constant.
+ */
+static int global_value(folder_t* f, int g, value_t* out) {
+
+    global_t* gl = &f->prog->globals[g];
+    value_t val;
+
+    switch(f->global_state[g]) {
+        case GLOBAL_CONST:
+            *out = f->prog->consts[f->global_const[g]];
+            return 1;
+        case GLOBAL_BUSY:
+        case GLOBAL_VAR:
+            return 0;
+    }
+
+    f->global_state[g] = GLOBAL_BUSY;
+    if(is_const_decl(f, CHILD(gl->def, 0)) &&
+                const_value(f, CHILD(gl->def, 1), gl->type, &val)) {
+        f->global_const[g] = add_const(f, val);
+        f->global_state[g] = GLOBAL_CONST;
+        *out = val;
+        return 1;
+    }
+    f->global_state[g] = GLOBAL_VAR;
+    return 0;
+}
+
+static int fold_name(folder_t* f, ast_idx_t idx, value_t* out) {
+
+    binding_t* b = BIND(f->prog, idx);
+    value_t val;
+    int k;
+
+    switch(b->kind) {
+        case BIND_LOCAL:
+            if((k = f->local_const[b->decl]) == 0)
+                return 0;
+            bind_const(f, idx, k - 1);
+            *out = f->prog->consts[k - 1];
+            return 1;
+
+        case BIND_GLOBAL:
+            if(!global_value(f, b->index, out))
+                return 0;
+            bind_const(f, idx, f->global_const[b->index]);
+            return 1;
+
+        default:
+            // the arguments of a call
+            fold(f, CHILD(idx, 0), &val);
+            return 0;
+    }
+}
+
+static int fold_binary(folder_t* f, ast_idx_t idx, value_t* out) {
+
+    int op = AST_NODE(f->ast, idx)->op;
+    value_t left, right, res;
+    int lc = fold(f, CHILD(idx, 0), &left);
+    int rc = fold(f, CHILD(idx, 1), &right);
+
+    if(op == AND_OP || op == OR_OP) {
+        // the right side does not run when the left side decides
+        if(lc && value_truth(left) == (op == OR_OP))
+            return folded(f, idx, BOOL_VAL(op == OR_OP), out);
+        if(lc && rc)
+            return folded(f, idx, BOOL_VAL(value_truth(right)), out);
+        return 0;
+    }
+
+    if(lc && rc && rt_binary(&f->rt, op, left, right, &res) == RT_OK)
+        return folded(f, idx, res, out);
+    return 0;
+}
+
+static int fold_format(folder_t* f, ast_idx_t idx, value_t* out) {
+
+    value_t args[MAX_ARGS], res;
+    int nargs = 0;
+    int all = 1;
+
+    for(ast_idx_t n = ast_list_first(f->ast, CHILD(idx, 0)); n != AST_NONE;
+                        n = AST_NODE(f->ast, n)->next) {
+        value_t val;
+        if(!fold(f, n, &val) || nargs >= MAX_ARGS)
+            all = 0;
+        else
+            args[nargs++] = val;
+    }
+
+    if(all && rt_format(&f->rt, f->prog->formats[BIND(f->prog, idx)->index], args, nargs,
+                        &res) == RT_OK)
+        return folded(f, idx, res, out);
+    return 0;
+}
+
+static void fold_define(folder_t* f, ast_idx_t idx) {
+
+    ast_idx_t decl = CHILD(idx, 0);
+    ast_idx_t init = CHILD(idx, 1);
+    binding_t* b = BIND(f->prog, decl);
+    value_t val;
+
+    if(b->kind != BIND_LOCAL) {
+        fold(f, init, &val);
+        return;
+    }
+    if(is_const_decl(f, decl) && const_value(f, init, b->type, &val))
+        f->local_const[decl] = add_const(f, val) + 1;
+    else
+        fold(f, init, &val);
+}
+
+static void fold_assign(folder_t* f, ast_idx_t idx) {
+
+    ast_idx_t target = CHILD(idx, 0);
+    binding_t* b = BIND(f->prog, target);
+    value_t val;
+
+    if((b->kind == BIND_LOCAL && is_const_decl(f, b->decl)) ||
+                (b->kind == BIND_GLOBAL &&
+                    is_const_decl(f, CHILD(f->prog->globals[b->index].def, 0)))) {
+        b->kind = BIND_CONST;
+        b->index = 0;
+    }
+    fold(f, CHILD(idx, 1), &val);
+}
+
+/*
+ * Fold the expression, or the expressions in the statement. Returns true
+ * with the value if the node is a constant expression.
+ */
+static int fold(folder_t* f, ast_idx_t idx, value_t* out) {
+
+    if(idx == AST_NONE)
+        return 0;
+
+    ast_node_t* node = AST_NODE(f->ast, idx);
+    ast_value_t* val = AST_VALUE(f->ast, idx);
+    binding_t* b = BIND(f->prog, idx);
+    value_t res;
+
+    if(b->kind == BIND_CONST) {
+        *out = f->prog->consts[b->index];
+        return 1;
+    }
+
+    switch(node->kind) {
+        case AST_INUM: *out = INT_VAL(val->inum); return 1;
+        case AST_UNUM: *out = UINT_VAL(val->unum); return 1;
+        case AST_FNUM: *out = FLOAT_VAL(val->fnum); return 1;
+        case AST_BOOL: *out = BOOL_VAL(val->inum); return 1;
+
+        case AST_FSTRING:
+            if(node->child[0] == AST_NONE) {
+                *out = STRING_VAL(STR_OF(val->str));
+                return 1;
+            }
+            return fold_format(f, idx, out);
+
+        case AST_BINARY:
+            return fold_binary(f, idx, out);
+
+        case AST_UNARY:
+            if(fold(f, node->child[0], &res) && rt_unary(&f->rt, node->op, res, &res) == RT_OK)
+                return folded(f, idx, res, out);
+            return 0;
+
+        case AST_CAST:
+            if(fold(f, node->child[1], &res) && rt_cast(&f->rt, &res, b->type) == RT_OK)
+                return folded(f, idx, res, out);
+            return 0;
+
+        case AST_COMPOUND_NAME:
+            return fold_name(f, idx, out);
+
+        case AST_VAR_DEF:
+            fold_define(f, idx);
+            return 0;
+
+        case AST_ASSIGN:
+            fold_assign(f, idx);
+            return 0;
+
+        case AST_LIST:
+            for(ast_idx_t n = ast_list_first(f->ast, idx); n != AST_NONE; n = AST_NODE(f->ast, n)->next)
+                fold(f, n, &res);
+            return 0;
+
+        case AST_TYPE_SPEC:
+        case AST_TYPE_NAME:
+            return 0;
+
+        default:
+            for(int i = 0; i < 4; i++)
+                fold(f, node->child[i], &res);
+            return 0;
+    }
+}
+
+void fold_program(program_t* prog) {
+
+    folder_t f;
+    value_t val;
+
+    memset(&f, 0, sizeof(f));
+    f.prog = prog;
+    f.ast = prog->ast;
+    init_runtime(&f.rt);
+    f.global_state = ALLOC_LST(prog->nglobals + 1, uint8_t);
+    f.global_const = ALLOC_LST(prog->nglobals + 1, int);
+    f.local_const = ALLOC_LST(prog->ast->count, int);
+
+    for(int i = 0; i < prog->nglobals; i++) {
+        global_value(&f, i, &val);
+        fold(&f, AST_CHILD(prog->ast, prog->globals[i].def, 1), &val);
+    }
+    for(int i = 0; i < prog->nmethods; i++)
+        fold(&f, prog->methods[i].body, &val);
+
+    // the strings that were made stay with the program
+    prog->arena = f.rt.arena;
+    f.rt.arena = NULL;
+    free_runtime(&f.rt);
+    FREE(f.local_const);
+    FREE(f.global_const);
+    FREE(f.global_state);
+}
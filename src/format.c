@@ -0,0 +1,199 @@
+/*
+ * Format plans and the text of numbers. See format.h.
+ *
+ * The numbers are written the way snprintf() writes them with %ld, %lu and
+ * %g, which is what they looked like before, but ints are done here two
+ * digits at a time, and so are the floats that %g would print with no more
+ * digits than they have, such as 3, 0.25 or 12.375. Other floats still go
+ * through snprintf().
+ */
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "memory.h"
+#include "format.h"
+
+static const char digit_pairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static void add_seg(fmt_plan_t** plan, int* cap, int arg, uint32_t start, uint32_t len) {
+
+    fmt_plan_t* p = *plan;
+
+    if(arg < 0 && len == 0)
+        return;
+    if(p->nsegs == *cap) {
+        *cap <<= 1;
+        p = *plan = REALLOC(p, FORMAT_PLAN_SIZE(*cap));
+    }
+    fmt_seg_t* seg = &p->segs[p->nsegs++];
+    seg->arg = arg;
+    seg->start = start;
+    seg->len = len;
+    if(arg < 0)
+        p->literal_len += len;
+    else if(arg > p->max_arg)
+        p->max_arg = arg;
+}
+
+/*
+ * Take the format apart. Literal text next to literal text, which is what
+ * a { that does not start an argument leaves, is one segment.
+ */
+fmt_plan_t* create_format_plan(const char* fmt) {
+
+    int cap = 4;
+    fmt_plan_t* plan = ALLOC(FORMAT_PLAN_SIZE(cap));
+    const char* lit = fmt;
+    const char* ptr = fmt;
+
+    plan->text = fmt;
+    plan->literal_len = 0;
+    plan->max_arg = -1;
+    plan->nsegs = 0;
+
+    while(*ptr != '\0') {
+        if(*ptr == '{' && ptr[1] >= '0' && ptr[1] <= '9') {
+            const char* end = ptr + 1;
+            long arg = 0;
+            while(*end >= '0' && *end <= '9' && arg < INT32_MAX / 10)
+                arg = arg * 10 + (*end++ - '0');
+            if(*end == '}') {
+                add_seg(&plan, &cap, -1, (uint32_t)(lit - fmt), (uint32_t)(ptr - lit));
+                add_seg(&plan, &cap, (int)arg, 0, 0);
+                ptr = lit = end + 1;
+                continue;
+            }
+        }
+        ptr++;
+    }
+    add_seg(&plan, &cap, -1, (uint32_t)(lit - fmt), (uint32_t)(ptr - lit));
+    return plan;
+}
+
+fmt_plan_t* copy_format_plan(const fmt_plan_t* plan) {
+
+    fmt_plan_t* copy = ALLOC(FORMAT_PLAN_SIZE(plan->nsegs));
+    memcpy(copy, plan, FORMAT_PLAN_SIZE(plan->nsegs));
+    return copy;
+}
+
+void destroy_format_plan(fmt_plan_t* plan) {
+
+    if(plan != NULL)
+        FREE(plan);
+}
+
+// the digits end at the end of the buffer, and the first one is returned
+static char* digits(char* end, unsigned long num) {
+
+    while(num >= 100) {
+        const char* pair = &digit_pairs[(num % 100) * 2];
+        num /= 100;
+        *--end = pair[1];
+        *--end = pair[0];
+    }
+    if(num >= 10) {
+        *--end = digit_pairs[num * 2 + 1];
+        *--end = digit_pairs[num * 2];
+    }
+    else
+        *--end = (char)('0' + num);
+    return end;
+}
+
+/*
+ * Write the number into the buffer, which has room for NUMBER_TEXT_SIZE
+ * bytes, with a NUL, and return its length.
+ */
+int uint_text(char* buf, unsigned long num) {
+
+    char tmp[NUMBER_TEXT_SIZE];
+    char* end = tmp + sizeof(tmp);
+    char* start = digits(end, num);
+    int len = (int)(end - start);
+
+    memcpy(buf, start, len);
+    buf[len] = '\0';
+    return len;
+}
+
+int int_text(char* buf, long num) {
+
+    if(num >= 0)
+        return uint_text(buf, (unsigned long)num);
+    buf[0] = '-';
+    return uint_text(buf + 1, -(unsigned long)num) + 1;
+}
+
+/*
+ * %g gives six significant digits, without an exponent from 0.0001 up to a
+ * million. A number in that range that is some integer m over 10^k, with m
+ * below a million, is m with a decimal point put in, since the number is
+ * far closer to m / 10^k than to the next decimal with six digits.
+ */
+static int decimal_text(char* buf, double num) {
+
+    static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+    double mag = fabs(num);
+    char tmp[NUMBER_TEXT_SIZE];
+    int k;
+
+    if(!(mag >= 1e-4 && mag < 1e6))
+        return -1;
+    for(k = 1; k < 10; k++) {
+        double scaled = mag * powers[k];
+        if(scaled >= 1e6)
+            return -1;
+        if(scaled == floor(scaled))
+            break;
+    }
+    if(k == 10)
+        return -1;
+
+    unsigned long m = (unsigned long)(mag * powers[k]);
+    while(k > 0 && m % 10 == 0) {
+        m /= 10;
+        k--;
+    }
+    char* end = tmp + sizeof(tmp);
+    char* start = digits(end, m);
+    while(end - start <= k)
+        *--start = '0';
+
+    int len = 0;
+    int whole = (int)(end - start) - k;
+    if(num < 0)
+        buf[len++] = '-';
+    memcpy(buf + len, start, whole);
+    len += whole;
+    if(k > 0) {
+        buf[len++] = '.';
+        memcpy(buf + len, start + whole, k);
+        len += k;
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+int float_text(char* buf, double num) {
+
+    int len;
+
+    // %g prints a whole number below a million without an exponent
+    if(num > -1e6 && num < 1e6 && num == (double)(long)num && !(num == 0 && signbit(num)))
+        return int_text(buf, (long)num);
+    if((len = decimal_text(buf, num)) >= 0)
+        return len;
+    return snprintf(buf, NUMBER_TEXT_SIZE, "%g", num);
+}
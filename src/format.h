@@ -0,0 +1,44 @@
+#ifndef __FORMAT_H__
+#define __FORMAT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A formatted string, such as "{0} of {1}"(n, total), is taken apart once,
+ * before the program runs, into a plan: the runs of literal text and the
+ * argument that goes between them. Formatting then only follows the plan,
+ * works out how long the result is and writes it into one buffer of that
+ * size. The format is never scanned again.
+ *
+ * Each {n} with a decimal n is the nth argument, counting from zero, and
+ * anything else, including a { that does not start one, is literal text.
+ */
+typedef struct {
+    int32_t arg;            // the argument, or -1 for literal text
+    uint32_t start;         // of the literal text in the format
+    uint32_t len;
+} fmt_seg_t;
+
+typedef struct {
+    const char* text;       // the format, interned
+    uint32_t literal_len;   // of all the literal text
+    int max_arg;            // the largest argument used, or -1
+    int nsegs;
+    fmt_seg_t segs[];
+} fmt_plan_t;
+
+#define FORMAT_PLAN_SIZE(n) (sizeof(fmt_plan_t) + (n) * sizeof(fmt_seg_t))
+
+// the room that the text of a number takes, with the NUL
+#define NUMBER_TEXT_SIZE    32
+
+fmt_plan_t* create_format_plan(const char* fmt);
+fmt_plan_t* copy_format_plan(const fmt_plan_t* plan);
+void destroy_format_plan(fmt_plan_t* plan);
+
+int int_text(char* buf, long num);
+int uint_text(char* buf, unsigned long num);
+int float_text(char* buf, double num);
+
+#endif /* __FORMAT_H__ */
@@ -0,0 +1,472 @@
+/*
+ * Load a set of files and everything that they import. See imports.h.
+ *
+ * The files are parsed by a pool of threads. Each thread has its own deque
+ * of units to parse. When a thread parses a file and finds an import of a
+ * file that no unit has yet, it makes the unit and pushes it on its own
+ * deque, and it takes its next unit from the same end, so a thread follows
+ * the imports that it found itself while they are likely to be near each
+ * other on disk. A thread with nothing left takes the oldest unit from the
+ * deque of another thread, which is the one most likely to lead to more
+ * work. Many files can import the same file, and the table of units by path
+ * is what makes sure that it is only parsed once.
+ *
+ * Every unit is counted from when it is pushed until it has been parsed,
+ * and its imports are pushed before it stops being counted, so the load is
+ * done when the count is back to zero.
+ *
+ * When all of the files are parsed the graph is searched once, depth first,
+ * which puts the units in an order where each one comes after the ones it
+ * imports and finds every import that closes a cycle. A cycle is an error
+ * in the file with that import.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "memory.h"
+#include "errors.h"
+#include "intern.h"
+#include "ast.h"
+#include "context.h"
+#include "imports.h"
+
+#define INITIAL_SLOTS   (0x01 << 6)
+
+// the marks of the search
+#define UNSEEN      0
+#define ON_PATH     1
+#define DONE        2
+
+typedef struct {
+    pthread_mutex_t lock;
+    import_unit_t** tasks;
+    size_t head;            // where the other threads steal from
+    size_t tail;            // where the owner pushes and pops
+    size_t cap;
+} deque_t;
+
+typedef struct {
+    import_graph_t* graph;
+    pthread_mutex_t graph_lock;
+    deque_t* deques;
+    int nworkers;
+    atomic_size_t pending;  // units pushed and not parsed yet
+    atomic_size_t queued;   // units in a deque
+    pthread_mutex_t idle_lock;
+    pthread_cond_t idle;
+} pool_t;
+
+typedef struct {
+    pool_t* pool;
+    int id;
+} worker_t;
+
+/*
+ * The table of units by path. The paths are interned, so they are compared
+ * by pointer. The caller holds the graph lock.
+ */
+static import_unit_t** find_slot(import_graph_t* graph, const char* path) {
+
+    size_t mask = graph->nslots - 1;
+    size_t idx = intern_hash(path) & mask;
+
+    while(graph->slots[idx] != NULL && graph->slots[idx]->path != path)
+        idx = (idx + 1) & mask;
+
+    return &graph->slots[idx];
+}
+
+static void grow_slots(import_graph_t* graph) {
+
+    graph->nslots = (graph->nslots == 0)? INITIAL_SLOTS: graph->nslots << 1;
+    if(graph->slots != NULL)
+        FREE(graph->slots);
+    graph->slots = ALLOC_LST(graph->nslots, import_unit_t*);
+    memset(graph->slots, 0, graph->nslots * sizeof(import_unit_t*));
+
+    for(size_t i = 0; i < graph->count; i++)
+        *find_slot(graph, graph->units[i]->path) = graph->units[i];
+}
+
+/*
+ * Return the unit of the path, and set created if it is new.
+ */
+static import_unit_t* add_unit(import_graph_t* graph, const char* path, int* created) {
+
+    if((graph->count + 1) * 4 > graph->nslots * 3)
+        grow_slots(graph);
+
+    import_unit_t** slot = find_slot(graph, path);
+    *created = (*slot == NULL);
+    if(*slot != NULL)
+        return *slot;
+
+    import_unit_t* unit = ALLOC_DS(import_unit_t);
+    memset(unit, 0, sizeof(import_unit_t));
+    unit->path = path;
+    unit->ctx = create_context(path);
+    *slot = unit;
+
+    if(graph->count == graph->cap) {
+        graph->cap = (graph->cap == 0)? 64: graph->cap << 1;
+        graph->units = REALLOC_LST(graph->units, graph->cap, import_unit_t*);
+    }
+    graph->units[graph->count++] = unit;
+    return unit;
+}
+
+static void add_edge(import_unit_t* unit, import_unit_t* dep, int line, int col) {
+
+    if(unit->ndeps == unit->deps_cap) {
+        unit->deps_cap = (unit->deps_cap == 0)? 8: unit->deps_cap << 1;
+        unit->deps = REALLOC_LST(unit->deps, unit->deps_cap, import_edge_t);
+    }
+
+    import_edge_t* edge = &unit->deps[unit->ndeps++];
+    edge->unit = dep;
+    edge->line = line;
+    edge->col = col;
+}
+
+/*
+ * The real path of the file that the import names, interned, or NULL if
+ * there is no such file. The name is relative to the directory of the file
+ * with the import, and ".nop" is tried after a name with no extension.
+ */
+static const char* import_path(const char* from, const char* name) {
+
+    char buf[PATH_MAX];
+    char real[PATH_MAX];
+    const char* slash = strrchr(from, '/');
+    int dir = (name[0] != '/' && slash != NULL)? (int)(slash - from) + 1: 0;
+
+    const char* base = strrchr(name, '/');
+    base = (base != NULL)? base + 1: name;
+    const char* ext = (strchr(base, '.') == NULL)? ".nop": "";
+
+    if(snprintf(buf, sizeof(buf), "%.*s%s", dir, from, name) >= (int)sizeof(buf))
+        return NULL;
+    if(realpath(buf, real) != NULL)
+        return intern_str(real);
+
+    if(*ext == '\0' || snprintf(buf, sizeof(buf), "%.*s%s%s", dir, from, name, ext) >= (int)sizeof(buf))
+        return NULL;
+    return (realpath(buf, real) != NULL)? intern_str(real): NULL;
+}
+
+/*
+ * Deques. The owner pushes and pops at the tail and the other threads take
+ * from the head.
+ */
+static void push_task(pool_t* pool, int id, import_unit_t* unit) {
+
+    deque_t* dq = &pool->deques[id];
+
+    // counted first, so that the count is never less than what is there
+    atomic_fetch_add(&pool->pending, 1);
+    atomic_fetch_add(&pool->queued, 1);
+    pthread_mutex_lock(&dq->lock);
+    if(dq->tail == dq->cap) {
+        if(dq->head > 0) {
+            // move what is left to the front
+            memmove(dq->tasks, dq->tasks + dq->head,
+                        (dq->tail - dq->head) * sizeof(import_unit_t*));
+            dq->tail -= dq->head;
+            dq->head = 0;
+        }
+        if(dq->tail == dq->cap) {
+            dq->cap = (dq->cap == 0)? 64: dq->cap << 1;
+            dq->tasks = REALLOC_LST(dq->tasks, dq->cap, import_unit_t*);
+        }
+    }
+    dq->tasks[dq->tail++] = unit;
+    pthread_mutex_unlock(&dq->lock);
+
+    // a thread that saw nothing queued is waiting by the time this has the
+    // lock, so it cannot miss the signal
+    pthread_mutex_lock(&pool->idle_lock);
+    pthread_cond_signal(&pool->idle);
+    pthread_mutex_unlock(&pool->idle_lock);
+}
+
+static import_unit_t* take_task(pool_t* pool, int id, int steal) {
+
+    deque_t* dq = &pool->deques[id];
+    import_unit_t* unit = NULL;
+
+    pthread_mutex_lock(&dq->lock);
+    if(dq->head < dq->tail) {
+        unit = steal? dq->tasks[dq->head++]: dq->tasks[--dq->tail];
+        if(dq->head == dq->tail)
+            dq->head = dq->tail = 0;
+    }
+    pthread_mutex_unlock(&dq->lock);
+
+    if(unit != NULL)
+        atomic_fetch_sub(&pool->queued, 1);
+    return unit;
+}
+
+static import_unit_t* next_task(pool_t* pool, int id) {
+
+    import_unit_t* unit = take_task(pool, id, 0);
+
+    for(int i = 1; unit == NULL && i < pool->nworkers; i++)
+        unit = take_task(pool, (id + i) % pool->nworkers, 1);
+
+    return unit;
+}
+
+/*
+ * Parse the unit and add a unit for every file that it imports that does
+ * not have one yet. An import of a file that is not there is an error in
+ * the unit.
+ */
+static void parse_unit(pool_t* pool, int id, import_unit_t* unit) {
+
+    parse_ctx_t* ctx = unit->ctx;
+    ast_t* ast = ctx->ast;
+
+    parse_context(ctx);
+    if(ast->root == AST_NONE)
+        return;
+
+    for(ast_idx_t item = ast_list_first(ast, ast->root); item != AST_NONE;
+                item = AST_NODE(ast, item)->next) {
+        ast_node_t* node = AST_NODE(ast, item);
+        ast_idx_t fstr = node->child[0];
+        if(node->kind != AST_IMPORT || fstr == AST_NONE || AST_KIND(ast, fstr) != AST_FSTRING)
+            continue;
+
+        const char* name = AST_VALUE(ast, fstr)->str;
+        const char* path = import_path(unit->path, name);
+        import_unit_t* dep = NULL;
+        if(path != NULL) {
+            int created;
+            pthread_mutex_lock(&pool->graph_lock);
+            dep = add_unit(pool->graph, path, &created);
+            pthread_mutex_unlock(&pool->graph_lock);
+            if(created)
+                push_task(pool, id, dep);
+        }
+        else {
+            parse_ctx_t* saved = get_context();
+            set_context(ctx);
+            error_at("import", node->line, node->col, "cannot find the import %s", name);
+            set_context(saved);
+        }
+
+        // the node can move if error_at() is ever made to add one
+        node = AST_NODE(ast, item);
+        add_edge(unit, dep, node->line, node->col);
+    }
+}
+
+static void* worker(void* arg) {
+
+    worker_t* self = (worker_t*)arg;
+    pool_t* pool = self->pool;
+
+    for(;;) {
+        import_unit_t* unit = next_task(pool, self->id);
+        if(unit != NULL) {
+            parse_unit(pool, self->id, unit);
+            if(atomic_fetch_sub(&pool->pending, 1) == 1) {
+                pthread_mutex_lock(&pool->idle_lock);
+                pthread_cond_broadcast(&pool->idle);
+                pthread_mutex_unlock(&pool->idle_lock);
+            }
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->idle_lock);
+        while(atomic_load(&pool->queued) == 0 && atomic_load(&pool->pending) > 0)
+            pthread_cond_wait(&pool->idle, &pool->idle_lock);
+        pthread_mutex_unlock(&pool->idle_lock);
+
+        if(atomic_load(&pool->pending) == 0)
+            break;
+    }
+
+    return NULL;
+}
+
+/*
+ * Report the import that closes a cycle, with the files on the cycle.
+ */
+static void report_cycle(import_unit_t** path, size_t depth, import_unit_t* unit,
+                        import_edge_t* edge) {
+
+    parse_ctx_t* saved = get_context();
+    set_context(unit->ctx);
+
+    size_t first = depth;
+    while(first > 0 && path[first - 1] != edge->unit)
+        first--;
+    if(first > 0)
+        first--;
+
+    char* buf;
+    size_t len;
+    FILE* fp = open_memstream(&buf, &len);
+    if(fp == NULL)
+        fatal_error("cannot create output buffer for %s", unit->path);
+    for(size_t i = first; i < depth; i++)
+        fprintf(fp, "%s -> ", path[i]->path);
+    fprintf(fp, "%s", edge->unit->path);
+    fclose(fp);
+
+    error_at("cycle", edge->line, edge->col, "import cycle: %s", buf);
+    free(buf); // allocated by open_memstream()
+    set_context(saved);
+}
+
+/*
+ * Search the graph depth first from every root, without recursion since an
+ * import chain can be as long as the number of files. A unit goes in the
+ * order when everything that it imports has, and an import of a unit that
+ * is still on the path closes a cycle.
+ */
+static void order_units(import_graph_t* graph) {
+
+    size_t count = graph->count;
+    import_unit_t** order = ALLOC_LST(count, import_unit_t*);
+    import_unit_t** path = ALLOC_LST(count, import_unit_t*);
+    size_t* next = ALLOC_LST(count, size_t);
+    size_t norder = 0;
+
+    // every unit was found from a root
+    for(size_t r = 0; r < graph->nroots; r++) {
+        import_unit_t* start = graph->roots[r];
+        if(start->mark != UNSEEN)
+            continue;
+
+        size_t depth = 0;
+        path[depth] = start;
+        next[depth++] = 0;
+        start->mark = ON_PATH;
+
+        while(depth > 0) {
+            import_unit_t* unit = path[depth - 1];
+            if(next[depth - 1] == unit->ndeps) {
+                unit->mark = DONE;
+                order[norder++] = unit;
+                depth--;
+                continue;
+            }
+
+            import_edge_t* edge = &unit->deps[next[depth - 1]++];
+            if(edge->unit == NULL)
+                continue;
+            if(edge->unit->mark == ON_PATH) {
+                report_cycle(path, depth, unit, edge);
+                graph->cycles++;
+            }
+            else if(edge->unit->mark == UNSEEN) {
+                edge->unit->mark = ON_PATH;
+                path[depth] = edge->unit;
+                next[depth++] = 0;
+            }
+        }
+    }
+
+    FREE(graph->units);
+    graph->units = order;
+    graph->cap = count;
+    FREE(path);
+    FREE(next);
+}
+
+/*
+ * Parse the files and everything that they import with up to jobs threads.
+ * The diagnostics of every file are kept with it, to be printed by the
+ * caller, and the files are parsed from the start of it.
+ */
+import_graph_t* load_imports(const char** fnames, int count, int jobs) {
+
+    import_graph_t* graph = ALLOC_DS(import_graph_t);
+    memset(graph, 0, sizeof(import_graph_t));
+    graph->roots = ALLOC_LST(count, import_unit_t*);
+
+    pool_t pool;
+    pool.graph = graph;
+    pool.nworkers = (jobs > 0)? jobs: 1;
+    pool.deques = ALLOC_LST(pool.nworkers, deque_t);
+    memset(pool.deques, 0, pool.nworkers * sizeof(deque_t));
+    for(int i = 0; i < pool.nworkers; i++)
+        pthread_mutex_init(&pool.deques[i].lock, NULL);
+    pthread_mutex_init(&pool.graph_lock, NULL);
+    pthread_mutex_init(&pool.idle_lock, NULL);
+    pthread_cond_init(&pool.idle, NULL);
+    atomic_init(&pool.pending, 0);
+    atomic_init(&pool.queued, 0);
+
+    // a root that cannot be found keeps its name, and is an error in that
+    // file when it is parsed
+    for(int i = 0; i < count; i++) {
+        char real[PATH_MAX];
+        const char* path = intern_str((realpath(fnames[i], real) != NULL)? real: fnames[i]);
+        int created;
+        import_unit_t* unit = add_unit(graph, path, &created);
+        unit->root = 1;
+        graph->roots[graph->nroots++] = unit;
+        if(created)
+            push_task(&pool, i % pool.nworkers, unit);
+    }
+    worker_t* workers = ALLOC_LST(pool.nworkers, worker_t);
+    for(int i = 0; i < pool.nworkers; i++) {
+        workers[i].pool = &pool;
+        workers[i].id = i;
+    }
+
+    if(pool.nworkers == 1)
+        worker(&workers[0]);
+    else {
+        pthread_t* threads = ALLOC_LST(pool.nworkers, pthread_t);
+        for(int i = 0; i < pool.nworkers; i++)
+            if(pthread_create(&threads[i], NULL, worker, &workers[i]) != 0)
+                fatal_error("cannot create thread %d", i);
+        for(int i = 0; i < pool.nworkers; i++)
+            pthread_join(threads[i], NULL);
+        FREE(threads);
+    }
+
+    order_units(graph);
+
+    for(int i = 0; i < pool.nworkers; i++) {
+        pthread_mutex_destroy(&pool.deques[i].lock);
+        if(pool.deques[i].tasks != NULL)
+            FREE(pool.deques[i].tasks);
+    }
+    pthread_mutex_destroy(&pool.graph_lock);
+    pthread_mutex_destroy(&pool.idle_lock);
+    pthread_cond_destroy(&pool.idle);
+    FREE(pool.deques);
+    FREE(workers);
+
+    return graph;
+}
+
+void destroy_import_graph(import_graph_t* graph) {
+
+    if(graph == NULL)
+        return;
+
+    for(size_t i = 0; i < graph->count; i++) {
+        import_unit_t* unit = graph->units[i];
+        destroy_context(unit->ctx);
+        if(unit->deps != NULL)
+            FREE(unit->deps);
+        FREE(unit);
+    }
+    if(graph->units != NULL)
+        FREE(graph->units);
+    if(graph->slots != NULL)
+        FREE(graph->slots);
+    FREE(graph->roots);
+    FREE(graph);
+}
@@ -0,0 +1,49 @@
+#ifndef __IMPORTS_H__
+#define __IMPORTS_H__
+
+#include <stddef.h>
+
+#include "context.h"
+
+/*
+ * The files that a set of files imports, and the files that those import,
+ * as a graph with one unit for each file however many times it is imported.
+ * A file is known by its real path, so two spellings of the same file are
+ * one unit.
+ *
+ * An import names a file relative to the directory of the file that has it,
+ * and ".nop" is added to a name that has no extension of its own.
+ */
+typedef struct _import_unit_t_ import_unit_t;
+
+typedef struct {
+    import_unit_t* unit;    // NULL if the file was not found
+    int line;               // of the import
+    int col;
+} import_edge_t;
+
+struct _import_unit_t_ {
+    const char* path;       // interned
+    parse_ctx_t* ctx;
+    import_edge_t* deps;
+    size_t ndeps;
+    size_t deps_cap;
+    int root;               // given to load_imports(), not only imported
+    int mark;               // used while the graph is searched
+};
+
+typedef struct {
+    import_unit_t** units;  // after the load, every unit after its imports
+    size_t count;
+    size_t cap;
+    import_unit_t** roots;  // one for each file given, in that order
+    size_t nroots;
+    import_unit_t** slots;  // the units by path
+    size_t nslots;
+    int cycles;             // the number of imports that close a cycle
+} import_graph_t;
+
+import_graph_t* load_imports(const char** fnames, int count, int jobs);
+void destroy_import_graph(import_graph_t* graph);
+
+#endif /* __IMPORTS_H__ */
@@ -0,0 +1,264 @@
+/*
+ * String interning pool. The scanner passes every identifier and type name
+ * through here so that each spelling is allocated one time, no matter how
+ * many times it appears in the source, and names can be compared by pointer.
+ *
+ * Every string is stored as a str_t, with the header that holds the hash and
+ * the length, so those never have to be computed again, and so that an
+ * interned string is a string value as it is. The strings are packed into
+ * arenas that live until the pool is destroyed.
+ *
+ * The pool is shared by every thread that is parsing, and every identifier
+ * passes through it, so a name that is in the pool is found without a lock.
+ * The pool is split in shards by the top bits of the hash, and each shard is
+ * a table that is read the way the type name sets are: a string is stored in
+ * its slot with a release store, and when a table grows the new one is
+ * filled first and then published, and the old ones are kept until the pool
+ * is destroyed. A name that is not found is added under the lock of its
+ * shard only, so threads that add names at the same time rarely wait for
+ * each other. The strings never move, so a pointer that was returned can be
+ * used without any lock.
+ */
+#include <stdio.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "memory.h"
+#include "errors.h"
+#include "intern.h"
+#include "str.h"
+
+#define SHARD_BITS      6
+#define NUM_SHARDS      (0x01 << SHARD_BITS)
+#define SHARD_OF(h)     ((h) >> (32 - SHARD_BITS))
+#define INITIAL_SLOTS   (0x01 << 6)
+
+typedef struct {
+    unsigned int hash;          // set before the string is published
+    _Atomic(const char*) str;
+} intern_slot_t;
+
+typedef struct _intern_table_t_ {
+    struct _intern_table_t_* retired; // older tables, kept for readers
+    size_t mask;
+    intern_slot_t slots[];
+} intern_table_t;
+
+typedef struct {
+    _Atomic(intern_table_t*) table;
+    atomic_size_t count;
+    arena_t* arena;
+    pthread_mutex_t lock;
+} shard_t;
+
+static shard_t shards[NUM_SHARDS];
+static pthread_once_t shards_once = PTHREAD_ONCE_INIT;
+
+static void init_shards() {
+
+    for(int i = 0; i < NUM_SHARDS; i++)
+        pthread_mutex_init(&shards[i].lock, NULL);
+}
+
+/*
+ * FNV-1a hash of a string of known length.
+ */
+unsigned int hash_str(const char* str, size_t len) {
+
+    uint32_t hash = 2166136261u;
+    for(size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)str[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+/*
+ * Return the string in the table that matches, or NULL. This takes no lock.
+ * A pointer that is already interned matches without comparing characters.
+ */
+static const char* find_str(intern_table_t* tab, const char* str, size_t len, unsigned int hash) {
+
+    size_t idx = hash & tab->mask;
+    const char* found;
+
+    while((found = atomic_load_explicit(&tab->slots[idx].str, memory_order_acquire)) != NULL) {
+        if(found == str || (tab->slots[idx].hash == hash &&
+                STR_OF(found)->len == len && memcmp(found, str, len) == 0))
+            return found;
+        idx = (idx + 1) & tab->mask;
+    }
+
+    return NULL;
+}
+
+/*
+ * Return the slot that holds the string or the empty slot where it belongs.
+ * Only the thread that holds the lock of the shard calls this.
+ */
+static intern_slot_t* find_slot(intern_table_t* tab, const char* str, size_t len, unsigned int hash) {
+
+    size_t idx = hash & tab->mask;
+    const char* found;
+
+    while((found = atomic_load_explicit(&tab->slots[idx].str, memory_order_relaxed)) != NULL) {
+        if(tab->slots[idx].hash == hash && STR_OF(found)->len == len &&
+                memcmp(found, str, len) == 0)
+            break;
+        idx = (idx + 1) & tab->mask;
+    }
+
+    return &tab->slots[idx];
+}
+
+static intern_table_t* create_table(size_t nslots) {
+
+    intern_table_t* tab = ALLOC(sizeof(intern_table_t) + nslots * sizeof(intern_slot_t));
+    tab->mask = nslots - 1;
+    return tab;
+}
+
+/*
+ * Copy the strings into a table twice the size and publish it.
+ */
+static void grow_table(shard_t* shard) {
+
+    intern_table_t* old = atomic_load_explicit(&shard->table, memory_order_relaxed);
+    intern_table_t* tab = create_table((old == NULL)? INITIAL_SLOTS: (old->mask + 1) << 1);
+
+    for(size_t i = 0; old != NULL && i <= old->mask; i++) {
+        const char* str = atomic_load_explicit(&old->slots[i].str, memory_order_relaxed);
+        if(str != NULL) {
+            size_t idx = old->slots[i].hash & tab->mask;
+            while(atomic_load_explicit(&tab->slots[idx].str, memory_order_relaxed) != NULL)
+                idx = (idx + 1) & tab->mask;
+            tab->slots[idx].hash = old->slots[i].hash;
+            atomic_store_explicit(&tab->slots[idx].str, str, memory_order_relaxed);
+        }
+    }
+
+    tab->retired = old;
+    atomic_store_explicit(&shard->table, tab, memory_order_release);
+}
+
+/*
+ * Copy the string into the arena of the shard.
+ */
+static const char* store_str(shard_t* shard, const char* str, size_t len, unsigned int hash) {
+
+    if(shard->arena == NULL)
+        shard->arena = create_arena(0);
+
+    str_t* s = str_new(shard->arena, str, len);
+    s->hash = hash;
+    s->flags = STR_HASHED | STR_INTERNED;
+
+    return STR_CHARS(s);
+}
+
+/*
+ * Return the canonical copy of the first len characters of str, adding it
+ * to the pool if it has not been seen before. The hash must be the one that
+ * hash_str() gives, for a caller that has it already.
+ */
+const char* intern_hashed(const char* str, size_t len, unsigned int hash) {
+
+    shard_t* shard = &shards[SHARD_OF(hash)];
+
+    intern_table_t* tab = atomic_load_explicit(&shard->table, memory_order_acquire);
+    const char* retv = (tab != NULL)? find_str(tab, str, len, hash): NULL;
+    if(retv != NULL)
+        return retv;
+
+    pthread_once(&shards_once, init_shards);
+    pthread_mutex_lock(&shard->lock);
+
+    // keep the load factor under 3/4
+    size_t count = atomic_load_explicit(&shard->count, memory_order_relaxed);
+    tab = atomic_load_explicit(&shard->table, memory_order_relaxed);
+    if(tab == NULL || (count + 1) * 4 > (tab->mask + 1) * 3) {
+        grow_table(shard);
+        tab = atomic_load_explicit(&shard->table, memory_order_relaxed);
+    }
+
+    intern_slot_t* slot = find_slot(tab, str, len, hash);
+    retv = atomic_load_explicit(&slot->str, memory_order_relaxed);
+    if(retv == NULL) {
+        retv = store_str(shard, str, len, hash);
+        slot->hash = hash;
+        atomic_store_explicit(&slot->str, retv, memory_order_release);
+        atomic_store_explicit(&shard->count, count + 1, memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&shard->lock);
+
+    return retv;
+}
+
+const char* intern_strn(const char* str, size_t len) {
+
+    return intern_hashed(str, len, hash_str(str, len));
+}
+
+const char* intern_str(const char* str) {
+
+    return intern_strn(str, strlen(str));
+}
+
+/*
+ * Return the canonical copy of the string if it has been interned, else
+ * NULL. The pool is not changed.
+ */
+const char* intern_find_hashed(const char* str, size_t len, unsigned int hash) {
+
+    intern_table_t* tab = atomic_load_explicit(&shards[SHARD_OF(hash)].table, memory_order_acquire);
+    return (tab != NULL)? find_str(tab, str, len, hash): NULL;
+}
+
+const char* intern_find(const char* str) {
+
+    size_t len = strlen(str);
+    return intern_find_hashed(str, len, hash_str(str, len));
+}
+
+unsigned int intern_hash(const char* str) {
+
+    return STR_OF(str)->hash;
+}
+
+size_t intern_len(const char* str) {
+
+    return STR_OF(str)->len;
+}
+
+size_t get_intern_count() {
+
+    size_t count = 0;
+    for(int i = 0; i < NUM_SHARDS; i++)
+        count += atomic_load_explicit(&shards[i].count, memory_order_relaxed);
+
+    return count;
+}
+
+/*
+ * Release every interned string. Any pointer that came from the pool is
+ * invalid after this.
+ */
+void destroy_intern_pool() {
+
+    for(int i = 0; i < NUM_SHARDS; i++) {
+        shard_t* shard = &shards[i];
+        intern_table_t* tab = atomic_load(&shard->table);
+        while(tab != NULL) {
+            intern_table_t* next = tab->retired;
+            FREE(tab);
+            tab = next;
+        }
+        destroy_arena(shard->arena);
+        atomic_store(&shard->table, NULL);
+        atomic_store(&shard->count, 0);
+        shard->arena = NULL;
+    }
+}
@@ -0,0 +1,26 @@
+#ifndef __INTERN_H__
+#define __INTERN_H__
+
+#include <stddef.h>
+
+/*
+ * Interned strings are stored once per distinct spelling and live until the
+ * program exits. Two interned strings are equal if and only if the pointers
+ * are equal. Each one is the text of a str_t, so STR_OF() of it is a string
+ * value.
+ */
+const char* intern_str(const char* str);
+const char* intern_strn(const char* str, size_t len);
+const char* intern_find(const char* str);
+const char* intern_hashed(const char* str, size_t len, unsigned int hash);
+const char* intern_find_hashed(const char* str, size_t len, unsigned int hash);
+
+// These only accept pointers that were returned by the intern functions.
+unsigned int intern_hash(const char* str);
+size_t intern_len(const char* str);
+
+unsigned int hash_str(const char* str, size_t len);
+size_t get_intern_count();
+void destroy_intern_pool();
+
+#endif
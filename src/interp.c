@@ -0,0 +1,647 @@
+/*
+ * AST walking interpreter. Every name was bound by the resolution pass, so
+ * a local variable is read straight out of its frame slot and a call goes
+ * straight to its method; nothing is looked up by name at run time.
+ *
+ * Frames are laid out one after the other on a value stack that does not
+ * move, so a frame can be kept as a plain pointer. A run time error prints
+ * a message and unwinds to run_program() with longjmp().
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <setjmp.h>
+
+#include "memory.h"
+#include "parser.h"
+#include "value.h"
+#include "runtime.h"
+#include "resolve.h"
+#include "interp.h"
+
+#define STACK_SLOTS     (0x01 << 16)
+#define MAX_DEPTH       (0x01 << 12)
+#define MAX_ARGS        32
+#define INIT_CHUNK      64  // values, an even number
+
+typedef enum {
+    EXEC_NEXT,
+    EXEC_BREAK,
+    EXEC_CONTINUE,
+    EXEC_RETURN,
+} exec_t;
+
+typedef struct {
+    program_t* prog;
+    ast_t* ast;
+    binding_t* binds;
+    value_t* globals;
+    value_t* stack;
+    size_t top;
+    int depth;
+    value_t ret;            // value of the last return statement
+    dispatch_cache_t* dcache;   // by set in the dispatch table
+    runtime_t rt;
+    FILE* out;
+    jmp_buf bail;
+} interp_t;
+
+static value_t eval(interp_t* in, value_t* frame, ast_idx_t idx);
+static exec_t exec(interp_t* in, value_t* frame, ast_idx_t idx);
+
+#define NODE(i)     AST_NODE(in->ast, i)
+#define CHILD(i, n) AST_CHILD(in->ast, i, n)
+#define NEXT(i)     (AST_NODE(in->ast, i)->next)
+#define FIRST(l)    (((l) == AST_NONE)? AST_NONE: AST_CHILD(in->ast, l, 0))
+
+static void runtime_error(interp_t* in, ast_idx_t idx, const char* fmt, ...) {
+
+    va_list args;
+
+    fflush(in->out);
+    fprintf(in->out, "runtime error: %u: %u: ", NODE(idx)->line, NODE(idx)->col);
+    va_start(args, fmt);
+    vfprintf(in->out, fmt, args);
+    va_end(args);
+    fprintf(in->out, "\n");
+    longjmp(in->bail, 1);
+}
+
+/*
+ * The text of a compound name, for error messages.
+ */
+static const char* name_text(interp_t* in, ast_idx_t idx, char* buf, size_t len) {
+
+    size_t pos = 0;
+
+    buf[0] = '\0';
+    for(ast_idx_t n = FIRST(CHILD(idx, 0)); n != AST_NONE && pos < len; n = NEXT(n))
+        pos += snprintf(buf + pos, len - pos, "%s%s", (pos > 0)? ".": "",
+                            AST_VALUE(in->ast, n)->str);
+    return buf;
+}
+
+static void check(interp_t* in, ast_idx_t idx, rt_error_t err) {
+
+    if(err != RT_OK)
+        runtime_error(in, idx, "%s", in->rt.msg);
+}
+
+static void convert(interp_t* in, ast_idx_t idx, value_t* val, int type) {
+
+    check(in, idx, rt_convert(&in->rt, val, type));
+}
+
+static value_t binary_op(interp_t* in, ast_idx_t idx, int op, value_t left, value_t right) {
+
+    value_t res;
+    check(in, idx, rt_binary(&in->rt, op, left, right, &res));
+    return res;
+}
+
+/*
+ * Evaluate the expressions in the list into the array, for a call to a
+ * builtin or a format.
+ */
+static int eval_args(interp_t* in, value_t* frame, ast_idx_t idx, ast_idx_t list, value_t* args) {
+
+    int nargs = 0;
+
+    for(ast_idx_t n = FIRST(list); n != AST_NONE; n = NEXT(n)) {
+        if(nargs >= MAX_ARGS)
+            runtime_error(in, idx, "too many arguments");
+        args[nargs++] = eval(in, frame, n);
+    }
+    return nargs;
+}
+
+/*
+ * The list, dict or struct that an index, a method or a field is used on,
+ * which is the variable that the last part of the name is bound to.
+ */
+static value_t receiver_of(interp_t* in, value_t* frame, ast_idx_t idx) {
+
+    binding_t* b = BIND(in->prog, CHILD(CHILD(idx, 0), 1));
+    return (b->kind == BIND_LOCAL)? frame[b->index]: in->globals[b->index];
+}
+
+static value_t call_builtin(interp_t* in, value_t* frame, ast_idx_t idx, binding_t* b) {
+
+    value_t args[MAX_ARGS], var, res;
+
+    switch(b->index) {
+        case BUILTIN_PRINT:
+            rt_print(&in->rt, in->out, args, eval_args(in, frame, idx, b->args, args));
+            return NOTHING_VAL;
+
+        case BUILTIN_APPEND:
+            var = receiver_of(in, frame, idx);
+            args[0] = eval(in, frame, FIRST(b->args));
+            check(in, idx, rt_append(&in->rt, var, args, 1));
+            return NOTHING_VAL;
+
+        case BUILTIN_LENGTH:
+            check(in, idx, rt_length(&in->rt, receiver_of(in, frame, idx), &res));
+            return res;
+
+        case BUILTIN_SLICE:
+            var = receiver_of(in, frame, idx);
+            eval_args(in, frame, idx, b->args, args);
+            check(in, idx, rt_slice(&in->rt, var, args[0], args[1], &res));
+            return res;
+
+        case BUILTIN_HAS:
+            var = receiver_of(in, frame, idx);
+            args[0] = eval(in, frame, FIRST(b->args));
+            check(in, idx, rt_has(&in->rt, var, args[0], &res));
+            return res;
+
+        default:
+            runtime_error(in, idx, "unknown builtin");
+            return NOTHING_VAL;
+    }
+}
+
+/*
+ * The callee's frame is taken from the stack before the arguments are
+ * evaluated, so calls made by the arguments go above it. The arguments are
+ * evaluated in the caller's frame and stored in the callee's parameter slots.
+ */
+static value_t* enter_method(interp_t* in, ast_idx_t idx, method_t* m) {
+
+    if(in->depth >= MAX_DEPTH)
+        runtime_error(in, idx, "calls are nested too deeply");
+    if(in->top + m->nslots > STACK_SLOTS)
+        runtime_error(in, idx, "stack overflow");
+
+    value_t* callee = &in->stack[in->top];
+    in->top += m->nslots;
+    return callee;
+}
+
+// the parameters are in the frame and the rest of it is cleared here
+static value_t run_method(interp_t* in, ast_idx_t idx, method_t* m, value_t* callee, int slot) {
+
+    for(; slot < m->nslots; slot++)
+        callee[slot] = NOTHING_VAL;
+
+    in->depth++;
+    exec_t result = exec(in, callee, m->body);
+    in->depth--;
+    in->top -= m->nslots;
+
+    value_t ret = (result == EXEC_RETURN)? in->ret: NOTHING_VAL;
+    convert(in, idx, &ret, m->ret_type);
+    return ret;
+}
+
+static value_t call_method(interp_t* in, value_t* frame, ast_idx_t idx, binding_t* b) {
+
+    method_t* m = &in->prog->methods[b->index];
+    value_t* callee = enter_method(in, idx, m);
+
+    // a method of a struct gets the instance first
+    int slot = 0;
+    if(m->owner >= 0)
+        callee[slot++] = receiver_of(in, frame, idx);
+    ast_idx_t param = FIRST(m->params);
+    for(ast_idx_t n = FIRST(b->args); n != AST_NONE; n = NEXT(n), param = NEXT(param)) {
+        value_t val = eval(in, frame, n);
+        convert(in, n, &val, DECL_TYPE(BIND(in->prog, param)));
+        callee[slot++] = val;
+    }
+    return run_method(in, idx, m, callee, slot);
+}
+
+/*
+ * A call to overloaded methods that is decided when it runs, by the types
+ * of the arguments. They are evaluated before the frame is taken, because
+ * which method gets it is not known until then.
+ */
+static value_t call_dispatch(interp_t* in, value_t* frame, ast_idx_t idx, binding_t* b) {
+
+    const uint32_t* set = &in->prog->dispatch[b->index];
+    value_t args[DISPATCH_MAX_ARGS + 1];
+    int nargs = 0;
+    int index;
+
+    if(SET_SKIP(set))
+        args[nargs++] = receiver_of(in, frame, idx);
+    for(ast_idx_t n = FIRST(b->args); n != AST_NONE; n = NEXT(n))
+        args[nargs++] = eval(in, frame, n);
+    check(in, idx, rt_dispatch(&in->rt, set, args, &in->dcache[b->index], &index));
+
+    method_t* m = &in->prog->methods[index];
+    value_t* callee = enter_method(in, idx, m);
+    memcpy(callee, args, nargs * sizeof(value_t));
+    return run_method(in, idx, m, callee, nargs);
+}
+
+static value_t eval_name(interp_t* in, value_t* frame, ast_idx_t idx) {
+
+    binding_t* b = BIND(in->prog, idx);
+    value_t var, res;
+    char buf[128];
+
+    switch(b->kind) {
+        case BIND_LOCAL: return frame[b->index];
+        case BIND_GLOBAL: return in->globals[b->index];
+        case BIND_METHOD: return call_method(in, frame, idx, b);
+        case BIND_DISPATCH: return call_dispatch(in, frame, idx, b);
+        case BIND_BUILTIN: return call_builtin(in, frame, idx, b);
+        case BIND_CONST: return in->prog->consts[b->index];
+        case BIND_ELEMENT:
+            var = receiver_of(in, frame, idx);
+            check(in, idx, rt_index(&in->rt, var, eval(in, frame, b->args), &res));
+            return res;
+        case BIND_FIELD:
+            var = receiver_of(in, frame, idx);
+            check(in, idx, rt_get_field(&in->rt, var, b->index, FIELD_KIND(b->type), &res));
+            return res;
+        default:
+            runtime_error(in, idx, "%s is not defined", name_text(in, idx, buf, sizeof(buf)));
+            return NOTHING_VAL;
+    }
+}
+
+static value_t eval(interp_t* in, value_t* frame, ast_idx_t idx) {
+
+    ast_node_t* node = NODE(idx);
+    ast_value_t* val = AST_VALUE(in->ast, idx);
+    value_t left, right;
+
+    // an expression that was folded is bound to its value
+#define FOLDED(i) \
+    if(in->binds[i].kind == BIND_CONST) \
+        return in->prog->consts[in->binds[i].index]
+
+    switch(node->kind) {
+        case AST_COMPOUND_NAME:
+            if(in->binds[idx].kind == BIND_LOCAL)
+                return frame[in->binds[idx].index];
+            return eval_name(in, frame, idx);
+
+        case AST_INUM:
+            return INT_VAL(val->inum);
+        case AST_UNUM:
+            return UINT_VAL(val->unum);
+        case AST_FNUM:
+            return FLOAT_VAL(val->fnum);
+        case AST_BOOL:
+            return BOOL_VAL(val->inum);
+
+        case AST_FSTRING: {
+            if(node->child[0] == AST_NONE)
+                return STRING_VAL(STR_OF(val->str));
+            FOLDED(idx);
+            value_t args[MAX_ARGS], res;
+            int nargs = eval_args(in, frame, idx, node->child[0], args);
+            check(in, idx, rt_format(&in->rt, in->prog->formats[in->binds[idx].index], args, nargs, &res));
+            return res;
+        }
+
+        case AST_BINARY:
+            FOLDED(idx);
+            left = eval(in, frame, node->child[0]);
+            if(node->op == AND_OP)
+                return value_truth(left)? BOOL_VAL(value_truth(eval(in, frame, node->child[1]))): BOOL_VAL(0);
+            if(node->op == OR_OP)
+                return value_truth(left)? BOOL_VAL(1): BOOL_VAL(value_truth(eval(in, frame, node->child[1])));
+            right = eval(in, frame, node->child[1]);
+            if(IS_INT(left) && IS_INT(right)) {
+                // the common case, without the conversions
+                switch(node->op) {
+                    case '+': return INT_VAL(int_add(AS_INT(left), AS_INT(right)));
+                    case '-': return INT_VAL(int_sub(AS_INT(left), AS_INT(right)));
+                    case '*': return INT_VAL(int_mul(AS_INT(left), AS_INT(right)));
+                    case '/':
+                        if(AS_INT(right) != 0)
+                            return INT_VAL(int_div(AS_INT(left), AS_INT(right)));
+                        break;
+                    case '%':
+                        if(AS_INT(right) != 0)
+                            return INT_VAL(int_mod(AS_INT(left), AS_INT(right)));
+                        break;
+                    case '<': return BOOL_VAL(AS_INT(left) < AS_INT(right));
+                    case '>': return BOOL_VAL(AS_INT(left) > AS_INT(right));
+                    case LE_OP: return BOOL_VAL(AS_INT(left) <= AS_INT(right));
+                    case GE_OP: return BOOL_VAL(AS_INT(left) >= AS_INT(right));
+                    case EQ_OP: return BOOL_VAL(AS_INT(left) == AS_INT(right));
+                    case NE_OP: return BOOL_VAL(AS_INT(left) != AS_INT(right));
+                }
+            }
+            return binary_op(in, idx, node->op, left, right);
+
+        case AST_UNARY: {
+            FOLDED(idx);
+            value_t res;
+            check(in, idx, rt_unary(&in->rt, node->op, eval(in, frame, node->child[0]), &res));
+            return res;
+        }
+
+        case AST_CAST: {
+            FOLDED(idx);
+            value_t res = eval(in, frame, node->child[1]);
+            check(in, idx, rt_cast(&in->rt, &res, BIND(in->prog, idx)->type));
+            return res;
+        }
+
+        default:
+            runtime_error(in, idx, "%s cannot be run yet", ast_kind_name(node->kind));
+            return NOTHING_VAL;
+    }
+#undef FOLDED
+}
+
+/*
+ * Return where the variable that a name is bound to is stored.
+ */
+static value_t* lvalue(interp_t* in, value_t* frame, ast_idx_t idx) {
+
+    binding_t* b = BIND(in->prog, idx);
+    char buf[128];
+
+    if(b->kind == BIND_LOCAL)
+        return &frame[b->index];
+    if(b->kind == BIND_GLOBAL)
+        return &in->globals[b->index];
+    if(b->kind == BIND_CONST)
+        runtime_error(in, idx, "cannot assign to the constant %s", name_text(in, idx, buf, sizeof(buf)));
+
+    runtime_error(in, idx, "cannot assign to %s", name_text(in, idx, buf, sizeof(buf)));
+    return NULL;
+}
+
+/*
+ * A list or dict initializer, which makes a new one of the declared type.
+ * The elements are evaluated and added INIT_CHUNK values at a time, which
+ * is what the bytecode does too. A dict element is its key and its value.
+ */
+static value_t make_container(interp_t* in, value_t* frame, ast_idx_t idx, int type) {
+
+    int is_dict = (NODE(idx)->kind == AST_DICT_INIT);
+    value_t items[INIT_CHUNK];
+    int nitems = 0;
+
+    if(is_dict? !IS_DICT_TYPE(type): !IS_LIST_TYPE(type))
+        runtime_error(in, idx, is_dict? "a dict cannot initialize %s": "a list cannot initialize %s",
+                    VAL_TOSTR(type));
+
+    value_t val = rt_zero(&in->rt, type);
+    for(ast_idx_t n = FIRST(CHILD(idx, 0)); n != AST_NONE; n = NEXT(n)) {
+        if(is_dict) {
+            items[nitems++] = STRING_VAL(STR_OF(AST_VALUE(in->ast, n)->str));
+            items[nitems++] = eval(in, frame, CHILD(n, 0));
+        }
+        else
+            items[nitems++] = eval(in, frame, n);
+        if(nitems == INIT_CHUNK || NEXT(n) == AST_NONE) {
+            check(in, idx, rt_extend(&in->rt, val, items, nitems));
+            nitems = 0;
+        }
+    }
+    return val;
+}
+
+static void exec_define(interp_t* in, value_t* frame, ast_idx_t idx) {
+
+    binding_t* b = BIND(in->prog, CHILD(idx, 0));
+    ast_idx_t init = CHILD(idx, 1);
+    value_t val;
+
+    if(init == AST_NONE && b->type == VAL_STRUCT)
+        val = rt_instance(&in->rt, b->layout);
+    else if(init == AST_NONE)
+        val = rt_zero(&in->rt, b->type);
+    else if(NODE(init)->kind == AST_LIST_INIT || NODE(init)->kind == AST_DICT_INIT)
+        val = make_container(in, frame, init, b->type);
+    else
+        val = eval(in, frame, init);
+
+    convert(in, idx, &val, DECL_TYPE(b));
+    if(b->kind == BIND_LOCAL)
+        frame[b->index] = val;
+    else
+        in->globals[b->index] = val;
+}
+
+/*
+ * Assign to an element of a list or a dict. The value is converted to the
+ * type of the elements by the runtime.
+ */
+static void assign_element(interp_t* in, value_t* frame, ast_idx_t idx, int op) {
+
+    ast_idx_t target = CHILD(idx, 0);
+    value_t var = receiver_of(in, frame, target);
+    value_t index = eval(in, frame, BIND(in->prog, target)->args);
+    value_t val = eval(in, frame, CHILD(idx, 1));
+
+    if(op != 0) {
+        value_t cur;
+        check(in, idx, rt_index(&in->rt, var, index, &cur));
+        val = binary_op(in, idx, op, cur, val);
+    }
+    check(in, idx, rt_set_index(&in->rt, var, index, val));
+}
+
+/*
+ * Assign to a field of a struct, converting the value to the type of the
+ * field.
+ */
+static void assign_field(interp_t* in, value_t* frame, ast_idx_t idx, int op) {
+
+    ast_idx_t target = CHILD(idx, 0);
+    binding_t* b = BIND(in->prog, target);
+    value_t var = receiver_of(in, frame, target);
+    value_t val = eval(in, frame, CHILD(idx, 1));
+
+    if(op != 0) {
+        value_t cur;
+        check(in, idx, rt_get_field(&in->rt, var, b->index, FIELD_KIND(b->type), &cur));
+        val = binary_op(in, idx, op, cur, val);
+    }
+    convert(in, idx, &val, b->type);
+    check(in, idx, rt_set_field(&in->rt, var, b->index, FIELD_KIND(b->type), val));
+}
+
+static void exec_assign(interp_t* in, value_t* frame, ast_idx_t idx) {
+
+    ast_node_t* node = NODE(idx);
+    int op;
+
+    switch(node->op) {
+        case ADD_ASSIGN: op = '+'; break;
+        case SUB_ASSIGN: op = '-'; break;
+        case MUL_ASSIGN: op = '*'; break;
+        case DIV_ASSIGN: op = '/'; break;
+        case MOD_ASSIGN: op = '%'; break;
+        default: op = 0; break;
+    }
+    if(BIND(in->prog, node->child[0])->kind == BIND_ELEMENT) {
+        assign_element(in, frame, idx, op);
+        return;
+    }
+    if(BIND(in->prog, node->child[0])->kind == BIND_FIELD) {
+        assign_field(in, frame, idx, op);
+        return;
+    }
+
+    value_t* dest = lvalue(in, frame, node->child[0]);
+    value_t val = eval(in, frame, node->child[1]);
+    if(op != 0)
+        val = binary_op(in, idx, op, *dest, val);
+
+    convert(in, idx, &val, DECL_TYPE(BIND(in->prog, node->child[0])));
+    *dest = val;
+}
+
+static exec_t exec_switch(interp_t* in, value_t* frame, ast_idx_t idx) {
+
+    value_t val = eval(in, frame, CHILD(idx, 0));
+
+    for(ast_idx_t n = FIRST(CHILD(idx, 1)); n != AST_NONE; n = NEXT(n)) {
+        if(AST_KIND(in->ast, n) == AST_CASE &&
+                    !AS_BOOL(binary_op(in, n, EQ_OP, val, eval(in, frame, CHILD(n, 0)))))
+            continue;
+        exec_t result = exec(in, frame, CHILD(n, 1));
+        return (result == EXEC_BREAK)? EXEC_NEXT: result;
+    }
+    return EXEC_NEXT;
+}
+
+static exec_t exec(interp_t* in, value_t* frame, ast_idx_t idx) {
+
+    ast_node_t* node = NODE(idx);
+    exec_t result;
+
+    switch(node->kind) {
+        case AST_BLOCK:
+            for(ast_idx_t n = FIRST(node->child[0]); n != AST_NONE; n = NEXT(n))
+                if((result = exec(in, frame, n)) != EXEC_NEXT)
+                    return result;
+            return EXEC_NEXT;
+
+        case AST_VAR_DEF:
+            exec_define(in, frame, idx);
+            return EXEC_NEXT;
+
+        case AST_ASSIGN:
+            exec_assign(in, frame, idx);
+            return EXEC_NEXT;
+
+        case AST_EXPR_STMT:
+            eval(in, frame, node->child[0]);
+            return EXEC_NEXT;
+
+        case AST_IF:
+            if(value_truth(eval(in, frame, node->child[0])))
+                return exec(in, frame, node->child[1]);
+            for(ast_idx_t n = FIRST(node->child[2]); n != AST_NONE; n = NEXT(n)) {
+                if(AST_KIND(in->ast, n) == AST_ELSE ||
+                            value_truth(eval(in, frame, CHILD(n, 0))))
+                    return exec(in, frame, CHILD(n, 1));
+            }
+            return EXEC_NEXT;
+
+        case AST_WHILE:
+            while(node->child[0] == AST_NONE || value_truth(eval(in, frame, node->child[0]))) {
+                result = exec(in, frame, node->child[1]);
+                if(result == EXEC_BREAK)
+                    break;
+                if(result == EXEC_RETURN)
+                    return result;
+            }
+            return EXEC_NEXT;
+
+        case AST_DO:
+            do {
+                result = exec(in, frame, node->child[1]);
+                if(result == EXEC_BREAK)
+                    break;
+                if(result == EXEC_RETURN)
+                    return result;
+            } while(node->child[0] == AST_NONE || value_truth(eval(in, frame, node->child[0])));
+            return EXEC_NEXT;
+
+        case AST_FOR:
+            if(node->child[0] != AST_NONE && AST_KIND(in->ast, node->child[0]) == AST_VAR_DEF)
+                exec_define(in, frame, node->child[0]);
+            while(node->child[1] == AST_NONE || value_truth(eval(in, frame, node->child[1]))) {
+                result = exec(in, frame, node->child[3]);
+                if(result == EXEC_BREAK)
+                    break;
+                if(result == EXEC_RETURN)
+                    return result;
+                if(node->child[2] != AST_NONE)
+                    eval(in, frame, node->child[2]);
+            }
+            return EXEC_NEXT;
+
+        case AST_SWITCH:
+            return exec_switch(in, frame, idx);
+
+        case AST_BREAK:
+            return EXEC_BREAK;
+
+        case AST_CONTINUE:
+            return EXEC_CONTINUE;
+
+        case AST_RETURN:
+            in->ret = (node->child[0] != AST_NONE)? eval(in, frame, node->child[0]): NOTHING_VAL;
+            return EXEC_RETURN;
+
+        default:
+            runtime_error(in, idx, "%s cannot be run yet", ast_kind_name(node->kind));
+            return EXEC_NEXT;
+    }
+}
+
+int run_program(program_t* prog, FILE* out) {
+
+    interp_t in;
+    volatile int status = 0;
+
+    memset(&in, 0, sizeof(in));
+    in.prog = prog;
+    in.ast = prog->ast;
+    in.binds = prog->binds;
+    in.out = out;
+    init_runtime(&in.rt);
+    in.rt.layouts = prog->layouts;
+    in.stack = ALLOC_LST(STACK_SLOTS, value_t);
+    in.globals = ALLOC_LST(prog->nglobals + 1, value_t);
+    in.dcache = ALLOC_LST(prog->ndispatch + 1, dispatch_cache_t);
+
+    if(setjmp(in.bail) == 0) {
+        for(int i = 0; i < prog->nglobals; i++)
+            in.globals[i] = zero_value(prog->globals[i].type);
+        for(int i = 0; i < prog->nglobals; i++)
+            exec_define(&in, NULL, prog->globals[i].def);
+
+        if(prog->entry >= 0) {
+            method_t* m = &prog->methods[prog->entry];
+            if(m->nslots > STACK_SLOTS)
+                runtime_error(&in, m->body, "stack overflow");
+            in.top = m->nslots;
+            exec(&in, in.stack, m->body);
+        }
+    }
+    else
+        status = 1;
+
+    fflush(out);
+    FREE(in.dcache);
+    FREE(in.globals);
+    FREE(in.stack);
+    free_runtime(&in.rt);
+    return status;
+}
+
+int interpret(ast_t* ast, FILE* out) {
+
+    program_t* prog = resolve_program(ast);
+    int status = run_program(prog, out);
+    destroy_program(prog);
+    return status;
+}
@@ -0,0 +1,19 @@
+#ifndef __INTERP_H__
+#define __INTERP_H__
+
+#include <stdio.h>
+#include "ast.h"
+#include "resolve.h"
+
+/*
+ * Tree walking interpreter. It runs the entry block of a resolved program,
+ * after the name space variables are initialized. Output goes to the
+ * stream. Returns zero, or non-zero if the program stopped with a run time
+ * error.
+ */
+int run_program(program_t* prog, FILE* out);
+
+// resolve and run the AST of a file that parsed without errors
+int interpret(ast_t* ast, FILE* out);
+
+#endif
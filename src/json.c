@@ -0,0 +1,386 @@
+/*
+ * A small JSON reader and writer for the language server. The reader builds
+ * the whole message as a tree in an arena and gives up with NULL at the
+ * first thing that is not JSON. Strings are decoded to UTF-8, including the
+ * surrogate pairs of \u escapes, and are NUL terminated, so a string that
+ * has a NUL in it is cut short by the functions that do not take its length.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "memory.h"
+#include "json.h"
+
+// nesting deeper than this is not a message that the server can use
+#define MAX_DEPTH   64
+
+typedef struct {
+    arena_t* arena;
+    const char* text;
+    const char* end;
+    int depth;
+} json_reader_t;
+
+static json_t* read_value(json_reader_t* rd);
+
+static void skip_space(json_reader_t* rd) {
+
+    while(rd->text < rd->end && (*rd->text == ' ' || *rd->text == '\t' ||
+                *rd->text == '\n' || *rd->text == '\r'))
+        rd->text++;
+}
+
+static json_t* new_value(json_reader_t* rd, json_type_t type) {
+
+    json_t* val = ARENA_ALLOC_DS(rd->arena, json_t);
+    memset(val, 0, sizeof(json_t));
+    val->type = type;
+    return val;
+}
+
+static int hex_value(const char* str, size_t len) {
+
+    int value = 0;
+    for(size_t i = 0; i < len; i++) {
+        char ch = str[i];
+        value <<= 4;
+        if(ch >= '0' && ch <= '9')
+            value |= ch - '0';
+        else if(ch >= 'a' && ch <= 'f')
+            value |= ch - 'a' + 10;
+        else if(ch >= 'A' && ch <= 'F')
+            value |= ch - 'A' + 10;
+        else
+            return -1;
+    }
+    return value;
+}
+
+static size_t put_utf8(char* out, unsigned int cp) {
+
+    if(cp < 0x80) {
+        out[0] = (char)cp;
+        return 1;
+    }
+    else if(cp < 0x800) {
+        out[0] = (char)(0xC0 | (cp >> 6));
+        out[1] = (char)(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    else if(cp < 0x10000) {
+        out[0] = (char)(0xE0 | (cp >> 12));
+        out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (cp >> 18));
+    out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+/*
+ * Read a string that starts at the opening quote. The decoded string is
+ * never longer than the source, so the buffer is sized from that.
+ */
+static const char* read_string(json_reader_t* rd, size_t* len) {
+
+    const char* start = ++rd->text;
+    const char* p = start;
+
+    while(p < rd->end && *p != '"') {
+        if(*p == '\\')
+            p++;
+        p++;
+    }
+    if(p >= rd->end)
+        return NULL;
+
+    char* buf = ARENA_ALLOC(rd->arena, (size_t)(p - start) + 1);
+    size_t n = 0;
+    for(const char* s = start; s < p; s++) {
+        if(*s != '\\') {
+            buf[n++] = *s;
+            continue;
+        }
+        switch(*++s) {
+            case '"': buf[n++] = '"'; break;
+            case '\\': buf[n++] = '\\'; break;
+            case '/': buf[n++] = '/'; break;
+            case 'b': buf[n++] = '\b'; break;
+            case 'f': buf[n++] = '\f'; break;
+            case 'n': buf[n++] = '\n'; break;
+            case 'r': buf[n++] = '\r'; break;
+            case 't': buf[n++] = '\t'; break;
+            case 'u': {
+                if(p - s < 5)
+                    return NULL;
+                int cp = hex_value(s + 1, 4);
+                if(cp < 0)
+                    return NULL;
+                s += 4;
+                // a high surrogate is followed by the low one
+                if(cp >= 0xD800 && cp < 0xDC00 && p - s >= 7 && s[1] == '\\' && s[2] == 'u') {
+                    int lo = hex_value(s + 3, 4);
+                    if(lo >= 0xDC00 && lo < 0xE000) {
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                        s += 6;
+                    }
+                }
+                n += put_utf8(buf + n, (unsigned int)cp);
+                break;
+            }
+            default:
+                return NULL;
+        }
+    }
+    buf[n] = '\0';
+
+    rd->text = p + 1;
+    *len = n;
+    return buf;
+}
+
+static json_t* read_members(json_reader_t* rd, json_t* val, int object) {
+
+    char close = object? '}': ']';
+    json_t** tail = &val->child;
+
+    rd->text++;
+    skip_space(rd);
+    if(rd->text < rd->end && *rd->text == close) {
+        rd->text++;
+        return val;
+    }
+
+    for(;;) {
+        const char* key = NULL;
+        size_t len;
+
+        skip_space(rd);
+        if(object) {
+            if(rd->text >= rd->end || *rd->text != '"' || (key = read_string(rd, &len)) == NULL)
+                return NULL;
+            skip_space(rd);
+            if(rd->text >= rd->end || *rd->text != ':')
+                return NULL;
+            rd->text++;
+        }
+
+        json_t* item = read_value(rd);
+        if(item == NULL)
+            return NULL;
+        item->key = key;
+        *tail = item;
+        tail = &item->next;
+
+        skip_space(rd);
+        if(rd->text >= rd->end)
+            return NULL;
+        if(*rd->text == close) {
+            rd->text++;
+            return val;
+        }
+        if(*rd->text != ',')
+            return NULL;
+        rd->text++;
+    }
+}
+
+static int read_word(json_reader_t* rd, const char* word) {
+
+    size_t len = strlen(word);
+    if((size_t)(rd->end - rd->text) < len || memcmp(rd->text, word, len) != 0)
+        return 0;
+    rd->text += len;
+    return 1;
+}
+
+static json_t* read_value(json_reader_t* rd) {
+
+    json_t* val = NULL;
+
+    skip_space(rd);
+    if(rd->text >= rd->end)
+        return NULL;
+
+    switch(*rd->text) {
+        case '{':
+        case '[':
+            if(++rd->depth > MAX_DEPTH)
+                return NULL;
+            val = new_value(rd, (*rd->text == '{')? JSON_OBJECT: JSON_ARRAY);
+            val = read_members(rd, val, val->type == JSON_OBJECT);
+            rd->depth--;
+            return val;
+        case '"':
+            val = new_value(rd, JSON_STRING);
+            val->str = read_string(rd, &val->len);
+            return (val->str != NULL)? val: NULL;
+        case 't':
+            return read_word(rd, "true")? new_value(rd, JSON_TRUE): NULL;
+        case 'f':
+            return read_word(rd, "false")? new_value(rd, JSON_FALSE): NULL;
+        case 'n':
+            return read_word(rd, "null")? new_value(rd, JSON_NULL): NULL;
+        default: {
+            // strtod() needs a terminated string and the text is not one
+            char buf[64];
+            size_t n = 0;
+            while(rd->text + n < rd->end && n < sizeof(buf) - 1 &&
+                        strchr("+-0123456789.eE", rd->text[n]) != NULL)
+                n++;
+            if(n == 0)
+                return NULL;
+            memcpy(buf, rd->text, n);
+            buf[n] = '\0';
+            char* end;
+            val = new_value(rd, JSON_NUMBER);
+            val->num = strtod(buf, &end);
+            if(end != buf + n)
+                return NULL;
+            rd->text += n;
+            return val;
+        }
+    }
+}
+
+/*
+ * Parse the text, which must be one JSON value and nothing else. Returns
+ * NULL if it is not.
+ */
+json_t* parse_json(arena_t* arena, const char* text, size_t len) {
+
+    json_reader_t rd;
+    rd.arena = arena;
+    rd.text = text;
+    rd.end = text + len;
+    rd.depth = 0;
+
+    json_t* val = read_value(&rd);
+    skip_space(&rd);
+
+    return (rd.text == rd.end)? val: NULL;
+}
+
+/*
+ * Return the member of the object with the key, or NULL.
+ */
+json_t* json_get(json_t* obj, const char* key) {
+
+    if(obj == NULL || obj->type != JSON_OBJECT)
+        return NULL;
+
+    for(json_t* member = obj->child; member != NULL; member = member->next)
+        if(strcmp(member->key, key) == 0)
+            return member;
+
+    return NULL;
+}
+
+/*
+ * Follow a path of keys separated by dots, such as "params.position.line".
+ */
+json_t* json_path(json_t* obj, const char* path) {
+
+    char key[64];
+
+    while(obj != NULL && *path != '\0') {
+        size_t len = strcspn(path, ".");
+        if(len >= sizeof(key))
+            return NULL;
+        memcpy(key, path, len);
+        key[len] = '\0';
+        obj = json_get(obj, key);
+        path += len;
+        if(*path == '.')
+            path++;
+    }
+
+    return obj;
+}
+
+long json_int(json_t* val, long dflt) {
+
+    return (val != NULL && val->type == JSON_NUMBER)? (long)val->num: dflt;
+}
+
+const char* json_str(json_t* val, size_t* len) {
+
+    if(val == NULL || val->type != JSON_STRING)
+        return NULL;
+    if(len != NULL)
+        *len = val->len;
+    return val->str;
+}
+
+/*
+ * Write the text as a JSON string, with the quotes.
+ */
+void write_json_str(FILE* fp, const char* str, size_t len) {
+
+    fputc('"', fp);
+    for(size_t i = 0; i < len; i++) {
+        // most of a string needs no escape, so write it a run at a time
+        size_t run = i;
+        while(run < len && (unsigned char)str[run] >= 0x20 && str[run] != '"' && str[run] != '\\')
+            run++;
+        if(run > i) {
+            fwrite(str + i, 1, run - i, fp);
+            i = run;
+            if(i == len)
+                break;
+        }
+        unsigned char ch = (unsigned char)str[i];
+        switch(ch) {
+            case '"': fputs("\\\"", fp); break;
+            case '\\': fputs("\\\\", fp); break;
+            case '\n': fputs("\\n", fp); break;
+            case '\r': fputs("\\r", fp); break;
+            case '\t': fputs("\\t", fp); break;
+            default: fprintf(fp, "\\u%04x", ch); break;
+        }
+    }
+    fputc('"', fp);
+}
+
+/*
+ * Write a value back out, which is how the id of a request goes back in the
+ * response whether it was a number or a string.
+ */
+void write_json(FILE* fp, json_t* val) {
+
+    if(val == NULL) {
+        fputs("null", fp);
+        return;
+    }
+
+    switch(val->type) {
+        case JSON_NULL: fputs("null", fp); break;
+        case JSON_FALSE: fputs("false", fp); break;
+        case JSON_TRUE: fputs("true", fp); break;
+        case JSON_NUMBER:
+            if(val->num == (double)(long)val->num)
+                fprintf(fp, "%ld", (long)val->num);
+            else
+                fprintf(fp, "%.17g", val->num);
+            break;
+        case JSON_STRING: write_json_str(fp, val->str, val->len); break;
+        case JSON_ARRAY:
+        case JSON_OBJECT:
+            fputc((val->type == JSON_OBJECT)? '{': '[', fp);
+            for(json_t* item = val->child; item != NULL; item = item->next) {
+                if(item != val->child)
+                    fputc(',', fp);
+                if(val->type == JSON_OBJECT) {
+                    write_json_str(fp, item->key, strlen(item->key));
+                    fputc(':', fp);
+                }
+                write_json(fp, item);
+            }
+            fputc((val->type == JSON_OBJECT)? '}': ']', fp);
+            break;
+    }
+}
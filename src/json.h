@@ -0,0 +1,46 @@
+#ifndef __JSON_H__
+#define __JSON_H__
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include "memory.h"
+
+/*
+ * Just enough JSON for the language server. A message is parsed into a tree
+ * of values allocated in an arena, which is released when the message has
+ * been handled. The members of an object and the elements of an array are
+ * a list through next, and a member has its key.
+ */
+typedef enum {
+    JSON_NULL,
+    JSON_FALSE,
+    JSON_TRUE,
+    JSON_NUMBER,
+    JSON_STRING,
+    JSON_ARRAY,
+    JSON_OBJECT,
+} json_type_t;
+
+typedef struct _json_t_ json_t;
+
+struct _json_t_ {
+    json_type_t type;
+    const char* key;        // when it is a member of an object
+    json_t* next;
+    json_t* child;          // first member or element
+    double num;
+    const char* str;        // decoded to UTF-8 and NUL terminated
+    size_t len;
+};
+
+json_t* parse_json(arena_t* arena, const char* text, size_t len);
+json_t* json_get(json_t* obj, const char* key);
+json_t* json_path(json_t* obj, const char* path);
+long json_int(json_t* val, long dflt);
+const char* json_str(json_t* val, size_t* len);
+
+void write_json_str(FILE* fp, const char* str, size_t len);
+void write_json(FILE* fp, json_t* val);
+
+#endif /* __JSON_H__ */
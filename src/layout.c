@@ -0,0 +1,266 @@
+/*
+ * Struct layouts. See layout.h.
+ *
+ * Every struct declaration in the AST gets a layout, including the ones
+ * that are declared inside another struct. They are laid out on demand, so
+ * that a struct can use one that is declared after it, and a struct that
+ * is being laid out is marked, so that one that contains itself ends.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "memory.h"
+#include "intern.h"
+#include "parser.h"
+#include "resolve.h"
+#include "layout.h"
+
+#define WORD_SIZE   8
+
+typedef enum {
+    LAYOUT_UNSEEN,
+    LAYOUT_BUSY,
+    LAYOUT_DONE,
+} layout_state_t;
+
+typedef struct {
+    ast_t* ast;
+    struct_layout_t* layouts;
+    int count;
+} builder_t;
+
+static void lay_out(builder_t* bld, int index);
+
+static const char* join(const char* prefix, const char* name) {
+
+    char buf[256];
+
+    if(prefix == NULL)
+        return name;
+    snprintf(buf, sizeof(buf), "%s.%s", prefix, name);
+    return intern_str(buf);
+}
+
+static void add_struct(builder_t* bld, const char* space, const char* outer, ast_idx_t def) {
+
+    ast_t* ast = bld->ast;
+    const char* path = join(outer, AST_VALUE(ast, def)->str);
+
+    bld->layouts = REALLOC_LST(bld->layouts, bld->count + 1, struct_layout_t);
+    struct_layout_t* lay = &bld->layouts[bld->count++];
+    memset(lay, 0, sizeof(struct_layout_t));
+
+    lay->tname = AST_VALUE(ast, def)->str;
+    lay->path = path;
+    lay->space = space;
+    lay->name = join(space, path);
+    lay->def = def;
+    lay->align = 1;
+
+    // the ones inside come after it
+    for(ast_idx_t n = ast_list_first(ast, AST_CHILD(ast, def, 0)); n != AST_NONE;
+                        n = AST_NODE(ast, n)->next)
+        if(AST_KIND(ast, n) == AST_STRUCT)
+            add_struct(bld, space, path, n);
+}
+
+static void add_field(struct_layout_t* lay, const char* name, int type, int size, uint32_t base) {
+
+    lay->fields = REALLOC_LST(lay->fields, lay->nfields + 1, field_t);
+    field_t* f = &lay->fields[lay->nfields++];
+    f->name = name;
+    f->type = type;
+    f->size = size;
+    f->offset = (base + size - 1) & ~(uint32_t)(size - 1);
+    lay->size = f->offset + size;
+    if((uint32_t)size > lay->align)
+        lay->align = size;
+}
+
+/*
+ * Put the fields of the inner struct into the outer one, named after the
+ * member.
+ */
+static void inline_struct(builder_t* bld, int outer, int inner, const char* member) {
+
+    struct_layout_t* in = &bld->layouts[inner];
+    struct_layout_t* out = &bld->layouts[outer];
+    uint32_t base = (out->size + in->align - 1) & ~(in->align - 1);
+
+    for(int i = 0; i < in->nfields; i++) {
+        field_t* f = &in->fields[i];
+        add_field(out, join(member, f->name), f->type, f->size, base + f->offset);
+    }
+    out->size = base + in->size;
+    if(in->align > out->align)
+        out->align = in->align;
+}
+
+/*
+ * The layout of the struct named by the type, preferring one that is
+ * declared inside the struct, then one in the same name space. Returns -1
+ * if the type is not a struct.
+ */
+static int member_struct(builder_t* bld, int index, ast_idx_t spec) {
+
+    ast_t* ast = bld->ast;
+    ast_idx_t tname = AST_CHILD(ast, spec, 0);
+
+    if(AST_NODE(ast, spec)->op != 0 || AST_NODE(ast, tname)->op != TYPEDEF_NAME)
+        return -1;
+
+    struct_layout_t* lay = &bld->layouts[index];
+    const char* path = join(lay->path, AST_VALUE(ast, tname)->str);
+    for(int i = 0; i < bld->count; i++)
+        if(bld->layouts[i].path == path && bld->layouts[i].space == lay->space)
+            return i;
+    return find_layout(bld->layouts, bld->count, lay->space, AST_VALUE(ast, tname)->str);
+}
+
+static void lay_out(builder_t* bld, int index) {
+
+    ast_t* ast = bld->ast;
+    struct_layout_t* lay = &bld->layouts[index];
+    int inner;
+
+    if(lay->state != LAYOUT_UNSEEN)
+        return;
+    lay->state = LAYOUT_BUSY;
+
+    for(ast_idx_t n = ast_list_first(ast, AST_CHILD(ast, lay->def, 0)); n != AST_NONE;
+                        n = AST_NODE(ast, n)->next) {
+        const char* name = AST_VALUE(ast, n)->str;
+
+        if(AST_KIND(ast, n) == AST_STRUCT) {
+            for(inner = index + 1; bld->layouts[inner].def != n; inner++)
+                ;
+            lay_out(bld, inner);
+            inline_struct(bld, index, inner, name);
+        }
+        else if(AST_KIND(ast, n) == AST_VAR_DECL) {
+            ast_idx_t spec = AST_CHILD(ast, n, 0);
+            if((inner = member_struct(bld, index, spec)) >= 0 &&
+                        bld->layouts[inner].state != LAYOUT_BUSY) {
+                lay_out(bld, inner);
+                inline_struct(bld, index, inner, name);
+            }
+            else {
+                int type = (inner >= 0)? VAL_ANY: spec_type(ast, spec);
+                add_field(lay, name, type, (type == VAL_BOOL)? 1: WORD_SIZE, lay->size);
+            }
+        }
+    }
+
+    lay->size = (lay->size + lay->align - 1) & ~(lay->align - 1);
+    lay->state = LAYOUT_DONE;
+}
+
+/*
+ * Lay out every struct in the AST. The name spaces and the structs in them
+ * are found first, so that the order of the declarations does not matter.
+ */
+struct_layout_t* create_layouts(ast_t* ast, int* count) {
+
+    builder_t bld;
+    memset(&bld, 0, sizeof(bld));
+    bld.ast = ast;
+
+    for(ast_idx_t item = ast_list_first(ast, ast->root); item != AST_NONE;
+                        item = AST_NODE(ast, item)->next) {
+        if(AST_KIND(ast, item) != AST_NAMESPACE)
+            continue;
+        const char* space = AST_VALUE(ast, item)->str;
+        for(ast_idx_t n = ast_list_first(ast, AST_CHILD(ast, item, 0)); n != AST_NONE;
+                            n = AST_NODE(ast, n)->next)
+            if(AST_KIND(ast, n) == AST_STRUCT)
+                add_struct(&bld, space, NULL, n);
+    }
+
+    for(int i = 0; i < bld.count; i++)
+        lay_out(&bld, i);
+
+    *count = bld.count;
+    return bld.layouts;
+}
+
+/*
+ * A copy that does not share the field arrays, for a module that outlives
+ * the program it was compiled from. The names are interned and are shared.
+ */
+struct_layout_t* copy_layouts(const struct_layout_t* layouts, int count) {
+
+    struct_layout_t* copy = ALLOC_LST(count + 1, struct_layout_t);
+
+    for(int i = 0; i < count; i++) {
+        copy[i] = layouts[i];
+        copy[i].fields = ALLOC_LST(layouts[i].nfields + 1, field_t);
+        if(layouts[i].nfields > 0)
+            memcpy(copy[i].fields, layouts[i].fields, layouts[i].nfields * sizeof(field_t));
+    }
+    return copy;
+}
+
+void destroy_layouts(struct_layout_t* layouts, int count) {
+
+    if(layouts == NULL)
+        return;
+    for(int i = 0; i < count; i++)
+        if(layouts[i].fields != NULL)
+            FREE(layouts[i].fields);
+    FREE(layouts);
+}
+
+/*
+ * The struct with the type name, preferring the name space. Returns -1 if
+ * there is none.
+ */
+int find_layout(const struct_layout_t* layouts, int count, const char* space, const char* tname) {
+
+    int found = -1;
+
+    for(int i = 0; i < count; i++) {
+        if(layouts[i].tname != tname)
+            continue;
+        if(layouts[i].space == space)
+            return i;
+        if(found < 0)
+            found = i;
+    }
+    return found;
+}
+
+// the name must be interned
+const field_t* find_field(const struct_layout_t* layout, const char* name) {
+
+    for(int i = 0; i < layout->nfields; i++)
+        if(layout->fields[i].name == name)
+            return &layout->fields[i];
+    return NULL;
+}
+
+static const char* field_type_name(int type) {
+
+    return (type == VAL_ANY)? "any": VAL_TOSTR(type);
+}
+
+/*
+ * Print the size, the alignment and the bytes that are lost to padding of
+ * every struct, and the offset, size and type of every field.
+ */
+void dump_layouts(const struct_layout_t* layouts, int count, FILE* fp) {
+
+    for(int i = 0; i < count; i++) {
+        const struct_layout_t* lay = &layouts[i];
+        uint32_t used = 0;
+
+        for(int j = 0; j < lay->nfields; j++)
+            used += lay->fields[j].size;
+        fprintf(fp, "struct %s: size %u, align %u, padding %u\n",
+                    lay->name, lay->size, lay->align, lay->size - used);
+        for(int j = 0; j < lay->nfields; j++) {
+            const field_t* f = &lay->fields[j];
+            fprintf(fp, "    %6u %4u  %-12s %s\n", f->offset, f->size,
+                        field_type_name(f->type), f->name);
+        }
+    }
+}
@@ -0,0 +1,102 @@
+#ifndef __LAYOUT_H__
+#define __LAYOUT_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "ast.h"
+#include "value.h"
+
+/*
+ * The layout of the instances of a struct, worked out once for each struct
+ * declaration before anything runs. An instance is one block of memory and
+ * every field is at a fixed offset in it, so reading or writing a field is
+ * a load or a store at that offset and the name is never looked up.
+ *
+ * The fields are kept in the order they are declared and each one is
+ * aligned to its size: a bool takes 1 byte, an int, a uint, a float and a
+ * string 8, and anything else, such as a list or a dict, a value word of 8.
+ *
+ * A struct that is declared inside another one, and a member whose type is
+ * a struct, is inlined: its fields become fields of the outer struct, named
+ * by the path to them, such as value.ival. So the fields of a layout are
+ * all that an instance holds, and a struct never points to a part of
+ * itself. A member whose struct is still being laid out, because it
+ * contains this one, cannot be inlined and is a value word instead.
+ */
+typedef struct {
+    const char* name;       // interned path in the struct, such as value.ival
+    uint32_t offset;
+    uint8_t type;           // declared type, VAL_ANY if it is not known
+    uint8_t size;
+} field_t;
+
+typedef struct {
+    const char* name;       // qualified, such as constants.constant.value
+    const char* space;      // the rest is NULL in a module from the cache
+    const char* path;       // interned name in the name space, constant.value
+    const char* tname;      // interned type name, the last part of the path
+    ast_idx_t def;          // AST_STRUCT
+    field_t* fields;
+    int nfields;
+    uint32_t size;
+    uint32_t align;
+    uint8_t state;          // while the layouts are worked out
+} struct_layout_t;
+
+/*
+ * An instance. The value of a struct is the address of one, and copying the
+ * value does not copy the instance. Instances are chained in the runtime
+ * and freed with it.
+ */
+struct _struct_t_ {
+    const struct_layout_t* layout;
+    struct _struct_t_* next;
+    char data[];
+};
+
+// how a field of the type is stored: the value type of a scalar or a string,
+// or zero for a value word
+#define FIELD_KIND(t)   (((t) >= VAL_BOOL && (t) <= VAL_STRING)? (t): 0)
+
+static inline value_t field_get(const struct_t* obj, uint32_t offset, int kind) {
+
+    const char* ptr = obj->data + offset;
+    switch(kind) {
+        case VAL_BOOL: return BOOL_VAL(*(const uint8_t*)ptr);
+        case VAL_INT: return INT_VAL(*(const long*)ptr);
+        case VAL_UINT: return UINT_VAL(*(const unsigned long*)ptr);
+        case VAL_FLOAT: return FLOAT_VAL(*(const double*)ptr);
+        case VAL_STRING: return STRING_VAL(*(str_t* const*)ptr);
+        default: return *(const value_t*)ptr;
+    }
+}
+
+/*
+ * Store the value in the field. The value must already have the type of
+ * the field.
+ */
+static inline void field_set(struct_t* obj, uint32_t offset, int kind, value_t val) {
+
+    char* ptr = obj->data + offset;
+    switch(kind) {
+        case VAL_BOOL: *(uint8_t*)ptr = AS_BOOL(val); break;
+        case VAL_INT: *(long*)ptr = AS_INT(val); break;
+        case VAL_UINT: *(unsigned long*)ptr = AS_UINT(val); break;
+        case VAL_FLOAT: *(double*)ptr = AS_FLOAT(val); break;
+        case VAL_STRING: *(str_t**)ptr = AS_STR(val); break;
+        default: *(value_t*)ptr = val; break;
+    }
+}
+
+struct_layout_t* create_layouts(ast_t* ast, int* count);
+struct_layout_t* copy_layouts(const struct_layout_t* layouts, int count);
+void destroy_layouts(struct_layout_t* layouts, int count);
+
+int find_layout(const struct_layout_t* layouts, int count, const char* space, const char* tname);
+const field_t* find_field(const struct_layout_t* layout, const char* name);
+
+void dump_layouts(const struct_layout_t* layouts, int count, FILE* fp);
+
+#endif /* __LAYOUT_H__ */
@@ -0,0 +1,72 @@
+#ifndef __LIST_H__
+#define __LIST_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "value.h"
+
+/*
+ * A list keeps its elements unboxed, one after the other, in a store the
+ * way a C array does: an int list takes 8 bytes an element, a bool list 1.
+ * The list itself is a view of a run of the store, so a slice is a new
+ * view of the same store and copies nothing. An element changed through
+ * one view is seen by every view that covers it.
+ *
+ * Appending grows the store in place when the list ends where the store
+ * does and doubles its capacity when it is full, so a run of appends costs
+ * O(1) each. A list that ends before the store does, such as a slice from
+ * the middle, is copied into a store of its own first, so appending never
+ * changes what another list sees.
+ *
+ * Stores are chained in the runtime and freed with it.
+ */
+typedef struct _list_store_t_ {
+    char* data;
+    size_t len;     // elements used by some list
+    size_t cap;     // elements there is room for
+    uint8_t elem;   // the value type of the elements
+    uint8_t size;   // bytes of an element
+    struct _list_store_t_* next;
+} list_store_t;
+
+struct _list_t_ {
+    list_store_t* store;
+    size_t start;
+    size_t len;
+};
+
+#define LIST_AT(l, i)   ((l)->store->data + ((l)->start + (i)) * (l)->store->size)
+
+/*
+ * The element at the index, which must be in range.
+ */
+static inline value_t list_get(const list_t* list, size_t index) {
+
+    const char* ptr = LIST_AT(list, index);
+    switch(list->store->elem) {
+        case VAL_BOOL: return BOOL_VAL(*(const uint8_t*)ptr);
+        case VAL_INT: return INT_VAL(*(const long*)ptr);
+        case VAL_UINT: return UINT_VAL(*(const unsigned long*)ptr);
+        case VAL_FLOAT: return FLOAT_VAL(*(const double*)ptr);
+        default: return STRING_VAL(*(str_t* const*)ptr);
+    }
+}
+
+/*
+ * Store the value at the index, which must be in range. The value must
+ * already have the type of the elements.
+ */
+static inline void list_set(list_t* list, size_t index, value_t val) {
+
+    char* ptr = LIST_AT(list, index);
+    switch(list->store->elem) {
+        case VAL_BOOL: *(uint8_t*)ptr = AS_BOOL(val); break;
+        case VAL_INT: *(long*)ptr = AS_INT(val); break;
+        case VAL_UINT: *(unsigned long*)ptr = AS_UINT(val); break;
+        case VAL_FLOAT: *(double*)ptr = AS_FLOAT(val); break;
+        default: *(str_t**)ptr = AS_STR(val); break;
+    }
+}
+
+#endif /* __LIST_H__ */
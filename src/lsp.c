@@ -0,0 +1,1002 @@
+/*
+ * The language server. See lsp.h.
+ *
+ * Each open file is a document from reparse.c, so its AST, its type names
+ * and the scopes of its name spaces and structs stay in memory between
+ * requests and an edit parses only the items around it. The diagnostics of
+ * the file are the records in the sink of the file's context, which the
+ * document makes again after each change from those of its items, so an
+ * error in an item that the change did not touch is still published.
+ *
+ * A name is resolved from the innermost place that the cursor is in. The
+ * locals of a method are not in the symbols any more, since method and
+ * block scopes are released when they are popped, so they are found in the
+ * AST: the parameters of the method and the variables defined before the
+ * cursor in each block around it. Anything else is looked up in the scopes
+ * of the file from the name space or struct that the cursor is in, the way
+ * the parser found it, and the symbol has the line and column where it was
+ * declared.
+ *
+ * Positions in LSP are a line from zero and a character in UTF-16 code
+ * units. The nodes and the symbols have a line from one and a column in
+ * bytes from one, and the text of the document is used to convert them.
+ *
+ * The files do not share symbols yet, since imports are not resolved, so a
+ * change to one file is never a reason to analyze another.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <errno.h>
+
+#include "memory.h"
+#include "errors.h"
+#include "intern.h"
+#include "ast.h"
+#include "symbols.h"
+#include "object.h"
+#include "context.h"
+#include "parser.h"
+#include "reparse.h"
+#include "json.h"
+#include "lsp.h"
+
+// JSON-RPC error codes
+#define RPC_PARSE_ERROR     -32700
+#define RPC_INVALID_REQUEST -32600
+#define RPC_NO_METHOD       -32601
+
+#define MAX_PARTS   32
+#define MAX_BODY    (64L << 20)     // bytes in a message
+
+typedef struct {
+    const char* uri;        // interned
+    document_t* doc;
+    long version;
+} lsp_file_t;
+
+typedef struct {
+    FILE* in;
+    FILE* out;
+    arena_t* arena;         // the message being handled
+    char* body;
+    size_t body_cap;
+    lsp_file_t* files;
+    size_t nfiles;
+    size_t files_cap;
+    int shutdown;
+    int exit;
+} lsp_server_t;
+
+/*
+ * The qualified name under the cursor, such as a.b.c with the cursor on b,
+ * which is a.b. The range is that of the last part.
+ */
+typedef struct {
+    const char* names[MAX_PARTS];
+    size_t count;
+    size_t start;
+    size_t end;
+} name_at_t;
+
+/*
+ * What the cursor is inside of: the name spaces and structs, the method and
+ * the local declarations that can be seen from there, innermost last.
+ */
+typedef struct {
+    const char* path[MAX_PARTS];
+    size_t depth;
+    ast_idx_t method;
+    int body;               // in a method or the entry block
+    ast_idx_t* locals;
+    size_t nlocals;
+    size_t locals_cap;
+} where_t;
+
+/*
+ * Messages are written to a memory stream and then sent with their header.
+ */
+static FILE* begin_message(char** buf, size_t* len) {
+
+    FILE* fp = open_memstream(buf, len);
+    if(fp == NULL)
+        fatal_error("cannot create a message buffer");
+    fputs("{\"jsonrpc\":\"2.0\",", fp);
+    return fp;
+}
+
+/*
+ * The stream sets the buffer and the length when it is closed, so they are
+ * passed by reference.
+ */
+static void send_message(lsp_server_t* srv, FILE* fp, char** buf, size_t* len) {
+
+    fputc('}', fp);
+    fclose(fp);
+    fprintf(srv->out, "Content-Length: %zu\r\n\r\n", *len);
+    fwrite(*buf, 1, *len, srv->out);
+    fflush(srv->out);
+    free(*buf); // allocated by open_memstream()
+}
+
+static FILE* begin_result(json_t* id, char** buf, size_t* len) {
+
+    FILE* fp = begin_message(buf, len);
+    fputs("\"id\":", fp);
+    write_json(fp, id);
+    fputs(",\"result\":", fp);
+    return fp;
+}
+
+static void send_error(lsp_server_t* srv, json_t* id, int code, const char* text) {
+
+    char* buf;
+    size_t len;
+    FILE* fp = begin_message(&buf, &len);
+
+    fputs("\"id\":", fp);
+    write_json(fp, id);
+    fprintf(fp, ",\"error\":{\"code\":%d,\"message\":", code);
+    write_json_str(fp, text, strlen(text));
+    fputc('}', fp);
+    send_message(srv, fp, &buf, &len);
+}
+
+/*
+ * Return the length in a Content-Length header, or -1 if it is not a number
+ * that fits in a long.
+ */
+static long header_length(const char* value) {
+
+    char* end;
+
+    while(*value == ' ' || *value == '\t')
+        value++;
+    if(!isdigit((unsigned char)*value))
+        return -1;
+    errno = 0;
+    long length = strtol(value, &end, 10);
+    while(isspace((unsigned char)*end))
+        end++;
+    return (*end != '\0' || errno == ERANGE)? -1: length;
+}
+
+// throw away the body of a message that is too long to read
+static int skip_body(FILE* in, size_t length) {
+
+    char buf[4096];
+
+    while(length > 0) {
+        size_t count = fread(buf, 1, (length < sizeof(buf))? length: sizeof(buf), in);
+        if(count == 0)
+            return 0;
+        length -= count;
+    }
+    return 1;
+}
+
+/*
+ * Read one message. Returns the body, which is good until the next one is
+ * read, or NULL at the end of the input. A message without a length that
+ * can be read is answered with an error and skipped, and so is the body of
+ * one that is longer than MAX_BODY.
+ */
+static char* read_message(lsp_server_t* srv, size_t* len) {
+
+    char line[256];
+
+    for(;;) {
+        long length = -1;
+        int headers = 0;
+
+        for(;;) {
+            if(fgets(line, sizeof(line), srv->in) == NULL)
+                return NULL;
+            if(line[0] == '\r' || line[0] == '\n') {
+                if(headers)
+                    break;
+                continue;
+            }
+            headers = 1;
+            if(strncasecmp(line, "Content-Length:", 15) == 0)
+                length = header_length(line + 15);
+        }
+
+        if(length < 0) {
+            send_error(srv, NULL, RPC_INVALID_REQUEST, "the message has no valid Content-Length");
+            continue;
+        }
+        if(length > MAX_BODY) {
+            send_error(srv, NULL, RPC_INVALID_REQUEST, "the message is too long");
+            if(!skip_body(srv->in, (size_t)length))
+                return NULL;
+            continue;
+        }
+
+        if((size_t)length + 1 > srv->body_cap) {
+            srv->body_cap = (size_t)length + 1;
+            srv->body = REALLOC_LST(srv->body, srv->body_cap, char);
+        }
+        if(fread(srv->body, 1, (size_t)length, srv->in) != (size_t)length)
+            return NULL;
+        srv->body[length] = '\0';
+
+        *len = (size_t)length;
+        return srv->body;
+    }
+}
+
+static void send_null(lsp_server_t* srv, json_t* id) {
+
+    char* buf;
+    size_t len;
+    FILE* fp = begin_result(id, &buf, &len);
+    fputs("null", fp);
+    send_message(srv, fp, &buf, &len);
+}
+
+/*
+ * Position conversion.
+ */
+static size_t line_start(const char* text, size_t len, long line) {
+
+    size_t pos = 0;
+    for(; line > 0; line--) {
+        const char* nl = memchr(text + pos, '\n', len - pos);
+        if(nl == NULL)
+            return len;
+        pos = (size_t)(nl - text) + 1;
+    }
+    return pos;
+}
+
+// the number of UTF-16 code units that the character at the byte needs
+static int utf16_units(unsigned char ch) {
+
+    if((ch & 0xC0) == 0x80)
+        return 0;       // a continuation byte
+    return (ch >= 0xF0)? 2: 1;
+}
+
+static size_t to_offset(document_t* doc, long line, long character) {
+
+    size_t pos = line_start(doc->text, doc->len, line);
+    while(pos < doc->len && doc->text[pos] != '\n' && character > 0) {
+        character -= utf16_units((unsigned char)doc->text[pos++]);
+        while(pos < doc->len && (doc->text[pos] & 0xC0) == 0x80)
+            pos++;
+    }
+    return pos;
+}
+
+static void to_position(document_t* doc, size_t offset, long* line, long* character) {
+
+    size_t start = 0;
+    long n = 0;
+
+    for(const char* nl; (nl = memchr(doc->text + start, '\n', offset - start)) != NULL; n++)
+        start = (size_t)(nl - doc->text) + 1;
+
+    long units = 0;
+    for(size_t i = start; i < offset; i++)
+        units += utf16_units((unsigned char)doc->text[i]);
+
+    *line = n;
+    *character = units;
+}
+
+// the offset of a line and column from one, as the nodes have them
+static size_t node_offset(document_t* doc, int line, int col) {
+
+    size_t pos = line_start(doc->text, doc->len, line - 1);
+    while(col > 1 && pos < doc->len && doc->text[pos] != '\n') {
+        pos++;
+        col--;
+    }
+    return pos;
+}
+
+static void write_range(FILE* fp, document_t* doc, size_t start, size_t end) {
+
+    long line, character;
+
+    to_position(doc, start, &line, &character);
+    fprintf(fp, "{\"start\":{\"line\":%ld,\"character\":%ld},", line, character);
+    to_position(doc, end, &line, &character);
+    fprintf(fp, "\"end\":{\"line\":%ld,\"character\":%ld}}", line, character);
+}
+
+static int is_word(char ch) {
+
+    return isalnum((unsigned char)ch) || ch == '_';
+}
+
+static size_t word_end(document_t* doc, size_t pos) {
+
+    size_t end = pos;
+    while(end < doc->len && is_word(doc->text[end]))
+        end++;
+    return (end > pos)? end: (pos < doc->len && doc->text[pos] != '\n')? pos + 1: pos;
+}
+
+/*
+ * Find the name as a whole word on the line of the offset, at the offset or
+ * after it, or else before it. Declarations are recorded at the start of
+ * the type and structs and name spaces just past their name. Returns the
+ * offset if it is not found.
+ */
+static size_t find_name(document_t* doc, size_t offset, const char* name) {
+
+    size_t len = strlen(name);
+    size_t bol = offset;
+    while(bol > 0 && doc->text[bol - 1] != '\n')
+        bol--;
+    const char* nl = memchr(doc->text + offset, '\n', doc->len - offset);
+    size_t eol = (nl != NULL)? (size_t)(nl - doc->text): doc->len;
+    size_t found = (size_t)-1;
+
+    for(size_t pos = bol; pos + len <= eol; pos++) {
+        if(memcmp(doc->text + pos, name, len) != 0 ||
+                    (pos > bol && is_word(doc->text[pos - 1])) ||
+                    (pos + len < eol && is_word(doc->text[pos + len])))
+            continue;
+        found = pos;
+        if(pos >= offset)
+            break;
+    }
+
+    return (found != (size_t)-1)? found: offset;
+}
+
+/*
+ * Collect the qualified name that the offset is in, up to and including the
+ * part that it is on.
+ */
+static int name_at(document_t* doc, size_t offset, name_at_t* name) {
+
+    const char* text = doc->text;
+
+    if(offset > doc->len)
+        return 0;
+    if((offset == doc->len || !is_word(text[offset])) && offset > 0 && is_word(text[offset - 1]))
+        offset--;
+    if(offset >= doc->len || !is_word(text[offset]))
+        return 0;
+
+    size_t start = offset;
+    while(start > 0 && is_word(text[start - 1]))
+        start--;
+    size_t end = offset;
+    while(end < doc->len && is_word(text[end]))
+        end++;
+    if(isdigit((unsigned char)text[start]))
+        return 0;
+
+    name->start = start;
+    name->end = end;
+
+    // the parts before it, right to left
+    const char* parts[MAX_PARTS];
+    size_t lens[MAX_PARTS];
+    size_t count = 0;
+    parts[count] = text + start;
+    lens[count++] = end - start;
+    while(count < MAX_PARTS && start > 1 && text[start - 1] == '.' && is_word(text[start - 2])) {
+        size_t e = start - 1;
+        start = e;
+        while(start > 0 && is_word(text[start - 1]))
+            start--;
+        parts[count] = text + start;
+        lens[count++] = e - start;
+    }
+
+    name->count = count;
+    for(size_t i = 0; i < count; i++)
+        name->names[i] = intern_strn(parts[count - 1 - i], lens[count - 1 - i]);
+
+    return 1;
+}
+
+/*
+ * Finding what the cursor is in.
+ */
+static int starts_before(ast_t* ast, ast_idx_t idx, int line, int col) {
+
+    ast_node_t* node = AST_NODE(ast, idx);
+    return (int)node->line < line || ((int)node->line == line && (int)node->col <= col);
+}
+
+/*
+ * Variables outside of a method body are members of a name space, which are
+ * in the symbols, so only the ones in a body are kept.
+ */
+static void add_local(where_t* w, ast_idx_t decl) {
+
+    if(!w->body)
+        return;
+    if(w->nlocals == w->locals_cap) {
+        w->locals_cap = (w->locals_cap == 0)? 32: w->locals_cap << 1;
+        w->locals = REALLOC_LST(w->locals, w->locals_cap, ast_idx_t);
+    }
+    w->locals[w->nlocals++] = decl;
+}
+
+static void walk(ast_t* ast, ast_idx_t idx, int line, int col, where_t* w);
+
+/*
+ * The last item of the list that starts before the cursor is the one that
+ * has it, and the variables defined by the ones before are in scope.
+ */
+static void walk_list(ast_t* ast, ast_idx_t list, int line, int col, where_t* w) {
+
+    ast_idx_t last = AST_NONE;
+
+    for(ast_idx_t item = ast_list_first(ast, list); item != AST_NONE;
+                item = AST_NODE(ast, item)->next) {
+        if(!starts_before(ast, item, line, col))
+            break;
+        if(last != AST_NONE && AST_KIND(ast, last) == AST_VAR_DEF)
+            add_local(w, AST_CHILD(ast, last, 0));
+        last = item;
+    }
+
+    if(last != AST_NONE)
+        walk(ast, last, line, col, w);
+}
+
+static void walk(ast_t* ast, ast_idx_t idx, int line, int col, where_t* w) {
+
+    ast_node_t* node = AST_NODE(ast, idx);
+
+    switch(node->kind) {
+        case AST_LIST:
+            walk_list(ast, idx, line, col, w);
+            return;
+        case AST_NAMESPACE:
+        case AST_STRUCT:
+            if(w->depth < MAX_PARTS)
+                w->path[w->depth++] = AST_VALUE(ast, idx)->str;
+            if(node->child[0] != AST_NONE)
+                walk_list(ast, node->child[0], line, col, w);
+            return;
+        case AST_ENTRY:
+            w->body = 1;
+            break;
+        case AST_METHOD_DEF:
+            w->method = idx;
+            w->body = 1;
+            for(ast_idx_t p = ast_list_first(ast, node->child[2]); p != AST_NONE;
+                        p = AST_NODE(ast, p)->next)
+                add_local(w, p);
+            break;
+        case AST_VAR_DEF:
+            add_local(w, node->child[0]);
+            break;
+        case AST_FOR:
+            if(node->child[0] != AST_NONE && AST_KIND(ast, node->child[0]) == AST_VAR_DEF)
+                add_local(w, AST_CHILD(ast, node->child[0], 0));
+            break;
+        default:
+            break;
+    }
+
+    // into the child that starts last before the cursor
+    ast_idx_t best = AST_NONE;
+    for(int i = 0; i < 4; i++) {
+        ast_idx_t child = AST_NODE(ast, idx)->child[i];
+        if(child == AST_NONE || !starts_before(ast, child, line, col))
+            continue;
+        ast_node_t* node = AST_NODE(ast, child);
+        if(best == AST_NONE || starts_before(ast, best, node->line, node->col))
+            best = child;
+    }
+    if(best != AST_NONE)
+        walk(ast, best, line, col, w);
+}
+
+static void free_where(where_t* w) {
+
+    if(w->locals != NULL)
+        FREE(w->locals);
+}
+
+static ast_idx_t find_local(ast_t* ast, where_t* w, const char* name) {
+
+    for(size_t i = w->nlocals; i > 0; i--) {
+        ast_idx_t decl = w->locals[i - 1];
+        if(AST_KIND(ast, decl) == AST_VAR_DECL && AST_VALUE(ast, decl)->str == name)
+            return decl;
+    }
+    return AST_NONE;
+}
+
+/*
+ * The scope that a name is looked up from at the cursor: the innermost name
+ * space or struct, or the owner of the method, such as s for s.m().
+ */
+static scope_t* where_scope(parse_ctx_t* ctx, where_t* w) {
+
+    ast_t* ast = ctx->ast;
+    scope_t* scope = ctx->symbols;
+
+    for(size_t i = 0; scope != NULL && i < w->depth; i++) {
+        scope_t* inner = lookup_scope(scope, &w->path[i], 1);
+        if(inner == NULL)
+            break;
+        scope = inner;
+    }
+
+    if(scope == NULL || w->method == AST_NONE)
+        return scope;
+
+    ast_node_t* def = AST_NODE(ast, w->method);
+    ast_idx_t id = def->child[1];
+    if(id == AST_NONE || AST_KIND(ast, id) != AST_COMPOUND_ID)
+        return scope;
+
+    const char* names[MAX_PARTS];
+    size_t count = 0;
+    for(ast_idx_t item = ast_list_first(ast, AST_CHILD(ast, id, 0));
+                item != AST_NONE && count < MAX_PARTS; item = AST_NODE(ast, item)->next)
+        names[count++] = AST_VALUE(ast, item)->str;
+    if(count == 0)
+        return scope;
+    size_t len = (def->op == AST_M_METHOD)? count - 1: count;
+
+    scope_t* owner = (len > 0)? lookup_scope(scope, names, len): NULL;
+    return (owner != NULL)? owner: scope;
+}
+
+/*
+ * What a name resolved to, a local declaration or a symbol, and where it
+ * was declared.
+ */
+typedef struct {
+    ast_idx_t local;
+    symbol_table_t* sym;
+    size_t offset;
+} target_t;
+
+static int resolve_name(document_t* doc, name_at_t* name, size_t offset, target_t* target) {
+
+    parse_ctx_t* ctx = doc->ctx;
+    ast_t* ast = ctx->ast;
+    where_t w;
+
+    memset(&w, 0, sizeof(w));
+    memset(target, 0, sizeof(target_t));
+    if(ast->root == AST_NONE || ctx->symbols == NULL)
+        return 0;
+
+    // the nodes count bytes, so this is not the LSP character
+    size_t bol = offset;
+    while(bol > 0 && doc->text[bol - 1] != '\n')
+        bol--;
+    int line = 1;
+    for(const char* p = doc->text; (p = memchr(p, '\n', (size_t)(doc->text + bol - p))) != NULL; p++)
+        line++;
+    // the nodes of the item have the lines it had when it was parsed
+    const item_span_t* item = document_item_at(doc, offset);
+    if(item == NULL)
+        return 0;
+    walk(ast, item->node, line - item->moved, (int)(offset - bol) + 1, &w);
+
+    ast_idx_t local = find_local(ast, &w, name->names[0]);
+    if(local != AST_NONE && name->count == 1) {
+        ast_node_t* node = AST_NODE(ast, local);
+        target->local = local;
+        target->offset = find_name(doc, node_offset(doc, node->line + item->moved, node->col),
+                            name->names[0]);
+        free_where(&w);
+        return 1;
+    }
+
+    scope_t* scope = where_scope(ctx, &w);
+    symbol_table_t* sym = NULL;
+    if(local != AST_NONE) {
+        // a member of a local, through the struct that is its type
+        ast_idx_t spec = AST_CHILD(ast, local, 0);
+        ast_idx_t type = (spec != AST_NONE)? AST_CHILD(ast, spec, 0): AST_NONE;
+        if(type != AST_NONE && AST_NODE(ast, type)->op == TYPEDEF_NAME) {
+            scope_t* struc = lookup_scope(scope, &AST_VALUE(ast, type)->str, 1);
+            sym = lookup_symbol(struc, name->names + 1, name->count - 1);
+        }
+    }
+    else
+        sym = lookup_symbol(scope, name->names, name->count);
+    free_where(&w);
+
+    if(sym == NULL || sym->line_no <= 0)
+        return 0;
+
+    target->sym = sym;
+    target->offset = find_name(doc, node_offset(doc, document_symbol_line(doc, sym), sym->col_no),
+                        sym->name);
+    return 1;
+}
+
+/*
+ * Files.
+ */
+static lsp_file_t* find_file(lsp_server_t* srv, const char* uri) {
+
+    if(uri == NULL)
+        return NULL;
+
+    uri = intern_str(uri);
+    for(size_t i = 0; i < srv->nfiles; i++)
+        if(srv->files[i].uri == uri)
+            return &srv->files[i];
+
+    return NULL;
+}
+
+static lsp_file_t* file_param(lsp_server_t* srv, json_t* params) {
+
+    return find_file(srv, json_str(json_path(params, "textDocument.uri"), NULL));
+}
+
+/*
+ * The path of a file URI, with the escapes decoded, which is the name that
+ * the diagnostics use. Anything else is used as it is.
+ */
+static const char* uri_path(const char* uri) {
+
+    if(strncmp(uri, "file://", 7) != 0)
+        return intern_str(uri);
+
+    const char* src = uri + 7;
+    char* path = ALLOC(strlen(src) + 1);
+    size_t n = 0;
+    for(; *src != '\0'; src++) {
+        if(src[0] == '%' && isxdigit((unsigned char)src[1]) && isxdigit((unsigned char)src[2])) {
+            char hex[3] = { src[1], src[2], '\0' };
+            path[n++] = (char)strtol(hex, NULL, 16);
+            src += 2;
+        }
+        else
+            path[n++] = *src;
+    }
+    path[n] = '\0';
+
+    const char* name = intern_str(path);
+    FREE(path);
+    return name;
+}
+
+// the LSP severities: 1 is an error, 2 a warning and 3 information
+static const int lsp_severity[] = { 3, 2, 1, 1 };
+
+static void write_diagnostic(FILE* fp, document_t* doc, diagnostic_t* rec, int first) {
+
+    size_t start = (rec->line > 0)? node_offset(doc, rec->line, rec->col): 0;
+
+    if(!first)
+        fputc(',', fp);
+    fputs("{\"range\":", fp);
+    write_range(fp, doc, start, word_end(doc, start));
+    fprintf(fp, ",\"severity\":%d,\"code\":", lsp_severity[rec->severity]);
+    write_json_str(fp, rec->code, strlen(rec->code));
+    fputs(",\"source\":\"nop\",\"message\":", fp);
+    write_json_str(fp, rec->message, strlen(rec->message));
+    fputc('}', fp);
+}
+
+/*
+ * Publish the records in the sink of the file. One with no position goes at
+ * the start of the file.
+ */
+static void publish_diagnostics(lsp_server_t* srv, lsp_file_t* file) {
+
+    char* buf;
+    size_t len;
+    FILE* fp = begin_message(&buf, &len);
+    diag_sink_t* diags = file->doc->ctx->diags;
+
+    fputs("\"method\":\"textDocument/publishDiagnostics\",\"params\":{\"uri\":", fp);
+    write_json_str(fp, file->uri, strlen(file->uri));
+    fprintf(fp, ",\"version\":%ld,\"diagnostics\":[", file->version);
+    for(size_t i = 0; i < diags->count; i++)
+        write_diagnostic(fp, file->doc, &diags->list[i], i == 0);
+    fputs("]}", fp);
+    send_message(srv, fp, &buf, &len);
+}
+
+/*
+ * Requests and notifications.
+ */
+static void initialize(lsp_server_t* srv, json_t* id) {
+
+    char* buf;
+    size_t len;
+    FILE* fp = begin_result(id, &buf, &len);
+
+    // 2 is incremental sync, so a change has only the range that changed
+    fputs("{\"capabilities\":{"
+            "\"textDocumentSync\":{\"openClose\":true,\"change\":2},"
+            "\"definitionProvider\":true,"
+            "\"hoverProvider\":true},"
+            "\"serverInfo\":{\"name\":\"nop\"}}", fp);
+    send_message(srv, fp, &buf, &len);
+}
+
+static void did_open(lsp_server_t* srv, json_t* params) {
+
+    size_t len;
+    const char* uri = json_str(json_path(params, "textDocument.uri"), NULL);
+    const char* text = json_str(json_path(params, "textDocument.text"), &len);
+    if(uri == NULL || text == NULL)
+        return;
+
+    lsp_file_t* file = find_file(srv, uri);
+    if(file != NULL)
+        close_document(file->doc);
+    else {
+        if(srv->nfiles == srv->files_cap) {
+            srv->files_cap = (srv->files_cap == 0)? 16: srv->files_cap << 1;
+            srv->files = REALLOC_LST(srv->files, srv->files_cap, lsp_file_t);
+        }
+        file = &srv->files[srv->nfiles++];
+    }
+
+    memset(file, 0, sizeof(lsp_file_t));
+    file->uri = intern_str(uri);
+    file->version = json_int(json_path(params, "textDocument.version"), 0);
+    file->doc = create_document(uri_path(uri), text, len);
+
+    reparse_document(file->doc);
+    publish_diagnostics(srv, file);
+}
+
+/*
+ * Apply the changes in order. Each one is parsed as it comes, since the
+ * range of the next one is in the text after it, and the diagnostics are
+ * those of the file after the last one.
+ */
+static void did_change(lsp_server_t* srv, json_t* params) {
+
+    lsp_file_t* file = file_param(srv, params);
+    json_t* changes = json_get(params, "contentChanges");
+    if(file == NULL || changes == NULL || changes->type != JSON_ARRAY)
+        return;
+
+    document_t* doc = file->doc;
+    int changed = 0;
+    file->version = json_int(json_path(params, "textDocument.version"), file->version);
+    for(json_t* change = changes->child; change != NULL; change = change->next) {
+        size_t len;
+        const char* text = json_str(json_get(change, "text"), &len);
+        json_t* range = json_get(change, "range");
+        if(text == NULL)
+            continue;
+
+        size_t start = 0;
+        size_t end = doc->len;
+        if(range != NULL) {
+            start = to_offset(doc, json_int(json_path(range, "start.line"), 0),
+                                json_int(json_path(range, "start.character"), 0));
+            end = to_offset(doc, json_int(json_path(range, "end.line"), 0),
+                                json_int(json_path(range, "end.character"), 0));
+            if(end < start)
+                end = start;
+        }
+
+        edit_document(doc, start, end - start, text, len);
+        changed = 1;
+    }
+
+    if(changed)
+        publish_diagnostics(srv, file);
+}
+
+static void did_close(lsp_server_t* srv, json_t* params) {
+
+    lsp_file_t* file = file_param(srv, params);
+    if(file == NULL)
+        return;
+
+    // clear what the editor shows for it
+    clear_diags(file->doc->ctx->diags);
+    publish_diagnostics(srv, file);
+
+    close_document(file->doc);
+    *file = srv->files[--srv->nfiles];
+}
+
+/*
+ * The name under the position of a definition or hover request.
+ */
+static lsp_file_t* request_name(lsp_server_t* srv, json_t* params, name_at_t* name,
+                        size_t* offset) {
+
+    lsp_file_t* file = file_param(srv, params);
+    if(file == NULL)
+        return NULL;
+
+    *offset = to_offset(file->doc, json_int(json_path(params, "position.line"), 0),
+                        json_int(json_path(params, "position.character"), 0));
+    return name_at(file->doc, *offset, name)? file: NULL;
+}
+
+static void definition(lsp_server_t* srv, json_t* id, json_t* params) {
+
+    name_at_t name;
+    target_t target;
+    size_t offset;
+    lsp_file_t* file = request_name(srv, params, &name, &offset);
+
+    if(file == NULL || !resolve_name(file->doc, &name, offset, &target)) {
+        send_null(srv, id);
+        return;
+    }
+
+    char* buf;
+    size_t len;
+    FILE* fp = begin_result(id, &buf, &len);
+    fputs("{\"uri\":", fp);
+    write_json_str(fp, file->uri, strlen(file->uri));
+    fputs(",\"range\":", fp);
+    write_range(fp, file->doc, target.offset, word_end(file->doc, target.offset));
+    fputc('}', fp);
+    send_message(srv, fp, &buf, &len);
+}
+
+static const char* symbol_kind(symbol_data_t* data) {
+
+    if(data == NULL)
+        return "name";
+
+    switch(data->type) {
+        case ST_INUM: return "int";
+        case ST_UNUM: return "uint";
+        case ST_FNUM: return "float";
+        case ST_STRING: return "string";
+        case ST_BOOL: return "bool";
+        case ST_METHOD: return "method";
+        case ST_OBJECT:
+            if(data->value.obj != NULL && data->value.obj->type == OT_NAMESPACE)
+                return "namespace";
+            if(data->value.obj != NULL && data->value.obj->type == OT_STRUCT)
+                return "struct";
+            return "object";
+    }
+    return "name";
+}
+
+/*
+ * Hover shows the line of the declaration and what the symbol is.
+ */
+static void hover(lsp_server_t* srv, json_t* id, json_t* params) {
+
+    name_at_t name;
+    target_t target;
+    size_t offset;
+    lsp_file_t* file = request_name(srv, params, &name, &offset);
+
+    if(file == NULL || !resolve_name(file->doc, &name, offset, &target)) {
+        send_null(srv, id);
+        return;
+    }
+
+    document_t* doc = file->doc;
+    size_t bol = target.offset;
+    while(bol > 0 && doc->text[bol - 1] != '\n')
+        bol--;
+    while(bol < doc->len && (doc->text[bol] == ' ' || doc->text[bol] == '\t'))
+        bol++;
+    const char* nl = memchr(doc->text + bol, '\n', doc->len - bol);
+    size_t eol = (nl != NULL)? (size_t)(nl - doc->text): doc->len;
+    while(eol > bol && isspace((unsigned char)doc->text[eol - 1]))
+        eol--;
+
+    char* text;
+    size_t text_len;
+    FILE* md = open_memstream(&text, &text_len);
+    if(md == NULL)
+        fatal_error("cannot create a message buffer");
+    fputs("```nop\n", md);
+    fwrite(doc->text + bol, 1, eol - bol, md);
+    fputs("\n```\n", md);
+    if(target.sym != NULL) {
+        symbol_data_t* data = target.sym->value;
+        const char* kind = symbol_kind(data);
+        fprintf(md, "%s %s", kind, target.sym->name);
+        // name spaces and structs are always const
+        if(data != NULL && data->is_const && data->type != ST_OBJECT)
+            fputs(", const", md);
+        if(data != NULL && data->is_private)
+            fputs(", private", md);
+    }
+    else
+        fprintf(md, "local %s", name.names[0]);
+    fclose(md);
+
+    char* buf;
+    size_t len;
+    FILE* fp = begin_result(id, &buf, &len);
+    fputs("{\"contents\":{\"kind\":\"markdown\",\"value\":", fp);
+    write_json_str(fp, text, text_len);
+    fputs("},\"range\":", fp);
+    write_range(fp, doc, name.start, name.end);
+    fputc('}', fp);
+    send_message(srv, fp, &buf, &len);
+    free(text); // allocated by open_memstream()
+}
+
+static void handle(lsp_server_t* srv, json_t* msg) {
+
+    const char* method = json_str(json_get(msg, "method"), NULL);
+    json_t* id = json_get(msg, "id");
+    json_t* params = json_get(msg, "params");
+
+    if(method == NULL) {
+        // a response to something that the server never sends
+        if(id == NULL)
+            send_error(srv, NULL, RPC_INVALID_REQUEST, "no method");
+        return;
+    }
+
+    if(strcmp(method, "exit") == 0) {
+        srv->exit = 1;
+        return;
+    }
+    if(srv->shutdown && id != NULL) {
+        send_error(srv, id, RPC_INVALID_REQUEST, "the server is shutting down");
+        return;
+    }
+
+    if(strcmp(method, "initialize") == 0)
+        initialize(srv, id);
+    else if(strcmp(method, "shutdown") == 0) {
+        srv->shutdown = 1;
+        send_null(srv, id);
+    }
+    else if(strcmp(method, "textDocument/didOpen") == 0)
+        did_open(srv, params);
+    else if(strcmp(method, "textDocument/didChange") == 0)
+        did_change(srv, params);
+    else if(strcmp(method, "textDocument/didClose") == 0)
+        did_close(srv, params);
+    else if(strcmp(method, "textDocument/definition") == 0)
+        definition(srv, id, params);
+    else if(strcmp(method, "textDocument/hover") == 0)
+        hover(srv, id, params);
+    else if(id != NULL)
+        send_error(srv, id, RPC_NO_METHOD, method);
+    // other notifications are ignored, as the protocol allows
+}
+
+int serve_lsp(FILE* in, FILE* out) {
+
+    lsp_server_t srv;
+    char* body;
+    size_t len;
+
+    memset(&srv, 0, sizeof(srv));
+    srv.in = in;
+    srv.out = out;
+    srv.arena = create_arena(0);
+
+    while(!srv.exit && (body = read_message(&srv, &len)) != NULL) {
+        json_t* msg = parse_json(srv.arena, body, len);
+        if(msg == NULL)
+            send_error(&srv, NULL, RPC_PARSE_ERROR, "the message is not JSON");
+        else if(msg->type != JSON_OBJECT)
+            send_error(&srv, NULL, RPC_INVALID_REQUEST, "the message is not an object");
+        else
+            handle(&srv, msg);
+        reset_arena(srv.arena);
+    }
+
+    for(size_t i = 0; i < srv.nfiles; i++)
+        close_document(srv.files[i].doc);
+    if(srv.files != NULL)
+        FREE(srv.files);
+    if(srv.body != NULL)
+        FREE(srv.body);
+    destroy_arena(srv.arena);
+
+    return (srv.exit && srv.shutdown)? 0: 1;
+}
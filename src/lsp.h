@@ -0,0 +1,19 @@
+#ifndef __LSP_H__
+#define __LSP_H__
+
+#include <stdio.h>
+
+/*
+ * A language server that speaks LSP over the two streams, normally stdin and
+ * stdout, until it is told to exit. Every file that the editor opens is kept
+ * as a document with its AST and its symbols, and an edit parses only the
+ * top level items that it touched. Diagnostics are published after every
+ * change, and go to definition and hover are answered from the symbols and
+ * the AST that are already there.
+ *
+ * Returns the exit status, which is zero if the client asked for a shutdown
+ * before it asked to exit.
+ */
+int serve_lsp(FILE* in, FILE* out);
+
+#endif /* __LSP_H__ */
@@ -4,11 +4,33 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
+#include <stdint.h>
 
 #include "errors.h"
+#include "memory.h"
+
+/*
+ * Calls into the system allocator made through these routines. The counts
+ * are kept per thread so that they cost no more than an increment. The
+ * benchmarks use them to see how much a scan or a parse allocates.
+ */
+static _Thread_local alloc_stats_t stats;
+
+void get_alloc_stats(alloc_stats_t* st) {
+
+    *st = stats;
+}
+
+void reset_alloc_stats() {
+
+    memset(&stats, 0, sizeof(stats));
+}
 
 void* memory_alloc(size_t size) {
 
+    stats.allocs++;
+    stats.bytes += size;
     void* ptr = calloc(1, size); // memory is cleared by calloc().
     if(ptr == NULL) {
         fatal_error("cannot allocate %lu bytes", size);
@@ -20,6 +42,8 @@ void* memory_alloc(size_t size) {
 
 void* memory_realloc(void* ptr, size_t size) {
 
+    stats.reallocs++;
+    stats.bytes += size;
     void* nptr = realloc(ptr, size);
     if(nptr == NULL) {
         fatal_error("cannot re-allocate ptr %p with %lu bytes", ptr, size);
@@ -31,8 +55,10 @@ void* memory_realloc(void* ptr, size_t size) {
 
 void memory_free(void* ptr) {
 
-    if(ptr != NULL)
+    if(ptr != NULL) {
+        stats.frees++;
         free(ptr);
+    }
     else {
         fatal_error("cannot free NULL pointer");
         exit(1);
@@ -42,6 +68,8 @@ void memory_free(void* ptr) {
 char* memory_dupstr(const char* str) {
 
     size_t len = strlen(str) + 1;
+    stats.allocs++;
+    stats.bytes += len;
     char* buf = malloc(len);
     if(buf == NULL) {
         fatal_error("cannot allocate string of %lu bytes", len);
@@ -53,6 +81,8 @@ char* memory_dupstr(const char* str) {
 
 void* memory_dupdata(void* data, size_t size) {
 
+    stats.allocs++;
+    stats.bytes += size;
     void* ptr = malloc(size);
     if(ptr == NULL) {
         fatal_error("cannot duplicate %lu bytes", size);
@@ -61,3 +91,180 @@ void* memory_dupdata(void* data, size_t size) {
     memcpy(ptr, data, size);
     return ptr;
 }
+
+/*
+ * Arena allocator. Memory is handed out from large blocks by bumping a
+ * pointer and is only released when the whole arena is reset or destroyed.
+ * This is used for data that lives as long as a translation unit or a
+ * compiler phase, where the individual pieces are never freed one at a time.
+ *
+ * Blocks come from calloc() and are cleared again when the arena is reset,
+ * so arena memory is always zeroed, the same as memory_alloc().
+ */
+#define ARENA_BLOCK_SIZE    (0x01 << 16)
+#define ARENA_ALIGN         (_Alignof(max_align_t))
+#define ALIGN_UP(v, a)      (((v) + (a) - 1) & ~((uintptr_t)(a) - 1))
+
+struct _arena_block_t_ {
+    struct _arena_block_t_* next;
+    size_t size;
+    size_t used;
+    _Alignas(max_align_t) char data[];
+};
+
+static arena_block_t* create_arena_block(size_t size) {
+
+    arena_block_t* blk = memory_alloc(sizeof(arena_block_t) + size);
+    blk->size = size;
+    return blk;
+}
+
+/*
+ * Create an arena. If the block size is zero then a default is used.
+ */
+arena_t* create_arena(size_t block_size) {
+
+    arena_t* arena = memory_alloc(sizeof(arena_t));
+    arena->block_size = (block_size == 0)? ARENA_BLOCK_SIZE: block_size;
+    arena->head = create_arena_block(arena->block_size);
+    return arena;
+}
+
+/*
+ * Return the offset in the block where an allocation with the alignment
+ * would start.
+ */
+static size_t aligned_start(arena_block_t* blk, size_t align) {
+
+    uintptr_t base = (uintptr_t)blk->data;
+    return ALIGN_UP(base + blk->used, align) - base;
+}
+
+/*
+ * Allocate memory with the given alignment, which must be a power of 2.
+ * Requests that are large compared to the block size get a block of their
+ * own that is linked behind the current one, so the space left in the current
+ * block is not wasted.
+ */
+void* arena_alloc_aligned(arena_t* arena, size_t size, size_t align) {
+
+    arena_block_t* blk = arena->head;
+    size_t start = aligned_start(blk, align);
+
+    if(start + size > blk->size) {
+        if(size + align > arena->block_size / 4) {
+            arena_block_t* big = create_arena_block(size + align);
+            big->next = blk->next;
+            blk->next = big;
+            blk = big;
+        }
+        else {
+            blk = create_arena_block(arena->block_size);
+            blk->next = arena->head;
+            arena->head = blk;
+        }
+        start = aligned_start(blk, align);
+    }
+
+    blk->used = start + size;
+    arena->total += size;
+    return blk->data + start;
+}
+
+void* arena_alloc(arena_t* arena, size_t size) {
+
+    return arena_alloc_aligned(arena, size, ARENA_ALIGN);
+}
+
+char* arena_dupstr(arena_t* arena, const char* str) {
+
+    size_t len = strlen(str) + 1;
+    char* buf = arena_alloc_aligned(arena, len, 1);
+    memcpy(buf, str, len);
+    return buf;
+}
+
+void* arena_dupdata(arena_t* arena, void* data, size_t size) {
+
+    void* ptr = arena_alloc(arena, size);
+    memcpy(ptr, data, size);
+    return ptr;
+}
+
+/*
+ * Remember the current end of the arena so that it can be released back to
+ * this point later. Marks are released in the reverse of the order that they
+ * were taken, like a stack.
+ */
+arena_mark_t arena_mark(arena_t* arena) {
+
+    arena_mark_t mark;
+    mark.head = arena->head;
+    mark.next = arena->head->next;
+    mark.used = arena->head->used;
+    mark.total = arena->total;
+    return mark;
+}
+
+/*
+ * Release everything that was allocated after the mark was taken. Blocks
+ * that were added after the mark are freed, including large blocks that were
+ * linked in behind the marked block, and the part of the marked block that
+ * was used since is cleared again.
+ */
+void arena_release(arena_t* arena, arena_mark_t mark) {
+
+    arena_block_t* blk = arena->head;
+    while(blk != mark.head) {
+        arena_block_t* next = blk->next;
+        free(blk);
+        blk = next;
+    }
+
+    blk = mark.head->next;
+    while(blk != mark.next) {
+        arena_block_t* next = blk->next;
+        free(blk);
+        blk = next;
+    }
+
+    blk = mark.head;
+    memset(blk->data + mark.used, 0, blk->used - mark.used);
+    blk->used = mark.used;
+    blk->next = mark.next;
+    arena->head = blk;
+    arena->total = mark.total;
+}
+
+/*
+ * Release everything that was allocated from the arena, but keep one block
+ * so that the arena can be used again without going back to the system.
+ */
+void reset_arena(arena_t* arena) {
+
+    arena_block_t* blk = arena->head->next;
+    while(blk != NULL) {
+        arena_block_t* next = blk->next;
+        free(blk);
+        blk = next;
+    }
+
+    blk = arena->head;
+    memset(blk->data, 0, blk->used);
+    blk->used = 0;
+    blk->next = NULL;
+    arena->total = 0;
+}
+
+void destroy_arena(arena_t* arena) {
+
+    if(arena != NULL) {
+        arena_block_t* blk = arena->head;
+        while(blk != NULL) {
+            arena_block_t* next = blk->next;
+            free(blk);
+            blk = next;
+        }
+        free(arena);
+    }
+}
@@ -1,6 +1,8 @@
 #ifndef __MEMORY_H__
 #define __MEMORY_H__
 
+#include <stddef.h>
+
 #define ALLOC(s)        memory_alloc(s)
 #define ALLOC_DS(t)     memory_alloc(sizeof(t))
 #define ALLOC_LST(n,t)  memory_alloc((n)*sizeof(t))
@@ -17,5 +19,57 @@ char* memory_dupstr(const char* str);
 void* memory_dupdata(void* data, size_t size);
 void memory_free(void* ptr);
 
+/*
+ * What the calling thread has asked of the system allocator. Arena blocks
+ * are counted when they are allocated; releasing them is not counted.
+ */
+typedef struct {
+    size_t allocs;          // including strings and copies
+    size_t reallocs;
+    size_t frees;
+    size_t bytes;           // requested by allocs and reallocs
+} alloc_stats_t;
+
+void get_alloc_stats(alloc_stats_t* st);
+void reset_alloc_stats();
+
+/*
+ * Arena allocation for data that is released all at once. These are opt-in;
+ * the macros above still go to the system allocator.
+ */
+typedef struct _arena_block_t_ arena_block_t;
+
+typedef struct {
+    arena_block_t* head;    // current block
+    size_t block_size;
+    size_t total;           // bytes handed out since the last reset
+} arena_t;
+
+/*
+ * A point in an arena that it can be released back to. Everything that was
+ * allocated after the mark was taken is released; what came before is kept.
+ */
+typedef struct {
+    arena_block_t* head;
+    arena_block_t* next;
+    size_t used;
+    size_t total;
+} arena_mark_t;
+
+#define ARENA_ALLOC(a,s)        arena_alloc((a), (s))
+#define ARENA_ALLOC_DS(a,t)     arena_alloc((a), sizeof(t))
+#define ARENA_ALLOC_LST(a,n,t)  arena_alloc((a), (n)*sizeof(t))
+#define ARENA_DUPSTR(a,s)       arena_dupstr((a), (s))
+#define ARENA_DUP_DS(a,p,t)     arena_dupdata((a), (p), sizeof(t))
+
+arena_t* create_arena(size_t block_size);
+void* arena_alloc(arena_t* arena, size_t size);
+void* arena_alloc_aligned(arena_t* arena, size_t size, size_t align);
+char* arena_dupstr(arena_t* arena, const char* str);
+void* arena_dupdata(arena_t* arena, void* data, size_t size);
+arena_mark_t arena_mark(arena_t* arena);
+void arena_release(arena_t* arena, arena_mark_t mark);
+void reset_arena(arena_t* arena);
+void destroy_arena(arena_t* arena);
 
 #endif
@@ -0,0 +1,569 @@
+/*
+ * The compiled module cache.
+ *
+ * A cache file is laid out so that it can be used where it is mapped. All
+ * references are byte offsets from the start of the file and every section
+ * starts on an 8 byte boundary:
+ *
+ *   header
+ *   functions      cache_func_t[nfuncs]
+ *   constants      cache_const_t[nconsts]
+ *   globals        one value type per name space variable
+ *   layouts        cache_layout_t[nlayouts]
+ *   fields         cache_field_t[nfields], of all the layouts in order
+ *   dispatch       uint32_t[ndispatch], the sets of overloads for CALLD
+ *   formats        cache_format_t[nformats], the plans for FMT
+ *   segments       fmt_seg_t[nsegs], of all the plans in order
+ *   code           instr_t[ncode] then code_loc_t[ncode], per function
+ *   strings        names and string constants, each one a str_t
+ *
+ * The strings are the module's interned strings, stored once each. Each one
+ * has the header of a string value, with its length and hash, followed by
+ * the text and a NUL and padded to 8 bytes, and the offsets are those of
+ * the text. A string constant is then a value where it is mapped. The
+ * values are in the byte order of the machine that wrote the file, and a
+ * file from a machine with the other order is not used.
+ *
+ * The file is written under a temporary name and renamed, so a reader never
+ * sees half of one. Nothing but nop writes these files, so past the checks
+ * of the header and the tables the content is trusted, the same as the
+ * compiler that made it.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "memory.h"
+#include "intern.h"
+#include "modcache.h"
+
+#define CACHE_MAGIC     "NOPM"
+#define BYTE_ORDER_MARK 0x01020304u
+#define ALIGN8(n)       (((n) + 7) & ~(uint64_t)7)
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t byte_order;
+    uint16_t nopcodes;
+    uint16_t instr_size;
+    uint64_t source_hash;
+    uint64_t source_size;
+    uint64_t file_size;
+    int32_t entry;
+    int32_t init;
+    uint32_t nfuncs;
+    uint32_t nconsts;
+    uint32_t nglobals;
+    uint32_t strings_len;
+    uint32_t nlayouts;
+    uint32_t nfields;
+    uint32_t ndispatch;
+    uint32_t nformats;
+    uint32_t nsegs;
+    uint32_t pad;
+    uint64_t funcs;         // offsets of the sections
+    uint64_t consts;
+    uint64_t globals;
+    uint64_t layouts;
+    uint64_t fields;
+    uint64_t dispatch;
+    uint64_t formats;
+    uint64_t segs;
+    uint64_t strings;
+} cache_header_t;
+
+typedef struct {
+    uint32_t name;          // offset in the strings
+    uint32_t ncode;
+    uint32_t nparams;
+    uint32_t nregs;
+    uint64_t code;
+    uint64_t locs;
+} cache_func_t;
+
+typedef struct {
+    uint8_t type;
+    uint8_t pad[7];
+    uint64_t bits;          // the value, or the offset of a string
+} cache_const_t;
+
+typedef struct {
+    uint32_t name;
+    uint32_t first;         // index of its first field
+    uint32_t nfields;
+    uint32_t size;
+    uint32_t align;
+    uint32_t pad;
+} cache_layout_t;
+
+typedef struct {
+    uint32_t text;
+    uint32_t first;         // index of its first segment
+    uint32_t nsegs;
+    uint32_t literal_len;
+    int32_t max_arg;
+    uint32_t pad;
+} cache_format_t;
+
+typedef struct {
+    uint32_t name;
+    uint32_t offset;
+    uint8_t type;
+    uint8_t size;
+    uint8_t pad[6];
+} cache_field_t;
+
+/*
+ * The strings of a module while it is written, each one once.
+ */
+typedef struct {
+    char* buf;
+    size_t len;
+    size_t cap;
+    uint32_t* slots;        // offset of the text + 1, zero if the slot is empty
+    size_t nslots;
+    size_t count;
+} strtab_t;
+
+/*
+ * FNV-1a with 64 bits, taken a word at a time instead of a byte at a time.
+ * Checking a warm cache reads the whole source, so this is most of the
+ * time that it takes. The 32 bit hash of the string pool is too narrow for
+ * telling whole files apart.
+ */
+static uint64_t hash_bytes(const unsigned char* data, size_t len) {
+
+    uint64_t hash = 14695981039346656037ULL;
+    uint64_t word;
+    size_t i = 0;
+
+    for(; i + sizeof(word) <= len; i += sizeof(word)) {
+        memcpy(&word, data + i, sizeof(word));
+        hash ^= word;
+        hash *= 1099511628211ULL;
+        hash ^= hash >> 32;
+    }
+    for(; i < len; i++) {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+int identify_source(const char* fname, source_id_t* id) {
+
+    int fd = open(fname, O_RDONLY);
+    if(fd < 0)
+        return 0;
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return 0;
+    }
+
+    id->size = (uint64_t)st.st_size;
+    if(st.st_size == 0) {
+        id->hash = hash_bytes(NULL, 0);
+        close(fd);
+        return 1;
+    }
+
+    void* base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(base == MAP_FAILED)
+        return 0;
+    madvise(base, st.st_size, MADV_SEQUENTIAL);
+    id->hash = hash_bytes(base, st.st_size);
+    munmap(base, st.st_size);
+    return 1;
+}
+
+const char* cache_path(const char* fname, char* buf, size_t len) {
+
+    snprintf(buf, len, "%sc", fname);
+    return buf;
+}
+
+static uint32_t add_string(strtab_t* tab, const char* str, size_t len) {
+
+    unsigned int hash = hash_str(str, len);
+
+    if(tab->count * 2 >= tab->nslots) {
+        size_t nslots = (tab->nslots == 0)? 64: tab->nslots << 1;
+        uint32_t* slots = ALLOC_LST(nslots, uint32_t);
+        for(size_t i = 0; i < tab->nslots; i++) {
+            if(tab->slots[i] == 0)
+                continue;
+            size_t h = STR_OF(tab->buf + tab->slots[i] - 1)->hash;
+            while(slots[h & (nslots - 1)] != 0)
+                h++;
+            slots[h & (nslots - 1)] = tab->slots[i];
+        }
+        if(tab->slots != NULL)
+            FREE(tab->slots);
+        tab->slots = slots;
+        tab->nslots = nslots;
+    }
+
+    for(size_t h = hash;; h++) {
+        uint32_t* slot = &tab->slots[h & (tab->nslots - 1)];
+        if(*slot == 0) {
+            size_t size = ALIGN8(sizeof(str_t) + len + 1);
+            if(tab->len + size > tab->cap) {
+                while(tab->len + size > tab->cap)
+                    tab->cap = (tab->cap == 0)? 1024: tab->cap << 1;
+                tab->buf = REALLOC(tab->buf, tab->cap);
+            }
+            str_t* s = (str_t*)(tab->buf + tab->len);
+            memset(s, 0, size);
+            s->hash = hash;
+            s->len = (uint32_t)len;
+            s->flags = STR_HASHED;
+            memcpy(STR_CHARS(s), str, len);
+            *slot = (uint32_t)(tab->len + sizeof(str_t)) + 1;
+            tab->len += size;
+            tab->count++;
+            return *slot - 1;
+        }
+        const str_t* s = STR_OF(tab->buf + *slot - 1);
+        if(s->hash == hash && s->len == len && memcmp(STR_CHARS(s), str, len) == 0)
+            return *slot - 1;
+    }
+}
+
+/*
+ * Build the image of the file in memory and write it in one go.
+ */
+int save_cached_module(module_t* mod, const char* fname, const source_id_t* id) {
+
+    strtab_t tab;
+    memset(&tab, 0, sizeof(tab));
+
+    uint32_t* names = ALLOC_LST(mod->nfuncs + 1, uint32_t);
+    for(int i = 0; i < mod->nfuncs; i++)
+        names[i] = add_string(&tab, mod->funcs[i].name, strlen(mod->funcs[i].name));
+    uint32_t* strs = ALLOC_LST(mod->nconsts + 1, uint32_t);
+    for(int i = 0; i < mod->nconsts; i++)
+        if(IS_STRING(mod->consts[i]))
+            strs[i] = add_string(&tab, AS_STRING(mod->consts[i]), AS_STR(mod->consts[i])->len);
+    // the names of the layouts, then the names of all of their fields
+    uint32_t nfields = 0;
+    for(int i = 0; i < mod->nlayouts; i++)
+        nfields += mod->layouts[i].nfields;
+    uint32_t* lnames = ALLOC_LST(mod->nlayouts + nfields + 1, uint32_t);
+    for(int i = 0, k = mod->nlayouts; i < mod->nlayouts; i++) {
+        lnames[i] = add_string(&tab, mod->layouts[i].name, strlen(mod->layouts[i].name));
+        for(int j = 0; j < mod->layouts[i].nfields; j++)
+            lnames[k++] = add_string(&tab, mod->layouts[i].fields[j].name,
+                                strlen(mod->layouts[i].fields[j].name));
+    }
+    uint32_t nsegs = 0;
+    uint32_t* ftexts = ALLOC_LST(mod->nformats + 1, uint32_t);
+    for(int i = 0; i < mod->nformats; i++) {
+        ftexts[i] = add_string(&tab, mod->formats[i]->text, strlen(mod->formats[i]->text));
+        nsegs += mod->formats[i]->nsegs;
+    }
+
+    cache_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, CACHE_MAGIC, sizeof(hdr.magic));
+    hdr.version = MODCACHE_VERSION;
+    hdr.byte_order = BYTE_ORDER_MARK;
+    hdr.nopcodes = OP_NUM_CODES;
+    hdr.instr_size = sizeof(instr_t);
+    hdr.source_hash = id->hash;
+    hdr.source_size = id->size;
+    hdr.entry = mod->entry;
+    hdr.init = mod->init;
+    hdr.nfuncs = mod->nfuncs;
+    hdr.nconsts = mod->nconsts;
+    hdr.nglobals = mod->nglobals;
+    hdr.strings_len = (uint32_t)tab.len;
+    hdr.nlayouts = mod->nlayouts;
+    hdr.nfields = nfields;
+    hdr.ndispatch = mod->ndispatch;
+    hdr.nformats = mod->nformats;
+    hdr.nsegs = nsegs;
+
+    uint64_t off = ALIGN8(sizeof(hdr));
+    hdr.funcs = off;
+    off += ALIGN8(mod->nfuncs * sizeof(cache_func_t));
+    hdr.consts = off;
+    off += ALIGN8(mod->nconsts * sizeof(cache_const_t));
+    hdr.globals = off;
+    off += ALIGN8(mod->nglobals);
+    hdr.layouts = off;
+    off += ALIGN8(mod->nlayouts * sizeof(cache_layout_t));
+    hdr.fields = off;
+    off += ALIGN8(nfields * sizeof(cache_field_t));
+    hdr.dispatch = off;
+    off += ALIGN8(mod->ndispatch * sizeof(uint32_t));
+    hdr.formats = off;
+    off += ALIGN8(mod->nformats * sizeof(cache_format_t));
+    hdr.segs = off;
+    off += ALIGN8(nsegs * sizeof(fmt_seg_t));
+    uint64_t code = off;
+    for(int i = 0; i < mod->nfuncs; i++)
+        off += ALIGN8(mod->funcs[i].ncode * sizeof(instr_t)) +
+                    ALIGN8(mod->funcs[i].ncode * sizeof(code_loc_t));
+    hdr.strings = off;
+    off += ALIGN8(tab.len);
+    hdr.file_size = off;
+
+    char* image = ALLOC(hdr.file_size);
+    memcpy(image, &hdr, sizeof(hdr));
+
+    cache_func_t* funcs = (cache_func_t*)(image + hdr.funcs);
+    for(int i = 0; i < mod->nfuncs; i++) {
+        func_t* fn = &mod->funcs[i];
+        size_t len = fn->ncode * sizeof(instr_t);
+        funcs[i].name = names[i];
+        funcs[i].ncode = fn->ncode;
+        funcs[i].nparams = fn->nparams;
+        funcs[i].nregs = fn->nregs;
+        funcs[i].code = code;
+        memcpy(image + code, fn->code, len);
+        code += ALIGN8(len);
+        len = fn->ncode * sizeof(code_loc_t);
+        funcs[i].locs = code;
+        memcpy(image + code, fn->locs, len);
+        code += ALIGN8(len);
+    }
+
+    cache_const_t* consts = (cache_const_t*)(image + hdr.consts);
+    for(int i = 0; i < mod->nconsts; i++) {
+        value_t val = mod->consts[i];
+        consts[i].type = VAL_TYPE(val);
+        consts[i].bits = IS_STRING(val)? strs[i]: value_bits(val);
+    }
+
+    memcpy(image + hdr.globals, mod->global_types, mod->nglobals);
+
+    cache_layout_t* layouts = (cache_layout_t*)(image + hdr.layouts);
+    cache_field_t* fields = (cache_field_t*)(image + hdr.fields);
+    for(int i = 0, k = 0; i < mod->nlayouts; i++) {
+        const struct_layout_t* lay = &mod->layouts[i];
+        layouts[i].name = lnames[i];
+        layouts[i].first = k;
+        layouts[i].nfields = lay->nfields;
+        layouts[i].size = lay->size;
+        layouts[i].align = lay->align;
+        for(int j = 0; j < lay->nfields; j++, k++) {
+            fields[k].name = lnames[mod->nlayouts + k];
+            fields[k].offset = lay->fields[j].offset;
+            fields[k].type = lay->fields[j].type;
+            fields[k].size = lay->fields[j].size;
+        }
+    }
+    memcpy(image + hdr.dispatch, mod->dispatch, mod->ndispatch * sizeof(uint32_t));
+
+    cache_format_t* formats = (cache_format_t*)(image + hdr.formats);
+    fmt_seg_t* segs = (fmt_seg_t*)(image + hdr.segs);
+    for(int i = 0, k = 0; i < mod->nformats; i++) {
+        const fmt_plan_t* plan = mod->formats[i];
+        formats[i].text = ftexts[i];
+        formats[i].first = k;
+        formats[i].nsegs = plan->nsegs;
+        formats[i].literal_len = plan->literal_len;
+        formats[i].max_arg = plan->max_arg;
+        memcpy(&segs[k], plan->segs, plan->nsegs * sizeof(fmt_seg_t));
+        k += plan->nsegs;
+    }
+    memcpy(image + hdr.strings, tab.buf, tab.len);
+
+    char path[1024], tmp[1100];
+    cache_path(fname, path, sizeof(path));
+    snprintf(tmp, sizeof(tmp), "%s.%ld", path, (long)getpid());
+
+    int ok = 0;
+    FILE* fp = fopen(tmp, "wb");
+    if(fp != NULL) {
+        ok = fwrite(image, 1, hdr.file_size, fp) == hdr.file_size;
+        ok = (fclose(fp) == 0) && ok;
+        if(ok)
+            ok = rename(tmp, path) == 0;
+        if(!ok)
+            unlink(tmp);
+    }
+
+    FREE(image);
+    FREE(ftexts);
+    FREE(lnames);
+    FREE(strs);
+    FREE(names);
+    if(tab.buf != NULL)
+        FREE(tab.buf);
+    if(tab.slots != NULL)
+        FREE(tab.slots);
+    return ok;
+}
+
+// true if the section lies inside the file
+static int in_file(const cache_header_t* hdr, uint64_t off, uint64_t count, size_t size) {
+
+    return off <= hdr->file_size && (off & 7) == 0 &&
+                count <= (hdr->file_size - off) / size;
+}
+
+static int check_header(const cache_header_t* hdr, size_t len, const source_id_t* id) {
+
+    if(len < sizeof(cache_header_t) ||
+                memcmp(hdr->magic, CACHE_MAGIC, sizeof(hdr->magic)) != 0 ||
+                hdr->version != MODCACHE_VERSION ||
+                hdr->byte_order != BYTE_ORDER_MARK ||
+                hdr->nopcodes != OP_NUM_CODES ||
+                hdr->instr_size != sizeof(instr_t) ||
+                hdr->file_size != len)
+        return 0;
+
+    if(hdr->source_hash != id->hash || hdr->source_size != id->size)
+        return 0;
+
+    if(!in_file(hdr, hdr->funcs, hdr->nfuncs, sizeof(cache_func_t)) ||
+                !in_file(hdr, hdr->consts, hdr->nconsts, sizeof(cache_const_t)) ||
+                !in_file(hdr, hdr->globals, hdr->nglobals, 1) ||
+                !in_file(hdr, hdr->layouts, hdr->nlayouts, sizeof(cache_layout_t)) ||
+                !in_file(hdr, hdr->fields, hdr->nfields, sizeof(cache_field_t)) ||
+                !in_file(hdr, hdr->dispatch, hdr->ndispatch, sizeof(uint32_t)) ||
+                !in_file(hdr, hdr->formats, hdr->nformats, sizeof(cache_format_t)) ||
+                !in_file(hdr, hdr->segs, hdr->nsegs, sizeof(fmt_seg_t)) ||
+                !in_file(hdr, hdr->strings, hdr->strings_len, 1))
+        return 0;
+
+    if(hdr->nfuncs == 0 || hdr->init < 0 || (uint32_t)hdr->init >= hdr->nfuncs ||
+                hdr->entry >= (int32_t)hdr->nfuncs)
+        return 0;
+
+    const char* strings = (const char*)hdr + hdr->strings;
+    return hdr->strings_len > 0 && strings[hdr->strings_len - 1] == '\0';
+}
+
+module_t* load_cached_module(const char* fname, const source_id_t* id) {
+
+    char path[1024];
+    int fd = open(cache_path(fname, path, sizeof(path)), O_RDONLY);
+    if(fd < 0)
+        return NULL;
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(cache_header_t)) {
+        close(fd);
+        return NULL;
+    }
+
+    char* base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(base == MAP_FAILED)
+        return NULL;
+
+    const cache_header_t* hdr = (const cache_header_t*)base;
+    if(!check_header(hdr, st.st_size, id)) {
+        munmap(base, st.st_size);
+        return NULL;
+    }
+
+    const char* strings = base + hdr->strings;
+    const cache_func_t* funcs = (const cache_func_t*)(base + hdr->funcs);
+    const cache_const_t* consts = (const cache_const_t*)(base + hdr->consts);
+    const cache_layout_t* layouts = (const cache_layout_t*)(base + hdr->layouts);
+    const cache_field_t* fields = (const cache_field_t*)(base + hdr->fields);
+    const cache_format_t* formats = (const cache_format_t*)(base + hdr->formats);
+    const fmt_seg_t* segs = (const fmt_seg_t*)(base + hdr->segs);
+
+    module_t* mod = ALLOC_DS(module_t);
+    mod->map = base;
+    mod->map_len = st.st_size;
+    mod->nfuncs = hdr->nfuncs;
+    mod->entry = hdr->entry;
+    mod->init = hdr->init;
+    mod->nglobals = hdr->nglobals;
+    mod->global_types = (uint8_t*)(base + hdr->globals);
+    mod->dispatch = (uint32_t*)(base + hdr->dispatch);
+    mod->ndispatch = hdr->ndispatch;
+    mod->funcs = ALLOC_LST(mod->nfuncs, func_t);
+    mod->nconsts = hdr->nconsts;
+    mod->consts = ALLOC_LST(mod->nconsts + 1, value_t);
+
+    for(int i = 0; i < mod->nfuncs; i++) {
+        func_t* fn = &mod->funcs[i];
+        if(funcs[i].name >= hdr->strings_len ||
+                    !in_file(hdr, funcs[i].code, funcs[i].ncode, sizeof(instr_t)) ||
+                    !in_file(hdr, funcs[i].locs, funcs[i].ncode, sizeof(code_loc_t)))
+            goto bad;
+        fn->name = strings + funcs[i].name;
+        fn->code = (instr_t*)(base + funcs[i].code);
+        fn->locs = (code_loc_t*)(base + funcs[i].locs);
+        fn->ncode = funcs[i].ncode;
+        fn->nparams = funcs[i].nparams;
+        fn->nregs = funcs[i].nregs;
+    }
+
+    // the ints that do not fit in a value are boxed in the module
+    mod->arena = create_arena(0);
+    for(int i = 0; i < mod->nconsts; i++) {
+        value_t* val = &mod->consts[i];
+        if(consts[i].type == VAL_STRING) {
+            if(consts[i].bits < sizeof(str_t) || consts[i].bits >= hdr->strings_len ||
+                        (consts[i].bits & 7) != 0)
+                goto bad;
+            *val = STRING_VAL(STR_OF(strings + consts[i].bits));
+        }
+        else if(consts[i].type < VAL_NUM_TYPES) {
+            arena_t* boxes = set_box_arena(mod->arena);
+            *val = value_from_bits(consts[i].type, consts[i].bits);
+            set_box_arena(boxes);
+        }
+        else
+            goto bad;
+    }
+
+    // the layouts are only read, so the names stay in the mapping
+    mod->nlayouts = hdr->nlayouts;
+    mod->layouts = ALLOC_LST(mod->nlayouts + 1, struct_layout_t);
+    for(int i = 0; i < mod->nlayouts; i++) {
+        struct_layout_t* lay = &mod->layouts[i];
+        if(layouts[i].name >= hdr->strings_len || layouts[i].first > hdr->nfields ||
+                    layouts[i].nfields > hdr->nfields - layouts[i].first)
+            goto bad;
+        lay->name = strings + layouts[i].name;
+        lay->size = layouts[i].size;
+        lay->align = layouts[i].align;
+        lay->nfields = layouts[i].nfields;
+        lay->fields = ALLOC_LST(lay->nfields + 1, field_t);
+        for(int j = 0; j < lay->nfields; j++) {
+            const cache_field_t* f = &fields[layouts[i].first + j];
+            if(f->name >= hdr->strings_len)
+                goto bad;
+            lay->fields[j].name = strings + f->name;
+            lay->fields[j].offset = f->offset;
+            lay->fields[j].type = f->type;
+            lay->fields[j].size = f->size;
+        }
+    }
+
+    // the plans are copied out, with the text of the format in the mapping
+    mod->nformats = hdr->nformats;
+    mod->formats = ALLOC_LST(mod->nformats + 1, fmt_plan_t*);
+    for(int i = 0; i < mod->nformats; i++) {
+        const cache_format_t* f = &formats[i];
+        if(f->text >= hdr->strings_len || f->first > hdr->nsegs || f->nsegs > hdr->nsegs - f->first)
+            goto bad;
+        fmt_plan_t* plan = mod->formats[i] = ALLOC(FORMAT_PLAN_SIZE(f->nsegs));
+        plan->text = strings + f->text;
+        plan->literal_len = f->literal_len;
+        plan->max_arg = f->max_arg;
+        plan->nsegs = f->nsegs;
+        memcpy(plan->segs, &segs[f->first], f->nsegs * sizeof(fmt_seg_t));
+    }
+    return mod;
+
+bad:
+    destroy_module(mod);
+    return NULL;
+}
@@ -0,0 +1,36 @@
+#ifndef __MODCACHE_H__
+#define __MODCACHE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "bytecode.h"
+
+/*
+ * The compiled module of a source file can be kept in a cache file next to
+ * it, the name of the source with a "c" added. The cache is used in place
+ * of parsing and compiling the file when the source is the same as when it
+ * was written, decided by the length and a hash of the content, and it was
+ * written by the same version of the compiler.
+ *
+ * The file is mapped and the code is run from the mapping as it is; only
+ * the tables of functions and constants are turned into pointers.
+ */
+#define MODCACHE_VERSION    7
+
+typedef struct {
+    uint64_t hash;
+    uint64_t size;
+} source_id_t;
+
+// zero if the source cannot be read
+int identify_source(const char* fname, source_id_t* id);
+
+const char* cache_path(const char* fname, char* buf, size_t len);
+
+// NULL if there is no cache or it does not match the source
+module_t* load_cached_module(const char* fname, const source_id_t* id);
+
+// zero if the cache cannot be written, which is not an error
+int save_cached_module(module_t* mod, const char* fname, const source_id_t* id);
+
+#endif
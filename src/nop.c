@@ -1,38 +1,295 @@
 /*
  * This is the main function for the parser. It is intended to be used as a
  * platform for testing the parser.
+ *
+ * nop [-j jobs] [-v level] [-r] [-b] [-d] [-l] [-c] [-i] [-f format] [-e limit] file...
+ * nop -s
+ *
+ * With -r the entry block of each file is run after all of them are parsed.
+ * A file with errors is not run. With -b it is compiled to bytecode and run
+ * by the VM instead of the tree walking interpreter, and -d prints the
+ * bytecode. With -c as well, the bytecode is kept in a cache file next to
+ * the source and a file that has not changed since is not parsed again.
+ * With -l the layout of every struct is printed, with its size and padding
+ * and the offset of every field.
+ *
+ * With -i the files that are imported are parsed as well, each one once
+ * however many files import it, and the output of each one is printed
+ * before the output of the files that import it. The cache is not used.
+ *
+ * The diagnostics of each file are printed after it is parsed, as text or,
+ * with -f json, as one JSON object per line. A file stops being parsed when
+ * it has as many errors as the limit, 1000 unless -e sets it, or 0 for no
+ * limit.
+ *
+ * With -s it is a language server that speaks LSP on stdin and stdout, and
+ * it takes no files; the editor sends them.
+ *
+ * The older form, nop file [level], is still accepted.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <errno.h>
+#include <unistd.h>
 
 #include "parser.h"
 #include "scanner.h"
 #include "errors.h"
+#include "symbols.h"
+#include "intern.h"
+#include "memory.h"
+#include "context.h"
+#include "driver.h"
+#include "ast.h"
+#include "interp.h"
+#include "resolve.h"
+#include "bytecode.h"
+#include "vm.h"
+#include "modcache.h"
+#include "lsp.h"
+#include "imports.h"
 
-extern FILE* yyin; // defined in scanner.c, generated file
 int verbosity = 0;
 
+static void usage(const char* name) {
+
+    fprintf(stderr, "%s [-j jobs] [-v level] [-r] [-b] [-d] [-l] [-c] [-i] [-f text|json] [-e limit] inputfile...\n", name);
+    fprintf(stderr, "%s -s\n", name);
+    fprintf(stderr, "%s inputfile [verbosity]\n", name);
+    exit(1);
+}
+
+static int is_number(const char* str) {
+
+    if(*str == '\0')
+        return 0;
+    for(; *str != '\0'; str++)
+        if(!isdigit((unsigned char)*str))
+            return 0;
+    return 1;
+}
+
+/*
+ * Print the struct layouts and the bytecode if they were asked for and run
+ * it if it was asked for.
+ */
+static int run_compiled(module_t* mod, int run, int dump, int layouts) {
+
+    if(layouts)
+        dump_layouts(mod->layouts, mod->nlayouts, stdout);
+    if(dump)
+        dump_module(mod, stdout);
+    return run? run_module(mod, stdout, NULL): 0;
+}
+
+/*
+ * Compile the file and do what was asked with it. The module is written to
+ * the cache if the source is identified.
+ */
+static int compile_file(parse_ctx_t* ctx, int run, int dump, int layouts,
+                        const source_id_t* id) {
+
+    program_t* prog = resolve_program(ctx->ast);
+    module_t* mod = compile_program(prog);
+
+    if(id != NULL && !save_cached_module(mod, ctx->fname, id) && verbosity >= 1)
+        printf("%s: cannot write the module cache\n", ctx->fname);
+    int status = run_compiled(mod, run, dump, layouts);
+
+    destroy_module(mod);
+    destroy_program(prog);
+    return status;
+}
+
+// the layouts of a file that is not compiled
+static void print_layouts(ast_t* ast) {
+
+    int count;
+    struct_layout_t* layouts = create_layouts(ast, &count);
+    dump_layouts(layouts, count, stdout);
+    destroy_layouts(layouts, count);
+}
+
 int main(int argc, char** argv) {
 
-    if(argc < 2) {
-        fprintf(stderr, "%s inputfile [verbosity]\n", argv[0]);
-        return 1;
+    int jobs = 1;
+    int run = 0;
+    int bytecode = 0;
+    int dump = 0;
+    int layouts = 0;
+    int cache = 0;
+    int serve = 0;
+    int imports = 0;
+    int status = 0;
+    int opt;
+
+    while((opt = getopt(argc, argv, "j:v:rbdlcsif:e:")) != -1) {
+        switch(opt) {
+            case 'j':
+                jobs = (int)strtol(optarg, NULL, 10);
+                if(jobs <= 0) {
+                    jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+                    if(jobs <= 0)
+                        jobs = 1;
+                }
+                break;
+            case 'v':
+                verbosity = (int)strtol(optarg, NULL, 10);
+                break;
+            case 'r':
+                run = 1;
+                break;
+            case 'b':
+                run = 1;
+                bytecode = 1;
+                break;
+            case 'd':
+                dump = 1;
+                break;
+            case 'l':
+                layouts = 1;
+                break;
+            case 'c':
+                cache = 1;
+                break;
+            case 's':
+                serve = 1;
+                break;
+            case 'i':
+                imports = 1;
+                break;
+            case 'f':
+                if(strcmp(optarg, "json") == 0)
+                    set_diag_format(DIAG_JSON);
+                else if(strcmp(optarg, "text") != 0)
+                    usage(argv[0]);
+                break;
+            case 'e':
+                if(!is_number(optarg))
+                    usage(argv[0]);
+                set_diag_limit((size_t)strtol(optarg, NULL, 10));
+                break;
+            default:
+                usage(argv[0]);
+        }
     }
-    else if(argc >= 3) {
-        verbosity = (int)strtol(argv[2], NULL, 10);
-        if(verbosity >= 5)
-            yydebug = 1;
+
+    if(serve) {
+        if(optind != argc)
+            usage(argv[0]);
+        status = serve_lsp(stdin, stdout);
+        destroy_symbols();
+        destroy_intern_pool();
+        return status;
     }
-    else {
-        yydebug = 0;
+
+    int nfiles = argc - optind;
+    if(nfiles < 1)
+        usage(argv[0]);
+    else if(nfiles == 2 && is_number(argv[optind + 1])) {
+        // legacy form: nop file level
+        verbosity = (int)strtol(argv[optind + 1], NULL, 10);
+        nfiles = 1;
+    }
+
+    // the parser trace is not useful with the output of several files mixed
+    yydebug = (verbosity >= 5 && jobs == 1)? 1: 0;
+
+    // the cache only holds bytecode, and not what a file imports
+    cache = cache && (bytecode || dump) && !imports;
+
+    /*
+     * A file that is in the cache is not parsed. The others are parsed
+     * together, so that they can use more than one thread.
+     */
+    parse_ctx_t** ctxs = ALLOC_LST(nfiles, parse_ctx_t*);
+    parse_ctx_t** todo = ALLOC_LST(nfiles, parse_ctx_t*);
+    module_t** cached = ALLOC_LST(nfiles, module_t*);
+    source_id_t* ids = ALLOC_LST(nfiles, source_id_t);
+    int* known = ALLOC_LST(nfiles, int);
+    int nparse = 0;
+
+    // with imports the graph makes the contexts of the files
+    for(int i = 0; i < nfiles && !imports; i++) {
+        const char* fname = argv[optind + i];
+        if(cache && (known[i] = identify_source(fname, &ids[i])) != 0)
+            cached[i] = load_cached_module(fname, &ids[i]);
+        if(cached[i] == NULL)
+            todo[nparse++] = ctxs[i] = create_context(fname);
+    }
+
+    import_graph_t* graph = NULL;
+    if(imports) {
+        graph = load_imports((const char**)&argv[optind], nfiles, jobs);
+        for(int i = 0; i < nfiles; i++)
+            ctxs[i] = graph->roots[i]->ctx;
+
+        // what the files import comes first, in the order that it is needed
+        for(size_t i = 0; i < graph->count; i++) {
+            import_unit_t* unit = graph->units[i];
+            if(unit->root)
+                continue;
+            flush_context_output(unit->ctx, stdout);
+            if(verbosity >= 1)
+                printf("import: %s\n", unit->path);
+            if(unit->ctx->errors != 0)
+                status = 1;
+        }
+    }
+    else
+        parse_all(todo, nparse, jobs);
+
+    for(int i = 0; i < nfiles; i++) {
+        if(cached[i] != NULL) {
+            if(verbosity >= 1)
+                printf("%s: from the module cache\n", argv[optind + i]);
+            status |= run_compiled(cached[i], run, dump, layouts);
+            destroy_module(cached[i]);
+            continue;
+        }
+
+        flush_context_output(ctxs[i], stdout);
+        if(ctxs[i]->unreadable)
+            status = 1;
+        if(nfiles > 1 && verbosity >= 1)
+            printf("file: %s\n", ctxs[i]->fname);
+        if(verbosity >= 2)
+            dump_ast(ctxs[i]->ast, ctxs[i]->ast->root);
+        if(verbosity >= 3)
+            dump_scope(ctxs[i]->symbols);
+        if(verbosity >= 1)
+            print_ast_stats(ctxs[i]->ast);
+        if(run || dump || layouts) {
+            if(ctxs[i]->errors != 0) {
+                printf("%s: not run because of errors\n", ctxs[i]->fname);
+                status = 1;
+            }
+            else {
+                if(bytecode || dump)
+                    status |= compile_file(ctxs[i], run && bytecode, dump, layouts,
+                                            known[i]? &ids[i]: NULL);
+                else if(layouts)
+                    print_layouts(ctxs[i]->ast);
+                if(run && !bytecode)
+                    status |= interpret(ctxs[i]->ast, stdout);
+            }
+        }
+        if(graph == NULL)
+            destroy_context(ctxs[i]);
     }
+    destroy_import_graph(graph);
+    flush_errors(stdout);
+    FREE(known);
+    FREE(ids);
+    FREE(cached);
+    FREE(todo);
+    FREE(ctxs);
 
-    init_scanner(argv[1]);
-    yyparse();
-    destroy_scanner();
+    destroy_symbols();
+    destroy_intern_pool();
 
-    return 0;
+    return status;
 }
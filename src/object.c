@@ -5,12 +5,43 @@
 #include "errors.h"
 #include "object.h"
 
+/*
+ * When an arena is set, new objects are allocated from it and destroy_obj()
+ * leaves them alone. Otherwise they come from the system allocator. The
+ * arena is set per thread. Returns the arena that was set before.
+ */
+static _Thread_local arena_t* obj_arena = NULL;
+
+arena_t* set_obj_arena(arena_t* arena) {
+
+    arena_t* prev = obj_arena;
+    obj_arena = arena;
+    return prev;
+}
+
+static object_t* alloc_obj(object_type_t type) {
+
+    object_t* obj;
+    if(obj_arena != NULL) {
+        obj = ARENA_ALLOC_DS(obj_arena, object_t);
+        obj->in_arena = 1;
+    }
+    else
+        obj = ALLOC_DS(object_t);
+
+    obj->type = type;
+    return obj;
+}
+
+static void* alloc_value(size_t size) {
+
+    return (obj_arena != NULL)? ARENA_ALLOC(obj_arena, size): ALLOC(size);
+}
 
 object_t* create_list_obj() {
 
-    object_t* obj = ALLOC_DS(object_t);
-    obj->type = OT_LIST;
-    obj->value.list = ALLOC_DS(obj_list_t);
+    object_t* obj = alloc_obj(OT_LIST);
+    obj->value.list = alloc_value(sizeof(obj_list_t));
     // list stuff here
 
     return obj;
@@ -18,9 +49,8 @@ object_t* create_list_obj() {
 
 object_t* create_dict_obj() {
 
-    object_t* obj = ALLOC_DS(object_t);
-    obj->type = OT_DICT;
-    obj->value.dict = ALLOC_DS(obj_dict_t);
+    object_t* obj = alloc_obj(OT_DICT);
+    obj->value.dict = alloc_value(sizeof(obj_dict_t));
     // dict stuff here
 
     return obj;
@@ -28,9 +58,8 @@ object_t* create_dict_obj() {
 
 object_t* create_struc_obj() {
 
-    object_t* obj = ALLOC_DS(object_t);
-    obj->type = OT_STRUCT;
-    obj->value.struc = ALLOC_DS(obj_struc_t);
+    object_t* obj = alloc_obj(OT_STRUCT);
+    obj->value.struc = alloc_value(sizeof(obj_struc_t));
     // struc stuff here
 
     return obj;
@@ -38,9 +67,8 @@ object_t* create_struc_obj() {
 
 object_t* create_namesp_obj() {
 
-    object_t* obj = ALLOC_DS(object_t);
-    obj->type = OT_NAMESPACE;
-    obj->value.namesp = ALLOC_DS(obj_namesp_t);
+    object_t* obj = alloc_obj(OT_NAMESPACE);
+    obj->value.namesp = alloc_value(sizeof(obj_namesp_t));
     // namespace stuff here
 
     return obj;
@@ -49,7 +77,7 @@ object_t* create_namesp_obj() {
 
 void destroy_obj(object_t* obj) {
 
-    if(obj != NULL) {
+    if(obj != NULL && !obj->in_arena) {
         switch(obj->type) {
             case OT_LIST:
                 if(obj->value.list != NULL)
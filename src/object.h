@@ -2,6 +2,8 @@
 #ifndef __OBJECT_H__
 #define __OBJECT_H__
 
+#include "memory.h"
+
 typedef enum {
     OT_LIST,
     OT_DICT,
@@ -24,12 +26,18 @@ typedef struct {
     // stub
 } obj_dict_t;
 
+struct _scope_t_; // see symbols.h
+
+/*
+ * Structs and name spaces keep the scope that holds their members, so a
+ * qualified name is resolved one part at a time from here.
+ */
 typedef struct {
-    // stub
+    struct _scope_t_* scope;
 } obj_struc_t;
 
 typedef struct {
-    // stub
+    struct _scope_t_* scope;
 } obj_namesp_t;
 
 /*
@@ -37,6 +45,7 @@ typedef struct {
  */
 typedef struct {
     object_type_t type;
+    unsigned char in_arena:1; // released with the arena, not by destroy_obj()
     union {
         obj_list_t* list;
         obj_dict_t* dict;
@@ -50,6 +59,7 @@ object_t* create_dict_obj();
 object_t* create_struc_obj();
 object_t* create_namesp_obj();
 
+arena_t* set_obj_arena(arena_t* arena);
 void destroy_obj(object_t* obj);
 void print_obj(int indent, object_t* obj);
 
@@ -65,19 +65,111 @@
  *
  */
 
+%code requires {
+#include <stddef.h>
+#include "ast.h"
+#include "context.h"
+
+/*
+ * Locations also carry the byte offset and length of the text in the input,
+ * so the source of a token or a whole rule can be found without copying it.
+ */
+typedef struct {
+    int first_line;
+    int first_column;
+    int last_line;
+    int last_column;
+    size_t offset;
+    size_t length;
+} nop_location_t;
+
+#define YYLLOC_DEFAULT(cur, rhs, n) do { \
+    if(n) { \
+        (cur).first_line = YYRHSLOC(rhs, 1).first_line; \
+        (cur).first_column = YYRHSLOC(rhs, 1).first_column; \
+        (cur).last_line = YYRHSLOC(rhs, n).last_line; \
+        (cur).last_column = YYRHSLOC(rhs, n).last_column; \
+        (cur).offset = YYRHSLOC(rhs, 1).offset; \
+        (cur).length = YYRHSLOC(rhs, n).offset + YYRHSLOC(rhs, n).length - \
+                        YYRHSLOC(rhs, 1).offset; \
+    } \
+    else { \
+        (cur).first_line = (cur).last_line = YYRHSLOC(rhs, 0).last_line; \
+        (cur).first_column = (cur).last_column = YYRHSLOC(rhs, 0).last_column; \
+        (cur).offset = YYRHSLOC(rhs, 0).offset + YYRHSLOC(rhs, 0).length; \
+        (cur).length = 0; \
+    }} while(0)
+}
+
+%code provides {
+int yylex(YYSTYPE* lval, YYLTYPE* lloc, void* scanner);
+void yyerror(YYLTYPE* lloc, void* scanner, parse_ctx_t* ctx, const char* s);
+}
+
 %{
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
 #include "scanner.h"
 #include "symbols.h"
+#include "errors.h"
+#include "context.h"
+#include "ast.h"
+
+// helpers for building AST nodes from the semantic actions
+#define LOC(l)      (l).first_line, (l).first_column
+#define MK(k, op, l, a, b, c, d) ast_make(ctx->ast, (k), (op), LOC(l), (a), (b), (c), (d))
+#define MKSTR(k, s, l, a, b) ast_make_str(ctx->ast, (k), (s), LOC(l), (a), (b))
+#define BINARY(op, l, a, b) MK(AST_BINARY, (op), l, (a), (b), AST_NONE, AST_NONE)
+#define LIST(l)     ast_list_new(ctx->ast, LOC(l))
+#define APPEND(l, n) ast_list_append(ctx->ast, (l), (n))
+
+// a name of one part, such as a variable that is spelled like a struct
+#define NAME(s, l)  MK(AST_COMPOUND_NAME, 0, l, \
+                        APPEND(LIST(l), MKSTR(AST_IDENT, (s), l, AST_NONE, AST_NONE)), \
+                        AST_NONE, AST_NONE, AST_NONE)
+
+// the type of a declaration that names a struct with a plain identifier
+#define NAMED_TYPE(s, l, k) MK(AST_TYPE_SPEC, (k), l, \
+                        set_op(ctx->ast, MKSTR(AST_TYPE_NAME, (s), l, AST_NONE, AST_NONE), TYPEDEF_NAME), \
+                        AST_NONE, AST_NONE, AST_NONE)
+
+static ast_idx_t set_flags(ast_t* ast, ast_idx_t idx, int flags) {
+
+    AST_NODE(ast, idx)->flags |= flags;
+    return idx;
+}
+#define FLAGS(n, f) set_flags(ctx->ast, (n), (f))
+
+static ast_idx_t set_op(ast_t* ast, ast_idx_t idx, int op) {
+
+    AST_NODE(ast, idx)->op = op;
+    return idx;
+}
+
+// where a top level item is, for an incremental reparse
+#define ITEM(n, l)  add_context_item(ctx, (n), (l).offset, (l).length, \
+                        (l).first_line, (l).first_column, (l).last_line, (l).last_column + 1)
+
+// an item with a syntax error, with the rest of it skipped by recover()
+#define RECOVER(list, n, l) do { \
+        (n) = MK(AST_ERROR, 0, l, AST_NONE, AST_NONE, AST_NONE, AST_NONE); \
+        if(!recover(ctx, (list), &yychar, &yylval, &yylloc, &(l))) \
+            YYABORT; \
+    } while(0)
+
+// symbol table helpers, defined after the grammar
+static void check_symbol(int line, int col, const char* name, symbols_error_t err);
+static void declare(parse_ctx_t* ctx, ast_idx_t decl, int flags, int assigned);
+static void declare_list(parse_ctx_t* ctx, ast_idx_t list);
+static void open_method(parse_ctx_t* ctx, ast_idx_t def);
 
 #ifdef PARSE_TRACE
 #define OSTR stderr
 extern int verbosity; // defined in nop.c
-extern int line_no, col_no; // defined in scanner.c, generated file
 #define PTRACE(v,fmt,...) do{ \
     if(verbosity >= (v)) { \
-    fprintf(OSTR, ">>>>>>>>>> PTRACE: %d: %d: %d: ", __LINE__, line_no, col_no); \
+    fprintf(OSTR, ">>>>>>>>>> PTRACE: %d: %d: %d: ", __LINE__, ctx->line_no, ctx->col_no); \
     fprintf(OSTR, fmt, ##__VA_ARGS__); \
     fprintf(OSTR,"\n");}}while(0)
 #else
@@ -85,9 +177,31 @@ extern int line_no, col_no; // defined in scanner.c, generated file
 #endif
 
 %}
+
+%code {
+// the lists that error recovery can go on with, see recover()
+typedef enum {
+    IN_FILE,
+    IN_NAMESPACE,
+    IN_STRUCT,
+    IN_BODY,
+    IN_SWITCH,
+} list_kind_t;
+
+static int recover(parse_ctx_t* ctx, list_kind_t list, int* token, YYSTYPE* lval,
+                        YYLTYPE* lloc, YYLTYPE* item);
+
+// the parser reads its tokens through this, defined after the grammar
+static int next_token(YYSTYPE* lval, YYLTYPE* lloc, void* scanner, parse_ctx_t* ctx);
+#define yylex(lval, lloc, scanner) next_token((lval), (lloc), (scanner), ctx)
+}
 %debug
 %defines
 %locations
+%define api.location.type {nop_location_t}
+%define api.pure full
+%parse-param {void* scanner} {parse_ctx_t* ctx}
+%lex-param {void* scanner}
 %define parse.error verbose
 
 %union {
@@ -97,6 +211,9 @@ extern int line_no, col_no; // defined in scanner.c, generated file
     unsigned long uint_literal;
     long int_literal;
     double float_literal;
+    ast_idx_t node;
+    int flag;
+    scope_t* scope;
 };
 
 %token <identifier> IDENTIFIER TYPEDEF_NAME
@@ -116,6 +233,39 @@ extern int line_no, col_no; // defined in scanner.c, generated file
 %token  CASE DEFAULT IF ELSE SWITCH WHILE DO FOR CONTINUE BREAK RETURN
 %token  NAMESPACE IMPORT PUBLIC PRIVATE
 
+%type <node> translation_unit translation_unit_item namespace namespace_item
+%type <node> namespace_item_list formatted_string identifier_parameter_list
+%type <node> identifier_parameter identifier compound_identifier compound_name
+%type <node> type_name type_specifier primary_expression expression
+%type <node> assignment_expression expression_list struct_declaration
+%type <node> struct_item struct_list variable_declaration method_declaration
+%type <node> method_declaration_parameters method_definition method_body
+%type <node> method_body_item method_body_list dict_init_element
+%type <node> dict_init_list list_init variable_definition if_clause
+%type <node> else_clause else_clause_list final_else while_clause do_clause
+%type <node> for_init for_clause case_clause case_clause_list
+%type <node> final_case_clause switch_clause assignment assignment_target
+%type <flag> public_or_private list_or_dict
+%type <identifier> namespace_name struct_name any_identifier
+%type <node> method_name ctor_name dtor_name
+%type <scope> block_scope
+
+/*
+ * These open a scope when they are reduced and the rule that contains them
+ * closes it. If one is thrown away by error recovery then its scope is
+ * closed here instead.
+ */
+%destructor { pop_scope(); } namespace_name struct_name method_name ctor_name
+%destructor { pop_scope(); } dtor_name
+%destructor { close_scope($$); } block_scope
+
+/*
+ * A body item that is a bare name, followed by an identifier, is read as
+ * the start of a declaration whose type is the name. See variable_declaration.
+ */
+%precedence BARE_NAME
+%precedence IDENTIFIER TYPEDEF_NAME
+
 %right '='
 %right ADD_ASSIGN SUB_ASSIGN
 %right MUL_ASSIGN DIV_ASSIGN MOD_ASSIGN
@@ -129,308 +279,825 @@ extern int line_no, col_no; // defined in scanner.c, generated file
 %right NOT
 %left ':'  // typecast
 
+%initial-action {
+    memset(&ctx->recovery, 0, sizeof(recovery_t));
+    ctx->stopped = 0;
+}
+
 %%
 
 translation_unit
-    : translation_unit_item
-    | translation_unit translation_unit_item
+    : translation_unit_item {
+            ITEM($1, @1);
+            $$ = APPEND(LIST(@$), $1);
+            ctx->ast->root = $$;
+        }
+    | translation_unit translation_unit_item {
+            ITEM($2, @2);
+            $$ = APPEND($1, $2);
+        }
     ;
 
 translation_unit_item
-    : namespace
-    | IMPORT formatted_string
-    | ENTRY method_body
+    : namespace { $$ = $1; }
+    | IMPORT formatted_string { $$ = MK(AST_IMPORT, 0, @$, $2, AST_NONE, AST_NONE, AST_NONE); }
+    | ENTRY method_body { $$ = MK(AST_ENTRY, 0, @$, $2, AST_NONE, AST_NONE, AST_NONE); }
+    | error { RECOVER(IN_FILE, $$, @$); }
     ;
 
 namespace
-    : NAMESPACE IDENTIFIER '{' namespace_item_list '}'
+    : namespace_name '{' namespace_item_list '}' {
+            $$ = MKSTR(AST_NAMESPACE, $1, @$, $3, AST_NONE);
+            pop_scope();
+        }
+    ;
+
+namespace_name
+    : NAMESPACE IDENTIFIER {
+            $$ = $2;
+            check_symbol(LOC(@2), $2, push_scope(SCOPE_NAMESPACE, $2));
+        }
     ;
 
 namespace_item
-    : struct_declaration
-    | public_or_private method_definition
-    | public_or_private variable_definition
+    : struct_declaration { $$ = $1; }
+    | public_or_private method_definition { $$ = FLAGS($2, $1); }
+    | public_or_private variable_definition { $$ = FLAGS($2, $1); }
+    | error { RECOVER(IN_NAMESPACE, $$, @$); }
     ;
 
 namespace_item_list
-    : namespace_item
-    | namespace_item_list namespace_item
+    : namespace_item { $$ = APPEND(LIST(@$), $1); }
+    | namespace_item_list namespace_item { $$ = APPEND($1, $2); }
     ;
 
 formatted_string
-    : STRING_LITERAL
-    | STRING_LITERAL '(' ')'
-    | STRING_LITERAL '(' expression_list ')'
+    : STRING_LITERAL { $$ = MKSTR(AST_FSTRING, $1, @$, AST_NONE, AST_NONE); }
+    | STRING_LITERAL '(' ')' { $$ = MKSTR(AST_FSTRING, $1, @$, AST_NONE, AST_NONE); }
+    | STRING_LITERAL '(' expression_list ')' { $$ = MKSTR(AST_FSTRING, $1, @$, $3, AST_NONE); }
     ;
 
 identifier_parameter_list
-    : identifier_parameter
-    | identifier_parameter_list identifier_parameter
+    : identifier_parameter { $$ = APPEND(LIST(@$), $1); }
+    | identifier_parameter_list identifier_parameter { $$ = APPEND($1, $2); }
     ;
 
 identifier_parameter
-    : '(' ')'
-    | '(' expression_list ')'
-    | '[' expression ']'
+    : '(' ')' { $$ = MK(AST_CALL_PARAMS, 0, @$, AST_NONE, AST_NONE, AST_NONE, AST_NONE); }
+    | '(' expression_list ')' { $$ = MK(AST_CALL_PARAMS, 0, @$, $2, AST_NONE, AST_NONE, AST_NONE); }
+    | '[' expression ']' { $$ = MK(AST_INDEX, 0, @$, $2, AST_NONE, AST_NONE, AST_NONE); }
     ;
 
 identifier
-    : IDENTIFIER
-    | IDENTIFIER identifier_parameter_list
+    : IDENTIFIER %prec BARE_NAME { $$ = MKSTR(AST_IDENT, $1, @$, AST_NONE, AST_NONE); }
+    | IDENTIFIER identifier_parameter_list { $$ = MKSTR(AST_IDENT, $1, @$, $2, AST_NONE); }
     ;
 
 compound_identifier
-    : IDENTIFIER
-    | compound_identifier '.' IDENTIFIER
-    | error
+    : any_identifier {
+            ast_idx_t lst = APPEND(LIST(@$),
+                                MKSTR(AST_IDENT, $1, @$, AST_NONE, AST_NONE));
+            $$ = MK(AST_COMPOUND_ID, 0, @$, lst, AST_NONE, AST_NONE, AST_NONE);
+        }
+    | compound_identifier '.' any_identifier {
+            APPEND(AST_CHILD(ctx->ast, $1, 0), MKSTR(AST_IDENT, $3, @3, AST_NONE, AST_NONE));
+            $$ = $1;
+        }
+    ;
+
+any_identifier
+    : IDENTIFIER { $$ = $1; }
+    | TYPEDEF_NAME { $$ = $1; }
     ;
 
 compound_name
-    : identifier
-    | compound_name '.' identifier
+    : identifier {
+            ast_idx_t lst = APPEND(LIST(@$), $1);
+            $$ = MK(AST_COMPOUND_NAME, 0, @$, lst, AST_NONE, AST_NONE, AST_NONE);
+        }
+    | TYPEDEF_NAME '.' identifier {
+            ast_idx_t lst = APPEND(LIST(@$),
+                                MKSTR(AST_IDENT, $1, @1, AST_NONE, AST_NONE));
+            APPEND(lst, $3);
+            $$ = MK(AST_COMPOUND_NAME, 0, @$, lst, AST_NONE, AST_NONE, AST_NONE);
+        }
+    | compound_name '.' identifier {
+            APPEND(AST_CHILD(ctx->ast, $1, 0), $3);
+            $$ = $1;
+        }
+    | compound_name '.' TYPEDEF_NAME {
+            APPEND(AST_CHILD(ctx->ast, $1, 0), MKSTR(AST_IDENT, $3, @3, AST_NONE, AST_NONE));
+            $$ = $1;
+        }
     ;
 
 type_name
-    : BOOL
-    | INT
-    | UINT
-    | FLOAT
-    | STRING
-    | NOTHING
-    | TYPEDEF_NAME
+    : BOOL { $$ = MK(AST_TYPE_NAME, BOOL, @$, AST_NONE, AST_NONE, AST_NONE, AST_NONE); }
+    | INT { $$ = MK(AST_TYPE_NAME, INT, @$, AST_NONE, AST_NONE, AST_NONE, AST_NONE); }
+    | UINT { $$ = MK(AST_TYPE_NAME, UINT, @$, AST_NONE, AST_NONE, AST_NONE, AST_NONE); }
+    | FLOAT { $$ = MK(AST_TYPE_NAME, FLOAT, @$, AST_NONE, AST_NONE, AST_NONE, AST_NONE); }
+    | STRING { $$ = MK(AST_TYPE_NAME, STRING, @$, AST_NONE, AST_NONE, AST_NONE, AST_NONE); }
+    | NOTHING { $$ = MK(AST_TYPE_NAME, NOTHING, @$, AST_NONE, AST_NONE, AST_NONE, AST_NONE); }
+    | TYPEDEF_NAME {
+            $$ = MKSTR(AST_TYPE_NAME, $1, @$, AST_NONE, AST_NONE);
+            AST_NODE(ctx->ast, $$)->op = TYPEDEF_NAME;
+        }
     ;
 
 list_or_dict
-    : LIST
-    | DICT
+    : LIST { $$ = LIST; }
+    | DICT { $$ = DICT; }
     ;
 
 type_specifier
-    : type_name
-    | CONST type_name
-    | CONST type_name list_or_dict
-    | type_name list_or_dict
+    : type_name { $$ = MK(AST_TYPE_SPEC, 0, @$, $1, AST_NONE, AST_NONE, AST_NONE); }
+    | CONST type_name { $$ = FLAGS(MK(AST_TYPE_SPEC, 0, @$, $2, AST_NONE, AST_NONE, AST_NONE), AST_F_CONST); }
+    | CONST type_name list_or_dict { $$ = FLAGS(MK(AST_TYPE_SPEC, $3, @$, $2, AST_NONE, AST_NONE, AST_NONE), AST_F_CONST); }
+    | type_name list_or_dict { $$ = MK(AST_TYPE_SPEC, $2, @$, $1, AST_NONE, AST_NONE, AST_NONE); }
     ;
 
 primary_expression
-    : I_CONSTANT
-    | U_CONSTANT
-    | F_CONSTANT
-    | B_CONSTANT
-    | formatted_string
-    | compound_name
+    : I_CONSTANT {
+            $$ = MK(AST_INUM, 0, @$, AST_NONE, AST_NONE, AST_NONE, AST_NONE);
+            AST_VALUE(ctx->ast, $$)->inum = $1;
+        }
+    | U_CONSTANT {
+            $$ = MK(AST_UNUM, 0, @$, AST_NONE, AST_NONE, AST_NONE, AST_NONE);
+            AST_VALUE(ctx->ast, $$)->unum = $1;
+        }
+    | F_CONSTANT {
+            $$ = MK(AST_FNUM, 0, @$, AST_NONE, AST_NONE, AST_NONE, AST_NONE);
+            AST_VALUE(ctx->ast, $$)->fnum = $1;
+        }
+    | B_CONSTANT {
+            $$ = MK(AST_BOOL, 0, @$, AST_NONE, AST_NONE, AST_NONE, AST_NONE);
+            AST_VALUE(ctx->ast, $$)->inum = $1;
+        }
+    | formatted_string { $$ = $1; }
+    | compound_name { $$ = $1; }
+    | TYPEDEF_NAME { $$ = NAME($1, @$); }
     ;
 
 expression
-    : primary_expression
-    | expression '+' expression
-    | expression '-' expression
-    | expression '*' expression
-    | expression '/' expression
-    | expression '%' expression
-    | expression EQ_OP expression
-    | expression NE_OP expression
-    | expression '<' expression
-    | expression '>' expression
-    | expression LE_OP expression
-    | expression GE_OP expression
-    | expression AND_OP expression
-    | expression OR_OP expression
-    | '-' expression %prec NEG
-    | NOT expression
-    | type_specifier '(' expression ')'
-    | '(' expression ')'
-    | error
+    : primary_expression { $$ = $1; }
+    | expression '+' expression { $$ = BINARY('+', @$, $1, $3); }
+    | expression '-' expression { $$ = BINARY('-', @$, $1, $3); }
+    | expression '*' expression { $$ = BINARY('*', @$, $1, $3); }
+    | expression '/' expression { $$ = BINARY('/', @$, $1, $3); }
+    | expression '%' expression { $$ = BINARY('%', @$, $1, $3); }
+    | expression EQ_OP expression { $$ = BINARY(EQ_OP, @$, $1, $3); }
+    | expression NE_OP expression { $$ = BINARY(NE_OP, @$, $1, $3); }
+    | expression '<' expression { $$ = BINARY('<', @$, $1, $3); }
+    | expression '>' expression { $$ = BINARY('>', @$, $1, $3); }
+    | expression LE_OP expression { $$ = BINARY(LE_OP, @$, $1, $3); }
+    | expression GE_OP expression { $$ = BINARY(GE_OP, @$, $1, $3); }
+    | expression AND_OP expression { $$ = BINARY(AND_OP, @$, $1, $3); }
+    | expression OR_OP expression { $$ = BINARY(OR_OP, @$, $1, $3); }
+    | '-' expression %prec NEG { $$ = MK(AST_UNARY, '-', @$, $2, AST_NONE, AST_NONE, AST_NONE); }
+    | NOT expression { $$ = MK(AST_UNARY, NOT, @$, $2, AST_NONE, AST_NONE, AST_NONE); }
+    | type_specifier '(' expression ')' { $$ = MK(AST_CAST, 0, @$, $1, $3, AST_NONE, AST_NONE); }
+    | '(' expression ')' { $$ = $2; }
     ;
 
 assignment_expression
-    : compound_name ADD_ASSIGN expression
-    | compound_name SUB_ASSIGN expression
-    | compound_name MUL_ASSIGN expression
-    | compound_name DIV_ASSIGN expression
-    | compound_name MOD_ASSIGN expression
+    : assignment_target ADD_ASSIGN expression { $$ = MK(AST_ASSIGN, ADD_ASSIGN, @$, $1, $3, AST_NONE, AST_NONE); }
+    | assignment_target SUB_ASSIGN expression { $$ = MK(AST_ASSIGN, SUB_ASSIGN, @$, $1, $3, AST_NONE, AST_NONE); }
+    | assignment_target MUL_ASSIGN expression { $$ = MK(AST_ASSIGN, MUL_ASSIGN, @$, $1, $3, AST_NONE, AST_NONE); }
+    | assignment_target DIV_ASSIGN expression { $$ = MK(AST_ASSIGN, DIV_ASSIGN, @$, $1, $3, AST_NONE, AST_NONE); }
+    | assignment_target MOD_ASSIGN expression { $$ = MK(AST_ASSIGN, MOD_ASSIGN, @$, $1, $3, AST_NONE, AST_NONE); }
+    ;
+
+assignment_target
+    : compound_name { $$ = $1; }
+    | TYPEDEF_NAME { $$ = NAME($1, @$); }
     ;
 
 expression_list
-    : expression
-    | expression_list ',' expression
+    : expression { $$ = APPEND(LIST(@$), $1); }
+    | expression_list ',' expression { $$ = APPEND($1, $3); }
     ;
 
 public_or_private
-    : PUBLIC
-    | PRIVATE
-    |
+    : PUBLIC { $$ = AST_F_PUBLIC; }
+    | PRIVATE { $$ = AST_F_PRIVATE; }
+    | { $$ = 0; }
     ;
 
 struct_declaration
-    : public_or_private STRUCT IDENTIFIER '{' struct_list '}'
+    : public_or_private struct_name struct_list '}' {
+            $$ = FLAGS(MKSTR(AST_STRUCT, $2, @$, $3, AST_NONE), $1);
+            pop_scope();
+        }
+    ;
+
+/*
+ * The name is a type name once the body is open, and not before, so that
+ * "struct" where it does not belong does not make the next identifier a
+ * type name for the rest of the file.
+ */
+struct_name
+    : STRUCT IDENTIFIER '{' {
+            $$ = $2;
+            check_symbol(LOC(@2), $2, push_scope(SCOPE_STRUCT, $2));
+            add_context_type(ctx, $2);
+        }
     ;
 
 struct_item
-    : public_or_private variable_declaration
-    | public_or_private method_declaration
-    | CTOR '(' method_declaration_parameters ')'
-    | CTOR '(' ')'
-    | DTOR
-    | struct_declaration
-    | error
+    : public_or_private variable_declaration {
+            $$ = FLAGS($2, $1);
+            declare(ctx, $2, $1, 0);
+        }
+    | public_or_private method_declaration {
+            $$ = FLAGS($2, $1);
+            declare(ctx, $2, $1, 0);
+        }
+    | CTOR '(' method_declaration_parameters ')' { $$ = MK(AST_CTOR_DECL, 0, @$, AST_NONE, $3, AST_NONE, AST_NONE); }
+    | CTOR '(' ')' { $$ = MK(AST_CTOR_DECL, 0, @$, AST_NONE, AST_NONE, AST_NONE, AST_NONE); }
+    | DTOR { $$ = MK(AST_DTOR_DECL, 0, @$, AST_NONE, AST_NONE, AST_NONE, AST_NONE); }
+    | struct_declaration { $$ = $1; }
+    | error { RECOVER(IN_STRUCT, $$, @$); }
     ;
 
 struct_list
-    : struct_item
-    | struct_list struct_item
+    : struct_item { $$ = APPEND(LIST(@$), $1); }
+    | struct_list struct_item { $$ = APPEND($1, $2); }
     ;
 
+/*
+ * The name that is declared can be spelled like a struct, which the scanner
+ * makes a TYPEDEF_NAME. The type can be a plain identifier, for a struct
+ * that is declared later or in an imported file, which is resolved like any
+ * other struct type. In a method body a bare name is not a useful statement,
+ * so a name followed by an identifier is this and not two statements.
+ */
 variable_declaration
-    : type_specifier IDENTIFIER
+    : type_specifier any_identifier { $$ = MKSTR(AST_VAR_DECL, $2, @$, $1, AST_NONE); }
+    | IDENTIFIER any_identifier { $$ = MKSTR(AST_VAR_DECL, $2, @$, NAMED_TYPE($1, @1, 0), AST_NONE); }
+    | IDENTIFIER list_or_dict any_identifier {
+            $$ = MKSTR(AST_VAR_DECL, $3, @$, NAMED_TYPE($1, @1, $2), AST_NONE);
+        }
+    | CONST IDENTIFIER any_identifier {
+            $$ = MKSTR(AST_VAR_DECL, $3, @$, FLAGS(NAMED_TYPE($2, @1, 0), AST_F_CONST), AST_NONE);
+        }
+    | CONST IDENTIFIER list_or_dict any_identifier {
+            $$ = MKSTR(AST_VAR_DECL, $4, @$, FLAGS(NAMED_TYPE($2, @1, $3), AST_F_CONST), AST_NONE);
+        }
     ;
 
+// the same as a variable with parameters after it
 method_declaration
-    : type_specifier IDENTIFIER '(' method_declaration_parameters ')'
-    | type_specifier IDENTIFIER '(' ')'
+    : variable_declaration '(' method_declaration_parameters ')' {
+            $$ = $1;
+            AST_KIND(ctx->ast, $$) = AST_METHOD_DECL;
+            AST_CHILD(ctx->ast, $$, 1) = $3;
+        }
+    | variable_declaration '(' ')' {
+            $$ = $1;
+            AST_KIND(ctx->ast, $$) = AST_METHOD_DECL;
+        }
     ;
 
 method_declaration_parameters
-    : variable_declaration
-    | method_declaration_parameters ',' variable_declaration
+    : variable_declaration { $$ = APPEND(LIST(@$), $1); }
+    | method_declaration_parameters ',' variable_declaration { $$ = APPEND($1, $3); }
     ;
 
 method_definition
-    : type_specifier compound_identifier '(' method_declaration_parameters ')' method_body
-    | type_specifier compound_identifier '(' ')' method_body
-    | compound_identifier '.' CTOR '(' method_declaration_parameters ')' method_body
-    | compound_identifier '.' CTOR '(' ')' method_body
-    | compound_identifier '.' DTOR method_body
-    | error
+    : method_name '(' method_declaration_parameters ')' { declare_list(ctx, $3); } method_body {
+            $$ = $1;
+            AST_CHILD(ctx->ast, $$, 2) = $3;
+            AST_CHILD(ctx->ast, $$, 3) = $6;
+            pop_scope();
+        }
+    | method_name '(' ')' method_body {
+            $$ = $1;
+            AST_CHILD(ctx->ast, $$, 3) = $4;
+            pop_scope();
+        }
+    | ctor_name '(' method_declaration_parameters ')' { declare_list(ctx, $3); } method_body {
+            $$ = $1;
+            AST_CHILD(ctx->ast, $$, 2) = $3;
+            AST_CHILD(ctx->ast, $$, 3) = $6;
+            pop_scope();
+        }
+    | ctor_name '(' ')' method_body {
+            $$ = $1;
+            AST_CHILD(ctx->ast, $$, 3) = $4;
+            pop_scope();
+        }
+    | dtor_name method_body {
+            $$ = $1;
+            AST_CHILD(ctx->ast, $$, 3) = $2;
+            pop_scope();
+        }
+    ;
+
+method_name
+    : type_specifier compound_identifier {
+            $$ = MK(AST_METHOD_DEF, AST_M_METHOD, @$, $1, $2, AST_NONE, AST_NONE);
+            open_method(ctx, $$);
+        }
+    | IDENTIFIER compound_identifier {
+            $$ = MK(AST_METHOD_DEF, AST_M_METHOD, @$, NAMED_TYPE($1, @1, 0), $2, AST_NONE, AST_NONE);
+            open_method(ctx, $$);
+        }
+    | IDENTIFIER list_or_dict compound_identifier {
+            $$ = MK(AST_METHOD_DEF, AST_M_METHOD, @$, NAMED_TYPE($1, @1, $2), $3, AST_NONE, AST_NONE);
+            open_method(ctx, $$);
+        }
+    ;
+
+ctor_name
+    : compound_identifier '.' CTOR {
+            $$ = MK(AST_METHOD_DEF, AST_M_CTOR, @$, AST_NONE, $1, AST_NONE, AST_NONE);
+            open_method(ctx, $$);
+        }
+    ;
+
+dtor_name
+    : compound_identifier '.' DTOR {
+            $$ = MK(AST_METHOD_DEF, AST_M_DTOR, @$, AST_NONE, $1, AST_NONE, AST_NONE);
+            open_method(ctx, $$);
+        }
     ;
 
 method_body
-    : '{' '}'
-    | '{' method_body_list '}'
+    : '{' '}' { $$ = MK(AST_BLOCK, 0, @$, AST_NONE, AST_NONE, AST_NONE, AST_NONE); }
+    | '{' block_scope method_body_list '}' {
+            $$ = MK(AST_BLOCK, 0, @$, $3, AST_NONE, AST_NONE, AST_NONE);
+            close_scope($2);
+        }
+    ;
+
+block_scope
+    : {
+            push_scope(SCOPE_BLOCK, NULL);
+            $$ = get_scope();
+        }
     ;
 
 method_body_item
-    : variable_definition
-    | if_clause
-    | while_clause
-    | do_clause
-    | for_clause
-    | switch_clause
-    | assignment
-    | assignment_expression
-    | compound_name
-    | BREAK
-    | CONTINUE
-    | RETURN expression
-    | method_body
-    | error
+    : variable_definition { $$ = $1; }
+    | if_clause { $$ = $1; }
+    | while_clause { $$ = $1; }
+    | do_clause { $$ = $1; }
+    | for_clause { $$ = $1; }
+    | switch_clause { $$ = $1; }
+    | assignment { $$ = $1; }
+    | assignment_expression { $$ = $1; }
+    | compound_name { $$ = MK(AST_EXPR_STMT, 0, @$, $1, AST_NONE, AST_NONE, AST_NONE); }
+    | BREAK { $$ = MK(AST_BREAK, 0, @$, AST_NONE, AST_NONE, AST_NONE, AST_NONE); }
+    | CONTINUE { $$ = MK(AST_CONTINUE, 0, @$, AST_NONE, AST_NONE, AST_NONE, AST_NONE); }
+    | RETURN expression { $$ = MK(AST_RETURN, 0, @$, $2, AST_NONE, AST_NONE, AST_NONE); }
+    | method_body { $$ = $1; }
+    | error { RECOVER(IN_BODY, $$, @$); }
     ;
 
 method_body_list
-    : method_body_item
-    | method_body_list method_body_item
+    : method_body_item { $$ = APPEND(LIST(@$), $1); }
+    | method_body_list method_body_item { $$ = APPEND($1, $2); }
     ;
 
 dict_init_element
-    : IDENTIFIER '=' expression
+    : IDENTIFIER '=' expression { $$ = MKSTR(AST_DICT_ELEM, $1, @$, $3, AST_NONE); }
     ;
 
 dict_init_list
-    : dict_init_element
-    | dict_init_list ',' dict_init_element
+    : dict_init_element { $$ = APPEND(LIST(@$), $1); }
+    | dict_init_list ',' dict_init_element { $$ = APPEND($1, $3); }
     ;
 
 list_init
-    : '[' expression_list ']'
-    | '[' dict_init_list ']'
+    : '[' expression_list ']' { $$ = MK(AST_LIST_INIT, 0, @$, $2, AST_NONE, AST_NONE, AST_NONE); }
+    | '[' dict_init_list ']' { $$ = MK(AST_DICT_INIT, 0, @$, $2, AST_NONE, AST_NONE, AST_NONE); }
     ;
 
 variable_definition
-    : variable_declaration
-    | variable_declaration '=' expression
-    | variable_declaration '=' list_init
+    : variable_declaration {
+            $$ = MK(AST_VAR_DEF, 0, @$, $1, AST_NONE, AST_NONE, AST_NONE);
+            declare(ctx, $1, 0, 0);
+        }
+    | variable_declaration '=' expression {
+            $$ = MK(AST_VAR_DEF, 0, @$, $1, $3, AST_NONE, AST_NONE);
+            declare(ctx, $1, 0, 1);
+        }
+    | variable_declaration '=' list_init {
+            $$ = MK(AST_VAR_DEF, 0, @$, $1, $3, AST_NONE, AST_NONE);
+            declare(ctx, $1, 0, 1);
+        }
     ;
 
 if_clause
-    : IF '(' expression ')' method_body
-    | IF '(' expression ')' method_body else_clause_list
-    | IF '(' expression ')' method_body final_else
-    | IF '(' expression ')' method_body else_clause_list final_else
+    : IF '(' expression ')' method_body {
+            $$ = MK(AST_IF, 0, @$, $3, $5, AST_NONE, AST_NONE);
+        }
+    | IF '(' expression ')' method_body else_clause_list {
+            $$ = MK(AST_IF, 0, @$, $3, $5, $6, AST_NONE);
+        }
+    | IF '(' expression ')' method_body final_else {
+            $$ = MK(AST_IF, 0, @$, $3, $5, APPEND(LIST(@6), $6), AST_NONE);
+        }
+    | IF '(' expression ')' method_body else_clause_list final_else {
+            $$ = MK(AST_IF, 0, @$, $3, $5, APPEND($6, $7), AST_NONE);
+        }
     ;
 
 else_clause
-    : ELSE '(' expression ')' method_body
+    : ELSE '(' expression ')' method_body { $$ = MK(AST_ELSE_IF, 0, @$, $3, $5, AST_NONE, AST_NONE); }
     ;
 
 else_clause_list
-    : else_clause
-    | else_clause_list else_clause
+    : else_clause { $$ = APPEND(LIST(@$), $1); }
+    | else_clause_list else_clause { $$ = APPEND($1, $2); }
     ;
 
 final_else
-    : ELSE method_body
-    | ELSE '(' ')' method_body
+    : ELSE method_body { $$ = MK(AST_ELSE, 0, @$, AST_NONE, $2, AST_NONE, AST_NONE); }
+    | ELSE '(' ')' method_body { $$ = MK(AST_ELSE, 0, @$, AST_NONE, $4, AST_NONE, AST_NONE); }
     ;
 
 while_clause
-    : WHILE '(' expression ')' method_body
-    | WHILE '(' ')' method_body
-    | WHILE method_body
+    : WHILE '(' expression ')' method_body { $$ = MK(AST_WHILE, 0, @$, $3, $5, AST_NONE, AST_NONE); }
+    | WHILE '(' ')' method_body { $$ = MK(AST_WHILE, 0, @$, AST_NONE, $4, AST_NONE, AST_NONE); }
+    | WHILE method_body { $$ = MK(AST_WHILE, 0, @$, AST_NONE, $2, AST_NONE, AST_NONE); }
     ;
 
 do_clause
-    : DO method_body WHILE '(' expression ')'
-    | DO method_body WHILE '(' ')'
+    : DO method_body WHILE '(' expression ')' { $$ = MK(AST_DO, 0, @$, $5, $2, AST_NONE, AST_NONE); }
+    | DO method_body WHILE '(' ')' { $$ = MK(AST_DO, 0, @$, AST_NONE, $2, AST_NONE, AST_NONE); }
     ;
 
 for_init
-    : variable_definition
-    | IDENTIFIER
+    : variable_definition { $$ = $1; }
+    | IDENTIFIER { $$ = MKSTR(AST_IDENT, $1, @$, AST_NONE, AST_NONE); }
     ;
 
 for_clause
-    : FOR '(' for_init ';' expression ';' expression ')' method_body
-    | FOR '(' ';' expression ';' expression ')' method_body
-    | FOR '(' for_init ';' expression ';' ')' method_body
-    | FOR '(' ';' expression ';' ')' method_body
+    : FOR '(' block_scope for_init ';' expression ';' expression ')' method_body {
+            $$ = MK(AST_FOR, 0, @$, $4, $6, $8, $10);
+            close_scope($3);
+        }
+    | FOR '(' block_scope ';' expression ';' expression ')' method_body {
+            $$ = MK(AST_FOR, 0, @$, AST_NONE, $5, $7, $9);
+            close_scope($3);
+        }
+    | FOR '(' block_scope for_init ';' expression ';' ')' method_body {
+            $$ = MK(AST_FOR, 0, @$, $4, $6, AST_NONE, $9);
+            close_scope($3);
+        }
+    | FOR '(' block_scope ';' expression ';' ')' method_body {
+            $$ = MK(AST_FOR, 0, @$, AST_NONE, $5, AST_NONE, $8);
+            close_scope($3);
+        }
     ;
 
 case_clause
-    : CASE '(' primary_expression ')' method_body
+    : CASE '(' primary_expression ')' method_body { $$ = MK(AST_CASE, 0, @$, $3, $5, AST_NONE, AST_NONE); }
+    | error { RECOVER(IN_SWITCH, $$, @$); }
     ;
 
 case_clause_list
-    : case_clause
-    | case_clause_list case_clause
+    : case_clause { $$ = APPEND(LIST(@$), $1); }
+    | case_clause_list case_clause { $$ = APPEND($1, $2); }
     ;
 
 final_case_clause
-    : CASE method_body
-    | CASE '(' ')' method_body
-    | DEFAULT method_body
+    : CASE method_body { $$ = MK(AST_DEFAULT, 0, @$, AST_NONE, $2, AST_NONE, AST_NONE); }
+    | CASE '(' ')' method_body { $$ = MK(AST_DEFAULT, 0, @$, AST_NONE, $4, AST_NONE, AST_NONE); }
+    | DEFAULT method_body { $$ = MK(AST_DEFAULT, 0, @$, AST_NONE, $2, AST_NONE, AST_NONE); }
     ;
 
 switch_clause
-    : SWITCH '(' expression ')' '{' case_clause_list '}'
-    | SWITCH '(' expression ')' '{' case_clause_list final_case_clause '}'
+    : SWITCH '(' expression ')' '{' case_clause_list '}' { $$ = MK(AST_SWITCH, 0, @$, $3, $6, AST_NONE, AST_NONE); }
+    | SWITCH '(' expression ')' '{' case_clause_list final_case_clause '}' {
+            $$ = MK(AST_SWITCH, 0, @$, $3, APPEND($6, $7), AST_NONE, AST_NONE);
+        }
     ;
 
 assignment
-    : compound_name '=' expression
+    : assignment_target '=' expression { $$ = MK(AST_ASSIGN, '=', @$, $1, $3, AST_NONE, AST_NONE); }
     ;
 
 %%
 #include <stdio.h>
 
-// defined in scanner.l
-extern int col_no;
-extern int line_no;
-extern char yytext[];
+#undef yylex // the scanner's from here on
 
-void yyerror(const char *s)
+void yyerror(YYLTYPE* lloc, void* scanner, parse_ctx_t* ctx, const char *s)
 {
-    fflush(stdout);
-    //fprintf(stderr, "*** %s\n", s);
-    //fprintf(stderr, "%s\n%*s\nsyntax error: %d: %s\n", yytext, col_no, "^", line_no, s);
-    fprintf(stderr, "syntax error: %d: %d: %s\n", line_no, col_no, s);
+    (void)lloc;
+    (void)scanner;
+
+    // the kind is written in front of the message, so bison's is not needed
+    if(strncmp(s, "syntax error, ", 14) == 0)
+        s += 14;
+
+    // the context is the current one while it is parsed, so the error goes
+    // to its sink
+    error_at("syntax", ctx->line_no, ctx->col_no, "%s", s);
+}
+
+static int brace(int token) {
+
+    return (token == '{')? 1: (token == '}')? -1: 0;
+}
+
+/*
+ * Give the parser the next token, which is a '}' that recover() asked for
+ * or the token that it held back, or else the next one from the scanner,
+ * and count the braces.
+ */
+static int next_token(YYSTYPE* lval, YYLTYPE* lloc, void* scanner, parse_ctx_t* ctx) {
+
+    recovery_t* rec = &ctx->recovery;
+    int token;
+
+    if(rec->closes > 0 || rec->token != 0) {
+        lloc->first_line = rec->line;
+        lloc->first_column = rec->col;
+        lloc->offset = rec->offset;
+        if(rec->closes > 0) {
+            // nothing in the text, just before the token
+            rec->closes--;
+            token = '}';
+            lloc->last_line = rec->line;
+            lloc->last_column = rec->col;
+            lloc->length = 0;
+        }
+        else {
+            token = rec->token;
+            rec->token = 0;
+            lloc->last_line = rec->end_line;
+            lloc->last_column = rec->end_col;
+            lloc->length = rec->length;
+        }
+    }
+    else
+        token = yylex(lval, lloc, scanner);
+
+    rec->depth += brace(token);
+    rec->last = token;
+    rec->prev_line = rec->last_line;
+    rec->last_line = lloc->last_line;
+    return token;
+}
+
+/*
+ * Where a token that can only be in some places belongs, as the number of
+ * braces open there, or -1 if it can be anywhere, or not where the list is.
+ * NAMESPACE, IMPORT and ENTRY are only at the top of the file, and STRUCT is
+ * not in a method body, so if one is found there, a '}' was left out.
+ */
+static int home_depth(list_kind_t list, int token, int level) {
+
+    switch(token) {
+        case NAMESPACE:
+        case IMPORT:
+        case ENTRY:
+            return 0;
+        case STRUCT:
+            if(list == IN_FILE)
+                return -1;
+            return (list == IN_NAMESPACE || list == IN_STRUCT || level < 1)? level: 1;
+        default:
+            return -1;
+    }
+}
+
+// whether the token can start an item of the list, or end it
+static int starts_item(list_kind_t list, int token) {
+
+    switch(token) {
+        case PUBLIC:
+        case PRIVATE:
+            return list == IN_NAMESPACE || list == IN_STRUCT;
+        case CTOR:
+        case DTOR:
+            return list == IN_STRUCT;
+        case BOOL:
+        case INT:
+        case UINT:
+        case FLOAT:
+        case STRING:
+        case NOTHING:
+        case CONST:
+        case TYPEDEF_NAME:
+            return list == IN_NAMESPACE || list == IN_STRUCT || list == IN_BODY;
+        case IDENTIFIER:
+            return list == IN_NAMESPACE || list == IN_BODY;
+        case IF:
+        case WHILE:
+        case DO:
+        case FOR:
+        case SWITCH:
+        case BREAK:
+        case CONTINUE:
+        case RETURN:
+        case '{':
+            return list == IN_BODY;
+        case CASE:
+        case DEFAULT:
+            return list == IN_SWITCH;
+        case '}':
+            return list != IN_FILE;
+        default:
+            return 0;
+    }
+}
+
+/*
+ * Skip the rest of an item that has a syntax error, up to a token that the
+ * list the item is in can go on with: one that starts another item and is
+ * the first on its line, since nothing ends a statement but the start of
+ * the next one, or the '}' that ends the list. The braces in what is
+ * skipped are matched, so a block is skipped whole and the '}' of one is
+ * not taken for the end of the list. A token that belongs in a list further
+ * out, such as NAMESPACE in a method body, ends the lists that are open
+ * above where it belongs, with a '}' for each that the parser is given
+ * before the token.
+ *
+ * The lookahead is the token where the error was found, or YYEMPTY if the
+ * parser threw it away. Every list that is in braces has an error item, so
+ * the parser never takes a '{' off its stack to get to one, and the braces
+ * that it has open are the ones counted here. The item's location is made
+ * to cover what is skipped. A token is skipped once, and the parser throws
+ * away no more than it read, so recovering costs no more than parsing the
+ * tokens would have. Returns 0 if the file has as many errors as the sink
+ * keeps, so the parse should stop.
+ */
+static int recover(parse_ctx_t* ctx, list_kind_t list, int* token, YYSTYPE* lval,
+                        YYLTYPE* lloc, YYLTYPE* item) {
+
+    recovery_t* rec = &ctx->recovery;
+
+    ctx->recoveries++;
+    if(ctx->diags->limit != 0 && (size_t)ctx->errors >= ctx->diags->limit) {
+        add_diag(ctx->diags, SEV_NOTE, ctx->fname, item->first_line, item->first_column,
+                    "limit", "too many errors, the rest of the file is not parsed");
+        ctx->stopped = 1;
+        return 0;
+    }
+
+    // the braces that are open where the list is; the parser only throws
+    // away the lookahead when it did not take the token after a recovery,
+    // and then it goes straight to another one
+    if(*token == YYEMPTY)
+        rec->depth -= brace(rec->last);
+    int level = rec->depth - ((*token == YYEMPTY)? 0: brace(*token));
+
+    for(;;) {
+        if(*token == YYEMPTY)
+            *token = next_token(lval, lloc, ctx->scanner, ctx);
+        if(*token <= YYEOF)
+            return 1;
+
+        int home = home_depth(list, *token, level);
+        if(home >= 0) {
+            // the braces that were skipped are not open
+            rec->depth = level;
+            if(home < level) {
+                rec->token = *token;
+                rec->line = lloc->first_line;
+                rec->col = lloc->first_column;
+                rec->end_line = lloc->last_line;
+                rec->end_col = lloc->last_column;
+                rec->offset = lloc->offset;
+                rec->length = lloc->length;
+                rec->closes = level - home;
+                *token = next_token(lval, lloc, ctx->scanner, ctx);
+            }
+            return 1;
+        }
+        if(rec->depth - brace(*token) == level && starts_item(list, *token) &&
+                    (*token == '}' || lloc->first_line > rec->prev_line))
+            return 1;
+
+        item->last_line = lloc->last_line;
+        item->last_column = lloc->last_column;
+        item->length = lloc->offset + lloc->length - item->offset;
+        *token = YYEMPTY;
+    }
+}
+
+static void check_symbol(int line, int col, const char* name, symbols_error_t err) {
+
+    if(err == SYM_EXISTS)
+        error_at("defined", line, col, "%s is already defined", name);
+    else if(err != SYM_NO_ERROR)
+        error_at("symbol", line, col, "%s: %s", name, SE_TOSTR(err));
+}
+
+/*
+ * Methods can be overloaded, the parameters tell them apart, so a method that
+ * has the name of another method in the same scope is not an error.
+ */
+static symbols_error_t add_method(const char* name, symbol_data_t* data, int line, int col) {
+
+    symbol_data_t old;
+
+    symbols_error_t err = add_symbol_at(name, data, line, col);
+    if(err == SYM_EXISTS && find_symbol(name, &old) == SYM_NO_ERROR && old.type == ST_METHOD)
+        err = SYM_NO_ERROR;
+
+    return err;
+}
+
+static symbol_type_t spec_type(ast_t* ast, ast_idx_t spec) {
+
+    if(spec == AST_NONE || AST_NODE(ast, spec)->op != 0)
+        return ST_OBJECT; // list or dict
+
+    switch(AST_NODE(ast, AST_CHILD(ast, spec, 0))->op) {
+        case INT: return ST_INUM;
+        case UINT: return ST_UNUM;
+        case FLOAT: return ST_FNUM;
+        case STRING: return ST_STRING;
+        case BOOL: return ST_BOOL;
+        default: return ST_OBJECT;
+    }
+}
+
+/*
+ * Add a variable or method declaration to the current scope.
+ */
+static void declare(parse_ctx_t* ctx, ast_idx_t decl, int flags, int assigned) {
+
+    ast_t* ast = ctx->ast;
+    ast_node_t* node = AST_NODE(ast, decl);
+    const char* name = AST_VALUE(ast, decl)->str;
+    if(node->kind == AST_ERROR || name == NULL)
+        return;
+
+    ast_idx_t spec = node->child[0];
+    symbol_data_t data;
+    memset(&data, 0, sizeof(data));
+    data.type = (node->kind == AST_VAR_DECL)? spec_type(ast, spec): ST_METHOD;
+    data.is_assigned = assigned? 1: 0;
+    data.is_const = (spec != AST_NONE && (AST_NODE(ast, spec)->flags & AST_F_CONST))? 1: 0;
+    data.is_private = (flags & AST_F_PRIVATE)? 1: 0;
+
+    check_symbol(node->line, node->col, name, (data.type == ST_METHOD)?
+                add_method(name, &data, node->line, node->col):
+                add_symbol_at(name, &data, node->line, node->col));
+}
+
+/*
+ * Add the method parameters to the method scope.
+ */
+static void declare_list(parse_ctx_t* ctx, ast_idx_t list) {
+
+    for(ast_idx_t item = ast_list_first(ctx->ast, list); item != AST_NONE;
+                item = AST_NODE(ctx->ast, item)->next)
+        declare(ctx, item, 0, 1);
+}
+
+/*
+ * Open the scope of a method definition. A plain name is defined in the
+ * current scope. For a qualified name, such as s.m or s.ctor, the method
+ * scope is opened under the struct or name space that it belongs to, so the
+ * members of that are visible in the body.
+ */
+static void open_method(parse_ctx_t* ctx, ast_idx_t def) {
+
+    ast_t* ast = ctx->ast;
+    ast_node_t* node = AST_NODE(ast, def);
+    int kind = node->op;
+    ast_idx_t id = node->child[1];
+
+    if(AST_KIND(ast, id) != AST_COMPOUND_ID) {
+        push_method_scope(NULL);
+        return;
+    }
+
+    ast_idx_t list = AST_CHILD(ast, id, 0);
+    size_t count = ast_list_count(ast, list);
+    const char** names = ALLOC_LST(count, const char*);
+    size_t n = 0;
+    for(ast_idx_t item = ast_list_first(ast, list); item != AST_NONE;
+                item = AST_NODE(ast, item)->next)
+        names[n++] = AST_VALUE(ast, item)->str;
+
+    scope_t* owner = NULL;
+    if(kind == AST_M_METHOD && count == 1) {
+        symbol_data_t data;
+        memset(&data, 0, sizeof(data));
+        data.type = ST_METHOD;
+        data.is_assigned = 1;
+        ast_node_t* first = AST_NODE(ast, ast_list_first(ast, list));
+        check_symbol(node->line, node->col, names[0],
+                    add_method(names[0], &data, first->line, first->col));
+    }
+    else {
+        // a method is owned by the prefix, a ctor or dtor by the whole name
+        size_t len = (kind == AST_M_METHOD)? count - 1: count;
+        // the owner can be in a file that is imported, so not finding it
+        // here is not an error
+        owner = find_scope(names, len);
+        if(owner != NULL && kind != AST_M_METHOD && get_scope_kind(owner) != SCOPE_STRUCT)
+            error_at("struct", node->line, node->col, "%s is not a struct", names[len - 1]);
+    }
+
+    push_method_scope(owner);
+    FREE(names);
 }
@@ -0,0 +1,490 @@
+/*
+ * Incremental parsing of a file that is being edited. See reparse.h.
+ *
+ * The items after the change are only kept if the change cannot have
+ * changed how they scan. The first one kept has to start its own line, with
+ * nothing but spaces or tabs before it. The text that is parsed then ends
+ * at a new line, so it cannot end in the middle of a token or of a // comment
+ * and the column of the item is the same as before. The scanner has to end
+ * it outside of a comment or a string, and the parse has to be clean,
+ * since a syntax error could swallow the items after it. The two items
+ * before the first one kept have to have been clean too, since the parser
+ * reports nothing for a few tokens after it recovers from an error, so
+ * what it found in an item depends on the ones before it. The struct names
+ * have to be the same, since they decide which identifiers are type names
+ * in the rest of the file.
+ *
+ * The symbols of every item are tagged with it, so the items that are kept
+ * are not declared again. While the changed part is parsed, the symbols of
+ * the items after it are hidden, the way a parse of the whole file would not
+ * have seen them yet, and those of the items that it replaces are hidden for
+ * good. Their nodes, symbols and diagnostics keep the lines they were made
+ * with, and an item that moves only adds the lines to its own moved count.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "memory.h"
+#include "errors.h"
+#include "intern.h"
+#include "ast.h"
+#include "symbols.h"
+#include "typenames.h"
+#include "context.h"
+#include "parser.h"
+#include "reparse.h"
+
+static void reserve(document_t* doc, size_t len) {
+
+    if(len + 2 > doc->cap) {
+        while(len + 2 > doc->cap)
+            doc->cap = (doc->cap == 0)? 0x01 << 12: doc->cap << 1;
+        doc->text = REALLOC_LST(doc->text, doc->cap, char);
+    }
+}
+
+// the number of struct names that the items before this one declared
+static size_t types_before(parse_ctx_t* ctx, size_t item) {
+
+    size_t count = 0;
+    for(size_t i = 0; i < item; i++)
+        count += ctx->items[i].ntypes;
+    return count;
+}
+
+static const char** copy_types(parse_ctx_t* ctx, size_t first, size_t count) {
+
+    const char** names = ALLOC_LST(count + 1, const char*);
+    memcpy(names, ctx->type_names + first, count * sizeof(const char*));
+    return names;
+}
+
+/*
+ * Return non-zero if the item had errors, or had one that the parser did
+ * not report because it was still recovering from the one before.
+ */
+static int dirty(const item_span_t* item) {
+
+    return item->errors > 0 || item->recovered;
+}
+
+/*
+ * Return non-zero if only spaces and tabs come between the start of the line
+ * and the position.
+ */
+static int starts_line(const char* text, size_t pos) {
+
+    while(pos > 0 && (text[pos - 1] == ' ' || text[pos - 1] == '\t'))
+        pos--;
+    return pos == 0 || text[pos - 1] == '\n';
+}
+
+/*
+ * Return the number of lines in the text if it has nothing in it but white
+ * space and comments, which the parser would not see at all, or -1. Open is
+ * set if the text ends inside a comment.
+ */
+static int blank_lines(const char* text, size_t len, int* open) {
+
+    int lines = 0;
+
+    *open = 0;
+    for(size_t i = 0; i < len; i++) {
+        char ch = text[i];
+        if(ch == '\n')
+            lines++;
+        else if(ch == '/' && i + 1 < len && text[i + 1] == '*') {
+            for(i += 2; i < len && !(text[i] == '*' && i + 1 < len && text[i + 1] == '/'); i++)
+                if(text[i] == '\n')
+                    lines++;
+            if(i >= len)
+                *open = 1;
+            i++;
+        }
+        else if(ch == '/' && i + 1 < len && text[i + 1] == '/') {
+            while(i + 1 < len && text[i + 1] != '\n')
+                i++;
+        }
+        else if(ch != ' ' && ch != '\t' && ch != '\v' && ch != '\f' && ch != ';')
+            return -1;
+    }
+
+    return lines;
+}
+
+/*
+ * Make the type names the first count of the names in the order that they
+ * were declared.
+ */
+static void reset_types(parse_ctx_t* ctx, size_t count) {
+
+    destroy_type_set(ctx->types);
+    ctx->types = create_type_set();
+    for(size_t i = 0; i < count; i++)
+        add_type_name(ctx->types, ctx->type_names[i]);
+}
+
+/*
+ * Make the list of the items the root of the AST again.
+ */
+static void link_items(parse_ctx_t* ctx) {
+
+    ast_t* ast = ctx->ast;
+
+    if(ctx->nitems == 0) {
+        ast->root = AST_NONE;
+        return;
+    }
+
+    ast_idx_t root = ast_list_new(ast, ctx->items[0].line, ctx->items[0].col);
+    for(size_t i = 0; i < ctx->nitems; i++) {
+        AST_NODE(ast, ctx->items[i].node)->next = AST_NONE;
+        ast_list_append(ast, root, ctx->items[i].node);
+    }
+    ast->root = root;
+}
+
+/*
+ * Forget the diagnostics of items that are not in the file any more.
+ */
+static void forget_diags(item_span_t* items, size_t first, size_t end) {
+
+    for(size_t i = first; i < end; i++) {
+        destroy_diag_sink(items[i].diags);
+        items[i].diags = NULL;
+    }
+}
+
+// what the sink has after the last item, which the document keeps
+static void keep_tail_diags(document_t* doc, diag_sink_t* sink) {
+
+    parse_ctx_t* ctx = doc->ctx;
+
+    destroy_diag_sink(doc->tail_diags);
+    doc->tail_diags = NULL;
+    if(sink->count > ctx->item_diags) {
+        doc->tail_diags = create_diag_sink(0);
+        copy_diags(doc->tail_diags, sink, ctx->item_diags, 0);
+    }
+}
+
+/*
+ * Put the diagnostics of every item in the context's sink, on the lines
+ * that the items are on now.
+ */
+static void collect_diags(document_t* doc) {
+
+    parse_ctx_t* ctx = doc->ctx;
+
+    clear_diags(ctx->diags);
+    for(size_t i = 0; i < ctx->nitems; i++)
+        if(ctx->items[i].diags != NULL)
+            copy_diags(ctx->diags, ctx->items[i].diags, 0, ctx->items[i].moved);
+    if(doc->tail_diags != NULL)
+        copy_diags(ctx->diags, doc->tail_diags, 0, doc->tail_moved);
+}
+
+static void count_errors(document_t* doc) {
+
+    parse_ctx_t* ctx = doc->ctx;
+    size_t live = 0;
+
+    ctx->errors = doc->tail_errors;
+    for(size_t i = 0; i < ctx->nitems; i++) {
+        ctx->errors += ctx->items[i].errors;
+        live += ctx->items[i].end - ctx->items[i].first;
+    }
+    doc->garbage = ctx->ast->count - live;
+}
+
+/*
+ * Parse the whole text again from nothing, and forget the diagnostics of
+ * the parses before.
+ */
+int reparse_document(document_t* doc) {
+
+    parse_ctx_t* ctx = doc->ctx;
+
+    forget_diags(ctx->items, 0, ctx->nitems);
+    destroy_scope(ctx->symbols);
+    ctx->symbols = NULL;
+    reset_types(ctx, 0);
+    destroy_ast(ctx->ast);
+    ctx->ast = create_ast();
+    ctx->nitems = 0;
+    ctx->item_serial = 0;
+    ctx->ntypes = 0;
+    ctx->errors = 0;
+    clear_diags(ctx->diags);
+    ctx->line_no = 1;
+    ctx->col_no = 1;
+    ctx->offset = 0;
+
+    parse_context_text(ctx, doc->text, doc->len);
+    keep_tail_diags(doc, ctx->diags);
+    doc->tail_errors = ctx->errors - ctx->item_errors;
+    doc->tail_serial = ctx->item_serial;
+    doc->tail_moved = 0;
+    doc->reused = 0;
+    doc->reparsed = ctx->nitems;
+    doc->scanned = doc->len;
+    count_errors(doc);
+
+    return ctx->errors;
+}
+
+/*
+ * Return the item that the offset is in, or the last one before it, or NULL
+ * if there is none.
+ */
+const item_span_t* document_item_at(document_t* doc, size_t offset) {
+
+    parse_ctx_t* ctx = doc->ctx;
+    size_t lo = 0, hi = ctx->nitems;
+
+    while(lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if(ctx->items[mid].offset <= offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return (lo > 0)? &ctx->items[lo - 1]: NULL;
+}
+
+/*
+ * Return the line that a symbol of the document is on now.
+ */
+int document_symbol_line(document_t* doc, const symbol_table_t* sym) {
+
+    parse_ctx_t* ctx = doc->ctx;
+
+    if(sym->item >= 0 && sym->item == doc->tail_serial)
+        return sym->line_no + doc->tail_moved;
+    if(sym->item >= 0)
+        for(size_t i = 0; i < ctx->nitems; i++)
+            if(ctx->items[i].serial == sym->item)
+                return sym->line_no + ctx->items[i].moved;
+    return sym->line_no;
+}
+
+/*
+ * Make a document with a copy of the text, which is not parsed yet. This
+ * lets the caller set up the context before the first parse.
+ */
+document_t* create_document(const char* fname, const char* text, size_t len) {
+
+    document_t* doc = ALLOC_DS(document_t);
+
+    doc->ctx = create_context(intern_str(fname));
+    doc->ctx->keep_items = 1;
+    reserve(doc, len);
+    memcpy(doc->text, text, len);
+    doc->len = len;
+    doc->text[len] = doc->text[len + 1] = '\0';
+
+    return doc;
+}
+
+document_t* open_document(const char* fname, const char* text, size_t len) {
+
+    document_t* doc = create_document(fname, text, len);
+    reparse_document(doc);
+    return doc;
+}
+
+void close_document(document_t* doc) {
+
+    if(doc != NULL) {
+        destroy_context(doc->ctx);
+        destroy_diag_sink(doc->tail_diags);
+        if(doc->text != NULL)
+            FREE(doc->text);
+        FREE(doc);
+    }
+}
+
+/*
+ * Parse the text from start to end, with the symbols and type names of the
+ * items before it in the context. The diagnostics go to a sink of their own,
+ * from which the items it makes take theirs. Returns 0 if the parse
+ * is good enough to keep the items after it, and sets the line where it
+ * ended.
+ */
+static int parse_range(document_t* doc, size_t start, size_t end, int line, int col,
+                        diag_sink_t* found, int* end_line) {
+
+    parse_ctx_t* ctx = doc->ctx;
+    int open;
+    int lines = blank_lines(doc->text + start, end - start, &open);
+
+    doc->scanned += end - start;
+    if(lines >= 0) {
+        *end_line = line + lines;
+        return open;
+    }
+
+    diag_sink_t* diags = ctx->diags;
+    ctx->diags = found;
+
+    char saved[2] = { doc->text[end], doc->text[end + 1] };
+    int errors = ctx->errors;
+
+    doc->text[end] = doc->text[end + 1] = '\0';
+    ctx->line_no = line;
+    ctx->col_no = col;
+    ctx->offset = start;
+    int status = parse_context_text(ctx, doc->text + start, end - start);
+    doc->text[end] = saved[0];
+    doc->text[end + 1] = saved[1];
+
+    ctx->diags = diags;
+
+    *end_line = ctx->line_no;
+    return status < 0 || ctx->errors != errors;
+}
+
+/*
+ * Replace removed bytes of the text at the offset with the new text and
+ * bring the parse up to date. Returns the number of errors in the file, or
+ * -1 if the range is not in the text.
+ */
+int edit_document(document_t* doc, size_t offset, size_t removed,
+                        const char* text, size_t len) {
+
+    parse_ctx_t* ctx = doc->ctx;
+
+    if(offset > doc->len || removed > doc->len - offset)
+        return -1;
+
+    size_t old_len = doc->len;
+    reserve(doc, old_len - removed + len);
+    memmove(doc->text + offset + len, doc->text + offset + removed,
+                old_len - offset - removed);
+    memcpy(doc->text + offset, text, len);
+    doc->len = old_len - removed + len;
+    doc->text[doc->len] = doc->text[doc->len + 1] = '\0';
+
+    if(ctx->nitems == 0 || doc->garbage > ctx->ast->count / 2)
+        return reparse_document(doc);
+
+    // the items that the change touches, which can be none
+    item_span_t* items = ctx->items;
+    size_t n = ctx->nitems;
+    long delta = (long)len - (long)removed;
+    size_t lo = 0;
+    while(lo < n && items[lo].offset + items[lo].length < offset)
+        lo++;
+    // after a syntax error the parser reports nothing for a few tokens, so
+    // start and end where the items before are clean
+    while(lo > 0 && (dirty(&items[lo - 1]) || (lo > 1 && dirty(&items[lo - 2]))))
+        lo--;
+    size_t hi = lo;
+    while(hi < n && items[hi].offset <= offset + removed)
+        hi++;
+    while(hi < n && (!starts_line(doc->text, items[hi].offset + delta) ||
+                (hi > 0 && dirty(&items[hi - 1])) || (hi > 1 && dirty(&items[hi - 2]))))
+        hi++;
+
+    size_t start = (lo > 0)? items[lo - 1].offset + items[lo - 1].length: 0;
+    int line = (lo > 0)? items[lo - 1].end_line: 1;
+    int col = (lo > 0)? items[lo - 1].end_col: 1;
+
+    // what is kept after the change, since parsing moves the arrays
+    size_t tlo = types_before(ctx, lo);
+    size_t thi = tlo;
+    for(size_t i = lo; i < hi; i++)
+        thi += items[i].ntypes;
+    size_t nkept = n - hi;
+    size_t nkept_types = ctx->ntypes - thi;
+    item_span_t* kept = ALLOC_LST(nkept + 1, item_span_t);
+    memcpy(kept, items + hi, nkept * sizeof(item_span_t));
+    const char** kept_types = copy_types(ctx, thi, nkept_types);
+    const char** old_types = copy_types(ctx, tlo, thi - tlo);
+
+    diag_sink_t* found = create_diag_sink(0);
+    int end_line;
+
+    // what the items from lo on declared is out of sight while the range is
+    // parsed, for good for the ones it replaces
+    for(size_t i = lo; i < n; i++)
+        hide_item_symbols(ctx->symbols, items[i].serial, 1);
+    hide_item_symbols(ctx->symbols, doc->tail_serial, 1);
+    forget_diags(items, lo, hi);
+
+    doc->scanned = 0;
+    for(;;) {
+        size_t end = (nkept > 0)? kept[0].offset + delta: doc->len;
+
+        // and anything declared after the last item of a range before
+        hide_item_symbols(ctx->symbols, ctx->item_serial++, 1);
+        if(ctx->ntypes > tlo)
+            reset_types(ctx, tlo);
+        ctx->nitems = lo;
+        ctx->ntypes = tlo;
+        ctx->errors = ctx->item_errors = 0;
+
+        int bad = parse_range(doc, start, end, line, col, found, &end_line);
+        if(nkept == 0)
+            break;
+        if(!bad && ctx->ntypes - tlo == thi - tlo && (thi == tlo ||
+                    memcmp(ctx->type_names + tlo, old_types, (thi - tlo) * sizeof(const char*)) == 0))
+            break;
+
+        // parse to the end of the file instead
+        for(size_t i = lo; i < ctx->nitems; i++)
+            hide_item_symbols(ctx->symbols, ctx->items[i].serial, 1);
+        forget_diags(ctx->items, lo, ctx->nitems);
+        forget_diags(kept, 0, nkept);
+        clear_diags(found);
+        nkept = 0;
+    }
+
+    doc->reparsed = ctx->nitems - lo;
+    doc->reused = lo + nkept;
+    if(nkept == 0) {
+        keep_tail_diags(doc, found);
+        doc->tail_errors = ctx->errors - ctx->item_errors;
+        doc->tail_serial = ctx->item_serial;
+        doc->tail_moved = 0;
+    }
+    else {
+        int lines = end_line - kept[0].line;
+        for(size_t i = 0; i < nkept; i++) {
+            item_span_t item = kept[i];
+            item.offset += delta;
+            item.line += lines;
+            item.end_line += lines;
+            item.moved += lines;
+            hide_item_symbols(ctx->symbols, item.serial, 0);
+            if(ctx->nitems == ctx->items_cap) {
+                ctx->items_cap <<= 1;
+                ctx->items = REALLOC_LST(ctx->items, ctx->items_cap, item_span_t);
+            }
+            ctx->items[ctx->nitems++] = item;
+        }
+        hide_item_symbols(ctx->symbols, doc->tail_serial, 0);
+        doc->tail_moved += lines;
+        // the names are the same as before, so they are still there
+        ctx->ntypes = thi;
+        memcpy(ctx->type_names + thi, kept_types, nkept_types * sizeof(const char*));
+        for(size_t i = thi; i < thi + nkept_types; i++)
+            add_type_name(ctx->types, ctx->type_names[i]);
+        ctx->ntypes += nkept_types;
+
+        // and the ones after a syntax error that ended the parse
+        for(size_t i = types_before(ctx, ctx->nitems); i < ctx->ntypes; i++)
+            add_type_name(ctx->types, ctx->type_names[i]);
+    }
+
+    FREE(kept_types);
+    FREE(old_types);
+    destroy_diag_sink(found);
+    FREE(kept);
+    link_items(ctx);
+    count_errors(doc);
+    collect_diags(doc);
+
+    return ctx->errors;
+}
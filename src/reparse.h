@@ -0,0 +1,55 @@
+#ifndef __REPARSE_H__
+#define __REPARSE_H__
+
+#include <stddef.h>
+
+#include "context.h"
+
+/*
+ * A source file that is kept parsed while it is edited, as an editor would
+ * have it. The context has the AST, the symbols and the type names of the
+ * whole text and keeps the place of every top level item. An edit scans and
+ * parses the text from the end of the last item before the change to the
+ * start of the first item after it, and the items outside that range keep
+ * their nodes and their symbols. The nodes and symbols of an item have the
+ * lines it had when it was parsed, and the item has how many lines it moved
+ * since then, so the line of a node is its line plus the item's moved.
+ *
+ * The range grows to the end of the file when what was parsed could change
+ * how the rest scans or parses: a syntax error, a comment or string that is
+ * still open at the end, or a different set of struct names. The nodes of
+ * the items that were replaced stay in the AST until there are more of them
+ * than of the live ones, and then the whole file is parsed again.
+ *
+ * Every item keeps what was reported while it was parsed, and so does the
+ * document for the text after the last item. After an edit the context's
+ * sink has the diagnostics of the whole file, made again from those of the
+ * items, so the ones of the items that were kept are on their lines now.
+ */
+typedef struct {
+    parse_ctx_t* ctx;
+    char* text;             // followed by two NUL bytes
+    size_t len;
+    size_t cap;
+    int tail_errors;        // errors after the last item
+    int tail_serial;        // what the symbols after it are tagged with
+    int tail_moved;         // and the lines they moved since
+    diag_sink_t* tail_diags; // what was reported after it, or NULL
+    size_t garbage;         // nodes that no item uses
+
+    // what the last edit did
+    size_t reused;          // items kept
+    size_t reparsed;        // items made by the parse
+    size_t scanned;         // bytes scanned
+} document_t;
+
+document_t* create_document(const char* fname, const char* text, size_t len);
+document_t* open_document(const char* fname, const char* text, size_t len);
+void close_document(document_t* doc);
+int edit_document(document_t* doc, size_t offset, size_t removed,
+                        const char* text, size_t len);
+int reparse_document(document_t* doc);
+const item_span_t* document_item_at(document_t* doc, size_t offset);
+int document_symbol_line(document_t* doc, const symbol_table_t* sym);
+
+#endif /* __REPARSE_H__ */
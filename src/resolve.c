@@ -0,0 +1,865 @@
+/*
+ * Name resolution for the interpreter. This runs over the AST of a file that
+ * parsed without errors and fills in a binding for every name that is used
+ * in executable code:
+ *
+ *  - Locals and parameters get a slot in the frame of their method. Slots
+ *    are handed out in order and are given back at the end of the block,
+ *    so a method's frame is as big as its deepest set of live locals.
+ *  - Other names are looked for among the variables that are defined in
+ *    name spaces, preferring the name space of the method.
+ *  - Formatted strings are bound to a plan of their format.
+ *  - Calls are bound to a builtin or to a method, matched by the trailing
+ *    parts of the qualified name and by the number of arguments. Between
+ *    overloaded methods the static types of the arguments decide, and only
+ *    a call with an argument whose type is not known until it runs, where
+ *    the overloads differ, is left to choose then.
+ *  - An index, a method of a list or a dict and the length, such as xs[i],
+ *    xs.append(x) and xs.length, bind the last part of the name to the
+ *    variable of the list or dict.
+ *  - A field of a struct, such as c.value.ival, is bound to its offset, and
+ *    a method of a struct, such as c.get_type(), to the method. Both bind
+ *    the last part to the variable of the struct. In a method of a struct
+ *    the fields and methods of the instance it runs on need no variable,
+ *    which is the hidden first parameter.
+ *
+ * Names that cannot be resolved are left as BIND_NONE. That is not an error
+ * until the interpreter tries to evaluate one, because much of what parses,
+ * such as constructors, does not run yet.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "memory.h"
+#include "intern.h"
+#include "resolve.h"
+#include "runtime.h"
+#include "parser.h"
+
+#define MAX_PARTS       16
+#define MAX_CANDIDATES  32
+
+typedef struct {
+    const char* name;
+    ast_idx_t decl;
+    int slot;
+    uint8_t type;
+    int layout;             // if the type is VAL_STRUCT
+} local_t;
+
+typedef struct {
+    program_t* prog;
+    ast_t* ast;
+    const char* space;      // name space of the code being resolved
+    local_t* locals;        // innermost last
+    int nlocals;
+    int cap;
+    int nslots;
+    int max_slots;
+    int owner;              // struct of the method being resolved, or -1
+} resolver_t;
+
+static const struct {
+    const char* parts[2];
+    builtin_t id;
+} builtins[] = {
+    {{"system", "print"}, BUILTIN_PRINT},
+};
+
+#define NUM_BUILTINS    (sizeof(builtins) / sizeof(builtins[0]))
+
+// nargs is -1 for what is used without parentheses
+static const struct {
+    const char* name;
+    builtin_t id;
+    int nargs;
+} container_methods[] = {
+    {"append", BUILTIN_APPEND, 1},
+    {"slice", BUILTIN_SLICE, 2},
+    {"has", BUILTIN_HAS, 1},
+    {"length", BUILTIN_LENGTH, -1},
+};
+
+#define NUM_CONTAINER_METHODS   (sizeof(container_methods) / sizeof(container_methods[0]))
+
+static void resolve_node(resolver_t* res, ast_idx_t idx);
+
+/*
+ * Return the run time type of a type specifier. A list or a dict of bools,
+ * numbers or strings is LIST_TYPE() or DICT_TYPE() of its elements. Structs
+ * are VAL_ANY here, see decl_type(), and other lists and dicts for now.
+ */
+int spec_type(ast_t* ast, ast_idx_t spec) {
+
+    int type;
+
+    if(spec == AST_NONE)
+        return VAL_NOTHING;
+
+    switch(AST_NODE(ast, AST_CHILD(ast, spec, 0))->op) {
+        case BOOL: type = VAL_BOOL; break;
+        case INT: type = VAL_INT; break;
+        case UINT: type = VAL_UINT; break;
+        case FLOAT: type = VAL_FLOAT; break;
+        case STRING: type = VAL_STRING; break;
+        case NOTHING: type = VAL_NOTHING; break;
+        default: return VAL_ANY;
+    }
+
+    switch(AST_NODE(ast, spec)->op) {
+        case 0: return type;
+        case LIST: return (type != VAL_NOTHING)? LIST_TYPE(type): VAL_ANY;
+        case DICT: return (type != VAL_NOTHING)? DICT_TYPE(type): VAL_ANY;
+        default: return VAL_ANY;
+    }
+}
+
+/*
+ * The type of a declaration, with the layout if it is a struct.
+ */
+static int decl_type(program_t* prog, const char* space, ast_idx_t spec, int* layout) {
+
+    ast_t* ast = prog->ast;
+    int type = spec_type(ast, spec);
+
+    *layout = -1;
+    if(type != VAL_ANY || AST_NODE(ast, spec)->op != 0 ||
+                    AST_NODE(ast, AST_CHILD(ast, spec, 0))->op != TYPEDEF_NAME)
+        return type;
+    *layout = find_layout(prog->layouts, prog->nlayouts, space,
+                    AST_VALUE(ast, AST_CHILD(ast, spec, 0))->str);
+    return (*layout >= 0)? VAL_STRUCT: VAL_ANY;
+}
+
+// the struct that the parts before the name of a method are the path of
+static int method_owner(program_t* prog, method_t* m) {
+
+    char buf[256];
+    size_t len = 0;
+
+    if(m->nparts < 2)
+        return -1;
+    for(int i = 0; i < m->nparts - 1 && len < sizeof(buf); i++)
+        len += snprintf(buf + len, sizeof(buf) - len, (i > 0)? ".%s": "%s", m->parts[i]);
+    if(len >= sizeof(buf))
+        return -1;
+
+    const char* path = intern_find(buf);
+    for(int i = 0; i < prog->nlayouts; i++)
+        if(prog->layouts[i].path == path && prog->layouts[i].space == m->space)
+            return i;
+    return -1;
+}
+
+static const char* type_text(program_t* prog, int type) {
+
+    if(IS_STRUCT_TYPE(type))
+        return prog->layouts[type - STRUCT_TYPE(0)].path;
+    return (type == VAL_ANY)? "any": VAL_TOSTR(type);
+}
+
+/*
+ * The types of the parameters, and the signature, which is the qualified
+ * name with the types of the parameters.
+ */
+static void method_signature(program_t* prog, method_t* m) {
+
+    ast_t* ast = prog->ast;
+    char buf[512];
+    size_t len = 0;
+    int i = 0;
+
+    m->ptypes = ALLOC_LST(m->nparams + 1, uint16_t);
+    if(m->space != NULL)
+        len += snprintf(buf, sizeof(buf), "%s.", m->space);
+    for(int j = 0; j < m->nparts && len < sizeof(buf); j++)
+        len += snprintf(buf + len, sizeof(buf) - len, (j > 0)? ".%s": "%s", m->parts[j]);
+    for(ast_idx_t p = ast_list_first(ast, m->params); p != AST_NONE; p = AST_NODE(ast, p)->next) {
+        int layout;
+        int type = decl_type(prog, m->space, AST_CHILD(ast, p, 0), &layout);
+        m->ptypes[i] = (type == VAL_STRUCT)? STRUCT_TYPE(layout): type;
+        if(len < sizeof(buf))
+            len += snprintf(buf + len, sizeof(buf) - len, "%s%s", (i == 0)? "(": ",",
+                                type_text(prog, m->ptypes[i]));
+        i++;
+    }
+    if(len < sizeof(buf))
+        snprintf(buf + len, sizeof(buf) - len, "%s", (i == 0)? "()": ")");
+    m->sig = intern_str(buf);
+}
+
+static void add_method(program_t* prog, const char* space, ast_idx_t def) {
+
+    ast_t* ast = prog->ast;
+    prog->methods = REALLOC_LST(prog->methods, prog->nmethods + 1, method_t);
+    method_t* m = &prog->methods[prog->nmethods++];
+    memset(m, 0, sizeof(method_t));
+
+    m->space = space;
+    m->def = def;
+    m->owner = -1;
+    if(AST_KIND(ast, def) == AST_ENTRY) {
+        m->body = AST_CHILD(ast, def, 0);
+        m->ret_type = VAL_NOTHING;
+        prog->entry = prog->nmethods - 1;
+        return;
+    }
+
+    ast_idx_t names = AST_CHILD(ast, AST_CHILD(ast, def, 1), 0);
+    m->nparts = (int)ast_list_count(ast, names);
+    m->parts = ALLOC_LST(m->nparts, const char*);
+    int i = 0;
+    for(ast_idx_t n = ast_list_first(ast, names); n != AST_NONE; n = AST_NODE(ast, n)->next)
+        m->parts[i++] = AST_VALUE(ast, n)->str;
+
+    m->params = AST_CHILD(ast, def, 2);
+    m->nparams = (int)ast_list_count(ast, m->params);
+    m->body = AST_CHILD(ast, def, 3);
+    m->ret_type = spec_type(ast, AST_CHILD(ast, def, 0));
+    m->owner = method_owner(prog, m);
+    method_signature(prog, m);
+}
+
+static void add_global(program_t* prog, const char* space, ast_idx_t def) {
+
+    ast_t* ast = prog->ast;
+    ast_idx_t decl = AST_CHILD(ast, def, 0);
+
+    prog->globals = REALLOC_LST(prog->globals, prog->nglobals + 1, global_t);
+    global_t* g = &prog->globals[prog->nglobals];
+    g->space = space;
+    g->name = AST_VALUE(ast, decl)->str;
+    g->def = def;
+    g->type = decl_type(prog, space, AST_CHILD(ast, decl, 0), &g->layout);
+
+    binding_t* b = BIND(prog, decl);
+    b->kind = BIND_GLOBAL;
+    b->type = g->type;
+    b->layout = g->layout;
+    b->index = prog->nglobals++;
+}
+
+/*
+ * Find the methods, the entry block and the name space variables.
+ */
+static void collect(program_t* prog) {
+
+    ast_t* ast = prog->ast;
+
+    for(ast_idx_t item = ast_list_first(ast, ast->root); item != AST_NONE;
+                        item = AST_NODE(ast, item)->next) {
+        if(AST_KIND(ast, item) == AST_ENTRY)
+            add_method(prog, NULL, item);
+        else if(AST_KIND(ast, item) == AST_NAMESPACE) {
+            const char* space = AST_VALUE(ast, item)->str;
+            for(ast_idx_t n = ast_list_first(ast, AST_CHILD(ast, item, 0)); n != AST_NONE;
+                                n = AST_NODE(ast, n)->next) {
+                if(AST_KIND(ast, n) == AST_METHOD_DEF && AST_NODE(ast, n)->op == AST_M_METHOD)
+                    add_method(prog, space, n);
+                else if(AST_KIND(ast, n) == AST_VAR_DEF)
+                    add_global(prog, space, n);
+            }
+        }
+    }
+}
+
+/*
+ * True if the name ends with the parts. The qualified name is the name
+ * space followed by the parts that the definition has.
+ */
+static int ends_with(const char* space, const char** names, int nnames,
+                        const char** parts, int nparts) {
+
+    if(nparts > nnames + ((space != NULL)? 1: 0))
+        return 0;
+
+    for(int i = 1; i <= nparts; i++) {
+        const char* name = (i <= nnames)? names[nnames - i]: space;
+        if(name != parts[nparts - i])
+            return 0;
+    }
+    return 1;
+}
+
+/*
+ * Put the methods that the name and the number of arguments match in the
+ * candidates and return how many there are. If some of them are in the name
+ * space of the code, only those are.
+ */
+static int find_methods(resolver_t* res, const char** parts, int nparts, int nargs, int* cands) {
+
+    program_t* prog = res->prog;
+    int count = 0;
+    int local = 0;
+
+    for(int i = 0; i < prog->nmethods && count < MAX_CANDIDATES; i++) {
+        method_t* m = &prog->methods[i];
+        if(m->parts == NULL || m->owner >= 0 || m->nparams != nargs ||
+                        !ends_with(m->space, m->parts, m->nparts, parts, nparts))
+            continue;
+        if(m->space == res->space && !local) {
+            local = 1;
+            count = 0;
+        }
+        if(m->space == res->space || !local)
+            cands[count++] = i;
+    }
+    return count;
+}
+
+static int find_global(resolver_t* res, const char** parts, int nparts) {
+
+    program_t* prog = res->prog;
+    int found = -1;
+
+    for(int i = 0; i < prog->nglobals; i++) {
+        global_t* g = &prog->globals[i];
+        if(!ends_with(g->space, &g->name, 1, parts, nparts))
+            continue;
+        if(g->space == res->space)
+            return i;
+        if(found < 0)
+            found = i;
+    }
+    return found;
+}
+
+static int find_builtin(const char** parts, int nparts) {
+
+    if(nparts != 2)
+        return -1;
+
+    for(size_t i = 0; i < NUM_BUILTINS; i++)
+        if(strcmp(parts[0], builtins[i].parts[0]) == 0 &&
+                        strcmp(parts[1], builtins[i].parts[1]) == 0)
+            return builtins[i].id;
+    return -1;
+}
+
+static int find_container_method(const char* name, int nargs) {
+
+    for(size_t i = 0; i < NUM_CONTAINER_METHODS; i++)
+        if(strcmp(name, container_methods[i].name) == 0 && nargs == container_methods[i].nargs)
+            return container_methods[i].id;
+    return -1;
+}
+
+static local_t* find_local(resolver_t* res, const char* name) {
+
+    for(int i = res->nlocals - 1; i >= 0; i--)
+        if(res->locals[i].name == name)
+            return &res->locals[i];
+    return NULL;
+}
+
+static void declare_local(resolver_t* res, ast_idx_t decl) {
+
+    if(res->nlocals + 1 > res->cap) {
+        res->cap = (res->cap == 0)? 32: res->cap << 1;
+        res->locals = REALLOC_LST(res->locals, res->cap, local_t);
+    }
+
+    local_t* loc = &res->locals[res->nlocals++];
+    loc->name = AST_VALUE(res->ast, decl)->str;
+    loc->decl = decl;
+    loc->slot = res->nslots++;
+    loc->type = decl_type(res->prog, res->space, AST_CHILD(res->ast, decl, 0), &loc->layout);
+    if(res->nslots > res->max_slots)
+        res->max_slots = res->nslots;
+
+    binding_t* b = BIND(res->prog, decl);
+    b->kind = BIND_LOCAL;
+    b->type = loc->type;
+    b->layout = loc->layout;
+    b->index = loc->slot;
+}
+
+/*
+ * The instance that a method of a struct runs on is in the first slot. It
+ * has no name, so only fields and methods without a variable find it.
+ */
+static void declare_self(resolver_t* res) {
+
+    if(res->nlocals + 1 > res->cap) {
+        res->cap = (res->cap == 0)? 32: res->cap << 1;
+        res->locals = REALLOC_LST(res->locals, res->cap, local_t);
+    }
+
+    local_t* loc = &res->locals[res->nlocals++];
+    loc->name = NULL;
+    loc->decl = AST_NONE;
+    loc->slot = res->nslots++;
+    loc->type = VAL_STRUCT;
+    loc->layout = res->owner;
+    if(res->nslots > res->max_slots)
+        res->max_slots = res->nslots;
+}
+
+static void bind_self(resolver_t* res, binding_t* b) {
+
+    b->kind = BIND_LOCAL;
+    b->index = 0;
+    b->type = VAL_STRUCT;
+    b->layout = res->owner;
+    b->decl = AST_NONE;
+}
+
+/*
+ * Bind the parts to a local or a global variable. Returns zero if there is
+ * no such variable.
+ */
+static int bind_variable(resolver_t* res, binding_t* b, const char** parts, int nparts) {
+
+    local_t* loc = (nparts == 1)? find_local(res, parts[0]): NULL;
+    if(loc != NULL) {
+        b->kind = BIND_LOCAL;
+        b->index = loc->slot;
+        b->type = loc->type;
+        b->layout = loc->layout;
+        b->decl = loc->decl;
+        return 1;
+    }
+
+    int g = find_global(res, parts, nparts);
+    if(g >= 0) {
+        b->kind = BIND_GLOBAL;
+        b->index = g;
+        b->type = res->prog->globals[g].type;
+        b->layout = res->prog->globals[g].layout;
+        return 1;
+    }
+    return 0;
+}
+
+// the field of the struct that the parts are the path of
+static const field_t* find_path(resolver_t* res, int layout, const char** parts, int nparts) {
+
+    char buf[256];
+    size_t len = 0;
+
+    for(int i = 0; i < nparts && len < sizeof(buf); i++)
+        len += snprintf(buf + len, sizeof(buf) - len, (i > 0)? ".%s": "%s", parts[i]);
+    if(len >= sizeof(buf))
+        return NULL;
+
+    const char* name = intern_find(buf);
+    return (name != NULL)? find_field(&res->prog->layouts[layout], name): NULL;
+}
+
+/*
+ * Bind the parts to a field: the parts after a variable of a struct or, in
+ * a method of a struct, all of them if they do not start with a local. The
+ * variable is bound to the last part. Returns zero if there is no such
+ * field.
+ */
+static int bind_field(resolver_t* res, binding_t* b, ast_idx_t last, const char** parts, int nparts) {
+
+    binding_t* var = BIND(res->prog, last);
+    const field_t* f = NULL;
+
+    for(int i = nparts - 1; i >= 1 && f == NULL; i--)
+        if(bind_variable(res, var, parts, i) && var->type == VAL_STRUCT)
+            f = find_path(res, var->layout, parts + i, nparts - i);
+    if(f == NULL && res->owner >= 0 && find_local(res, parts[0]) == NULL &&
+                    (f = find_path(res, res->owner, parts, nparts)) != NULL)
+        bind_self(res, var);
+
+    if(f == NULL) {
+        var->kind = BIND_NONE;
+        return 0;
+    }
+    b->kind = BIND_FIELD;
+    b->index = f->offset;
+    b->type = f->type;
+    return 1;
+}
+
+/*
+ * The methods of a struct that are called on a variable of the struct, or
+ * in a method of the same struct, on its own instance. The variable is
+ * bound to the last part. Returns the number of candidates.
+ */
+static int find_struct_methods(resolver_t* res, ast_idx_t last, const char** parts, int nparts,
+                        int nargs, int* cands) {
+
+    program_t* prog = res->prog;
+    binding_t* var = BIND(prog, last);
+    int owner = -1;
+    int count = 0;
+
+    if(nparts > 1 && bind_variable(res, var, parts, nparts - 1) && var->type == VAL_STRUCT)
+        owner = var->layout;
+    else if(nparts == 1 && res->owner >= 0) {
+        bind_self(res, var);
+        owner = res->owner;
+    }
+
+    for(int i = 0; owner >= 0 && i < prog->nmethods && count < MAX_CANDIDATES; i++) {
+        method_t* m = &prog->methods[i];
+        if(m->owner == owner && m->nparams == nargs && m->parts[m->nparts - 1] == parts[nparts - 1])
+            cands[count++] = i;
+    }
+    if(count == 0)
+        var->kind = BIND_NONE;
+    return count;
+}
+
+/*
+ * The static type of an expression that has been resolved, as a declared
+ * type, or VAL_ANY if it is not known until it runs.
+ */
+static int expr_type(resolver_t* res, ast_idx_t idx) {
+
+    ast_t* ast = res->ast;
+    binding_t* b = BIND(res->prog, idx);
+    int op = AST_NODE(ast, idx)->op;
+    int left, right;
+
+    switch(AST_KIND(ast, idx)) {
+        case AST_INUM: return VAL_INT;
+        case AST_UNUM: return VAL_UINT;
+        case AST_FNUM: return VAL_FLOAT;
+        case AST_BOOL: return VAL_BOOL;
+        case AST_FSTRING: return VAL_STRING;
+        case AST_CAST: return b->type;
+
+        case AST_COMPOUND_NAME:
+            if(b->kind == BIND_LOCAL || b->kind == BIND_GLOBAL)
+                return DECL_TYPE(b);
+            return (b->kind == BIND_NONE)? VAL_ANY: b->type;
+
+        case AST_UNARY:
+            if(op == NOT)
+                return VAL_BOOL;
+            left = expr_type(res, AST_CHILD(ast, idx, 0));
+            return (left == VAL_BOOL)? VAL_INT: IS_NUMBER_TYPE(left)? left: VAL_ANY;
+
+        case AST_BINARY:
+            if(op == AND_OP || op == OR_OP || op == EQ_OP || op == NE_OP ||
+                        op == '<' || op == '>' || op == LE_OP || op == GE_OP)
+                return VAL_BOOL;
+            left = expr_type(res, AST_CHILD(ast, idx, 0));
+            right = expr_type(res, AST_CHILD(ast, idx, 1));
+            if(op == '+' && left == VAL_STRING && right == VAL_STRING)
+                return VAL_STRING;
+            if(!IS_NUMBER_TYPE(left) || !IS_NUMBER_TYPE(right))
+                return VAL_ANY;
+            if(left == VAL_FLOAT || right == VAL_FLOAT)
+                return VAL_FLOAT;
+            return (left == VAL_UINT || right == VAL_UINT)? VAL_UINT: VAL_INT;
+
+        default:
+            return VAL_ANY;
+    }
+}
+
+/*
+ * Leave the choice between the candidates until the call runs, in a new set
+ * of the dispatch table.
+ */
+static void bind_dispatch(resolver_t* res, binding_t* b, const int* cands, int count) {
+
+    program_t* prog = res->prog;
+    int nargs = b->nargs;
+    int at = prog->ndispatch;
+
+    prog->ndispatch += SET_SIZE(count, nargs);
+    prog->dispatch = REALLOC_LST(prog->dispatch, prog->ndispatch, uint32_t);
+    uint32_t* set = &prog->dispatch[at];
+    SET_CANDIDATES(set) = count;
+    SET_NARGS(set) = nargs;
+    SET_SKIP(set) = (prog->methods[cands[0]].owner >= 0)? 1: 0;
+
+    b->kind = BIND_DISPATCH;
+    b->index = at;
+    b->type = prog->methods[cands[0]].ret_type;
+    for(int i = 0; i < count; i++) {
+        method_t* m = &prog->methods[cands[i]];
+        SET_METHOD(set, i) = cands[i];
+        for(int j = 0; j < nargs; j++)
+            SET_TYPES(set, i)[j] = m->ptypes[j];
+        if(m->ret_type != b->type)
+            b->type = VAL_ANY;
+    }
+}
+
+/*
+ * Bind a call to one of the candidates. Overloads are told apart by the
+ * static types of the arguments, and the one that fits them best is chosen,
+ * or the first of those that fit equally well. When an argument has no
+ * static type and the overloads do not all take the same type for it, the
+ * choice is left until the call runs.
+ */
+static void bind_call(resolver_t* res, binding_t* b, const int* cands, int count) {
+
+    program_t* prog = res->prog;
+    int types[DISPATCH_MAX_ARGS];
+    int nargs = b->nargs;
+    int best = cands[0], best_score = 0;
+
+    if(count > 1 && nargs <= DISPATCH_MAX_ARGS) {
+        int i = 0;
+        for(ast_idx_t a = ast_list_first(res->ast, b->args); a != AST_NONE;
+                            a = AST_NODE(res->ast, a)->next)
+            types[i++] = expr_type(res, a);
+
+        for(i = 0; i < nargs; i++) {
+            if(types[i] != VAL_ANY)
+                continue;
+            for(int c = 1; c < count; c++)
+                if(prog->methods[cands[c]].ptypes[i] != prog->methods[cands[0]].ptypes[i]) {
+                    bind_dispatch(res, b, cands, count);
+                    return;
+                }
+        }
+
+        for(int c = 0; c < count; c++) {
+            const uint16_t* params = prog->methods[cands[c]].ptypes;
+            int score = 0;
+            for(i = 0; i < nargs && score >= 0; i++) {
+                int match = (types[i] == VAL_ANY)? 1: type_match(types[i], params[i]);
+                score = (match > 0)? score + match: -1;
+            }
+            if(score > best_score) {
+                best = cands[c];
+                best_score = score;
+            }
+        }
+    }
+
+    b->kind = BIND_METHOD;
+    b->index = best;
+    b->type = prog->methods[best].ret_type;
+}
+
+// a formatted string is taken apart here, once
+static void bind_format(resolver_t* res, ast_idx_t idx) {
+
+    program_t* prog = res->prog;
+    binding_t* b = BIND(prog, idx);
+
+    prog->formats = REALLOC_LST(prog->formats, prog->nformats + 1, fmt_plan_t*);
+    prog->formats[prog->nformats] = create_format_plan(AST_VALUE(res->ast, idx)->str);
+    b->kind = BIND_FORMAT;
+    b->index = prog->nformats++;
+    b->type = VAL_STRING;
+}
+
+/*
+ * Bind a compound name. Only the last part may have parameters, and then
+ * only one set, which is either a call in parentheses or an index in
+ * brackets.
+ */
+static void resolve_name(resolver_t* res, ast_idx_t idx) {
+
+    ast_t* ast = res->ast;
+    binding_t* b = BIND(res->prog, idx);
+    const char* parts[MAX_PARTS];
+    ast_idx_t params = AST_NONE;
+    ast_idx_t last = AST_NONE;
+    int nparts = 0;
+    int bad = 0;
+
+    for(ast_idx_t n = ast_list_first(ast, AST_CHILD(ast, idx, 0)); n != AST_NONE;
+                        n = AST_NODE(ast, n)->next) {
+        if(params != AST_NONE || nparts >= MAX_PARTS)
+            bad = 1;
+        else
+            parts[nparts++] = AST_VALUE(ast, n)->str;
+        params = AST_CHILD(ast, n, 0);
+        resolve_node(res, params);
+        last = n;
+    }
+    if(bad)
+        return;
+
+    if(params != AST_NONE) {
+        ast_idx_t first = ast_list_first(ast, params);
+        if(ast_list_count(ast, params) != 1)
+            return;
+
+        if(AST_KIND(ast, first) == AST_INDEX) {
+            binding_t* var = BIND(res->prog, last);
+            if(!bind_variable(res, var, parts, nparts))
+                return;
+            b->kind = BIND_ELEMENT;
+            b->type = IS_CONTAINER_TYPE(var->type)? ELEM_TYPE(var->type): VAL_ANY;
+            b->args = AST_CHILD(ast, first, 0);
+            return;
+        }
+        if(AST_KIND(ast, first) != AST_CALL_PARAMS)
+            return;
+
+        b->args = AST_CHILD(ast, first, 0);
+        b->nargs = (uint16_t)ast_list_count(ast, b->args);
+        int cands[MAX_CANDIDATES];
+        int count;
+        int id = find_builtin(parts, nparts);
+        if(id >= 0) {
+            b->kind = BIND_BUILTIN;
+            b->index = id;
+        }
+        else if((count = find_struct_methods(res, last, parts, nparts, b->nargs, cands)) > 0 ||
+                        (count = find_methods(res, parts, nparts, b->nargs, cands)) > 0)
+            bind_call(res, b, cands, count);
+        else if(nparts > 1 && (id = find_container_method(parts[nparts - 1], b->nargs)) >= 0 &&
+                        bind_variable(res, BIND(res->prog, last), parts, nparts - 1)) {
+            int type = BIND(res->prog, last)->type;
+            b->kind = BIND_BUILTIN;
+            b->index = id;
+            b->type = (id == BUILTIN_SLICE)? type: (id == BUILTIN_HAS)? VAL_BOOL: VAL_NOTHING;
+        }
+        return;
+    }
+
+    if(bind_field(res, b, last, parts, nparts) || bind_variable(res, b, parts, nparts))
+        return;
+    if(nparts > 1 && find_container_method(parts[nparts - 1], -1) == BUILTIN_LENGTH &&
+                    bind_variable(res, BIND(res->prog, last), parts, nparts - 1)) {
+        b->kind = BIND_BUILTIN;
+        b->index = BUILTIN_LENGTH;
+        b->type = VAL_INT;
+        b->args = AST_NONE;
+        b->nargs = 0;
+    }
+}
+
+static void resolve_node(resolver_t* res, ast_idx_t idx) {
+
+    ast_t* ast = res->ast;
+    int nlocals, nslots;
+
+    if(idx == AST_NONE)
+        return;
+
+    switch(AST_KIND(ast, idx)) {
+        case AST_LIST:
+            for(ast_idx_t n = ast_list_first(ast, idx); n != AST_NONE; n = AST_NODE(ast, n)->next)
+                resolve_node(res, n);
+            break;
+
+        case AST_BLOCK:
+        case AST_FOR:
+            // locals end with the block, and the for loop is a block
+            nlocals = res->nlocals;
+            nslots = res->nslots;
+            for(int i = 0; i < 4; i++)
+                resolve_node(res, AST_CHILD(ast, idx, i));
+            res->nlocals = nlocals;
+            res->nslots = nslots;
+            break;
+
+        case AST_VAR_DEF:
+            // the initializer cannot see the variable it initializes
+            resolve_node(res, AST_CHILD(ast, idx, 1));
+            declare_local(res, AST_CHILD(ast, idx, 0));
+            break;
+
+        case AST_COMPOUND_NAME:
+            resolve_name(res, idx);
+            break;
+
+        case AST_FSTRING:
+            if(AST_CHILD(ast, idx, 0) != AST_NONE)
+                bind_format(res, idx);
+            resolve_node(res, AST_CHILD(ast, idx, 0));
+            break;
+
+        case AST_CAST:
+            BIND(res->prog, idx)->kind = BIND_TYPE;
+            BIND(res->prog, idx)->type = spec_type(ast, AST_CHILD(ast, idx, 0));
+            resolve_node(res, AST_CHILD(ast, idx, 1));
+            break;
+
+        case AST_TYPE_SPEC:
+        case AST_TYPE_NAME:
+        case AST_IDENT:
+            break;
+
+        default:
+            for(int i = 0; i < 4; i++)
+                resolve_node(res, AST_CHILD(ast, idx, i));
+            break;
+    }
+}
+
+static void resolve_method(resolver_t* res, method_t* m) {
+
+    res->space = m->space;
+    res->nlocals = 0;
+    res->nslots = 0;
+    res->max_slots = 0;
+    res->owner = m->owner;
+
+    if(m->owner >= 0)
+        declare_self(res);
+    for(ast_idx_t p = ast_list_first(res->ast, m->params); p != AST_NONE;
+                        p = AST_NODE(res->ast, p)->next)
+        declare_local(res, p);
+    resolve_node(res, m->body);
+
+    m->nslots = res->max_slots;
+}
+
+/*
+ * Resolve every name in the executable code of the AST. The AST must have
+ * parsed without errors and must not change while the program is in use.
+ */
+program_t* resolve_program(ast_t* ast) {
+
+    program_t* prog = ALLOC_DS(program_t);
+    prog->ast = ast;
+    prog->binds = ALLOC_LST(ast->count, binding_t);
+    prog->entry = -1;
+    prog->layouts = create_layouts(ast, &prog->nlayouts);
+    collect(prog);
+
+    resolver_t res;
+    memset(&res, 0, sizeof(res));
+    res.prog = prog;
+    res.ast = ast;
+    res.owner = -1;
+
+    // name space variables are initialized with only the globals in sight
+    for(int i = 0; i < prog->nglobals; i++) {
+        res.space = prog->globals[i].space;
+        resolve_node(&res, AST_CHILD(ast, prog->globals[i].def, 1));
+    }
+
+    for(int i = 0; i < prog->nmethods; i++)
+        resolve_method(&res, &prog->methods[i]);
+
+    if(res.locals != NULL)
+        FREE(res.locals);
+
+    fold_program(prog);
+    return prog;
+}
+
+void destroy_program(program_t* prog) {
+
+    if(prog != NULL) {
+        for(int i = 0; i < prog->nmethods; i++) {
+            if(prog->methods[i].parts != NULL)
+                FREE(prog->methods[i].parts);
+            if(prog->methods[i].ptypes != NULL)
+                FREE(prog->methods[i].ptypes);
+        }
+        if(prog->methods != NULL)
+            FREE(prog->methods);
+        if(prog->globals != NULL)
+            FREE(prog->globals);
+        if(prog->consts != NULL)
+            FREE(prog->consts);
+        destroy_arena(prog->arena);
+        destroy_layouts(prog->layouts, prog->nlayouts);
+        if(prog->dispatch != NULL)
+            FREE(prog->dispatch);
+        for(int i = 0; i < prog->nformats; i++)
+            destroy_format_plan(prog->formats[i]);
+        if(prog->formats != NULL)
+            FREE(prog->formats);
+        FREE(prog->binds);
+        FREE(prog);
+    }
+}
@@ -0,0 +1,125 @@
+#ifndef __RESOLVE_H__
+#define __RESOLVE_H__
+
+#include <stdint.h>
+#include "memory.h"
+#include "ast.h"
+#include "value.h"
+#include "layout.h"
+#include "format.h"
+
+/*
+ * The resolution pass decides once, before anything runs, what every name
+ * in the executable code refers to. Locals become slots in the frame of the
+ * method, so the interpreter never looks a name up while it runs.
+ */
+typedef enum {
+    BIND_NONE,      // not resolved, an error if it is ever evaluated
+    BIND_LOCAL,     // index = frame slot
+    BIND_GLOBAL,    // index = name space variable
+    BIND_METHOD,    // index = method, args = argument list
+    BIND_BUILTIN,   // index = builtin, args = argument list
+    BIND_TYPE,      // a cast or a declaration, type only
+    BIND_CONST,     // index = folded constant, type = its type
+    BIND_ELEMENT,   // args = index or key expression, type = element type
+    BIND_FIELD,     // index = offset in the struct, type = field type
+    BIND_DISPATCH,  // index = overload set in the dispatch table, args = argument list
+    BIND_FORMAT,    // index = plan of a formatted string
+} bind_kind_t;
+
+typedef enum {
+    BUILTIN_PRINT,
+    BUILTIN_APPEND,     // the methods of lists and dicts, called on
+    BUILTIN_LENGTH,     // the variable that the last part of the name
+    BUILTIN_SLICE,      // is bound to
+    BUILTIN_HAS,
+    BUILTIN_NUM,
+} builtin_t;
+
+/*
+ * What a node refers to. There is one for every node in the AST, found by
+ * the node's index; most of them are unused.
+ */
+typedef struct {
+    uint8_t kind;
+    uint8_t type;           // declared type of the variable or cast
+    union {
+        uint16_t nargs;
+        uint16_t layout;    // of a variable of type VAL_STRUCT
+    };
+    uint32_t index;
+    union {
+        ast_idx_t args;     // expression list of a call
+        ast_idx_t decl;     // AST_VAR_DECL of a local
+    };
+} binding_t;
+
+/*
+ * A method or the entry block. The name is the last part of the compound
+ * name it was defined with and the owner parts come before it. Methods can
+ * be overloaded, so what tells one apart is the signature, which adds the
+ * types of the parameters.
+ */
+typedef struct {
+    const char* space;      // name space, NULL for the entry block
+    const char** parts;     // qualified name without the name space
+    int nparts;
+    const char* sig;        // interned, such as shapes.area(float,int list)
+    uint16_t* ptypes;       // declared types of the parameters, see DECL_TYPE()
+    ast_idx_t def;          // AST_METHOD_DEF or AST_ENTRY
+    ast_idx_t params;       // list of AST_VAR_DECL
+    ast_idx_t body;
+    int nparams;
+    int nslots;             // frame size, parameters first
+    int owner;              // layout of the struct whose method it is, or -1
+    uint8_t ret_type;
+} method_t;
+
+typedef struct {
+    const char* space;
+    const char* name;
+    ast_idx_t def;          // AST_VAR_DEF
+    uint8_t type;
+    int layout;             // if the type is VAL_STRUCT
+} global_t;
+
+typedef struct {
+    ast_t* ast;
+    binding_t* binds;
+    method_t* methods;
+    int nmethods;
+    global_t* globals;
+    int nglobals;
+    int entry;              // index of the entry block, or -1
+    value_t* consts;        // values of the expressions that were folded
+    int nconsts;
+    arena_t* arena;         // strings and boxes that were made by folding
+    struct_layout_t* layouts;
+    int nlayouts;
+    uint32_t* dispatch;     // overload sets of BIND_DISPATCH, see rt_dispatch()
+    int ndispatch;
+    fmt_plan_t** formats;   // plans of BIND_FORMAT
+    int nformats;
+} program_t;
+
+program_t* resolve_program(ast_t* ast);
+void destroy_program(program_t* prog);
+
+/*
+ * Evaluate the expressions that only depend on literals and on constants,
+ * once, and bind them to their values. Part of resolve_program().
+ */
+void fold_program(program_t* prog);
+
+/*
+ * The run time type of a type specifier, VAL_ANY for anything that is not
+ * a builtin type or a list or a dict of one.
+ */
+int spec_type(ast_t* ast, ast_idx_t spec);
+
+#define BIND(p, i)  (&(p)->binds[i])
+
+// what to convert a value to when it is stored where the binding declares
+#define DECL_TYPE(b) (((b)->type == VAL_STRUCT)? STRUCT_TYPE((b)->layout): (b)->type)
+
+#endif
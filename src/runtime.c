@@ -0,0 +1,757 @@
+/*
+ * Operations on run time values. The functions return RT_OK, or an error
+ * with a message in the runtime that the caller reports with the location.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+
+#include "memory.h"
+#include "parser.h"
+#include "intern.h"
+#include "runtime.h"
+
+void init_runtime(runtime_t* rt) {
+
+    memset(rt, 0, sizeof(runtime_t));
+    rt->arena = create_arena(0);
+    rt->boxes = set_box_arena(rt->arena);
+}
+
+void free_runtime(runtime_t* rt) {
+
+    while(rt->stores != NULL) {
+        list_store_t* next = rt->stores->next;
+        FREE(rt->stores->data);
+        FREE(rt->stores);
+        rt->stores = next;
+    }
+    while(rt->dicts != NULL) {
+        dict_t* next = rt->dicts->next;
+        destroy_dict(rt->dicts);
+        rt->dicts = next;
+    }
+    while(rt->structs != NULL) {
+        struct_t* next = rt->structs->next;
+        FREE(rt->structs);
+        rt->structs = next;
+    }
+    if(rt->buf != NULL)
+        FREE(rt->buf);
+    if(rt->pieces != NULL)
+        FREE(rt->pieces);
+    set_box_arena(rt->boxes);
+    destroy_arena(rt->arena);
+    rt->buf = NULL;
+    rt->arena = NULL;
+}
+
+static rt_error_t fail(runtime_t* rt, rt_error_t err, const char* fmt, ...) {
+
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(rt->msg, sizeof(rt->msg), fmt, args);
+    va_end(args);
+    return err;
+}
+
+static void buf_add(runtime_t* rt, const char* str, size_t len) {
+
+    if(rt->len + len + 1 > rt->cap) {
+        while(rt->len + len + 1 > rt->cap)
+            rt->cap = (rt->cap == 0)? 128: rt->cap << 1;
+        rt->buf = REALLOC(rt->buf, rt->cap);
+    }
+    memcpy(rt->buf + rt->len, str, len);
+    rt->len += len;
+    rt->buf[rt->len] = '\0';
+}
+
+// copy what was built to the arena
+static value_t buf_string(runtime_t* rt) {
+
+    return STRING_VAL(str_new(rt->arena, rt->buf, rt->len));
+}
+
+// the name of the type of the value, which for a list or a dict says the
+// elements and for a struct is the name of the struct
+static const char* type_name(value_t val) {
+
+    if(IS_STRUCT(val))
+        return AS_STRUCT(val)->layout->name;
+    if(IS_LIST(val))
+        return VAL_TOSTR(LIST_TYPE(AS_LIST(val)->store->elem));
+    if(IS_DICT(val))
+        return VAL_TOSTR(DICT_TYPE(AS_DICT(val)->elem));
+    return VAL_TOSTR(VAL_TYPE(val));
+}
+
+// add the text of the value to what is being built
+static void buf_value(runtime_t* rt, value_t val) {
+
+    char tmp[64];
+
+    if(IS_LIST(val)) {
+        list_t* list = AS_LIST(val);
+        buf_add(rt, "[", 1);
+        for(size_t i = 0; i < list->len; i++) {
+            if(i > 0)
+                buf_add(rt, ", ", 2);
+            buf_value(rt, list_get(list, i));
+        }
+        buf_add(rt, "]", 1);
+        return;
+    }
+    if(IS_DICT(val)) {
+        dict_t* dict = AS_DICT(val);
+        buf_add(rt, "[", 1);
+        for(size_t i = 0; i < dict->len; i++) {
+            if(i > 0)
+                buf_add(rt, ", ", 2);
+            buf_value(rt, dict->entries[i].key);
+            buf_add(rt, " = ", 3);
+            buf_value(rt, dict->entries[i].val);
+        }
+        buf_add(rt, "]", 1);
+        return;
+    }
+    if(IS_STRUCT(val)) {
+        // a struct in a field is only named, since it can be this one
+        struct_t* obj = AS_STRUCT(val);
+        buf_add(rt, "[", 1);
+        for(int i = 0; i < obj->layout->nfields; i++) {
+            const field_t* f = &obj->layout->fields[i];
+            value_t item = field_get(obj, f->offset, FIELD_KIND(f->type));
+            if(i > 0)
+                buf_add(rt, ", ", 2);
+            buf_add(rt, f->name, strlen(f->name));
+            buf_add(rt, " = ", 3);
+            if(IS_STRUCT(item))
+                buf_add(rt, type_name(item), strlen(type_name(item)));
+            else
+                buf_value(rt, item);
+        }
+        buf_add(rt, "]", 1);
+        return;
+    }
+
+    switch(VAL_TYPE(val)) {
+        case VAL_INT: buf_add(rt, tmp, int_text(tmp, AS_INT(val))); break;
+        case VAL_UINT: buf_add(rt, tmp, uint_text(tmp, AS_UINT(val))); break;
+        case VAL_FLOAT: buf_add(rt, tmp, float_text(tmp, AS_FLOAT(val))); break;
+        default: {
+            const char* str = format_value(val, tmp, sizeof(tmp));
+            buf_add(rt, str, strlen(str));
+        }
+    }
+}
+
+static rt_error_t string_op(runtime_t* rt, int op, value_t left, value_t right, value_t* res) {
+
+    if(!IS_STRING(left) || !IS_STRING(right))
+        return fail(rt, RT_NO_OPERATOR, "cannot mix %s and %s",
+                        type_name(left), type_name(right));
+
+    str_t* l = AS_STR(left);
+    str_t* r = AS_STR(right);
+    switch(op) {
+        case '+':
+            if((size_t)l->len + r->len > STR_MAX_LEN)
+                return fail(rt, RT_NO_OPERATOR, "string is too long");
+            *res = STRING_VAL(str_concat(rt->arena, l, r));
+            return RT_OK;
+        case EQ_OP: *res = BOOL_VAL(str_equal(l, r)); return RT_OK;
+        case NE_OP: *res = BOOL_VAL(!str_equal(l, r)); return RT_OK;
+        case '<': *res = BOOL_VAL(str_compare(l, r) < 0); return RT_OK;
+        case '>': *res = BOOL_VAL(str_compare(l, r) > 0); return RT_OK;
+        case LE_OP: *res = BOOL_VAL(str_compare(l, r) <= 0); return RT_OK;
+        case GE_OP: *res = BOOL_VAL(str_compare(l, r) >= 0); return RT_OK;
+        default:
+            return fail(rt, RT_NO_OPERATOR, "operator is not defined for strings");
+    }
+}
+
+/*
+ * Binary operators other than "and" and "or". The operands are converted to
+ * the wider of their types first, where float is wider than uint and uint is
+ * wider than int. Bools act as ints.
+ */
+rt_error_t rt_binary(runtime_t* rt, int op, value_t left, value_t right, value_t* res) {
+
+    if(IS_STRING(left) || IS_STRING(right))
+        return string_op(rt, op, left, right, res);
+    if(!IS_NUMBER(left) || !IS_NUMBER(right))
+        return fail(rt, RT_NO_OPERATOR, "operator is not defined for %s and %s",
+                        type_name(left), type_name(right));
+
+    if(IS_FLOAT(left) || IS_FLOAT(right)) {
+        convert_value(&left, VAL_FLOAT);
+        convert_value(&right, VAL_FLOAT);
+        double l = AS_FLOAT(left), r = AS_FLOAT(right);
+        switch(op) {
+            case '+': *res = FLOAT_VAL(l + r); return RT_OK;
+            case '-': *res = FLOAT_VAL(l - r); return RT_OK;
+            case '*': *res = FLOAT_VAL(l * r); return RT_OK;
+            case '/': *res = FLOAT_VAL(l / r); return RT_OK;
+            case '%': *res = FLOAT_VAL(fmod(l, r)); return RT_OK;
+            case EQ_OP: *res = BOOL_VAL(l == r); return RT_OK;
+            case NE_OP: *res = BOOL_VAL(l != r); return RT_OK;
+            case '<': *res = BOOL_VAL(l < r); return RT_OK;
+            case '>': *res = BOOL_VAL(l > r); return RT_OK;
+            case LE_OP: *res = BOOL_VAL(l <= r); return RT_OK;
+            case GE_OP: *res = BOOL_VAL(l >= r); return RT_OK;
+        }
+    }
+    else if(IS_UINT(left) || IS_UINT(right)) {
+        unsigned long l = AS_UINT(left), r = AS_UINT(right);
+        if((op == '/' || op == '%') && r == 0)
+            return fail(rt, RT_DIV_ZERO, "division by zero");
+        switch(op) {
+            case '+': *res = UINT_VAL(l + r); return RT_OK;
+            case '-': *res = UINT_VAL(l - r); return RT_OK;
+            case '*': *res = UINT_VAL(l * r); return RT_OK;
+            case '/': *res = UINT_VAL(l / r); return RT_OK;
+            case '%': *res = UINT_VAL(l % r); return RT_OK;
+            case EQ_OP: *res = BOOL_VAL(l == r); return RT_OK;
+            case NE_OP: *res = BOOL_VAL(l != r); return RT_OK;
+            case '<': *res = BOOL_VAL(l < r); return RT_OK;
+            case '>': *res = BOOL_VAL(l > r); return RT_OK;
+            case LE_OP: *res = BOOL_VAL(l <= r); return RT_OK;
+            case GE_OP: *res = BOOL_VAL(l >= r); return RT_OK;
+        }
+    }
+    else {
+        long l = AS_INT(left), r = AS_INT(right);
+        if((op == '/' || op == '%') && r == 0)
+            return fail(rt, RT_DIV_ZERO, "division by zero");
+        switch(op) {
+            case '+': *res = INT_VAL(int_add(l, r)); return RT_OK;
+            case '-': *res = INT_VAL(int_sub(l, r)); return RT_OK;
+            case '*': *res = INT_VAL(int_mul(l, r)); return RT_OK;
+            case '/': *res = INT_VAL(int_div(l, r)); return RT_OK;
+            case '%': *res = INT_VAL(int_mod(l, r)); return RT_OK;
+            case EQ_OP: *res = BOOL_VAL(l == r); return RT_OK;
+            case NE_OP: *res = BOOL_VAL(l != r); return RT_OK;
+            case '<': *res = BOOL_VAL(l < r); return RT_OK;
+            case '>': *res = BOOL_VAL(l > r); return RT_OK;
+            case LE_OP: *res = BOOL_VAL(l <= r); return RT_OK;
+            case GE_OP: *res = BOOL_VAL(l >= r); return RT_OK;
+        }
+    }
+
+    return fail(rt, RT_NO_OPERATOR, "unknown operator");
+}
+
+rt_error_t rt_unary(runtime_t* rt, int op, value_t val, value_t* res) {
+
+    if(op == NOT) {
+        *res = BOOL_VAL(!value_truth(val));
+        return RT_OK;
+    }
+
+    switch(VAL_TYPE(val)) {
+        case VAL_BOOL:
+        case VAL_INT: *res = INT_VAL(int_neg(AS_INT(val))); return RT_OK;
+        case VAL_UINT: *res = UINT_VAL(-AS_UINT(val)); return RT_OK;
+        case VAL_FLOAT: *res = FLOAT_VAL(-AS_FLOAT(val)); return RT_OK;
+        default:
+            return fail(rt, RT_NO_OPERATOR, "cannot negate %s", type_name(val));
+    }
+}
+
+/*
+ * Convert a value that is being stored to the declared type of where it
+ * goes. Numbers do not become strings this way.
+ */
+rt_error_t rt_convert(runtime_t* rt, value_t* val, int type) {
+
+    if(IS_STRUCT_TYPE(type)) {
+        const struct_layout_t* lay = &rt->layouts[type - STRUCT_TYPE(0)];
+        if(!IS_STRUCT(*val) || AS_STRUCT(*val)->layout != lay)
+            return fail(rt, RT_NO_CONVERSION, "cannot convert %s to %s",
+                            type_name(*val), lay->name);
+        return RT_OK;
+    }
+    if(convert_value(val, type) != 0)
+        return fail(rt, RT_NO_CONVERSION, "cannot convert %s to %s",
+                        type_name(*val), VAL_TOSTR(type));
+    return RT_OK;
+}
+
+/*
+ * An explicit cast, which can also make a string of a number.
+ */
+rt_error_t rt_cast(runtime_t* rt, value_t* val, int type) {
+
+    if(type == VAL_STRING && !IS_STRING(*val)) {
+        rt->len = 0;
+        buf_value(rt, *val);
+        *val = buf_string(rt);
+        return RT_OK;
+    }
+    return rt_convert(rt, val, type);
+}
+
+/*
+ * A string with arguments is a format, which was made into a plan. Each
+ * argument is turned into text once, however often it is used: a string is
+ * used where it is, and anything else is written into the buffer. Then the
+ * result is copied together in the arena, where it takes exactly its size.
+ */
+rt_error_t rt_format(runtime_t* rt, const fmt_plan_t* plan, value_t* args, int nargs, value_t* res) {
+
+    char num[NUMBER_TEXT_SIZE];
+    size_t total = plan->literal_len;
+    int nused = plan->max_arg + 1;
+
+    if(nused > nargs) {
+        for(int i = 0; i < plan->nsegs; i++)
+            if(plan->segs[i].arg >= nargs)
+                return fail(rt, RT_BAD_FORMAT, "format argument {%d} is not given",
+                                plan->segs[i].arg);
+    }
+    if(nused > rt->npieces) {
+        rt->npieces = nused;
+        rt->pieces = REALLOC_LST(rt->pieces, nused, fmt_piece_t);
+    }
+
+    rt->len = 0;
+    for(int i = 0; i < nused; i++) {
+        fmt_piece_t* piece = &rt->pieces[i];
+        value_t val = args[i];
+        size_t pos = rt->len;
+        piece->str = NULL;
+        switch(VAL_TYPE(val)) {
+            case VAL_STRING:
+                piece->str = AS_STRING(val);
+                piece->len = AS_STR(val)->len;
+                break;
+            case VAL_BOOL:
+                piece->str = AS_BOOL(val)? "true": "false";
+                piece->len = AS_BOOL(val)? 4: 5;
+                break;
+            case VAL_INT: buf_add(rt, num, int_text(num, AS_INT(val))); break;
+            case VAL_UINT: buf_add(rt, num, uint_text(num, AS_UINT(val))); break;
+            case VAL_FLOAT: buf_add(rt, num, float_text(num, AS_FLOAT(val))); break;
+            default: buf_value(rt, val); break;
+        }
+        if(piece->str == NULL) {
+            piece->pos = pos;
+            piece->len = rt->len - pos;
+        }
+    }
+
+    for(int i = 0; i < plan->nsegs; i++)
+        total += (plan->segs[i].arg >= 0)? rt->pieces[plan->segs[i].arg].len: 0;
+    str_t* str = str_alloc(rt->arena, total);
+    char* out = STR_CHARS(str);
+    for(int i = 0; i < plan->nsegs; i++) {
+        const fmt_seg_t* seg = &plan->segs[i];
+        if(seg->arg < 0) {
+            memcpy(out, plan->text + seg->start, seg->len);
+            out += seg->len;
+        }
+        else {
+            const fmt_piece_t* piece = &rt->pieces[seg->arg];
+            memcpy(out, (piece->str != NULL)? piece->str: rt->buf + piece->pos, piece->len);
+            out += piece->len;
+        }
+    }
+    *res = STRING_VAL(str);
+    return RT_OK;
+}
+
+/*
+ * What system.print does: the values separated by spaces, then a newline.
+ */
+void rt_print(runtime_t* rt, FILE* fp, value_t* args, int nargs) {
+
+    for(int i = 0; i < nargs; i++) {
+        if(i > 0)
+            fputc(' ', fp);
+        if(IS_LIST(args[i]) || IS_DICT(args[i]) || IS_STRUCT(args[i])) {
+            rt->len = 0;
+            buf_value(rt, args[i]);
+            fputs(rt->buf, fp);
+        }
+        else
+            print_value(fp, args[i]);
+    }
+    fputc('\n', fp);
+}
+
+/*
+ * The value that a variable of the type has before anything is assigned,
+ * which for a list or a dict is a new empty one.
+ */
+value_t rt_zero(runtime_t* rt, int type) {
+
+    value_t val;
+
+    if(!IS_CONTAINER_TYPE(type))
+        return zero_value(type);
+    rt_new(rt, type, NULL, 0, &val);
+    return val;
+}
+
+static list_store_t* new_store(runtime_t* rt, int elem, size_t cap) {
+
+    list_store_t* store = ALLOC_DS(list_store_t);
+    store->elem = elem;
+    store->size = (elem == VAL_BOOL)? sizeof(uint8_t):
+                  (elem == VAL_STRING)? sizeof(str_t*): sizeof(uint64_t);
+    store->cap = cap;
+    store->len = 0;
+    store->data = ALLOC(cap * store->size);
+    store->next = rt->stores;
+    rt->stores = store;
+    return store;
+}
+
+/*
+ * The key as a dict keeps it, an int or an interned string. A string that
+ * is not interned cannot be in any dict, so unless the key is being added
+ * it is not interned here and becomes nothing, which matches no key. The
+ * literals of the program are interned already, and the others are looked
+ * up with the length and the hash that the string keeps.
+ */
+static rt_error_t dict_key(runtime_t* rt, value_t key, int add, value_t* res) {
+
+    if(IS_INT(key)) {
+        *res = key;
+        return RT_OK;
+    }
+    if(!IS_STRING(key))
+        return fail(rt, RT_BAD_INDEX, "a dict key must be an int or a string, not %s", type_name(key));
+
+    str_t* s = AS_STR(key);
+    if(s->flags & STR_INTERNED) {
+        *res = key;
+        return RT_OK;
+    }
+    const char* text = str_text(s);
+    const char* str = add? intern_hashed(text, s->len, str_hash(s)):
+                            intern_find_hashed(text, s->len, str_hash(s));
+    *res = (str != NULL)? STRING_VAL(STR_OF(str)): NOTHING_VAL;
+    return RT_OK;
+}
+
+// the items are keys and values, one after the other
+static rt_error_t insert(runtime_t* rt, value_t val, value_t* items, int nitems) {
+
+    if(!IS_DICT(val))
+        return fail(rt, RT_NO_OPERATOR, "cannot insert into %s", type_name(val));
+
+    dict_t* dict = AS_DICT(val);
+    for(int i = 0; i + 1 < nitems; i += 2) {
+        value_t key, item = items[i + 1];
+        if(dict_key(rt, items[i], 1, &key) != RT_OK)
+            return RT_BAD_INDEX;
+        if(rt_convert(rt, &item, dict->elem) != RT_OK)
+            return RT_NO_CONVERSION;
+        dict_insert(dict, key, item);
+    }
+    return RT_OK;
+}
+
+/*
+ * A new list or dict of the declared type. The items are the elements of
+ * a list, or the keys and values of a dict one after the other, and they
+ * are converted to the type of the elements.
+ */
+rt_error_t rt_new(runtime_t* rt, int type, value_t* items, int nitems, value_t* res) {
+
+    if(IS_DICT_TYPE(type)) {
+        dict_t* dict = create_dict(ELEM_TYPE(type));
+        dict->next = rt->dicts;
+        rt->dicts = dict;
+        *res = DICT_VAL(dict);
+        return insert(rt, *res, items, nitems);
+    }
+
+    list_t* list = ARENA_ALLOC_DS(rt->arena, list_t);
+    list->store = new_store(rt, ELEM_TYPE(type), (nitems > 8)? nitems: 8);
+    list->start = 0;
+    list->len = 0;
+    *res = LIST_VAL(list);
+    return rt_append(rt, *res, items, nitems);
+}
+
+/*
+ * Add more items, as rt_new() takes them, to a list or a dict.
+ */
+rt_error_t rt_extend(runtime_t* rt, value_t val, value_t* items, int nitems) {
+
+    if(IS_DICT(val))
+        return insert(rt, val, items, nitems);
+    return rt_append(rt, val, items, nitems);
+}
+
+/*
+ * Add the items to the end of the list. The store grows in place when the
+ * list ends where the store does; otherwise the list is moved to a store of
+ * its own first, so that no other list sees the new elements.
+ */
+rt_error_t rt_append(runtime_t* rt, value_t val, value_t* items, int nitems) {
+
+    if(!IS_LIST(val))
+        return fail(rt, RT_NO_OPERATOR, "cannot append to %s", type_name(val));
+
+    list_t* list = AS_LIST(val);
+    list_store_t* store = list->store;
+    size_t need = list->len + nitems;
+
+    if(list->start + list->len != store->len) {
+        list_store_t* own = new_store(rt, store->elem, (need > 8)? need * 2: 8);
+        memcpy(own->data, LIST_AT(list, 0), list->len * store->size);
+        own->len = list->len;
+        list->store = store = own;
+        list->start = 0;
+    }
+    else if(list->start + need > store->cap) {
+        while(list->start + need > store->cap)
+            store->cap <<= 1;
+        store->data = REALLOC(store->data, store->cap * store->size);
+    }
+
+    for(int i = 0; i < nitems; i++) {
+        value_t item = items[i];
+        if(rt_convert(rt, &item, store->elem) != RT_OK)
+            return RT_NO_CONVERSION;
+        store->len++;
+        list_set(list, list->len++, item);
+    }
+    return RT_OK;
+}
+
+// check that the value is a list and the index is in it
+static rt_error_t check_index(runtime_t* rt, value_t val, value_t index, size_t* pos) {
+
+    if(!IS_LIST(val))
+        return fail(rt, RT_NO_OPERATOR, "cannot index %s", type_name(val));
+    if(!IS_INT(index) && !IS_UINT(index))
+        return fail(rt, RT_BAD_INDEX, "a list index must be an int, not %s", type_name(index));
+
+    list_t* list = AS_LIST(val);
+    if((IS_INT(index) && AS_INT(index) < 0) || AS_UINT(index) >= list->len) {
+        char tmp[64];
+        return fail(rt, RT_BAD_INDEX, "index %s is out of range for a list of %zu",
+                        format_value(index, tmp, sizeof(tmp)), list->len);
+    }
+    *pos = AS_UINT(index);
+    return RT_OK;
+}
+
+/*
+ * The element of a list at an index, or the value of a key in a dict.
+ */
+rt_error_t rt_index(runtime_t* rt, value_t val, value_t index, value_t* res) {
+
+    size_t pos;
+
+    if(IS_DICT(val)) {
+        value_t key;
+        if(dict_key(rt, index, 0, &key) != RT_OK)
+            return RT_BAD_INDEX;
+        value_t* found = dict_find(AS_DICT(val), key);
+        if(found == NULL) {
+            char tmp[64];
+            return fail(rt, RT_BAD_INDEX, "key %s is not in the dict",
+                            format_value(index, tmp, sizeof(tmp)));
+        }
+        *res = *found;
+        return RT_OK;
+    }
+
+    if(check_index(rt, val, index, &pos) != RT_OK)
+        return RT_BAD_INDEX;
+    *res = list_get(AS_LIST(val), pos);
+    return RT_OK;
+}
+
+/*
+ * Store an element of a list, which must be there already, or the value
+ * of a key in a dict, which is added if it is not.
+ */
+rt_error_t rt_set_index(runtime_t* rt, value_t val, value_t index, value_t item) {
+
+    size_t pos;
+
+    if(IS_DICT(val)) {
+        value_t pair[2] = { index, item };
+        return insert(rt, val, pair, 2);
+    }
+
+    if(check_index(rt, val, index, &pos) != RT_OK)
+        return RT_BAD_INDEX;
+    if(rt_convert(rt, &item, AS_LIST(val)->store->elem) != RT_OK)
+        return RT_NO_CONVERSION;
+    list_set(AS_LIST(val), pos, item);
+    return RT_OK;
+}
+
+rt_error_t rt_length(runtime_t* rt, value_t val, value_t* res) {
+
+    if(IS_LIST(val))
+        *res = INT_VAL((long)AS_LIST(val)->len);
+    else if(IS_DICT(val))
+        *res = INT_VAL((long)AS_DICT(val)->len);
+    else if(IS_STRING(val))
+        *res = INT_VAL((long)AS_STR(val)->len);
+    else
+        return fail(rt, RT_NO_OPERATOR, "%s has no length", type_name(val));
+    return RT_OK;
+}
+
+rt_error_t rt_has(runtime_t* rt, value_t dict, value_t key, value_t* res) {
+
+    if(!IS_DICT(dict))
+        return fail(rt, RT_NO_OPERATOR, "%s has no keys", type_name(dict));
+    if(dict_key(rt, key, 0, &key) != RT_OK)
+        return RT_BAD_INDEX;
+    *res = BOOL_VAL(dict_find(AS_DICT(dict), key) != NULL);
+    return RT_OK;
+}
+
+/*
+ * The elements from start up to but not including end, as a list that
+ * shares the store of the original.
+ */
+rt_error_t rt_slice(runtime_t* rt, value_t val, value_t start, value_t end, value_t* res) {
+
+    if(!IS_LIST(val))
+        return fail(rt, RT_NO_OPERATOR, "cannot slice %s", type_name(val));
+    if(!IS_INT(start) || !IS_INT(end))
+        return fail(rt, RT_BAD_INDEX, "a slice needs int bounds, not %s and %s",
+                        type_name(start), type_name(end));
+
+    list_t* list = AS_LIST(val);
+    long from = AS_INT(start), to = AS_INT(end);
+    if(from < 0 || from > to || (size_t)to > list->len)
+        return fail(rt, RT_BAD_INDEX, "slice %ld to %ld is out of range for a list of %zu",
+                        from, to, list->len);
+
+    list_t* slice = ARENA_ALLOC_DS(rt->arena, list_t);
+    slice->store = list->store;
+    slice->start = list->start + from;
+    slice->len = to - from;
+    *res = LIST_VAL(slice);
+    return RT_OK;
+}
+
+/*
+ * A new instance of the struct. Every field starts at the zero value of its
+ * type, which for most of them is all zero bytes.
+ */
+value_t rt_instance(runtime_t* rt, int layout) {
+
+    const struct_layout_t* lay = &rt->layouts[layout];
+    struct_t* obj = ALLOC(sizeof(struct_t) + lay->size);
+
+    obj->layout = lay;
+    obj->next = rt->structs;
+    rt->structs = obj;
+    memset(obj->data, 0, lay->size);
+    for(int i = 0; i < lay->nfields; i++) {
+        const field_t* f = &lay->fields[i];
+        int kind = FIELD_KIND(f->type);
+        if(kind == 0 || kind == VAL_STRING)
+            field_set(obj, f->offset, kind, rt_zero(rt, f->type));
+    }
+    return STRUCT_VAL(obj);
+}
+
+/*
+ * The field at the offset, which the resolver found in the declared struct
+ * of the value, stored as the kind says.
+ */
+rt_error_t rt_get_field(runtime_t* rt, value_t val, uint32_t offset, int kind, value_t* res) {
+
+    if(!IS_STRUCT(val))
+        return fail(rt, RT_NO_OPERATOR, "%s has no fields", type_name(val));
+    *res = field_get(AS_STRUCT(val), offset, kind);
+    return RT_OK;
+}
+
+// the item must already have the type of the field
+rt_error_t rt_set_field(runtime_t* rt, value_t val, uint32_t offset, int kind, value_t item) {
+
+    if(!IS_STRUCT(val))
+        return fail(rt, RT_NO_OPERATOR, "%s has no fields", type_name(val));
+    field_set(AS_STRUCT(val), offset, kind, item);
+    return RT_OK;
+}
+
+// the declared type that the value would match, such as an int list
+static int value_decl_type(runtime_t* rt, value_t val) {
+
+    if(IS_LIST(val))
+        return LIST_TYPE(AS_LIST(val)->store->elem);
+    if(IS_DICT(val))
+        return DICT_TYPE(AS_DICT(val)->elem);
+    if(IS_STRUCT(val))
+        return STRUCT_TYPE(AS_STRUCT(val)->layout - rt->layouts);
+    return VAL_TYPE(val);
+}
+
+/*
+ * Choose the method of the set that fits the argument values best and
+ * convert them to its parameters. The first of the best ones is chosen, the
+ * same as before running. With up to four arguments the types make the key
+ * of the cache, so a call that keeps getting the same types chooses once.
+ */
+rt_error_t rt_dispatch(runtime_t* rt, const uint32_t* set, value_t* args,
+                        dispatch_cache_t* cache, int* method) {
+
+    int nargs = SET_NARGS(set);
+    value_t* vals = args + SET_SKIP(set);
+    int types[DISPATCH_MAX_ARGS];
+    uint64_t key = 0;
+    int best = -1, best_score = 0;
+
+    for(int i = 0; i < nargs; i++) {
+        types[i] = value_decl_type(rt, vals[i]);
+        key = (key << 16) | (uint64_t)(types[i] + 1);
+    }
+    if(nargs > 4)
+        key = 0;
+
+    if(key != 0 && cache->key == key)
+        best = cache->choice;
+    else {
+        for(uint32_t c = 0; c < SET_CANDIDATES(set); c++) {
+            const uint32_t* params = SET_TYPES(set, c);
+            int score = 0;
+            for(int i = 0; i < nargs && score >= 0; i++) {
+                int match = type_match(types[i], params[i]);
+                score = (match > 0)? score + match: -1;
+            }
+            if(score > best_score) {
+                best = c;
+                best_score = score;
+            }
+        }
+        if(best < 0) {
+            char buf[96];
+            size_t len = 0;
+            buf[0] = '\0';
+            for(int i = 0; i < nargs && len < sizeof(buf); i++)
+                len += snprintf(buf + len, sizeof(buf) - len, "%s%s", (i > 0)? ", ": "",
+                                type_name(vals[i]));
+            return fail(rt, RT_NO_CONVERSION, "no overload takes (%s)", buf);
+        }
+        cache->key = key;
+        cache->choice = best;
+    }
+
+    const uint32_t* params = SET_TYPES(set, best);
+    for(int i = 0; i < nargs; i++) {
+        rt_error_t err = rt_convert(rt, &vals[i], params[i]);
+        if(err != RT_OK)
+            return err;
+    }
+    *method = SET_METHOD(set, best);
+    return RT_OK;
+}
@@ -0,0 +1,115 @@
+#ifndef __RUNTIME_H__
+#define __RUNTIME_H__
+
+#include <stdio.h>
+#include <stddef.h>
+#include "memory.h"
+#include "value.h"
+#include "list.h"
+#include "dict.h"
+#include "layout.h"
+#include "format.h"
+
+/*
+ * The operations on values that both the tree walking interpreter and the
+ * bytecode VM use, so that they cannot disagree about what a program means.
+ * Strings that are made while a program runs live in the runtime's arena,
+ * and + makes a rope of two long ones instead of copying them (see str.h).
+ * So do the boxes of the ints that do not fit in a value, from the time the
+ * runtime is made until it is freed, on the thread that made it.
+ */
+typedef enum {
+    RT_OK,
+    RT_DIV_ZERO,
+    RT_NO_OPERATOR,
+    RT_NO_CONVERSION,
+    RT_BAD_FORMAT,
+    RT_BAD_INDEX,
+} rt_error_t;
+
+// the text of one argument of a format, in the buffer if str is NULL
+typedef struct {
+    const char* str;
+    size_t pos;
+    size_t len;
+} fmt_piece_t;
+
+typedef struct {
+    arena_t* arena;
+    char* buf;              // the string being built
+    size_t len;
+    size_t cap;
+    fmt_piece_t* pieces;    // of the format being made
+    int npieces;
+    list_store_t* stores;   // the elements of every list made
+    dict_t* dicts;          // every dict made
+    struct_t* structs;      // every struct instance made
+    const struct_layout_t* layouts; // of the program, by STRUCT_TYPE
+    arena_t* boxes;         // the box arena that was set before
+    char msg[128];          // what went wrong, when a call fails
+} runtime_t;
+
+/*
+ * Ints wrap around in two's complement the way uints do, so no program can
+ * overflow a long in C. Dividing by zero is the only error: the smallest
+ * int over -1 is itself again and the remainder is 0, where the machine
+ * instruction would trap. The callers check for zero.
+ */
+static inline long int_add(long l, long r) { return (long)((unsigned long)l + (unsigned long)r); }
+static inline long int_sub(long l, long r) { return (long)((unsigned long)l - (unsigned long)r); }
+static inline long int_mul(long l, long r) { return (long)((unsigned long)l * (unsigned long)r); }
+static inline long int_neg(long n) { return (long)(0UL - (unsigned long)n); }
+static inline long int_div(long l, long r) { return (r == -1)? int_neg(l): l / r; }
+static inline long int_mod(long l, long r) { return (r == -1)? 0: l % r; }
+
+void init_runtime(runtime_t* rt);
+void free_runtime(runtime_t* rt);
+
+rt_error_t rt_binary(runtime_t* rt, int op, value_t left, value_t right, value_t* res);
+rt_error_t rt_unary(runtime_t* rt, int op, value_t val, value_t* res);
+rt_error_t rt_convert(runtime_t* rt, value_t* val, int type);
+rt_error_t rt_cast(runtime_t* rt, value_t* val, int type);
+rt_error_t rt_format(runtime_t* rt, const fmt_plan_t* plan, value_t* args, int nargs, value_t* res);
+void rt_print(runtime_t* rt, FILE* fp, value_t* args, int nargs);
+
+value_t rt_zero(runtime_t* rt, int type);
+rt_error_t rt_new(runtime_t* rt, int type, value_t* items, int nitems, value_t* res);
+rt_error_t rt_extend(runtime_t* rt, value_t val, value_t* items, int nitems);
+rt_error_t rt_append(runtime_t* rt, value_t list, value_t* items, int nitems);
+rt_error_t rt_index(runtime_t* rt, value_t val, value_t index, value_t* res);
+rt_error_t rt_set_index(runtime_t* rt, value_t val, value_t index, value_t item);
+rt_error_t rt_length(runtime_t* rt, value_t val, value_t* res);
+rt_error_t rt_slice(runtime_t* rt, value_t list, value_t start, value_t end, value_t* res);
+rt_error_t rt_has(runtime_t* rt, value_t dict, value_t key, value_t* res);
+
+/*
+ * Overloaded methods that cannot be told apart before running, because the
+ * type of an argument is not known, are chosen by the types of the values.
+ * The choices are kept in a table of words. A set in it is the number of
+ * candidates, the number of arguments and the number of values before them
+ * (1 for the instance of a struct method), then for each candidate its
+ * method and the declared types of its parameters.
+ */
+#define SET_CANDIDATES(s)   ((s)[0])
+#define SET_NARGS(s)        ((s)[1])
+#define SET_SKIP(s)         ((s)[2])
+#define SET_SIZE(n, nargs)  (3 + (n) * (1 + (nargs)))
+#define SET_METHOD(s, i)    ((s)[3 + (i) * (1 + SET_NARGS(s))])
+#define SET_TYPES(s, i)     (&(s)[4 + (i) * (1 + SET_NARGS(s))])
+
+#define DISPATCH_MAX_ARGS   16
+
+// the last choice made for a set, by the types of the arguments
+typedef struct {
+    uint64_t key;           // zero if nothing was chosen yet
+    int choice;
+} dispatch_cache_t;
+
+rt_error_t rt_dispatch(runtime_t* rt, const uint32_t* set, value_t* args,
+                        dispatch_cache_t* cache, int* method);
+
+value_t rt_instance(runtime_t* rt, int layout);
+rt_error_t rt_get_field(runtime_t* rt, value_t val, uint32_t offset, int kind, value_t* res);
+rt_error_t rt_set_field(runtime_t* rt, value_t val, uint32_t offset, int kind, value_t item);
+
+#endif
@@ -1,16 +1,18 @@
 #ifndef __SCANNER_H__
 #define __SCANNER_H__
 
-extern int yylex(void);
-extern int yyparse(void);
-extern void yyerror(const char *s);
-extern void* yy_scan_string(const char* str);
-extern void yy_delete_buffer(const char* str);
+#include <stddef.h>
+#include "context.h"
 
+// these are the current context's position
 int get_line_no();
 int get_col_no();
 
-void init_scanner(const char*);
-void destroy_scanner();
+int init_scanner(parse_ctx_t* ctx);
+void init_scanner_text(parse_ctx_t* ctx, char* text, size_t len);
+int scanner_in_token(parse_ctx_t* ctx);
+void destroy_scanner(parse_ctx_t* ctx);
+void set_scanner_mmap(int flag);
+const char* get_scanner_source(parse_ctx_t* ctx, size_t* len);
 
 #endif
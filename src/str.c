@@ -0,0 +1,166 @@
+/*
+ * Strings. See str.h.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "memory.h"
+#include "intern.h"
+#include "str.h"
+
+// the hash of no characters
+#define EMPTY_HASH  2166136261u
+
+#define STACK_SIZE  32
+
+// the zero value of a string, which needs no memory of its own
+static const struct {
+    str_t head;
+    char text[STR_ALIGN];
+} empty = { { EMPTY_HASH, 0, STR_HASHED, 0 }, "" };
+
+str_t* str_empty() {
+
+    return (str_t*)&empty.head;
+}
+
+/*
+ * A flat string of the length, with the NUL written and the text left for
+ * the caller to fill in.
+ */
+str_t* str_alloc(arena_t* arena, size_t len) {
+
+    str_t* s = arena_alloc_aligned(arena, sizeof(str_t) + len + 1, STR_ALIGN);
+    s->hash = 0;
+    s->len = (uint32_t)len;
+    s->flags = 0;
+    s->pad = 0;
+    STR_CHARS(s)[len] = '\0';
+    return s;
+}
+
+str_t* str_new(arena_t* arena, const char* text, size_t len) {
+
+    str_t* s = str_alloc(arena, len);
+    memcpy(STR_CHARS(s), text, len);
+    return s;
+}
+
+/*
+ * The two strings one after the other. An empty one gives the other one,
+ * and two that are short together are copied, which costs less than the
+ * rope and reading it would.
+ */
+str_t* str_concat(arena_t* arena, str_t* a, str_t* b) {
+
+    size_t len = (size_t)a->len + b->len;
+
+    if(a->len == 0)
+        return b;
+    if(b->len == 0)
+        return a;
+
+    if(len < ROPE_MIN) {
+        str_t* s = str_alloc(arena, len);
+        memcpy(STR_CHARS(s), STR_CHARS(a), a->len);
+        memcpy(STR_CHARS(s) + a->len, STR_CHARS(b), b->len);
+        return s;
+    }
+
+    str_t* s = arena_alloc_aligned(arena, sizeof(str_t) + sizeof(rope_t), STR_ALIGN);
+    rope_t* rope = STR_ROPE_OF(s);
+    s->hash = 0;
+    s->len = (uint32_t)len;
+    s->flags = STR_ROPE;
+    s->pad = 0;
+    rope->left = a;
+    rope->right = b;
+    rope->flat = NULL;
+    rope->arena = arena;
+    return s;
+}
+
+/*
+ * Copy the parts of the rope together and keep the text in it. The parts
+ * are copied from the end backwards, and the ones still to do are kept on
+ * a stack rather than recursing, since the rope that a loop builds is as
+ * deep as the loop ran.
+ */
+const char* str_flatten(str_t* s) {
+
+    rope_t* rope = STR_ROPE_OF(s);
+    str_t* fixed[STACK_SIZE];
+    str_t** stack = fixed;
+    size_t cap = STACK_SIZE;
+    size_t n = 0;
+
+    if(rope->flat != NULL)
+        return rope->flat;
+
+    char* text = arena_alloc_aligned(rope->arena, (size_t)s->len + 1, 1);
+    char* end = text + s->len;
+
+    stack[n++] = s;
+    while(n > 0) {
+        str_t* part = stack[--n];
+        rope_t* r = STR_ROPE_OF(part);
+
+        if(!(part->flags & STR_ROPE) || r->flat != NULL) {
+            end -= part->len;
+            memcpy(end, (part->flags & STR_ROPE)? r->flat: STR_CHARS(part), part->len);
+            continue;
+        }
+        if(n + 2 > cap) {
+            cap <<= 1;
+            if(stack == fixed) {
+                stack = ALLOC_LST(cap, str_t*);
+                memcpy(stack, fixed, n * sizeof(str_t*));
+            }
+            else
+                stack = REALLOC_LST(stack, cap, str_t*);
+        }
+        stack[n++] = r->left;
+        stack[n++] = r->right;
+    }
+
+    text[s->len] = '\0';
+    if(stack != fixed)
+        FREE(stack);
+    rope->flat = text;
+    return text;
+}
+
+uint32_t str_hash(str_t* s) {
+
+    if(!(s->flags & STR_HASHED)) {
+        s->hash = hash_str(str_text(s), s->len);
+        s->flags |= STR_HASHED;
+    }
+    return s->hash;
+}
+
+/*
+ * Strings of different lengths, two different interned ones and two with
+ * different hashes are not equal without reading the text.
+ */
+int str_equal(str_t* a, str_t* b) {
+
+    if(a == b)
+        return 1;
+    if(a->len != b->len || (a->flags & b->flags & STR_INTERNED))
+        return 0;
+    if((a->flags & b->flags & STR_HASHED) && a->hash != b->hash)
+        return 0;
+    return memcmp(str_text(a), str_text(b), a->len) == 0;
+}
+
+// the order of strcmp()
+int str_compare(str_t* a, str_t* b) {
+
+    size_t n = (a->len < b->len)? a->len: b->len;
+    int cmp = (a == b)? 0: memcmp(str_text(a), str_text(b), n);
+
+    if(cmp != 0)
+        return cmp;
+    return (a->len > b->len) - (a->len < b->len);
+}
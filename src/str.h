@@ -0,0 +1,76 @@
+#ifndef __STR_H__
+#define __STR_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "memory.h"
+
+/*
+ * The string of a run time value. Every string has a header with its
+ * length, so that nothing has to count the characters again, and its hash,
+ * which is worked out the first time that it is needed. A string is never
+ * changed after it is made, so values share it freely. Strings that a
+ * program makes live in the arena of its runtime, and the others are the
+ * interned ones of the source and the ones in a mapped module cache.
+ *
+ * A flat string has its text right after the header, in the same block,
+ * ending with a NUL. A rope is what + makes of two long strings: the header
+ * is followed by the two parts instead, and the text is only copied
+ * together when something reads it. Adding to the end of a string in a
+ * loop then makes one copy of the result instead of one per step.
+ */
+typedef struct _str_t_ {
+    uint32_t hash;          // if STR_HASHED is set
+    uint32_t len;
+    uint32_t flags;
+    uint32_t pad;
+} str_t;
+
+#define STR_HASHED      0x01
+#define STR_INTERNED    0x02    // equal strings are the same one
+#define STR_ROPE        0x04
+
+typedef struct {
+    str_t* left;
+    str_t* right;
+    const char* flat;       // the text, once it was read
+    arena_t* arena;         // where the text goes
+} rope_t;
+
+#define STR_ALIGN       8
+#define STR_CHARS(s)    ((char*)((s) + 1))
+#define STR_ROPE_OF(s)  ((rope_t*)((s) + 1))
+
+// the string with the text, which must be flat
+#define STR_OF(text)    ((str_t*)(uintptr_t)(text) - 1)
+
+// shorter strings are copied together instead of making a rope
+#define ROPE_MIN        64
+#define STR_MAX_LEN     UINT32_MAX
+
+#ifdef __GNUC__
+#define STR_LIKELY(e)   __builtin_expect(!!(e), 1)
+#else
+#define STR_LIKELY(e)   (e)
+#endif
+
+const char* str_flatten(str_t* s);
+
+// the text, with a NUL, which for a rope is copied together the first time
+static inline const char* str_text(str_t* s) {
+
+    if(STR_LIKELY(!(s->flags & STR_ROPE)))
+        return STR_CHARS(s);
+    return str_flatten(s);
+}
+
+str_t* str_empty();
+str_t* str_alloc(arena_t* arena, size_t len);
+str_t* str_new(arena_t* arena, const char* text, size_t len);
+str_t* str_concat(arena_t* arena, str_t* a, str_t* b);
+uint32_t str_hash(str_t* s);
+int str_equal(str_t* a, str_t* b);
+int str_compare(str_t* a, str_t* b);
+
+#endif /* __STR_H__ */
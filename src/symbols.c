@@ -1,8 +1,48 @@
 /*
- * Symbols are stored in a binary tree because it's quick and easy. There
- * will never more than a couple of hundred symbols, one would think.
- * Different storage and retrieval techniques are not going to make much
- * difference.
+ * Symbols are kept in a tree of scopes. Every scope has its own open
+ * addressing hash table. The entries themselves are kept in fixed size blocks
+ * in the order that they were added, so they never move once created, and
+ * the hash index is a separate array of (hash, position) slots that is probed
+ * linearly.
+ *
+ * Names are interned when they are added, and looked up with the hash that
+ * the pool keeps for each, so a name is hashed one time however many times
+ * it is looked up. The scope and qualified name lookups take an interned
+ * name, which every name from the scanner is, and match on the pointer. The
+ * lookups of one name, such as find_symbol(), take any string, the same as
+ * add_symbol(), and find it in the pool first; a name that was never
+ * interned is not in any table.
+ *
+ * Generated sources define thousands of symbols in sorted order, which made
+ * the old binary tree degrade into a list. This does not care about the
+ * order.
+ *
+ * The parser pushes a scope for every name space, struct, method and block,
+ * and pops it at the end. A name is added to the current scope and looked up
+ * in the current scope and then in each enclosing scope, so a name only
+ * collides with the same name in the same scope. Each scope keeps a 64 bit
+ * filter with a bit for the top bits of every hash in it, so a lookup passes
+ * over a scope that cannot have the name without probing it. Deep nesting
+ * with a few names in each scope then costs little more than a flat table.
+ *
+ * Name spaces and structs are kept after they are popped, because their
+ * members are referenced from outside with qualified names. The parent scope
+ * holds a symbol whose object points at the scope, so resolving "a.b.c" is
+ * one probe per part starting from where "a" is found. These scopes are
+ * allocated in one arena that lives as long as the global scope.
+ *
+ * Method and block scopes are gone when they are popped. They are allocated
+ * from a second arena that is used like a stack: the scope remembers where
+ * the arena was when it was pushed and popping it releases everything after
+ * that point in one operation, the table, the entries and the values.
+ *
+ * The symbols of a file that is being edited are tagged with the top level
+ * item that declared them (see reparse.c). The items of a tree can be hidden
+ * one by one, and a lookup passes over what a hidden item declared as if it
+ * were not there, so the items that an edit does not touch keep their
+ * symbols. A name space belongs to the first item that opened it, but it is
+ * never hidden, since the other items can open it again, and the next one
+ * that does takes it over if that item is hidden.
  *
  * In the AST, when a node needs to reference a symbol, it stores a pointer to
  * one of these data structures, so all of the data pertaining to a symbol is
@@ -17,60 +57,462 @@
 #include "errors.h"
 #include "symbols.h"
 #include "scanner.h"
+#include "intern.h"
+
+#define INITIAL_SLOTS   (0x01 << 4)
+#define BLOCK_SHIFT     5
+#define BLOCK_SIZE      (0x01 << BLOCK_SHIFT)
+#define BLOCK_MASK      (BLOCK_SIZE - 1)
+#define ENTRY(s, p)     (&(s)->blocks[(p) >> BLOCK_SHIFT][(p) & BLOCK_MASK])
+#define TRANSIENT(s)    ((s)->kind == SCOPE_METHOD || (s)->kind == SCOPE_BLOCK)
+#define FILTER_BIT(h)   (1ULL << ((h) >> 26))
+#define HIDDEN(r, e)    ((e)->item >= 0 && (size_t)(e)->item < (r)->nhidden && (r)->hidden[(e)->item])
+#define NAMESPACE(e)    ((e)->value->type == ST_OBJECT && (e)->value->value.obj != NULL && \
+                            (e)->value->value.obj->type == OT_NAMESPACE)
 
-// global symbol table
-static symbol_table_t* root = NULL;
+/*
+ * A slot in the hash index. The position is one based so that a zeroed slot
+ * is empty.
+ */
+typedef struct {
+    unsigned int hash;
+    unsigned int pos;
+} symbol_slot_t;
+
+struct _scope_t_ {
+    scope_kind_t kind;
+    const char* name;
+    scope_t* parent;    // where a lookup goes when the name is not here
+    scope_t* outer;     // the scope that was current when this was pushed
+    scope_t* children;  // name spaces and structs opened in this scope
+    scope_t* sibling;
+    scope_t* root;      // the global scope of the tree
+    arena_t* arena;     // where this scope and its symbols are allocated
+    arena_t* stack;     // shared by the method and block scopes
+    arena_mark_t mark;  // where to release the stack to when popped
+    symbol_table_t** blocks;
+    size_t nblocks;
+    size_t count;
+    symbol_slot_t* slots;
+    size_t nslots; // always a power of 2
+    unsigned long long filter; // one bit for each hash that was added
+    // only used in the global scope
+    int item;           // that the symbols added now belong to, or -1
+    unsigned char* hidden; // non-zero for each item whose symbols are hidden
+    size_t nhidden;
+};
+
+// the current scope of the thread
+static _Thread_local scope_t* current = NULL;
 
 /*
- * Recursively add the symbol to the tree.
+ * Create a global scope with the two arenas that the whole tree uses.
  */
-static symbols_error_t recursive_add(symbol_table_t* root, symbol_table_t* node) {
+static scope_t* create_global_scope() {
 
-    if(strcmp(root->name, node->name) < 0) {
-        if(root->left == NULL) {
-            root->left = node;
-            return SYM_NO_ERROR;
+    arena_t* arena = create_arena(0);
+    scope_t* scope = ARENA_ALLOC_DS(arena, scope_t);
+    scope->kind = SCOPE_GLOBAL;
+    scope->root = scope;
+    scope->arena = arena;
+    scope->stack = create_arena(0);
+    scope->item = -1;
+
+    return scope;
+}
+
+/*
+ * Return the current scope, creating the global scope if there is none.
+ */
+scope_t* get_scope() {
+
+    if(current == NULL)
+        current = create_global_scope();
+
+    return current;
+}
+
+/*
+ * Make the scope the current scope of this thread and return the one that
+ * was current. NULL is allowed and means the next use creates a new global
+ * scope.
+ */
+scope_t* set_scope(scope_t* scope) {
+
+    scope_t* prev = current;
+    current = scope;
+    return prev;
+}
+
+static scope_t* root_scope(scope_t* scope) {
+
+    while(scope->parent != NULL)
+        scope = scope->parent;
+
+    return scope;
+}
+
+/*
+ * Return the global scope of the tree that the current scope is part of.
+ */
+scope_t* get_global_scope() {
+
+    return root_scope(get_scope());
+}
+
+const char* get_scope_name(scope_t* scope) {
+
+    return scope->name;
+}
+
+scope_kind_t get_scope_kind(scope_t* scope) {
+
+    return scope->kind;
+}
+
+/*
+ * Return the number of scopes that are open on top of the global scope.
+ */
+int get_scope_depth() {
+
+    int depth = 0;
+    for(scope_t* scope = get_scope(); scope->outer != NULL; scope = scope->outer)
+        depth++;
+
+    return depth;
+}
+
+/*
+ * Return the slot where the name lives, or the empty slot where it would be
+ * placed.
+ */
+static symbol_slot_t* find_slot(scope_t* scope, const char* name, unsigned int hash) {
+
+    size_t mask = scope->nslots - 1;
+    size_t idx = hash & mask;
+
+    while(scope->slots[idx].pos != 0) {
+        symbol_slot_t* slot = &scope->slots[idx];
+        if(slot->hash == hash) {
+            symbol_table_t* sym = ENTRY(scope, slot->pos-1);
+            if(sym->name == name && (!HIDDEN(scope->root, sym) || NAMESPACE(sym)))
+                return slot;
         }
-        else
-            return recursive_add(root->left, node);
+        idx = (idx + 1) & mask;
     }
-    else if(strcmp(root->name, node->name) > 0) {
-        if(root->right == NULL) {
-            root->right = node;
-            return SYM_NO_ERROR;
+
+    return &scope->slots[idx];
+}
+
+/*
+ * Double the hash index and re-insert the slots. The entries do not move.
+ * The old index stays in the arena until the scope is released.
+ */
+static void grow_slots(scope_t* scope) {
+
+    symbol_slot_t* old = scope->slots;
+    size_t nold = scope->nslots;
+
+    scope->nslots = (nold == 0)? INITIAL_SLOTS: nold << 1;
+    scope->slots = ARENA_ALLOC_LST(scope->arena, scope->nslots, symbol_slot_t);
+
+    size_t mask = scope->nslots - 1;
+    for(size_t i = 0; i < nold; i++) {
+        if(old[i].pos != 0) {
+            size_t idx = old[i].hash & mask;
+            while(scope->slots[idx].pos != 0)
+                idx = (idx + 1) & mask;
+            scope->slots[idx] = old[i];
         }
-        else
-            return recursive_add(root->right, node);
+    }
+}
+
+/*
+ * Add a block of entries, copying the list of blocks if it is full.
+ */
+static void grow_blocks(scope_t* scope) {
+
+    if((scope->nblocks & (scope->nblocks - 1)) == 0) {
+        size_t n = (scope->nblocks == 0)? 1: scope->nblocks << 1;
+        symbol_table_t** blocks = ARENA_ALLOC_LST(scope->arena, n, symbol_table_t*);
+        if(scope->nblocks > 0)
+            memcpy(blocks, scope->blocks, scope->nblocks * sizeof(symbol_table_t*));
+        scope->blocks = blocks;
+    }
+
+    scope->blocks[scope->nblocks++] = ARENA_ALLOC_LST(scope->arena,
+                                            BLOCK_SIZE, symbol_table_t);
+}
+
+/*
+ * Find a symbol in one scope only.
+ */
+static symbol_table_t* scope_find(scope_t* scope, const char* name, unsigned int hash) {
+
+    if((scope->filter & FILTER_BIT(hash)) == 0)
+        return NULL;
+
+    symbol_slot_t* slot = find_slot(scope, name, hash);
+    return (slot->pos != 0)? ENTRY(scope, slot->pos-1): NULL;
+}
+
+/*
+ * Find a symbol in the current scope or the nearest enclosing scope that has
+ * it.
+ */
+static symbol_table_t* table_find(const char* name) {
+
+    unsigned int hash = intern_hash(name);
+    for(scope_t* scope = get_scope(); scope != NULL; scope = scope->parent) {
+        symbol_table_t* sym = scope_find(scope, name, hash);
+        if(sym != NULL)
+            return sym;
+    }
+
+    return NULL;
+}
+
+/*
+ * The same for a name that may not be interned.
+ */
+static symbol_table_t* table_find_str(const char* name) {
+
+    const char* interned = intern_find(name);
+    return (interned != NULL)? table_find(interned): NULL;
+}
+
+/*
+ * Return the scope of a name space or struct symbol, or NULL if the symbol is
+ * something else.
+ */
+static scope_t* symbol_scope(symbol_table_t* sym) {
+
+    if(sym == NULL || sym->value == NULL || sym->value->type != ST_OBJECT)
+        return NULL;
+
+    object_t* obj = sym->value->value.obj;
+    if(obj == NULL)
+        return NULL;
+    else if(obj->type == OT_NAMESPACE)
+        return obj->value.namesp->scope;
+    else if(obj->type == OT_STRUCT)
+        return obj->value.struc->scope;
+
+    return NULL;
+}
+
+/*
+ * Add a scope on top of the current one.
+ */
+static scope_t* open_scope(scope_kind_t kind, const char* name, scope_t* parent) {
+
+    scope_t* outer = get_scope();
+    scope_t* scope;
+
+    if(kind == SCOPE_METHOD || kind == SCOPE_BLOCK) {
+        arena_mark_t mark = arena_mark(outer->stack);
+        scope = ARENA_ALLOC_DS(outer->stack, scope_t);
+        scope->arena = outer->stack;
+        scope->mark = mark;
     }
     else {
-        return SYM_EXISTS;  // node exists.
+        scope = ARENA_ALLOC_DS(outer->arena, scope_t);
+        scope->arena = outer->arena;
+        scope->sibling = parent->children;
+        parent->children = scope;
     }
+
+    scope->kind = kind;
+    scope->name = name;
+    scope->parent = parent;
+    scope->outer = outer;
+    scope->root = outer->root;
+    scope->stack = outer->stack;
+    current = scope;
+
+    return scope;
 }
 
 /*
- * Recursively find a symbol in the tree.
+ * Open a scope. Method and block scopes are unnamed and their parent is the
+ * current scope. Name spaces and structs are named and are added as a symbol
+ * to the current scope, which must not be a method or a block. Opening a name
+ * space that already exists opens the same scope again. A name that is
+ * already used for something else returns SYM_EXISTS, but a scope is opened
+ * anyway so that the pushes and pops still match.
  */
-static symbol_table_t* recursive_find(symbol_table_t* root, const char* name) {
+symbols_error_t push_scope(scope_kind_t kind, const char* name) {
 
-    if(root != NULL) {
-        if(strcmp(root->name, name) < 0) {
-            if(root->left == NULL)
-                return NULL;
-            else
-                return recursive_find(root->left, name);
+    scope_t* parent = get_scope();
+    symbols_error_t retv = SYM_NO_ERROR;
 
+    if(kind == SCOPE_METHOD || kind == SCOPE_BLOCK) {
+        open_scope(kind, NULL, parent);
+        return retv;
+    }
+
+    name = intern_str(name);
+    symbol_table_t* sym = scope_find(parent, name, intern_hash(name));
+    if(sym != NULL) {
+        scope_t* scope = symbol_scope(sym);
+        if(kind == SCOPE_NAMESPACE && scope != NULL && scope->kind == SCOPE_NAMESPACE) {
+            if(HIDDEN(parent->root, sym)) {
+                sym->item = parent->root->item;
+                sym->line_no = get_line_no();
+                sym->col_no = get_col_no();
+            }
+            scope->outer = parent;
+            current = scope;
+            return retv;
         }
-        else if(strcmp(root->name, name) > 0) {
-            if(root->right == NULL)
-                return NULL;
-            else
-                return recursive_find(root->right, name);
-        }
-        else
-            return root;
+        open_scope(kind, name, parent);
+        return SYM_EXISTS;
     }
 
-    return NULL;
+    scope_t* scope = open_scope(kind, name, parent);
+
+    arena_t* saved = set_obj_arena(scope->arena);
+    object_t* obj;
+    if(kind == SCOPE_NAMESPACE) {
+        obj = create_namesp_obj();
+        obj->value.namesp->scope = scope;
+    }
+    else {
+        obj = create_struc_obj();
+        obj->value.struc->scope = scope;
+    }
+    set_obj_arena(saved);
+
+    // the symbol goes in the parent, not in the new scope
+    current = parent;
+    retv = add_obj_symbol(name, obj, 1, 0);
+    current = scope;
+
+    return retv;
+}
+
+/*
+ * Open a method scope whose parent is the owner, which is the struct or name
+ * space that the method belongs to. The members of the owner are then visible
+ * in the method. If the owner is NULL then the parent is the current scope.
+ */
+void push_method_scope(scope_t* owner) {
+
+    open_scope(SCOPE_METHOD, NULL, (owner != NULL)? owner: get_scope());
+}
+
+/*
+ * Close the current scope and go back to the one that was current when it
+ * was opened. A method or block scope is released with everything in it.
+ * Popping the global scope does nothing.
+ */
+void pop_scope() {
+
+    scope_t* scope = get_scope();
+    if(scope->outer == NULL)
+        return;
+
+    current = scope->outer;
+    if(TRANSIENT(scope))
+        arena_release(scope->stack, scope->mark);
+}
+
+/*
+ * Pop scopes until the scope itself has been popped. This closes anything
+ * that was left open inside it, which can happen when the parser recovers
+ * from a syntax error. Nothing happens if the scope is not open.
+ */
+void close_scope(scope_t* scope) {
+
+    scope_t* open = get_scope();
+    while(open != NULL && open != scope)
+        open = open->outer;
+
+    if(open != NULL) {
+        // the scope is released by the pop, so do not look at it after
+        scope_t* outer = scope->outer;
+        while(get_scope() != outer)
+            pop_scope();
+    }
+}
+
+/*
+ * Resolve the names, which are the parts of a qualified name, to the scope of
+ * a name space or struct. The first part is looked up like any other name and
+ * the rest are looked up only in the scope found for the part before. Returns
+ * NULL if any part is not found or is not a name space or struct.
+ */
+scope_t* find_scope(const char** names, size_t count) {
+
+    if(count == 0)
+        return NULL;
+
+    scope_t* scope = symbol_scope(table_find(names[0]));
+    for(size_t i = 1; scope != NULL && i < count; i++)
+        scope = symbol_scope(scope_find(scope, names[i], intern_hash(names[i])));
+
+    return scope;
+}
+
+/*
+ * Find a qualified name, such as a.b.c, and fill out the value. Only the
+ * first part searches the enclosing scopes.
+ */
+symbols_error_t find_qualified(const char** names, size_t count, symbol_data_t* val) {
+
+    symbol_table_t* sym;
+
+    if(count == 0)
+        return SYM_NOT_FOUND;
+    else if(count == 1)
+        sym = table_find(names[0]);
+    else {
+        scope_t* scope = find_scope(names, count - 1);
+        if(scope == NULL)
+            return SYM_NOT_FOUND;
+        const char* name = names[count - 1];
+        sym = scope_find(scope, name, intern_hash(name));
+    }
+
+    if(sym == NULL)
+        return SYM_NOT_FOUND;
+    else if(sym->value == NULL)
+        return SYM_NOT_ASSIGNED;
+
+    memcpy(val, sym->value, sizeof(symbol_data_t));
+    return SYM_NO_ERROR;
+}
+
+/*
+ * Find a qualified name the way that it would be found with the scope as the
+ * current scope, without making it current. Returns the entry, which has
+ * where the name was declared, or NULL.
+ */
+symbol_table_t* lookup_symbol(scope_t* scope, const char** names, size_t count) {
+
+    if(scope == NULL || count == 0)
+        return NULL;
+
+    unsigned int hash = intern_hash(names[0]);
+    symbol_table_t* sym = NULL;
+    for(; scope != NULL && sym == NULL; scope = scope->parent)
+        sym = scope_find(scope, names[0], hash);
+
+    for(size_t i = 1; sym != NULL && i < count; i++) {
+        scope = symbol_scope(sym);
+        sym = (scope != NULL)? scope_find(scope, names[i], intern_hash(names[i])): NULL;
+    }
+
+    return sym;
+}
+
+/*
+ * Return the scope of the name space or struct that the qualified name
+ * refers to from the scope, or NULL.
+ */
+scope_t* lookup_scope(scope_t* scope, const char** names, size_t count) {
+
+    return symbol_scope(lookup_symbol(scope, names, count));
 }
 
 /*
@@ -104,6 +546,8 @@ void print_node(symbol_table_t* node) {
             case ST_BOOL:
                 printf("    value: %s\n", node->value->value.boolean? "TRUE":"FALSE");
                 break;
+            case ST_METHOD:
+                break;
             default:
                 fatal_error("value has unknown type: %02X", node->value->type);
 
@@ -114,53 +558,64 @@ void print_node(symbol_table_t* node) {
 }
 
 /*
- * Recursively dump the symbol table.
+ * Add a symbol to the current scope. Note that the value is re-allocated to facilitate
+ * using a locally defined data structure to initialize the data.
  */
-static void recursive_dump(symbol_table_t* node) {
-
-    if(node != NULL) {
-        if(node->left != NULL) {
-            recursive_dump(node->left);
-        }
-
-        if(node->right != NULL) {
-            recursive_dump(node->right);
-        }
+symbols_error_t add_symbol(const char* name, symbol_data_t* val) {
 
-        print_node(node);
-    }
+    return add_symbol_at(name, val, get_line_no(), get_col_no());
 }
 
 /*
- * Add a symbol to the tree. Note that the value is re-allocated to facilitate
- * using a locally defined data structure to initialize the data.
+ * Add a symbol that was declared at the line and column. The scanner is
+ * often past the declaration by the time the parser reduces it, so the
+ * parser gives the position of the node instead.
  */
-symbols_error_t add_symbol(const char* name, symbol_data_t* val) {
+symbols_error_t add_symbol_at(const char* name, symbol_data_t* val, int line, int col) {
 
-    symbol_table_t* node = ALLOC_DS(symbol_table_t);
-    node->name = DUPSTR(name);
-    node->value = DUP_DS(val, symbol_data_t);
-    node->line_no = get_line_no();
-    node->col_no = get_col_no();
+    scope_t* scope = get_scope();
 
-    if(root == NULL) {
-        root = node;
-        return SYM_NO_ERROR;
-    }
-    else
-        return recursive_add(root, node);
+    // keep the load factor under 3/4
+    if((scope->count + 1) * 4 > scope->nslots * 3)
+        grow_slots(scope);
+
+    name = intern_str(name);
+    unsigned int hash = intern_hash(name);
+    symbol_slot_t* slot = find_slot(scope, name, hash);
+    if(slot->pos != 0)
+        return SYM_EXISTS;  // node exists.
+
+    if((scope->count >> BLOCK_SHIFT) >= scope->nblocks)
+        grow_blocks(scope);
+
+    symbol_table_t* node = ENTRY(scope, scope->count);
+    node->name = name;
+    node->hash = hash;
+    node->value = ARENA_DUP_DS(scope->arena, val, symbol_data_t);
+    node->line_no = line;
+    node->col_no = col;
+    node->item = scope->root->item;
+
+    scope->count++;
+    scope->filter |= FILTER_BIT(hash);
+    slot->hash = hash;
+    slot->pos = (unsigned int)scope->count;
+
+    return SYM_NO_ERROR;
 }
 
 /*
- * Update the data in the symbol using only one lookup.
+ * Update the data in the symbol using only one lookup per scope. The data is copied
+ * over the old data in place.
  */
 symbols_error_t update_symbol(const char* name, symbol_data_t* val) {
 
-    symbol_table_t* sym = recursive_find(root, name);
+    symbol_table_t* sym = table_find_str(name);
     if(sym != NULL) {
         if(sym->value != NULL)
-            FREE(sym->value);
-        sym->value = DUP_DS(val, symbol_data_t);
+            memcpy(sym->value, val, sizeof(symbol_data_t));
+        else
+            sym->value = ARENA_DUP_DS(get_symbol_arena(), val, symbol_data_t);
         return SYM_NO_ERROR;
     }
 
@@ -173,7 +628,7 @@ symbols_error_t update_symbol(const char* name, symbol_data_t* val) {
  */
 symbols_error_t find_symbol(const char* name, symbol_data_t* val) {
 
-    symbol_table_t* sym = recursive_find(root, name);
+    symbol_table_t* sym = table_find_str(name);
     if(sym != NULL) {
         if(sym->value != NULL) {
             memcpy(val, sym->value, sizeof(symbol_data_t));
@@ -193,7 +648,7 @@ symbols_error_t find_symbol(const char* name, symbol_data_t* val) {
  */
 symbols_error_t symbol_is_assigned(const char* name) {
 
-    symbol_table_t* sym = recursive_find(root, name);
+    symbol_table_t* sym = table_find_str(name);
     if(sym != NULL) {
         if(sym->value != NULL)
             return sym->value->is_assigned == 0? SYM_FALSE: SYM_TRUE;
@@ -211,7 +666,7 @@ symbols_error_t symbol_is_assigned(const char* name) {
  */
 symbols_error_t symbol_is_const(const char* name) {
 
-    symbol_table_t* sym = recursive_find(root, name);
+    symbol_table_t* sym = table_find_str(name);
     if(sym != NULL) {
         if(sym->value != NULL)
             return sym->value->is_const == 0? SYM_FALSE: SYM_TRUE;
@@ -229,7 +684,7 @@ symbols_error_t symbol_is_const(const char* name) {
  */
 symbols_error_t symbol_is_private(const char* name) {
 
-    symbol_table_t* sym = recursive_find(root, name);
+    symbol_table_t* sym = table_find_str(name);
     if(sym != NULL) {
         if(sym->value != NULL)
             return sym->value->is_private == 0? SYM_FALSE: SYM_TRUE;
@@ -242,13 +697,14 @@ symbols_error_t symbol_is_private(const char* name) {
 
 /*
  * Create a symbol value data structure. Used mostly internally, but also part
- * of the API. The is_assigned flag is left false.
+ * of the API. The is_assigned flag is left false. The data belongs to the
+ * symbol table and is released with it.
  */
 symbol_data_t* create_symbol_data(symbol_type_t type,
                                     unsigned char is_const,
                                     unsigned char is_private) {
 
-    symbol_data_t* data = ALLOC_DS(symbol_data_t);
+    symbol_data_t* data = ARENA_ALLOC_DS(get_symbol_arena(), symbol_data_t);
     data->type = type;
     data->is_const = is_const;
     data->is_private = is_private;
@@ -347,10 +803,100 @@ symbols_error_t add_bool_symbol(const char* name, unsigned char boolean,
 }
 
 
-void dump_symbols() {
+/*
+ * Print the symbols in the scope and in the name spaces and structs under it.
+ */
+static void dump_scope_tree(scope_t* scope) {
+
+    printf("scope: %s %s\n", SCOPE_TOSTR(scope->kind),
+                (scope->name != NULL)? scope->name: "");
+    for(size_t i = 0; i < scope->count; i++)
+        print_node(ENTRY(scope, i));
+    for(scope_t* child = scope->children; child != NULL; child = child->sibling)
+        dump_scope_tree(child);
+}
+
+void dump_scope(scope_t* scope) {
 
     printf("Dump symbol table\n");
-    recursive_dump(root);
+    if(scope != NULL)
+        dump_scope_tree(scope);
+}
+
+void dump_symbols() {
+
+    dump_scope(get_global_scope());
+}
+
+/*
+ * Return the arena that holds the symbols of the current scope. Other modules
+ * can allocate data that should live exactly as long as those symbols from it.
+ */
+arena_t* get_symbol_arena() {
+
+    return get_scope()->arena;
+}
+
+/*
+ * Release the whole tree of scopes that the scope belongs to. Every pointer
+ * to an entry or to data in a symbol arena is invalid after this.
+ */
+void destroy_scope(scope_t* scope) {
+
+    if(scope != NULL) {
+        scope = root_scope(scope);
+        if(current != NULL && root_scope(current) == scope)
+            current = NULL;
+        if(scope->hidden != NULL)
+            FREE(scope->hidden);
+        destroy_arena(scope->stack);
+        destroy_arena(scope->arena);
+    }
+}
+
+/*
+ * Tag the symbols that are added to the current tree from now on with the
+ * item, or with nothing if it is -1.
+ */
+void set_symbol_item(int item) {
+
+    get_global_scope()->item = item;
+}
+
+/*
+ * Hide the symbols that the item added to the tree that the scope is in, or
+ * show them again.
+ */
+void hide_item_symbols(scope_t* scope, int item, bool hide) {
+
+    scope_t* root = scope->root;
+
+    if((size_t)item >= root->nhidden) {
+        size_t n = (root->nhidden == 0)? 64: root->nhidden;
+        while(n <= (size_t)item)
+            n <<= 1;
+        root->hidden = REALLOC_LST(root->hidden, n, unsigned char);
+        memset(root->hidden + root->nhidden, 0, n - root->nhidden);
+        root->nhidden = n;
+    }
+    root->hidden[item] = hide;
+}
+
+/*
+ * Release the symbols of this thread.
+ */
+void destroy_symbols() {
+
+    if(current != NULL)
+        destroy_scope(current);
+}
+
+/*
+ * Return the number of symbols in the current scope.
+ */
+size_t get_symbol_count() {
+
+    return get_scope()->count;
 }
 
 
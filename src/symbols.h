@@ -4,7 +4,9 @@
 #define __SYMBOLS_H__
 
 #include <stdbool.h>
+#include <stddef.h>
 #include "object.h"
+#include "memory.h"
 
 typedef enum {
     SYM_NO_ERROR,
@@ -31,6 +33,7 @@ typedef enum {
     ST_FNUM,
     ST_STRING,
     ST_BOOL,
+    ST_METHOD,
 } symbol_type_t;
 
 #define ST_TOSTR(t) (\
@@ -39,7 +42,8 @@ typedef enum {
     ((t) == ST_UNUM)? "UNUM": \
     ((t) == ST_FNUM)? "FNUM": \
     ((t) == ST_STRING)? "STRING": \
-    ((t) == ST_BOOL)? "BOOL": "UNKNOWN"\
+    ((t) == ST_BOOL)? "BOOL": \
+    ((t) == ST_METHOD)? "METHOD": "UNKNOWN"\
     )
 
 /*
@@ -61,24 +65,70 @@ typedef struct {
 } symbol_data_t;
 
 /*
- * Symbol table entry.
+ * Symbol table entry. Entries are stored densely in insertion order and the
+ * hash index refers to them by position.
  */
-typedef struct _ste_t_ {
+typedef struct {
     const char* name;
+    unsigned int hash; // precomputed hash of the name
     symbol_data_t* value; // standard attributes of a symbol
-    struct _ste_t_* left;
-    struct _ste_t_* right;
     int line_no; // source code line where symbol is defined
     int col_no; // source code column where symbol is defined
+    int item; // the top level item of an edited file that defined it, or -1
 } symbol_table_t;
 
+/*
+ * Scopes nest the way they do in the source. Name spaces and structs are kept
+ * for the life of the global scope; methods and blocks are released when
+ * they are popped.
+ */
+typedef enum {
+    SCOPE_GLOBAL,
+    SCOPE_NAMESPACE,
+    SCOPE_STRUCT,
+    SCOPE_METHOD,
+    SCOPE_BLOCK,
+} scope_kind_t;
+
+#define SCOPE_TOSTR(k) (\
+    ((k) == SCOPE_GLOBAL)? "GLOBAL": \
+    ((k) == SCOPE_NAMESPACE)? "NAMESPACE": \
+    ((k) == SCOPE_STRUCT)? "STRUCT": \
+    ((k) == SCOPE_METHOD)? "METHOD": \
+    ((k) == SCOPE_BLOCK)? "BLOCK": "UNKNOWN"\
+    )
+
+typedef struct _scope_t_ scope_t;
+
+symbols_error_t push_scope(scope_kind_t kind, const char* name);
+void push_method_scope(scope_t* owner);
+void pop_scope();
+void close_scope(scope_t* scope);
+scope_t* get_scope();
+scope_t* set_scope(scope_t* scope);
+scope_t* get_global_scope();
+const char* get_scope_name(scope_t* scope);
+scope_kind_t get_scope_kind(scope_t* scope);
+int get_scope_depth();
+void dump_scope(scope_t* scope);
+void destroy_scope(scope_t* scope);
+void set_symbol_item(int item);
+void hide_item_symbols(scope_t* scope, int item, bool hide);
+
 symbols_error_t add_symbol(const char* name, symbol_data_t* val);
+symbols_error_t add_symbol_at(const char* name, symbol_data_t* val, int line, int col);
 symbols_error_t update_symbol(const char* name, symbol_data_t* val);
 symbols_error_t find_symbol(const char* name, symbol_data_t* val);
 symbols_error_t symbol_is_assigned(const char* name);
 symbols_error_t symbol_is_const(const char* name);
 symbols_error_t symbol_is_private(const char* name);
 
+// the names of these have to be interned, as the scanner's are
+scope_t* find_scope(const char** names, size_t count);
+symbols_error_t find_qualified(const char** names, size_t count, symbol_data_t* val);
+symbol_table_t* lookup_symbol(scope_t* scope, const char** names, size_t count);
+scope_t* lookup_scope(scope_t* scope, const char** names, size_t count);
+
 symbol_data_t* create_symbol_data(symbol_type_t type,
                         unsigned char is_const,
                         unsigned char is_private);
@@ -112,7 +162,9 @@ symbols_error_t add_bool_symbol(const char* name, unsigned char boolean,
                         unsigned char is_const,
                         unsigned char is_private);
 
-
 void dump_symbols();
+size_t get_symbol_count();
+arena_t* get_symbol_arena();
+void destroy_symbols();
 
 #endif
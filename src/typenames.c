@@ -0,0 +1,138 @@
+/*
+ * Set of type names for the scanner. This is tested for every identifier
+ * token, so the test has to be about as cheap as matching a keyword. The
+ * names are interned, so the hash is taken from the pointer itself and not
+ * from the characters, and each slot probed is one pointer compare. Nothing
+ * but the table is touched and no lock is taken.
+ *
+ * Readers never block and never see a partly built table. A name is stored
+ * in its slot with a release store, and when the table grows a new one is
+ * filled first and then published by swapping the table pointer. The old
+ * tables are kept until the set is destroyed, because a reader on another
+ * thread could still be probing one. The tables double, so the old ones
+ * together are never larger than the current one.
+ *
+ * There is one writer at a time for a set, which is the parser that owns
+ * it. Any number of threads can read.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "memory.h"
+#include "errors.h"
+#include "typenames.h"
+
+#define INITIAL_SLOTS   (0x01 << 6)
+
+// Fibonacci hash of the address; the low bits are always zero
+#define PTR_HASH(p)     ((size_t)(((uintptr_t)(p) >> 3) * 0x9E3779B97F4A7C15ULL >> 32))
+
+typedef struct _type_table_t_ {
+    struct _type_table_t_* retired; // older tables, kept for readers
+    size_t mask;
+    _Atomic(const char*) slots[];
+} type_table_t;
+
+struct _type_set_t_ {
+    _Atomic(type_table_t*) table;
+    size_t count;
+};
+
+static type_table_t* create_table(size_t nslots) {
+
+    type_table_t* tab = ALLOC(sizeof(type_table_t) + nslots * sizeof(const char*));
+    tab->mask = nslots - 1;
+    return tab;
+}
+
+/*
+ * Return the slot where the name is, or the empty slot where it would go.
+ */
+static _Atomic(const char*)* find_slot(type_table_t* tab, const char* name) {
+
+    size_t idx = PTR_HASH(name) & tab->mask;
+    const char* str;
+
+    while((str = atomic_load_explicit(&tab->slots[idx], memory_order_acquire)) != NULL) {
+        if(str == name)
+            break;
+        idx = (idx + 1) & tab->mask;
+    }
+
+    return &tab->slots[idx];
+}
+
+/*
+ * Copy the names into a table twice the size and publish it. Only the writer
+ * calls this.
+ */
+static void grow_table(type_set_t* set) {
+
+    type_table_t* old = atomic_load_explicit(&set->table, memory_order_relaxed);
+    type_table_t* tab = create_table((old->mask + 1) << 1);
+
+    for(size_t i = 0; i <= old->mask; i++) {
+        const char* str = atomic_load_explicit(&old->slots[i], memory_order_relaxed);
+        if(str != NULL)
+            atomic_store_explicit(find_slot(tab, str), str, memory_order_relaxed);
+    }
+
+    tab->retired = old;
+    atomic_store_explicit(&set->table, tab, memory_order_release);
+}
+
+type_set_t* create_type_set() {
+
+    type_set_t* set = ALLOC_DS(type_set_t);
+    atomic_init(&set->table, create_table(INITIAL_SLOTS));
+    return set;
+}
+
+void destroy_type_set(type_set_t* set) {
+
+    if(set != NULL) {
+        type_table_t* tab = atomic_load(&set->table);
+        while(tab != NULL) {
+            type_table_t* next = tab->retired;
+            FREE(tab);
+            tab = next;
+        }
+        FREE(set);
+    }
+}
+
+/*
+ * Add an interned name to the set. Adding a name that is already there does
+ * nothing.
+ */
+void add_type_name(type_set_t* set, const char* name) {
+
+    type_table_t* tab = atomic_load_explicit(&set->table, memory_order_relaxed);
+
+    // keep the load factor under 1/2 so misses stop early
+    if((set->count + 1) * 2 > tab->mask + 1) {
+        grow_table(set);
+        tab = atomic_load_explicit(&set->table, memory_order_relaxed);
+    }
+
+    _Atomic(const char*)* slot = find_slot(tab, name);
+    if(atomic_load_explicit(slot, memory_order_relaxed) == NULL) {
+        atomic_store_explicit(slot, name, memory_order_release);
+        set->count++;
+    }
+}
+
+/*
+ * Return non-zero if the interned name is in the set.
+ */
+int is_type_name(type_set_t* set, const char* name) {
+
+    type_table_t* tab = atomic_load_explicit(&set->table, memory_order_acquire);
+    return atomic_load_explicit(find_slot(tab, name), memory_order_relaxed) != NULL;
+}
+
+size_t get_type_count(type_set_t* set) {
+
+    return set->count;
+}
@@ -0,0 +1,21 @@
+#ifndef __TYPENAMES_H__
+#define __TYPENAMES_H__
+
+#include <stddef.h>
+
+/*
+ * The set of names that the scanner returns as TYPEDEF_NAME. A name is added
+ * when the parser reduces a struct declaration, and the scanner tests every
+ * identifier against the set.
+ *
+ * Names must be interned; membership is decided by pointer.
+ */
+typedef struct _type_set_t_ type_set_t;
+
+type_set_t* create_type_set();
+void destroy_type_set(type_set_t* set);
+void add_type_name(type_set_t* set, const char* name);
+int is_type_name(type_set_t* set, const char* name);
+size_t get_type_count(type_set_t* set);
+
+#endif
@@ -0,0 +1,199 @@
+/*
+ * Operations on run time values that do not need the interpreter.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "memory.h"
+#include "errors.h"
+#include "value.h"
+#include "list.h"
+#include "dict.h"
+
+/*
+ * The arena that ints and uints that do not fit are boxed in, which is set
+ * per thread by whatever owns the values: the runtime of a program that
+ * runs, and the module that is compiled or loaded. Returns the arena that
+ * was set before.
+ */
+static _Thread_local arena_t* boxes = NULL;
+
+arena_t* set_box_arena(arena_t* arena) {
+
+    arena_t* prev = boxes;
+    boxes = arena;
+    return prev;
+}
+
+/*
+ * Keep an int or a uint that does not fit in the payload of a value. This
+ * is the slow path of INT_VAL() and UINT_VAL(); most numbers are small.
+ */
+value_t box_value(uint64_t tag, uint64_t word) {
+
+    if(boxes == NULL)
+        fatal_error("there is no arena for an int that does not fit in a value");
+    uint64_t* box = arena_alloc_aligned(boxes, sizeof(uint64_t), sizeof(uint64_t));
+
+    *box = word;
+    return MAKE_VAL(tag, (uint64_t)(uintptr_t)box);
+}
+
+/*
+ * The value that a variable of the type has before anything is assigned.
+ */
+value_t zero_value(int type) {
+
+    switch(type) {
+        case VAL_BOOL: return BOOL_VAL(0);
+        case VAL_INT: return INT_VAL(0);
+        case VAL_UINT: return UINT_VAL(0);
+        case VAL_FLOAT: return FLOAT_VAL(0.0);
+        case VAL_STRING: return STRING_VAL(str_empty());
+        default: return NOTHING_VAL;
+    }
+}
+
+/*
+ * How well a value of the type fits a parameter of the declared type, for
+ * choosing between overloaded methods: 3 if it is the same type, 2 if both
+ * are numbers, 1 if the parameter takes anything and 0 if it does not fit.
+ */
+int type_match(int type, int param) {
+
+    if(type == param)
+        return 3;
+    if(IS_NUMBER_TYPE(type) && IS_NUMBER_TYPE(param))
+        return 2;
+    return (param == VAL_ANY)? 1: 0;
+}
+
+/*
+ * Numbers are true when they are not zero and strings, lists and dicts
+ * when they are not empty. Structs are true and nothing is false.
+ */
+int value_truth(value_t val) {
+
+    switch(VAL_TYPE(val)) {
+        case VAL_BOOL:
+        case VAL_INT: return AS_INT(val) != 0;
+        case VAL_UINT: return AS_UINT(val) != 0;
+        case VAL_FLOAT: return AS_FLOAT(val) != 0.0;
+        case VAL_STRING: return AS_STR(val)->len != 0;
+        case VAL_LIST: return AS_LIST(val)->len != 0;
+        case VAL_DICT: return AS_DICT(val)->len != 0;
+        case VAL_STRUCT: return 1;
+        default: return 0;
+    }
+}
+
+/*
+ * Convert the value in place to the type. Any number converts to any other
+ * number, but strings and numbers do not convert to each other here because
+ * making a string needs memory. VAL_ANY leaves the value as it is. Returns
+ * zero if the value was converted.
+ */
+int convert_value(value_t* val, int type) {
+
+    if(type == VAL_ANY || type == VAL_TYPE(*val))
+        return 0;
+
+    if(type == VAL_NOTHING) {
+        *val = NOTHING_VAL;
+        return 0;
+    }
+
+    // a list or a dict only goes where one of the same elements is declared
+    if(IS_LIST_TYPE(type))
+        return !IS_LIST(*val) || AS_LIST(*val)->store->elem != ELEM_TYPE(type);
+    if(IS_DICT_TYPE(type))
+        return !IS_DICT(*val) || AS_DICT(*val)->elem != ELEM_TYPE(type);
+
+    if(!IS_NUMBER(*val))
+        return 1;
+
+    switch(type) {
+        case VAL_BOOL:
+            *val = BOOL_VAL(value_truth(*val));
+            return 0;
+        case VAL_INT:
+            *val = INT_VAL(IS_FLOAT(*val)? (long)AS_FLOAT(*val): AS_INT(*val));
+            return 0;
+        case VAL_UINT:
+            *val = UINT_VAL(IS_FLOAT(*val)? (unsigned long)AS_FLOAT(*val): AS_UINT(*val));
+            return 0;
+        case VAL_FLOAT:
+            *val = FLOAT_VAL(IS_UINT(*val)? (double)AS_UINT(*val):
+                            IS_FLOAT(*val)? AS_FLOAT(*val): (double)AS_INT(*val));
+            return 0;
+        default:
+            return 1;
+    }
+}
+
+/*
+ * Return the text of the value. Strings are returned as they are and other
+ * values are written into the buffer. The elements of a list or a dict need
+ * more room than a buffer has, so the runtime writes those itself.
+ */
+const char* format_value(value_t val, char* buf, size_t len) {
+
+    switch(VAL_TYPE(val)) {
+        case VAL_BOOL: return AS_BOOL(val)? "true": "false";
+        case VAL_INT: snprintf(buf, len, "%ld", AS_INT(val)); return buf;
+        case VAL_UINT: snprintf(buf, len, "%lu", AS_UINT(val)); return buf;
+        case VAL_FLOAT: snprintf(buf, len, "%g", AS_FLOAT(val)); return buf;
+        case VAL_STRING: return AS_STRING(val);
+        case VAL_LIST: return "list";
+        case VAL_DICT: return "dict";
+        case VAL_STRUCT: return "struct";
+        default: return "nothing";
+    }
+}
+
+void print_value(FILE* fp, value_t val) {
+
+    char buf[64];
+    fputs(format_value(val, buf, sizeof(buf)), fp);
+}
+
+/*
+ * The payload of a value as 64 bits, for hashing and for writing it out.
+ * A string gives its address. Together with the type it tells values apart.
+ */
+uint64_t value_bits(value_t val) {
+
+    uint64_t bits = 0;
+    double fnum;
+
+    switch(VAL_TYPE(val)) {
+        case VAL_BOOL:
+        case VAL_INT: bits = (uint64_t)AS_INT(val); break;
+        case VAL_UINT: bits = AS_UINT(val); break;
+        case VAL_FLOAT:
+            fnum = AS_FLOAT(val);
+            memcpy(&bits, &fnum, sizeof(bits));
+            break;
+        case VAL_STRING: bits = (uint64_t)(uintptr_t)AS_STR(val); break;
+        default: break;
+    }
+    return bits;
+}
+
+/*
+ * The value of the type from what value_bits() gave. Not for strings.
+ */
+value_t value_from_bits(int type, uint64_t bits) {
+
+    double fnum;
+
+    switch(type) {
+        case VAL_BOOL: return BOOL_VAL(bits != 0);
+        case VAL_INT: return INT_VAL((long)bits);
+        case VAL_UINT: return UINT_VAL(bits);
+        case VAL_FLOAT:
+            memcpy(&fnum, &bits, sizeof(fnum));
+            return FLOAT_VAL(fnum);
+        default: return NOTHING_VAL;
+    }
+}
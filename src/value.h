@@ -0,0 +1,230 @@
+#ifndef __VALUE_H__
+#define __VALUE_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "str.h"
+
+/*
+ * Run time values. Code outside of value.c uses the macros below and does
+ * not look inside of value_t, so that the representation can be changed
+ * without touching the interpreter.
+ */
+typedef enum {
+    VAL_NOTHING,
+    VAL_BOOL,
+    VAL_INT,
+    VAL_UINT,
+    VAL_FLOAT,
+    VAL_STRING,
+    VAL_LIST,
+    VAL_DICT,
+    VAL_STRUCT,
+    VAL_NUM_TYPES,
+} value_type_t;
+
+// a declared type that is not one of the above, such as a list of structs
+#define VAL_ANY     0xFF
+
+// the declared type of a list or a dict, which says what its elements are
+#define LIST_TYPE(e)        (0x10 | (e))
+#define DICT_TYPE(e)        (0x20 | (e))
+#define IS_LIST_TYPE(t)     (((t) & ~0x0F) == 0x10)
+#define IS_DICT_TYPE(t)     (((t) & ~0x0F) == 0x20)
+#define IS_CONTAINER_TYPE(t) (IS_LIST_TYPE(t) || IS_DICT_TYPE(t))
+#define ELEM_TYPE(t)        ((t) & 0x0F)
+
+// the declared type of a struct, which says which of the program's layouts
+// it has; values only know that they are a VAL_STRUCT
+#define STRUCT_TYPE(i)      (0x100 + (i))
+#define IS_STRUCT_TYPE(t)   ((t) >= 0x100)
+
+#define IS_NUMBER_TYPE(t)   ((t) >= VAL_BOOL && (t) <= VAL_FLOAT)
+
+typedef struct _list_t_ list_t; // see list.h
+typedef struct _dict_t_ dict_t; // see dict.h
+typedef struct _struct_t_ struct_t; // see layout.h
+
+/*
+ * A value is one 64 bit word, so that it is passed and returned in a
+ * register. An int that fits in 48 bits is the word itself, so that most
+ * arithmetic needs no decoding at all. A float is its bits with 2^48
+ * added, which moves the doubles out of the way of the ints at the top
+ * and the bottom of the range; a NaN is always stored as the same one so
+ * that none of them ends up among the tags. Everything else has a tag in
+ * the top 16 bits that no float or small int has, and a 48 bit payload:
+ *
+ *   0xFFF6  struct, the address of its struct_t
+ *   0xFFF7  dict, the address of its dict_t
+ *   0xFFF8  nothing
+ *   0xFFF9  bool, 0 or 1
+ *   0xFFFA  string, the address of its str_t
+ *   0xFFFB  list, the address of its list_t
+ *   0xFFFC  uint
+ *   0xFFFD  uint that does not fit, the address of its 64 bits
+ *   0xFFFE  int that does not fit, the address of its 64 bits
+ *   0xFFFF  small ints below zero, 0x0000 small ints from zero up
+ *
+ * The boxed int is next to the small ones and the two uints are next to
+ * each other, so every type check is a compare of the word or of the tag.
+ * Addresses must fit in 48 bits, which is true of user space on x86-64 and
+ * AArch64. A box is in the arena that set_box_arena() set on the thread, so
+ * it goes away with the runtime or the module that the value is part of.
+ */
+typedef struct {
+    uint64_t bits;
+} value_t;
+
+#define VAL_TAG_SHIFT   48
+#define VAL_PAYLOAD     ((UINT64_C(1) << VAL_TAG_SHIFT) - 1)
+#define VAL_SMALL_HALF  (UINT64_C(1) << (VAL_TAG_SHIFT - 1))
+#define VAL_FLOAT_BIAS  (UINT64_C(1) << VAL_TAG_SHIFT)
+#define VAL_CANON_NAN   UINT64_C(0x7FF8000000000000)
+
+#define TAG_STRUCT      UINT64_C(0xFFF6)
+#define TAG_DICT        UINT64_C(0xFFF7)
+#define TAG_NOTHING     UINT64_C(0xFFF8)
+#define TAG_BOOL        UINT64_C(0xFFF9)
+#define TAG_STRING      UINT64_C(0xFFFA)
+#define TAG_LIST        UINT64_C(0xFFFB)
+#define TAG_UINT        UINT64_C(0xFFFC)
+#define TAG_UINT_BOX    UINT64_C(0xFFFD)
+#define TAG_INT_BOX     UINT64_C(0xFFFE)
+
+#define VAL_TAG(v)      ((v).bits >> VAL_TAG_SHIFT)
+#define MAKE_VAL(t, p)  ((value_t){.bits = ((t) << VAL_TAG_SHIFT) | (p)})
+
+// words from TAG_STRUCT up to the small ints, moved to start at zero
+#define VAL_SLOT(v)     ((v).bits + (UINT64_C(10) << VAL_TAG_SHIFT))
+#define VAL_SLOTS       (UINT64_C(11) << VAL_TAG_SHIFT)
+#define VAL_SLOT_TYPES  "\10\7\0\1\5\6\3\3\2\2\2"
+#define VAL_NUMBERS     0x7C8
+
+// the top 17 bits are all the same
+#define IS_SMALL_INT(v) ((uint64_t)((int64_t)(v).bits >> (VAL_TAG_SHIFT - 1)) + 1 <= 1)
+#define IS_FLOAT(v)     (VAL_SLOT(v) >= VAL_SLOTS)
+#define IS_NOTHING(v)   (VAL_TAG(v) == TAG_NOTHING)
+#define IS_BOOL(v)      (VAL_TAG(v) == TAG_BOOL)
+#define IS_INT(v)       ((v).bits + (UINT64_C(2) << VAL_TAG_SHIFT) < \
+                            (UINT64_C(2) << VAL_TAG_SHIFT) + VAL_SMALL_HALF)
+#define IS_UINT(v)      (VAL_TAG(v) >> 1 == TAG_UINT >> 1)
+#define IS_STRING(v)    (VAL_TAG(v) == TAG_STRING)
+#define IS_LIST(v)      (VAL_TAG(v) == TAG_LIST)
+#define IS_DICT(v)      (VAL_TAG(v) == TAG_DICT)
+#define IS_STRUCT(v)    (VAL_TAG(v) == TAG_STRUCT)
+#define IS_NUMBER(v)    (IS_FLOAT(v) || (VAL_NUMBERS >> (VAL_SLOT(v) >> VAL_TAG_SHIFT)) & 1)
+
+#define VAL_TYPE(v)     (IS_FLOAT(v)? VAL_FLOAT: \
+                            VAL_SLOT_TYPES[VAL_SLOT(v) >> VAL_TAG_SHIFT])
+
+#define NOTHING_VAL     MAKE_VAL(TAG_NOTHING, 0)
+#define BOOL_VAL(b)     MAKE_VAL(TAG_BOOL, (b)? 1: 0)
+#define INT_VAL(n)      int_value(n)
+#define UINT_VAL(n)     uint_value(n)
+#define FLOAT_VAL(n)    float_value(n)
+#define STRING_VAL(s)   MAKE_VAL(TAG_STRING, (uint64_t)(uintptr_t)(s))
+#define LIST_VAL(l)     MAKE_VAL(TAG_LIST, (uint64_t)(uintptr_t)(l))
+#define DICT_VAL(d)     MAKE_VAL(TAG_DICT, (uint64_t)(uintptr_t)(d))
+#define STRUCT_VAL(s)   MAKE_VAL(TAG_STRUCT, (uint64_t)(uintptr_t)(s))
+
+#define AS_BOOL(v)      (((v).bits & VAL_PAYLOAD) != 0)
+#define AS_INT(v)       ((long)value_word(v))
+#define AS_UINT(v)      ((unsigned long)value_word(v))
+#define AS_FLOAT(v)     as_float(v)
+#define AS_STR(v)       ((str_t*)(uintptr_t)((v).bits & VAL_PAYLOAD))
+#define AS_STRING(v)    str_text(AS_STR(v))
+#define AS_LIST(v)      ((list_t*)(uintptr_t)((v).bits & VAL_PAYLOAD))
+#define AS_DICT(v)      ((dict_t*)(uintptr_t)((v).bits & VAL_PAYLOAD))
+#define AS_STRUCT(v)    ((struct_t*)(uintptr_t)((v).bits & VAL_PAYLOAD))
+
+#ifdef __GNUC__
+#define VAL_LIKELY(e)   __builtin_expect(!!(e), 1)
+#else
+#define VAL_LIKELY(e)   (e)
+#endif
+
+arena_t* set_box_arena(arena_t* arena);
+value_t box_value(uint64_t tag, uint64_t word);
+
+static inline value_t int_value(long n) {
+
+    value_t v = { .bits = (uint64_t)n };
+    if(VAL_LIKELY(IS_SMALL_INT(v)))
+        return v;
+    return box_value(TAG_INT_BOX, (uint64_t)n);
+}
+
+static inline value_t uint_value(unsigned long n) {
+
+    if(VAL_LIKELY(n <= VAL_PAYLOAD))
+        return MAKE_VAL(TAG_UINT, n);
+    return box_value(TAG_UINT_BOX, n);
+}
+
+static inline value_t float_value(double n) {
+
+    value_t v;
+    if(n != n)
+        v.bits = VAL_CANON_NAN;
+    else
+        memcpy(&v.bits, &n, sizeof(n));
+    v.bits += VAL_FLOAT_BIAS;
+    return v;
+}
+
+static inline double as_float(value_t v) {
+
+    double n;
+    v.bits -= VAL_FLOAT_BIAS;
+    memcpy(&n, &v.bits, sizeof(n));
+    return n;
+}
+
+/*
+ * The 64 bits of an int, a uint or a bool. An int is sign extended and
+ * the others are not, so an int read as a uint is the same as a cast.
+ */
+static inline uint64_t value_word(value_t v) {
+
+    if(VAL_LIKELY(IS_SMALL_INT(v)))
+        return v.bits;
+    if(VAL_TAG(v) == TAG_INT_BOX || VAL_TAG(v) == TAG_UINT_BOX)
+        return *(const uint64_t*)(uintptr_t)(v.bits & VAL_PAYLOAD);
+    return v.bits & VAL_PAYLOAD;
+}
+
+#define VAL_TOSTR(t) ( \
+    ((t) == VAL_NOTHING)? "nothing": \
+    ((t) == VAL_BOOL)? "bool": \
+    ((t) == VAL_INT)? "int": \
+    ((t) == VAL_UINT)? "uint": \
+    ((t) == VAL_FLOAT)? "float": \
+    ((t) == VAL_STRING)? "string": \
+    ((t) == VAL_LIST)? "list": \
+    ((t) == LIST_TYPE(VAL_BOOL))? "bool list": \
+    ((t) == LIST_TYPE(VAL_INT))? "int list": \
+    ((t) == LIST_TYPE(VAL_UINT))? "uint list": \
+    ((t) == LIST_TYPE(VAL_FLOAT))? "float list": \
+    ((t) == LIST_TYPE(VAL_STRING))? "string list": \
+    ((t) == VAL_DICT)? "dict": \
+    ((t) == DICT_TYPE(VAL_BOOL))? "bool dict": \
+    ((t) == DICT_TYPE(VAL_INT))? "int dict": \
+    ((t) == DICT_TYPE(VAL_UINT))? "uint dict": \
+    ((t) == DICT_TYPE(VAL_FLOAT))? "float dict": \
+    ((t) == DICT_TYPE(VAL_STRING))? "string dict": \
+    ((t) == VAL_STRUCT)? "struct": "unknown" \
+    )
+
+value_t zero_value(int type);
+int type_match(int type, int param);
+int value_truth(value_t val);
+int convert_value(value_t* val, int type);
+const char* format_value(value_t val, char* buf, size_t len);
+void print_value(FILE* fp, value_t val);
+uint64_t value_bits(value_t val);
+value_t value_from_bits(int type, uint64_t bits);
+
+#endif
@@ -0,0 +1,346 @@
+/*
+ * The bytecode VM. Registers are slots on a value stack that does not move
+ * and a call makes the callee's frame start at the caller's first argument
+ * register, so the arguments are already in the callee's parameter slots
+ * and the value that is returned lands where the caller wants it.
+ *
+ * With GCC and clang the dispatch is a computed goto at the end of every
+ * instruction, which gives the branch predictor one indirect jump per
+ * instruction to learn from instead of a single shared one. Elsewhere it is
+ * a switch in a loop.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "memory.h"
+#include "parser.h"
+#include "runtime.h"
+#include "bytecode.h"
+#include "vm.h"
+
+#define STACK_SLOTS     (0x01 << 16)
+#define MAX_DEPTH       (0x01 << 12)
+
+#if defined(__GNUC__) && !defined(NO_COMPUTED_GOTO)
+#define USE_COMPUTED_GOTO
+#endif
+
+typedef struct {
+    func_t* fn;
+    const instr_t* pc;      // where to go on in the caller
+    value_t* base;
+} frame_t;
+
+typedef struct {
+    module_t* mod;
+    value_t* stack;
+    value_t* globals;
+    frame_t* frames;
+    dispatch_cache_t* dcache;   // by set in the dispatch table
+    runtime_t rt;
+    FILE* out;
+    uint64_t insns;
+} vm_t;
+
+static const int arith_ops[] = { '+', '-', '*', '/', '%' };
+static const int compare_ops[] = { EQ_OP, NE_OP, '<', '>', LE_OP, GE_OP };
+
+static void runtime_error(vm_t* vm, func_t* fn, const instr_t* ins) {
+
+    code_loc_t* loc = &fn->locs[ins - fn->code];
+
+    fflush(vm->out);
+    fprintf(vm->out, "runtime error: %u: %u: %s\n", loc->line, loc->col, vm->rt.msg);
+}
+
+#ifdef USE_COMPUTED_GOTO
+#define VM_START    DISPATCH();
+#define CASE(n)     L_##n:
+#define DISPATCH()  do { ins = pc++; count++; goto *labels[ins->op]; } while(0)
+#define VM_END
+#else
+#define VM_START    for(;;) { ins = pc++; count++; switch(ins->op) {
+#define CASE(n)     case OP_##n:
+#define DISPATCH()  continue
+#define VM_END      default: goto bad_op; } }
+#endif
+
+#define A           R[ins->a]
+#define B           R[ins->b]
+#define C           R[ins->c]
+#define KC          K[ins->c]
+#define JUMP()      (pc = code + ins->c)
+
+#define FAIL(...)   do { \
+        snprintf(vm->rt.msg, sizeof(vm->rt.msg), __VA_ARGS__); \
+        goto fail; \
+    } while(0)
+#define CHECK(e)    do { if((e) != RT_OK) goto fail; } while(0)
+
+#define GENERIC_ARITH(s, n) \
+    CASE(s) CHECK(rt_binary(&vm->rt, arith_ops[n], B, C, &A)); DISPATCH();
+#define GENERIC_COMPARE(s, n) \
+    CASE(s) CHECK(rt_binary(&vm->rt, compare_ops[n], B, C, &A)); DISPATCH();
+
+#define TYPED_ARITH(s, mk, as, rhs) \
+    CASE(ADD##s) A = mk(as(B) + rhs); DISPATCH(); \
+    CASE(SUB##s) A = mk(as(B) - rhs); DISPATCH(); \
+    CASE(MUL##s) A = mk(as(B) * rhs); DISPATCH();
+#define TYPED_DIV(s, mk, as, rhs) \
+    CASE(DIV##s) if(rhs == 0) FAIL("division by zero"); A = mk(as(B) / rhs); DISPATCH(); \
+    CASE(MOD##s) if(rhs == 0) FAIL("division by zero"); A = mk(as(B) % rhs); DISPATCH();
+// ints wrap around, with the functions of runtime.h
+#define INT_ARITH(s, rhs) \
+    CASE(ADD##s) A = INT_VAL(int_add(AS_INT(B), rhs)); DISPATCH(); \
+    CASE(SUB##s) A = INT_VAL(int_sub(AS_INT(B), rhs)); DISPATCH(); \
+    CASE(MUL##s) A = INT_VAL(int_mul(AS_INT(B), rhs)); DISPATCH(); \
+    CASE(DIV##s) if(rhs == 0) FAIL("division by zero"); A = INT_VAL(int_div(AS_INT(B), rhs)); DISPATCH(); \
+    CASE(MOD##s) if(rhs == 0) FAIL("division by zero"); A = INT_VAL(int_mod(AS_INT(B), rhs)); DISPATCH();
+#define TYPED_COMPARE(s, as, rhs) \
+    CASE(EQ##s) A = BOOL_VAL(as(B) == rhs); DISPATCH(); \
+    CASE(NE##s) A = BOOL_VAL(as(B) != rhs); DISPATCH(); \
+    CASE(LT##s) A = BOOL_VAL(as(B) < rhs); DISPATCH(); \
+    CASE(GT##s) A = BOOL_VAL(as(B) > rhs); DISPATCH(); \
+    CASE(LE##s) A = BOOL_VAL(as(B) <= rhs); DISPATCH(); \
+    CASE(GE##s) A = BOOL_VAL(as(B) >= rhs); DISPATCH();
+#define COMPARE_JUMP(s, rhs) \
+    CASE(JEQ##s) if(AS_INT(A) == rhs) JUMP(); DISPATCH(); \
+    CASE(JNE##s) if(AS_INT(A) != rhs) JUMP(); DISPATCH(); \
+    CASE(JLT##s) if(AS_INT(A) < rhs) JUMP(); DISPATCH(); \
+    CASE(JGT##s) if(AS_INT(A) > rhs) JUMP(); DISPATCH(); \
+    CASE(JLE##s) if(AS_INT(A) <= rhs) JUMP(); DISPATCH(); \
+    CASE(JGE##s) if(AS_INT(A) >= rhs) JUMP(); DISPATCH();
+
+/*
+ * Run the function until it returns. Returns non-zero if it stopped with a
+ * run time error.
+ */
+static int execute(vm_t* vm, func_t* fn) {
+
+#ifdef USE_COMPUTED_GOTO
+    static const void* labels[] = {
+#define OP(n, f) &&L_##n,
+        OPCODES
+#undef OP
+    };
+#endif
+    const value_t* K = vm->mod->consts;
+    frame_t* frame = vm->frames;
+    const instr_t* code = fn->code;
+    const instr_t* pc = code;
+    const instr_t* ins = NULL;
+    value_t* R = vm->stack;
+    uint64_t count = 0;
+    value_t val;
+    func_t* callee;
+    int index;
+
+    if(fn->nregs > STACK_SLOTS) {
+        snprintf(vm->rt.msg, sizeof(vm->rt.msg), "stack overflow");
+        ins = code;
+        goto fail;
+    }
+
+    VM_START
+
+    CASE(MOVE) A = B; DISPATCH();
+    CASE(LOADK) A = K[OPERAND_K(ins)]; DISPATCH();
+    CASE(GETG) A = vm->globals[ins->b]; DISPATCH();
+    CASE(SETG) vm->globals[ins->b] = A; DISPATCH();
+
+    GENERIC_ARITH(ADD, ARITH_ADD)
+    GENERIC_ARITH(SUB, ARITH_SUB)
+    GENERIC_ARITH(MUL, ARITH_MUL)
+    GENERIC_ARITH(DIV, ARITH_DIV)
+    GENERIC_ARITH(MOD, ARITH_MOD)
+    GENERIC_COMPARE(EQ, CMP_EQ)
+    GENERIC_COMPARE(NE, CMP_NE)
+    GENERIC_COMPARE(LT, CMP_LT)
+    GENERIC_COMPARE(GT, CMP_GT)
+    GENERIC_COMPARE(LE, CMP_LE)
+    GENERIC_COMPARE(GE, CMP_GE)
+
+    INT_ARITH(I, AS_INT(C))
+    TYPED_COMPARE(I, AS_INT, AS_INT(C))
+    TYPED_ARITH(U, UINT_VAL, AS_UINT, AS_UINT(C))
+    TYPED_DIV(U, UINT_VAL, AS_UINT, AS_UINT(C))
+    TYPED_COMPARE(U, AS_UINT, AS_UINT(C))
+    TYPED_ARITH(F, FLOAT_VAL, AS_FLOAT, AS_FLOAT(C))
+    CASE(DIVF) A = FLOAT_VAL(AS_FLOAT(B) / AS_FLOAT(C)); DISPATCH();
+    CASE(MODF) A = FLOAT_VAL(fmod(AS_FLOAT(B), AS_FLOAT(C))); DISPATCH();
+    TYPED_COMPARE(F, AS_FLOAT, AS_FLOAT(C))
+    INT_ARITH(IK, AS_INT(KC))
+    TYPED_COMPARE(IK, AS_INT, AS_INT(KC))
+
+    CASE(NEG) CHECK(rt_unary(&vm->rt, '-', B, &A)); DISPATCH();
+    CASE(NOT) A = BOOL_VAL(!value_truth(B)); DISPATCH();
+    CASE(BOOL) A = BOOL_VAL(value_truth(B)); DISPATCH();
+    CASE(CONV) val = B; CHECK(rt_convert(&vm->rt, &val, ins->c)); A = val; DISPATCH();
+    CASE(CAST) val = B; CHECK(rt_cast(&vm->rt, &val, ins->c)); A = val; DISPATCH();
+
+    CASE(JMP) JUMP(); DISPATCH();
+    CASE(JMPF) if(!value_truth(A)) JUMP(); DISPATCH();
+    CASE(JMPT) if(value_truth(A)) JUMP(); DISPATCH();
+    COMPARE_JUMP(I, AS_INT(B))
+    COMPARE_JUMP(IK, AS_INT(K[ins->b]))
+
+    CASE(CALLD)
+        CHECK(rt_dispatch(&vm->rt, vm->mod->dispatch + ins->b, R + ins->a,
+                        &vm->dcache[ins->b], &index));
+        callee = &vm->mod->funcs[index];
+        goto call;
+
+    CASE(CALL)
+        callee = &vm->mod->funcs[ins->b];
+    call: {
+        value_t* base = R + ins->a;
+        if(frame - vm->frames >= MAX_DEPTH - 1)
+            FAIL("calls are nested too deeply");
+        if(base + callee->nregs > vm->stack + STACK_SLOTS)
+            FAIL("stack overflow");
+        frame->fn = fn;
+        frame->pc = pc;
+        frame->base = R;
+        frame++;
+        fn = callee;
+        code = pc = fn->code;
+        R = base;
+        DISPATCH();
+    }
+
+    CASE(BUILTIN)
+        switch(ins->b) {
+            case BUILTIN_PRINT:
+                rt_print(&vm->rt, vm->out, R + ins->a, ins->c);
+                A = NOTHING_VAL;
+                break;
+            case BUILTIN_APPEND:
+                CHECK(rt_append(&vm->rt, A, R + ins->a + 1, 1));
+                A = NOTHING_VAL;
+                break;
+            case BUILTIN_LENGTH:
+                CHECK(rt_length(&vm->rt, A, &A));
+                break;
+            case BUILTIN_SLICE:
+                CHECK(rt_slice(&vm->rt, A, R[ins->a + 1], R[ins->a + 2], &A));
+                break;
+            case BUILTIN_HAS:
+                CHECK(rt_has(&vm->rt, A, R[ins->a + 1], &A));
+                break;
+            default:
+                FAIL("unknown builtin");
+        }
+        DISPATCH();
+
+    CASE(FMT)
+        CHECK(rt_format(&vm->rt, vm->mod->formats[ins->b], R + ins->a + 1, ins->c, &A));
+        DISPATCH();
+
+    CASE(NEW) CHECK(rt_new(&vm->rt, ins->b, R + ins->a + 1, ins->c, &A)); DISPATCH();
+    CASE(EXTEND) CHECK(rt_extend(&vm->rt, A, R + ins->a + 1, ins->c)); DISPATCH();
+
+    CASE(GETIDX)
+        // an int index that is in range is read here, the rest is checked
+        if(IS_LIST(B) && IS_SMALL_INT(C) && (uint64_t)AS_INT(C) < AS_LIST(B)->len)
+            A = list_get(AS_LIST(B), AS_INT(C));
+        else
+            CHECK(rt_index(&vm->rt, B, C, &A));
+        DISPATCH();
+
+    CASE(SETIDX) CHECK(rt_set_index(&vm->rt, A, B, C)); DISPATCH();
+
+    CASE(INST) A = rt_instance(&vm->rt, ins->b); DISPATCH();
+
+    CASE(GETF)
+        if(VAL_LIKELY(IS_STRUCT(B)))
+            A = field_get(AS_STRUCT(B), FIELD_OFFSET(ins->c), FIELD_STORED(ins->c));
+        else
+            CHECK(rt_get_field(&vm->rt, B, FIELD_OFFSET(ins->c), FIELD_STORED(ins->c), &A));
+        DISPATCH();
+
+    CASE(SETF) CHECK(rt_set_field(&vm->rt, A, FIELD_OFFSET(ins->b), FIELD_STORED(ins->b), C)); DISPATCH();
+
+    CASE(RET)
+        R[0] = A;
+        if(frame == vm->frames)
+            goto done;
+        frame--;
+        fn = frame->fn;
+        code = fn->code;
+        pc = frame->pc;
+        R = frame->base;
+        DISPATCH();
+
+    CASE(RETN)
+        R[0] = NOTHING_VAL;
+        if(frame == vm->frames)
+            goto done;
+        frame--;
+        fn = frame->fn;
+        code = fn->code;
+        pc = frame->pc;
+        R = frame->base;
+        DISPATCH();
+
+    CASE(ERR) FAIL("%s", AS_STRING(K[ins->b]));
+
+    VM_END
+
+#ifndef USE_COMPUTED_GOTO
+bad_op:
+    FAIL("bad instruction %d", ins->op);
+#endif
+
+fail:
+    vm->insns += count;
+    runtime_error(vm, fn, ins);
+    return 1;
+
+done:
+    vm->insns += count;
+    return 0;
+}
+
+int run_module(module_t* mod, FILE* out, vm_stats_t* stats) {
+
+    vm_t vm;
+    int status = 0;
+
+    memset(&vm, 0, sizeof(vm));
+    vm.mod = mod;
+    vm.out = out;
+    init_runtime(&vm.rt);
+    vm.rt.layouts = mod->layouts;
+    vm.stack = ALLOC_LST(STACK_SLOTS, value_t);
+    vm.frames = ALLOC_LST(MAX_DEPTH, frame_t);
+    vm.globals = ALLOC_LST(mod->nglobals + 1, value_t);
+    vm.dcache = ALLOC_LST(mod->ndispatch + 1, dispatch_cache_t);
+
+    for(int i = 0; i < mod->nglobals; i++)
+        vm.globals[i] = zero_value(mod->global_types[i]);
+    status = execute(&vm, &mod->funcs[mod->init]);
+    if(status == 0 && mod->entry >= 0)
+        status = execute(&vm, &mod->funcs[mod->entry]);
+
+    if(stats != NULL)
+        stats->insns = vm.insns;
+
+    fflush(out);
+    FREE(vm.dcache);
+    FREE(vm.globals);
+    FREE(vm.frames);
+    FREE(vm.stack);
+    free_runtime(&vm.rt);
+    return status;
+}
+
+int run_bytecode(ast_t* ast, FILE* out) {
+
+    program_t* prog = resolve_program(ast);
+    module_t* mod = compile_program(prog);
+    int status = run_module(mod, out, NULL);
+    destroy_module(mod);
+    destroy_program(prog);
+    return status;
+}
@@ -0,0 +1,24 @@
+#ifndef __VM_H__
+#define __VM_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include "bytecode.h"
+
+typedef struct {
+    uint64_t insns;         // instructions executed
+} vm_stats_t;
+
+/*
+ * Run the entry block of a compiled module, after the name space variables
+ * are initialized. The result is the same as run_program() gives for the
+ * program that the module was compiled from, except that a value that
+ * cannot be converted to the return type is reported at the return and not
+ * at the call. The statistics are filled in if they are not NULL.
+ */
+int run_module(module_t* mod, FILE* out, vm_stats_t* stats);
+
+// resolve, compile and run the AST of a file that parsed without errors
+int run_bytecode(ast_t* ast, FILE* out);
+
+#endif